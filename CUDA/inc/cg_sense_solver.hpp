@@ -0,0 +1,163 @@
+#ifndef CG_SENSE_SOLVER_H_INCLUDED
+#define CG_SENSE_SOLVER_H_INCLUDED
+
+#include "gpuNUFFT_types.hpp"
+#include "gpuNUFFT_operator.hpp"
+#include "thread_pool.hpp"
+#include <vector>
+
+namespace gpuNUFFT
+{
+/**
+ * \brief Iterative SENSE reconstruction by conjugate gradients
+ *
+ * Solves the normal equations
+ *
+ * (A^H A + alpha I) x = A^H y
+ *
+ * of the encoding operator A (NUFFT of the coil images S_c x) for the image
+ * x, starting at x = 0. The iterations match the CG of
+ * matlab/demo/utils/cg_sense_2d.m and cg_sense_3d.m with Tikhonov
+ * regularization alpha, but are performed inside the library.
+ *
+ * The coil sensitivities are either applied by the operator itself or
+ * passed to the solver for an operator without sensitivities, which then
+ * processes the coil images as channels. A^H A is applied by
+ * CpuNUFFTOperator::performNormal on the host, other operators perform
+ * forward and adjoint operation into buffers of the solver.
+ *
+ * The vector operations of each iteration are fused into three passes over
+ * the image: coil combination and regularization compute p^H q, the update
+ * of x and r computes |r|^2, followed by the update of the search
+ * direction. All buffers are allocated by the first solve and reused by
+ * subsequent calls of the same problem size.
+ */
+class CgSenseSolver
+{
+ public:
+  /** \brief CgSenseSolver ctor
+    *
+    * @param gpuNUFFTOp   NUFFT operator A, referenced during the lifetime of
+    *the solver
+    * @param sens         coil sensitivities applied by the solver, empty if
+    *the operator applies its own or for single coil data
+    * @param threadPool   thread pool used for the vector updates, NULL
+    *selects the default thread pool
+    */
+  CgSenseSolver(GpuNUFFTOperator *gpuNUFFTOp,
+                Array<DType2> sens = Array<DType2>(),
+                ThreadPool *threadPool = NULL);
+
+  /** \brief Set the maximum amount of iterations, default 10 */
+  void setMaxIterations(int maxIterations)
+  {
+    this->maxIterations = maxIterations;
+  }
+
+  int getMaxIterations() const
+  {
+    return maxIterations;
+  }
+
+  /** \brief Set the relative tolerance of the residual norm, default 0 (all
+   * iterations are performed)
+   *
+   * The iterations stop as soon as |r| <= tolerance * |A^H y|.
+   */
+  void setTolerance(DType tolerance)
+  {
+    this->tolerance = tolerance;
+  }
+
+  DType getTolerance() const
+  {
+    return tolerance;
+  }
+
+  /** \brief Set the weight alpha of the Tikhonov regularization, default 0 */
+  void setRegularization(DType alpha)
+  {
+    this->alpha = alpha;
+  }
+
+  DType getRegularization() const
+  {
+    return alpha;
+  }
+
+  /** \brief Reconstruct the image of the k-space data
+    *
+    * @param kspaceData k-space data, one channel per coil
+    * @param imgData    preallocated output image with one channel
+    * @return amount of iterations performed
+    */
+  int solve(Array<DType2> kspaceData, Array<CufftType> &imgData);
+
+  /** \brief Reconstruct the image of the k-space data
+    *
+    * The memory for the output array is allocated automatically but has to be
+    *freed manually.
+    *
+    * @param kspaceData k-space data
+    * @return reconstructed image
+    */
+  Array<CufftType> solve(Array<DType2> kspaceData);
+
+  /** \brief Residual norms |r| of the last solve, starting with |A^H y| */
+  const std::vector<double> &getResidualNorms() const
+  {
+    return residualNorms;
+  }
+
+ private:
+  /** \brief q = (A^H A + alpha I) p, returns the real part of p^H q */
+  double applySystemMatrix();
+
+  /** \brief Allocate the buffers of the coils, dataCount samples each */
+  void reserveBuffers(IndType dataCount);
+
+  /** \brief Return thread pool used for processing */
+  ThreadPool *getThreadPool()
+  {
+    return (threadPool != NULL) ? threadPool : &ThreadPool::getDefault();
+  }
+
+  GpuNUFFTOperator *gpuNUFFTOp;
+
+  /** \brief Coil sensitivities applied by the solver, NULL otherwise */
+  Array<DType2> sens;
+
+  Dimensions imgDims;
+
+  /** \brief Amount of coils of the current solve */
+  IndType coilCount;
+
+  int maxIterations;
+  DType tolerance;
+  DType alpha;
+
+  /** \brief Solution x, residual r, search direction p and q = M p */
+  std::vector<CufftType> x;
+  std::vector<CufftType> r;
+  std::vector<CufftType> p;
+  std::vector<CufftType> q;
+
+  /** \brief Coil images S_c p and A^H A S_c p if the solver applies the
+   * sensitivities */
+  std::vector<CufftType> coilImages;
+  std::vector<CufftType> coilNormal;
+
+  /** \brief k-space buffer of operators without normal operation */
+  std::vector<CufftType> kspace;
+
+  /** \brief Partial inner products of the image blocks */
+  std::vector<double> partialSums;
+
+  std::vector<double> residualNorms;
+
+  /** \brief Thread pool used for processing, NULL for the default pool */
+  ThreadPool *threadPool;
+};
+}
+
+#endif  // CG_SENSE_SOLVER_H_INCLUDED
@@ -8,7 +8,8 @@
  * @file
  * \brief Definition of types used in gpuNUFFT
  *
- * Depends on CMAKE build parameters MATLAB_DEBUG, DEBUG, GPU_DOUBLE_PREC
+ * Depends on CMAKE build parameters MATLAB_DEBUG, DEBUG, GPU_DOUBLE_PREC,
+ * GPU_INDEX64
  *
  */
 
@@ -16,6 +17,7 @@
 #define DEBUG @DEBUG@
 
 #cmakedefine GPU_DOUBLE_PREC
+#cmakedefine GPU_INDEX64
 
 #ifdef GPU_DOUBLE_PREC
   typedef double DType;
@@ -29,7 +31,11 @@
   typedef cufftComplex CufftType;
 #endif
 
-typedef unsigned int IndType;
+#ifdef GPU_INDEX64
+  typedef unsigned long long IndType;
+#else
+  typedef unsigned int IndType;
+#endif
 
 /** \brief Combined 2-tuple (x,y) of IndType */
 typedef struct IndType2
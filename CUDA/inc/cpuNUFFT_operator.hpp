@@ -0,0 +1,452 @@
+#ifndef CPUNUFFT_OPERATOR_H_INCLUDED
+#define CPUNUFFT_OPERATOR_H_INCLUDED
+
+#include "gpuNUFFT_types.hpp"
+#include "gpuNUFFT_operator.hpp"
+#include "balanced_operator.hpp"
+#include "thread_pool.hpp"
+#include "gpuNUFFT_cpu_kernels.hpp"
+
+#include <vector>
+#include <algorithm>
+
+namespace gpuNUFFT
+{
+/**
+* \brief GpuNUFFTOperator executed on the host CPU, inherited from
+*gpuNUFFT::GpuNUFFTOperator
+*
+* Performs all gridding steps (density compensation, convolution, FFT,
+* cropping/padding, deapodization and coil sensitivity handling) in host
+* memory using the threads of a gpuNUFFT::ThreadPool. The results match the
+* ones of the GPU implementation, thus the operator can be used on machines
+* without CUDA device or as reference implementation.
+*
+* Coils are gridded in batches: the kernel weights of each sample are
+* evaluated once and applied to all coils of a batch, which are stored
+* coil-interleaved on an oversampled grid per batch (see setCoilBatchSize).
+* FFT, deapodization and coil sensitivity handling are performed per coil.
+* The deapodization is applied as outer product of one vector per image axis
+* (see setDeapodizationVectors) unless a deapodization volume is set.
+* Only host arrays are supported, the GpuArray overloads throw
+* std::runtime_error.
+*
+* The sector processing order (chunks of the sectors sorted by estimated
+* cost) is computed by the factory using a gpuNUFFT::LoadBalancer, by default
+* the gpuNUFFT::CostModelBalancer. The convolutions schedule its chunks by
+* work stealing (see gpuNUFFT::ThreadPool::parallelForStealing), thus densely
+* sampled central sectors are processed by several threads.
+*
+* Optionally the sparse gridding matrix can be precomputed (see
+* precomputeGriddingMatrix), which replaces the kernel evaluation of each
+* convolution by a sparse matrix vector product. This pays off if the
+* operator is applied many times, e.g. in iterative reconstructions.
+*
+* Created by the gpuNUFFT::GpuNUFFTOperatorFactory if the factory is
+* initialized with useGpu set to false.
+*/
+class CpuNUFFTOperator : public GpuNUFFTOperator, public BalancedOperator
+{
+ public:
+  /** \brief CpuNUFFTOperator ctor
+    *
+    * @param kernelWidth  kernel width in grid units
+    * @param sectorWidth  sector width in grid units
+    * @param osf          oversampling factor
+    * @param imgDims      image dimensions of problem
+    * @param matlabSharedMem Flag to indicate that the data arrays are owned
+    *by Matlab
+    * @param threadPool   thread pool used for processing, NULL selects the
+    *default thread pool
+    */
+  CpuNUFFTOperator(IndType kernelWidth, IndType sectorWidth, DType osf,
+                   Dimensions imgDims, bool matlabSharedMem = false,
+                   ThreadPool *threadPool = NULL)
+    : GpuNUFFTOperator(kernelWidth, sectorWidth, osf, imgDims, true, CPU,
+                       matlabSharedMem),
+      threadPool(threadPool), coilBatchSize(0), dataCount(0),
+      foldFFTShift(true), prunedFFT(true)
+  {
+  }
+
+  /** \brief Default memory budget of the gridding matrix in bytes */
+  static const size_t DEFAULT_GRIDDING_MATRIX_BUDGET = 1024 * 1024 * 1024;
+
+  /** \brief Memory budget of the buffers of a call besides the plan arrays
+   * in bytes, limits the automatically selected coil batch size
+   *
+   * @see MemoryPlanner
+   */
+  static const size_t DEFAULT_COIL_BATCH_MEMORY = 256 * 1024 * 1024;
+
+  ~CpuNUFFTOperator()
+  {
+    if (!matlabSharedMem)
+    {
+      freeLocalMemberArray(this->sectorProcessingOrder.data);
+      freeLocalMemberArray(this->deapoVectors.data);
+    }
+  }
+
+  Array<IndType2> getSectorProcessingOrder()
+  {
+    return this->sectorProcessingOrder;
+  }
+  /** \brief Set the processing order of the chunks
+   *
+   * Discards the chunks cached by the convolutions, thus it has to be called
+   * after the sector mapping is changed in place.
+   */
+  void setSectorProcessingOrder(Array<IndType2> sectorProcessingOrder)
+  {
+    this->sectorProcessingOrder = sectorProcessingOrder;
+    workspace.convolution.invalidate();
+  }
+
+  /** \brief Set the separable deapodization factors of the image axes
+   *
+   * Used instead of the deapodization function if no image volume of
+   * deapodization values is set, see computeDeapodizationVectors.
+   */
+  void setDeapodizationVectors(Array<DType> deapoVectors)
+  {
+    this->deapoVectors = deapoVectors;
+  }
+  Array<DType> getDeapodizationVectors()
+  {
+    return this->deapoVectors;
+  }
+
+  /** \brief Set the amount of samples per coil of the k-space data arrays
+   *
+   * Required if the sorted arrays contain unused slots (data index
+   * INVALID_DATA_INDEX) or the data indices do not cover all samples, see
+   * gpuNUFFT::IncrementalPlan. Unused slots are gridded with zero data and
+   * their interpolated values are dropped. 0 selects the length of the
+   * sorted trajectory.
+   */
+  void setDataCount(IndType dataCount)
+  {
+    this->dataCount = dataCount;
+  }
+  IndType getDataCount()
+  {
+    return dataCount > 0 ? dataCount : this->kSpaceTraj.count();
+  }
+
+  /** \brief Compute the separable deapodization factors of the kernel
+   *
+   * @return newly allocated array of width + height (+ depth) values, see
+   *computeDeapodizationVectorsCPU
+   */
+  Array<DType> computeDeapodizationVectors();
+
+  /** \brief Set thread pool used for processing, NULL selects the default
+   * thread pool */
+  void setThreadPool(ThreadPool *threadPool)
+  {
+    this->threadPool = threadPool;
+  }
+
+  /** \brief Return thread pool used for processing */
+  ThreadPool *getThreadPool()
+  {
+    return (threadPool != NULL) ? threadPool : &ThreadPool::getDefault();
+  }
+
+  /** \brief Set the amount of coils gridded at once
+   *
+   * A batch of n coils requires n oversampled grids and sorted k-space
+   * buffers. 0 selects the largest batch whose buffers fit into
+   * DEFAULT_COIL_BATCH_MEMORY, 1 disables batching.
+   */
+  void setCoilBatchSize(IndType coilBatchSize)
+  {
+    this->coilBatchSize = coilBatchSize;
+  }
+
+  /** \brief Return the amount of coils gridded at once, 0 for automatic
+   * selection */
+  IndType getCoilBatchSize() const
+  {
+    return coilBatchSize;
+  }
+
+  /** \brief Set whether the FFT shifts are folded into crop and padding
+   *
+   * If enabled (default) the grid is transformed without the two cyclic
+   * shift passes, crop and padding apply the shifts as index mapping and
+   * phase, see performCropDeapodizationCPU. Results match the separate
+   * shift passes up to rounding for even and odd grid dimensions.
+   */
+  void setFoldFFTShift(bool foldFFTShift)
+  {
+    this->foldFFTShift = foldFFTShift;
+  }
+
+  /** \brief Return true if the FFT shifts are folded into crop and
+   * padding */
+  bool getFoldFFTShift() const
+  {
+    return foldFFTShift;
+  }
+
+  /** \brief Set whether the FFTs skip the pencils outside of the image
+   *
+   * If enabled (default) the forward FFT skips the pencils of the zero
+   * padding and the adjoint FFT the pencils of the cropped away grid points,
+   * see CpuFFTPlan::executePruned. Results are identical.
+   */
+  void setPrunedFFT(bool prunedFFT)
+  {
+    this->prunedFFT = prunedFFT;
+  }
+
+  /** \brief Return true if the FFTs skip the pencils outside of the
+   * image */
+  bool getPrunedFFT() const
+  {
+    return prunedFFT;
+  }
+
+  /** \brief Precompute the sparse gridding matrix of the trajectory
+   *
+   * Requires the sector mapping to be set. Subsequent convolutions use the
+   * matrix instead of evaluating the kernel on-the-fly. The matrix has to be
+   * recomputed if the trajectory is changed afterwards.
+   *
+   * @param memoryBudget maximum size of the matrix in bytes
+   * @return false if the matrix exceeds the memory budget, the convolution is
+   *performed on-the-fly in that case
+   */
+  bool precomputeGriddingMatrix(
+      size_t memoryBudget = DEFAULT_GRIDDING_MATRIX_BUDGET);
+
+  /** \brief Release the gridding matrix and return to on-the-fly
+   * convolution */
+  void releaseGriddingMatrix()
+  {
+    griddingMatrix.clear();
+  }
+
+  /** \brief Return true if the convolutions use the gridding matrix */
+  bool hasGriddingMatrix() const
+  {
+    return !griddingMatrix.empty();
+  }
+
+  /** \brief Return the gridding matrix, empty if not precomputed */
+  const CpuGriddingMatrix &getGriddingMatrix() const
+  {
+    return griddingMatrix;
+  }
+
+  // OPERATIONS
+  using GpuNUFFTOperator::performGpuNUFFTAdj;
+  using GpuNUFFTOperator::performForwardGpuNUFFT;
+
+  void performGpuNUFFTAdj(Array<DType2> kspaceData, Array<CufftType> &imgData,
+                          GpuNUFFTOutput gpuNUFFTOut = DEAPODIZATION);
+  void performGpuNUFFTAdj(GpuArray<DType2> kspaceData_gpu,
+                          GpuArray<CufftType> &imgData_gpu,
+                          GpuNUFFTOutput gpuNUFFTOut = DEAPODIZATION);
+
+  void performForwardGpuNUFFT(Array<DType2> imgData,
+                              Array<CufftType> &kspaceData,
+                              GpuNUFFTOutput gpuNUFFTOut = DEAPODIZATION);
+  void performForwardGpuNUFFT(GpuArray<DType2> imgData_gpu,
+                              GpuArray<CufftType> &kspaceData_gpu,
+                              GpuNUFFTOutput gpuNUFFTOut = DEAPODIZATION);
+
+  /** \brief Normal operator NUFFT^H W NUFFT on the host
+   *
+   * Performs the forward operation, the optional weighting of the k-space
+   * samples and the adjoint operation coil batch by coil batch without
+   * writing the intermediate k-space data back to the caller. Density
+   * compensation and coil sensitivities are applied as by
+   * performForwardGpuNUFFT and performGpuNUFFTAdj, thus the result equals
+   * performGpuNUFFTAdj(weights * performForwardGpuNUFFT(imgData)). In
+   * contrast to the ToeplitzNormalOperator the gridding is not approximated
+   * and the weights may change between calls, e.g. in iterative
+   * reconstructions with data weighting.
+   *
+   * The buffers are kept in a workspace of the operator (see
+   * getWorkspaceBytes), calls after the first one do not allocate grid,
+   * k-space or image memory. Concurrent calls on the same operator are not
+   * supported.
+   *
+   * @param imgData    image, one channel per coil without sensitivities
+   * @param normalData output image of the same layout
+   * @param weights    real weights of the samples of one coil, applied to
+   *all coils, no weighting if empty
+   */
+  void performNormal(Array<DType2> imgData, Array<CufftType> &normalData,
+                     Array<DType> weights = Array<DType>());
+
+  /** \brief Bytes held by the workspace of the host operations */
+  size_t getWorkspaceBytes() const;
+
+  /** \brief Release the workspace, it is reallocated by the next call */
+  void releaseWorkspace();
+
+  OperatorType getType()
+  {
+    return gpuNUFFT::CPU;
+  }
+
+ protected:
+  /** \brief Compute the meta information without copying it to the GPU */
+  GpuNUFFTInfo *initAndCopyGpuNUFFTInfo(int n_coils_cc = 1);
+
+  /** \brief Update the meta information of a single coil in hostInfo,
+   * which is kept to avoid an allocation per call */
+  GpuNUFFTInfo *updateHostInfo();
+
+  void adjConvolution(DType2 *data_d, DType *crds_d, CufftType *gdata_d,
+                      DType *kernel_d, IndType *sectors_d,
+                      IndType *sector_centers_d,
+                      gpuNUFFT::GpuNUFFTInfo *gi_host);
+
+  void forwardConvolution(CufftType *data_d, DType *crds_d, CufftType *gdata_d,
+                          DType *kernel_d, IndType *sectors_d,
+                          IndType *sector_centers_d,
+                          gpuNUFFT::GpuNUFFTInfo *gi_host);
+
+  /** \brief Adjoint convolution of coilCount coil-interleaved channels */
+  void adjConvolutionBatch(DType2 *data, CufftType *gdata, IndType coilCount,
+                           gpuNUFFT::GpuNUFFTInfo *gi_host);
+
+  /** \brief Forward convolution of coilCount coil-interleaved channels */
+  void forwardConvolutionBatch(CufftType *data, CufftType *gdata,
+                               IndType coilCount,
+                               gpuNUFFT::GpuNUFFTInfo *gi_host);
+
+  /** \brief Return the amount of coils gridded at once for n_coils coils */
+  IndType selectCoilBatchSize(IndType n_coils);
+
+  /** \brief Grow the workspace to coil batches of batch_size coils */
+  void reserveWorkspace(IndType batch_size, GpuNUFFTInfo *gi_host);
+
+  /** \brief FFT shift of the grid gdata of a single coil, the copy of the
+   * grid is kept in the workspace */
+  void applyFFTShift(CufftType *gdata, FFTShiftDir shift_dir,
+                       GpuNUFFTInfo *gi_host);
+
+  /** \brief Forward operation of the coils [batch_it, batch_it +
+   * batch_count) up to the sorted, coil-interleaved k-space data of the
+   * workspace */
+  void forwardBatch(Array<DType2> imgData, int batch_it, IndType batch_count,
+                    GpuNUFFTInfo *gi_host);
+
+  /** \brief Adjoint operation of the sorted, coil-interleaved k-space data
+   * of the workspace, coil images are summed up if sensitivities are applied
+   *
+   * @return false if the output stops after the FFT step
+   */
+  bool adjointBatch(int batch_it, IndType batch_count,
+                    Array<CufftType> &imgData, GpuNUFFTOutput gpuNUFFTOut,
+                    GpuNUFFTInfo *gi_host);
+
+ private:
+  /** \brief Thread pool used for processing, NULL for the default pool */
+  ThreadPool *threadPool;
+
+  /** \brief Chunks (sector, sample offset) sorted by load, computed on
+   * demand by the convolutions if empty */
+  Array<IndType2> sectorProcessingOrder;
+
+  /** \brief Separable deapodization factors of the image axes */
+  Array<DType> deapoVectors;
+
+  /** \brief Precomputed gridding matrix, empty for on-the-fly convolution */
+  CpuGriddingMatrix griddingMatrix;
+
+  /** \brief Amount of coils gridded at once, 0 for automatic selection */
+  IndType coilBatchSize;
+
+  /** \brief Automatically selected coil batch size and the parameters it
+   * was selected for */
+  struct CoilBatchSelection
+  {
+    CoilBatchSelection()
+      : coilCount(0), dataCount(0), slotCount(0), orderCount(0),
+        threadCount(0), densComp(false), sensData(false), batchSize(0)
+    {
+    }
+
+    bool operator==(const CoilBatchSelection &other) const
+    {
+      return coilCount == other.coilCount && dataCount == other.dataCount &&
+             slotCount == other.slotCount &&
+             orderCount == other.orderCount &&
+             threadCount == other.threadCount &&
+             densComp == other.densComp && sensData == other.sensData;
+    }
+
+    IndType coilCount;
+    IndType dataCount;
+    IndType slotCount;
+    IndType orderCount;
+    unsigned threadCount;
+    bool densComp;
+    bool sensData;
+    IndType batchSize;
+  };
+
+  CoilBatchSelection coilBatchSelection;
+
+  /** \brief Meta information of the host operations */
+  GpuNUFFTInfo hostInfo;
+
+  /** \brief Samples per coil of the k-space data, 0 for the length of the
+   * sorted trajectory */
+  IndType dataCount;
+
+  /** \brief FFT shifts are folded into crop and padding */
+  bool foldFFTShift;
+
+  /** \brief FFTs skip the pencils outside of the image */
+  bool prunedFFT;
+
+  /** \brief Buffers of the host operations, kept between calls */
+  struct Workspace
+  {
+    /** \brief Sorted, coil-interleaved k-space data of a coil batch */
+    std::vector<CufftType> kspaceBatch;
+    /** \brief Coil-interleaved grids of a coil batch */
+    std::vector<CufftType> gridBatch;
+    /** \brief Grid of a single coil */
+    std::vector<CufftType> grid;
+    /** \brief Copy of the grid of the FFT shifts which are not folded */
+    std::vector<CufftType> shiftGrid;
+    /** \brief Pencil offsets and batch buffers of the FFTs */
+    CpuFFTPlan::Scratch fft;
+    /** \brief Chunks, sector grids and kernel windows of the convolutions */
+    CpuConvolutionWorkspace convolution;
+    /** \brief Image supports of the pruned FFTs, crop and padding */
+    CpuFFTPlan::Support supports[2];
+    /** \brief Image and grid size of the supports */
+    Dimensions imgDims;
+    Dimensions gridDims;
+
+    void swap(Workspace &other)
+    {
+      kspaceBatch.swap(other.kspaceBatch);
+      gridBatch.swap(other.gridBatch);
+      grid.swap(other.grid);
+      shiftGrid.swap(other.shiftGrid);
+      fft.swap(other.fft);
+      convolution.swap(other.convolution);
+      for (int i = 0; i < 2; i++)
+        for (int axis = 0; axis < 3; axis++)
+          supports[i].axes[axis].swap(other.supports[i].axes[axis]);
+      std::swap(imgDims, other.imgDims);
+      std::swap(gridDims, other.gridDims);
+    }
+  };
+
+  Workspace workspace;
+};
+}
+
+#endif  // CPUNUFFT_OPERATOR_H_INCLUDED
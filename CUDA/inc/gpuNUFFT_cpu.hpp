@@ -2,11 +2,75 @@
 #define GPUNUFFT_CPU_H_
 
 #include "gpuNUFFT_utils.hpp"
+#include "gpuNUFFT_types.hpp"
+#include "thread_pool.hpp"
 
-/** \brief CPU implementation of gridding */
+/** \brief Initialize the gridding related members of gi_host
+ *
+ * Computes the same kernel radius, sector padding and anisotropic scaling
+ * values as gpuNUFFT::GpuNUFFTOperator::initGpuNUFFTInfo for the oversampled
+ * grid gridDims (depth 0 for 2-d grids). The sector count is set to the
+ * amount of sectors needed to cover the grid.
+ */
+void initGpuNUFFTInfoCPU(gpuNUFFT::GpuNUFFTInfo *gi_host,
+                         gpuNUFFT::Dimensions gridDims, int sector_width,
+                         int kernel_width, int kernel_count);
+
+/** \brief CPU implementation of gridding
+ *
+ * Grids the (sector sorted) samples data at the coordinates crds onto the
+ * grid gdata of size gi_host->gridDims. Coordinates are stored interleaved,
+ * (x,y) per sample and sector center in the 2-d case and (x,y,z) in the
+ * 3-d case. Kernel distances are scaled by the aniso_*_scale factors like in
+ * the CUDA kernels, thus anisotropic grids are supported. Grid points
+ * outside of the grid are skipped.
+ *
+ * The samples are converted to the layout of the host gridding kernels and
+ * gridded by performConvolutionCPU with SKIP_GRID_BOUNDARY, using the
+ * threads of threadPool, or the default ThreadPool if none is passed.
+ */
+void gpuNUFFT_cpu(DType *data, DType *crds, DType *gdata, DType *kernel,
+                  int *sectors, int *sector_centers,
+                  gpuNUFFT::GpuNUFFTInfo *gi_host,
+                  gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief CPU implementation of gridding onto a cubic 3-d grid of size
+ * width^3
+ *
+ * @see gpuNUFFT_cpu
+ */
 void gpuNUFFT_cpu(DType *data, DType *crds, DType *gdata, DType *kernel,
                   int *sectors, int sector_count, int *sector_centers,
                   int sector_width, int kernel_width, int kernel_count,
-                  int width);
+                  int width, gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief CPU implementation of the forward gridding (interpolation)
+ *
+ * Interpolates the samples at the (sector sorted) coordinates crds from the
+ * grid gdata, i.e. performs the adjoint operation of gpuNUFFT_cpu. The
+ * resulting complex samples are written in sorted order to data or, if
+ * data_indices is passed, to their original positions data_indices[i].
+ *
+ * The samples are interpolated by performForwardConvolutionCPU with
+ * SKIP_GRID_BOUNDARY using the threads of threadPool, or the default
+ * ThreadPool if none is passed.
+ */
+void gpuNUFFT_forward_cpu(DType *data, DType *crds, DType *gdata,
+                          DType *kernel, int *sectors, int *sector_centers,
+                          gpuNUFFT::GpuNUFFTInfo *gi_host,
+                          IndType *data_indices = NULL,
+                          gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief CPU implementation of the forward gridding from a cubic 3-d grid
+ * of size width^3
+ *
+ * @see gpuNUFFT_forward_cpu
+ */
+void gpuNUFFT_forward_cpu(DType *data, DType *crds, DType *gdata,
+                          DType *kernel, int *sectors, int sector_count,
+                          int *sector_centers, int sector_width,
+                          int kernel_width, int kernel_count, int width,
+                          IndType *data_indices = NULL,
+                          gpuNUFFT::ThreadPool *threadPool = NULL);
 
 #endif  // GPUNUFFT_CPU_H_
@@ -0,0 +1,199 @@
+#ifndef GPUNUFFT_CPU_FFT_H_INCLUDED
+#define GPUNUFFT_CPU_FFT_H_INCLUDED
+
+#include "config.hpp"
+#include "gpuNUFFT_types.hpp"
+#include "thread_pool.hpp"
+#include <vector>
+
+/**
+ * @file
+ * \brief Host FFT used by the CPU gridding operator
+ *
+ * Complex-to-complex in-place transform of a 2-d or 3-d grid in x-fastest
+ * (column major) memory order. The transform follows the CUFFT conventions:
+ * CUFFT_FORWARD applies exp(-i...), CUFFT_INVERSE applies exp(+i...) and no
+ * normalization is performed.
+ */
+
+namespace gpuNUFFT
+{
+/**
+ * \brief Precomputed plan of a host FFT, the host counterpart of a cufft plan
+ *
+ * The grid is transformed by 1-d transforms along x, y and z (row-column
+ * decomposition). Each 1-d transform is a mixed radix Stockham FFT with
+ * dedicated butterflies for the radices 2, 3, 4 and 5 and a generic odd
+ * radix butterfly for 7 and larger prime factors, thus arbitrary grid sizes
+ * are supported.
+ *
+ * Pencils are processed in batches of LANES lines which are stored
+ * interleaved with split real and imaginary parts, such that the inner
+ * butterfly loops run over contiguous memory and are vectorized by the
+ * compiler. The passes are compiled for the baseline and the AVX2
+ * instruction set and selected at runtime by gpuNUFFT::getCpuSimdLevel().
+ * Batches are distributed over the threads of a gpuNUFFT::ThreadPool.
+ *
+ * Plans are immutable and cached per (grid dimensions, direction, precision)
+ * for the lifetime of the process. Use getPlan() to obtain a plan, which
+ * may then be shared by all operators and threads.
+ */
+class CpuFFTPlan
+{
+ public:
+  /** \brief Amount of pencils transformed together */
+  static const IndType LANES = 8;
+
+  /** \brief Return the cached plan for the given grid size and direction.
+   *
+   * The plan is created on first use.
+   *
+   * @param gridDims  grid dimensions, depth 0 for 2-d grids
+   * @param direction CUFFT_FORWARD or CUFFT_INVERSE
+   */
+  static const CpuFFTPlan &getPlan(Dimensions gridDims, int direction);
+
+  /** \brief Amount of plans in the process wide plan cache */
+  static IndType getCachedPlanCount();
+
+  /** \brief Sub-grid of a pruned transform, the points whose x, y and z
+   * indices are flagged along all axes */
+  struct Support
+  {
+    /** \brief Flags of the grid indices along x, y and z, depth 1 for 2-d
+     * grids */
+    std::vector<bool> axes[3];
+  };
+
+  /** \brief Pruning of the pencils of a transform */
+  enum Pruning
+  {
+    /** \brief The grid is zero outside of the support, pencils of the
+     * first passes containing only zeros are skipped */
+    PRUNE_INPUT,
+    /** \brief Only the points inside of the support are required, pencils
+     * of the last passes not contributing to them are skipped */
+    PRUNE_OUTPUT
+  };
+
+  /** \brief Scratch memory of the transforms
+   *
+   * Holds the pencil offsets of the current axis and the batch buffers of
+   * the threads. The memory grows to the largest transform executed and is
+   * reused afterwards, a scratch must not be used by concurrent transforms.
+   */
+  struct Scratch
+  {
+    std::vector<IndType> pencils;
+    std::vector<std::vector<DType> > buffers;
+
+    /** \brief Allocated bytes */
+    size_t getBytes() const;
+
+    void swap(Scratch &other)
+    {
+      pencils.swap(other.pencils);
+      buffers.swap(other.buffers);
+    }
+  };
+
+  /** \brief Perform in-place FFT of one grid
+   *
+   * @param data        grid data, gridDims.width * height * depth entries
+   * @param threadPool  thread pool used to process the pencils, NULL selects
+   *the default thread pool
+   * @param scratch     scratch memory reused by repeated transforms, NULL
+   *allocates temporary memory
+   */
+  void execute(CufftType *data, ThreadPool *threadPool = NULL,
+               Scratch *scratch = NULL) const;
+
+  /** \brief Perform in-place FFT of one grid with pruned pencils
+   *
+   * The zero padded image of the forward operation and the cropped image of
+   * the adjoint operation cover only a part of the oversampled grid. With
+   * PRUNE_INPUT the pencils along x are restricted to the support in y and
+   * z, the pencils along y to the support in z. With PRUNE_OUTPUT the
+   * pencils along y are restricted to the support in x, the pencils along z
+   * to the support in x and y, the points outside of the support are
+   * undefined afterwards. The transformed pencils are computed as by
+   * execute.
+   *
+   * @param data        grid data, gridDims.width * height * depth entries
+   * @param support     sub-grid of the non-zero input or required output
+   * @param pruning     PRUNE_INPUT or PRUNE_OUTPUT
+   * @param threadPool  thread pool used to process the pencils, NULL selects
+   *the default thread pool
+   * @param scratch     scratch memory reused by repeated transforms, NULL
+   *allocates temporary memory
+   */
+  void executePruned(CufftType *data, const Support &support, Pruning pruning,
+                     ThreadPool *threadPool = NULL,
+                     Scratch *scratch = NULL) const;
+
+  Dimensions getGridDims() const
+  {
+    return gridDims;
+  }
+
+  int getDirection() const
+  {
+    return direction;
+  }
+
+ private:
+  CpuFFTPlan(Dimensions gridDims, int direction);
+
+  /** \brief One radix pass of a 1-d transform */
+  struct Stage
+  {
+    /** \brief Radix of the pass */
+    IndType radix;
+    /** \brief Product of the radices of the previous passes */
+    IndType stride;
+    /** \brief Length of the sub transforms divided by radix */
+    IndType m;
+    /** \brief Twiddle factors w^(q*r), r = 1..radix-1, per q */
+    std::vector<DType> twRe;
+    std::vector<DType> twIm;
+    /** \brief Roots of unity of the radix (generic odd radix only) */
+    std::vector<DType> rootRe;
+    std::vector<DType> rootIm;
+  };
+
+  /** \brief Stages of the 1-d transform along one axis */
+  struct AxisPlan
+  {
+    IndType n;
+    std::vector<Stage> stages;
+  };
+
+  void initAxisPlan(AxisPlan &axis, IndType n);
+
+  /** \brief Transform the 1-d pencils starting at the offsets of the
+   * scratch, the elements of a pencil are inner entries apart */
+  void transformAxis(const AxisPlan &axis, CufftType *data, IndType inner,
+                     ThreadPool *threadPool, Scratch &scratch) const;
+
+  /** \brief Row-column transform, NULL support transforms all pencils */
+  void transform(CufftType *data, const Support *support, Pruning pruning,
+                 ThreadPool *threadPool, Scratch *scratch) const;
+
+  Dimensions gridDims;
+  int direction;
+  AxisPlan axes[3];
+};
+}
+
+/** \brief Perform in-place FFT of one grid using the cached plan
+ *
+ * @param data        grid data, gridDims.width * height * depth entries
+ * @param gridDims    grid dimensions, depth 0 for 2-d grids
+ * @param direction   CUFFT_FORWARD or CUFFT_INVERSE
+ * @param threadPool  thread pool used to process the 1-d transforms, NULL
+ *selects the default thread pool
+ */
+void performFFTCPU(CufftType *data, gpuNUFFT::Dimensions gridDims,
+                   int direction, gpuNUFFT::ThreadPool *threadPool = NULL);
+
+#endif  // GPUNUFFT_CPU_FFT_H_INCLUDED
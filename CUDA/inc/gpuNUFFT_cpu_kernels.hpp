@@ -0,0 +1,562 @@
+#ifndef GPUNUFFT_CPU_KERNELS_H
+#define GPUNUFFT_CPU_KERNELS_H
+#include "gpuNUFFT_utils.hpp"
+#include "gpuNUFFT_types.hpp"
+#include "thread_pool.hpp"
+#include "gpuNUFFT_cpu_fft.hpp"
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * @file
+ * \brief gpuNUFFT host function prototypes
+ *
+ * Host counterparts of the CUDA functions declared in gpuNUFFT_kernels.hpp,
+ * used by the gpuNUFFT::CpuNUFFTOperator. The functions expect the same data
+ * layout and meta information (gpuNUFFT::GpuNUFFTInfo) as the CUDA versions
+ * but operate on host memory. The convolution functions grid or interpolate
+ * a batch of coilCount coils per call, stored coil-interleaved: value c of
+ * sample or grid point i is found at index i * coilCount + c. Overloads
+ * without coilCount handle a single coil. The pre- and post-processing
+ * functions (scaling, shift, crop, padding, deapodization) work on the grid
+ * or image of one coil. The legacy host gridding functions gpuNUFFT_cpu and
+ * gpuNUFFT_forward_cpu are built on the same functions.
+ *
+ * All functions distribute their work over the threads of the passed
+ * gpuNUFFT::ThreadPool, or of the default pool if NULL is passed.
+ */
+
+namespace gpuNUFFT
+{
+/**
+ * \brief Precomputed sparse gridding matrix
+ *
+ * Row n of the matrix holds the grid indices and kernel weights of all grid
+ * points in the kernel support of the (sorted) sample n, in compressed sparse
+ * row (CSR) layout. As the samples are sorted by sector, the rows of one
+ * sector are stored consecutively.
+ *
+ * The forward convolution is the product with the matrix, the adjoint
+ * convolution the product with its transpose. Grid points outside of the
+ * grid are wrapped around as done by the on-the-fly convolution.
+ */
+struct CpuGriddingMatrix
+{
+  /** \brief First entry of each row, data_count + 1 values */
+  std::vector<IndType> rowOffsets;
+  /** \brief Linear grid index of each entry */
+  std::vector<IndType> gridIndices;
+  /** \brief Kernel weight of each entry */
+  std::vector<DType> weights;
+
+  /** \brief Memory in bytes required by a matrix of the given size */
+  static size_t computeMemorySize(size_t rowCount, size_t entryCount)
+  {
+    return (rowCount + 1) * sizeof(IndType) +
+           entryCount * (sizeof(IndType) + sizeof(DType));
+  }
+
+  bool empty() const
+  {
+    return rowOffsets.empty();
+  }
+
+  size_t getMemorySize() const
+  {
+    return empty() ? 0 : computeMemorySize(rowOffsets.size() - 1,
+                                           weights.size());
+  }
+
+  /** \brief Release the memory of the matrix */
+  void clear()
+  {
+    std::vector<IndType>().swap(rowOffsets);
+    std::vector<IndType>().swap(gridIndices);
+    std::vector<DType>().swap(weights);
+  }
+};
+
+/** \brief Treatment of kernel support points outside of the oversampled
+ * grid */
+enum GridBoundary
+{
+  /** \brief Wrap around to the opposite side as done by the CUDA kernels */
+  WRAP_GRID_BOUNDARY,
+  /** \brief Skip the points, used by gpuNUFFT_cpu and gpuNUFFT_forward_cpu */
+  SKIP_GRID_BOUNDARY
+};
+
+/**
+ * \brief Reusable state of the host convolutions of an operator
+ *
+ * Caches the chunks of the sector processing order, split into the sector
+ * color groups for the adjoint convolution, and holds the padded sector
+ * grids, kernel windows and merge locks of the threads. The chunks are
+ * computed by the first convolution and reused as long as the same
+ * processing order array is passed, invalidate() has to be called if the
+ * sector mapping or the order change in place. The scratch memory grows to
+ * the largest coil batch.
+ *
+ * A workspace must not be used by concurrent convolutions. Copies start
+ * with an empty workspace.
+ */
+class CpuConvolutionWorkspace
+{
+ public:
+  /** \brief Cached chunks and scratch memory, defined by the convolution
+   * functions */
+  struct State;
+
+  CpuConvolutionWorkspace() : state(NULL)
+  {
+  }
+
+  CpuConvolutionWorkspace(const CpuConvolutionWorkspace &) : state(NULL)
+  {
+  }
+
+  CpuConvolutionWorkspace &operator=(const CpuConvolutionWorkspace &)
+  {
+    clear();
+    return *this;
+  }
+
+  ~CpuConvolutionWorkspace()
+  {
+    clear();
+  }
+
+  /** \brief Discard the cached chunks, the scratch memory is kept */
+  void invalidate();
+
+  /** \brief Release the cached chunks and the scratch memory */
+  void clear();
+
+  /** \brief Bytes held by the cached chunks and the scratch memory */
+  size_t getMemorySize() const;
+
+  void swap(CpuConvolutionWorkspace &other)
+  {
+    State *tmp = state;
+    state = other.state;
+    other.state = tmp;
+  }
+
+  /** \brief Return the state, created on first use */
+  State &getState();
+
+ private:
+  State *state;
+};
+}
+
+// ADJOINT Operations
+
+/**
+ * \brief Adjoint gridding convolution implementation on the host.
+ *
+ * Each sector is gridded onto a private padded sector grid which is added to
+ * the output grid afterwards. Grid points outside of the grid are wrapped
+ * around to the opposite side as done by the CUDA implementation. Sectors
+ * are processed in color groups, such that sectors processed at the same
+ * time never write to the same grid points.
+ *
+ * @param data            Input k-space sample data value, complex, sorted due
+ *to precomputation
+ * @param crds            k-space sample coordinate (non-cartesian),
+ *linearized array (x1,x2,x3,...,xn,y1,y2,y3,...,yn,z1,z2,z3,...zn)
+ * @param gdata           Output k-space grid (cartesian)
+ * @param kernel          precomputed interpolation kernel
+ * @param sectors         precomputed data-sector mapping
+ * @param sector_centers  precomputed coordinates (x,y,z) of sector centers
+ * @param gi_host         info struct with meta information
+ * @param threadPool      thread pool used for processing
+ */
+void performConvolutionCPU(DType2 *data, DType *crds, CufftType *gdata,
+                           DType *kernel, IndType *sectors,
+                           IndType *sector_centers,
+                           gpuNUFFT::GpuNUFFTInfo *gi_host,
+                           gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/**
+ * \brief Coil-batched adjoint gridding convolution on the host.
+ *
+ * Grids coilCount channels at once. data and gdata are stored
+ * coil-interleaved, i.e. value c of sample i is data[i * coilCount + c] and
+ * value c of grid point g is gdata[g * coilCount + c]. The kernel weights of
+ * each sample are evaluated once and applied to all channels.
+ *
+ * The chunks of the processing order are scheduled by work stealing inside
+ * of each sector color group. Chunks of the same sector are gridded
+ * concurrently and merged one after another.
+ *
+ * @param sectorProcessingOrder Chunks (sector, sample offset) sorted by load
+ *with gi_host->sectorsToProcess entries, NULL computes the order
+ * @param coilCount       Amount of interleaved channels
+ * @param boundary        Treatment of grid points outside of the grid
+ * @param workspace       Chunks and scratch memory reused by repeated
+ *convolutions, NULL computes and allocates them per call
+ */
+void performConvolutionCPU(
+    DType2 *data, DType *crds, CufftType *gdata, DType *kernel,
+    IndType *sectors, IndType *sector_centers,
+    IndType2 *sectorProcessingOrder, IndType coilCount,
+    gpuNUFFT::GpuNUFFTInfo *gi_host, gpuNUFFT::ThreadPool *threadPool = NULL,
+    gpuNUFFT::GridBoundary boundary = gpuNUFFT::WRAP_GRID_BOUNDARY,
+    gpuNUFFT::CpuConvolutionWorkspace *workspace = NULL);
+
+/**
+ * \brief Forward gridding convolution implementation on the host.
+ *
+ * Interpolates the sample values from the oversampled grid. Each sample is
+ * computed by exactly one thread.
+ *
+ * @param data            Output k-space sample data value, sorted order
+ * @param crds            k-space sample coordinates, linearized array
+ * @param gdata           Input k-space grid (cartesian)
+ * @param kernel          precomputed interpolation kernel
+ * @param sectors         precomputed data-sector mapping
+ * @param sector_centers  precomputed coordinates (x,y,z) of sector centers
+ * @param gi_host         info struct with meta information
+ * @param threadPool      thread pool used for processing
+ */
+void performForwardConvolutionCPU(CufftType *data, DType *crds,
+                                  CufftType *gdata, DType *kernel,
+                                  IndType *sectors, IndType *sector_centers,
+                                  gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                  gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/**
+ * \brief Coil-batched forward gridding convolution on the host.
+ *
+ * Interpolates coilCount coil-interleaved channels at once, see the batched
+ * performConvolutionCPU for the data layout and the processing order. The
+ * chunks are scheduled by work stealing.
+ *
+ * @param sectorProcessingOrder Chunks (sector, sample offset) sorted by load,
+ *NULL computes the order
+ * @param coilCount       Amount of interleaved channels
+ * @param boundary        Treatment of grid points outside of the grid
+ * @param dataIndices     Output position of each sample, NULL writes the
+ *samples in sorted order
+ * @param workspace       Chunks and scratch memory reused by repeated
+ *convolutions, NULL computes and allocates them per call
+ */
+void performForwardConvolutionCPU(
+    CufftType *data, DType *crds, CufftType *gdata, DType *kernel,
+    IndType *sectors, IndType *sector_centers,
+    IndType2 *sectorProcessingOrder, IndType coilCount,
+    gpuNUFFT::GpuNUFFTInfo *gi_host, gpuNUFFT::ThreadPool *threadPool = NULL,
+    gpuNUFFT::GridBoundary boundary = gpuNUFFT::WRAP_GRID_BOUNDARY,
+    IndType *dataIndices = NULL,
+    gpuNUFFT::CpuConvolutionWorkspace *workspace = NULL);
+
+/**
+ * \brief Precompute the sparse gridding matrix of the sorted samples.
+ *
+ * The grid points per sample are counted first, the matrix is only
+ * allocated and filled if it fits into memoryBudget bytes.
+ *
+ * @param matrix          Output matrix, cleared if it does not fit
+ * @param crds            k-space sample coordinates, linearized array
+ * @param kernel          precomputed interpolation kernel
+ * @param sectors         precomputed data-sector mapping
+ * @param sector_centers  precomputed coordinates (x,y,z) of sector centers
+ * @param gi_host         info struct with meta information
+ * @param memoryBudget    maximum size of the matrix in bytes
+ * @param threadPool      thread pool used for processing
+ * @return false if the matrix exceeds the memory budget
+ */
+bool computeGriddingMatrixCPU(gpuNUFFT::CpuGriddingMatrix &matrix,
+                              DType *crds, DType *kernel, IndType *sectors,
+                              IndType *sector_centers,
+                              gpuNUFFT::GpuNUFFTInfo *gi_host,
+                              size_t memoryBudget,
+                              gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/**
+ * \brief Adjoint gridding convolution using the precomputed gridding matrix.
+ *
+ * Computes gdata += matrix^T * data. Sectors are processed in the same color
+ * groups as by the on-the-fly convolution.
+ */
+void performConvolutionCPU(DType2 *data,
+                           const gpuNUFFT::CpuGriddingMatrix &matrix,
+                           CufftType *gdata, IndType *sectors,
+                           IndType *sector_centers,
+                           gpuNUFFT::GpuNUFFTInfo *gi_host,
+                           gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Coil-batched adjoint gridding convolution using the precomputed
+ * gridding matrix, data and gdata hold coilCount interleaved channels
+ *
+ * The chunks of the sector color groups are cached by workspace if passed.
+ */
+void performConvolutionCPU(
+    DType2 *data, const gpuNUFFT::CpuGriddingMatrix &matrix, CufftType *gdata,
+    IndType *sectors, IndType *sector_centers,
+    IndType2 *sectorProcessingOrder, IndType coilCount,
+    gpuNUFFT::GpuNUFFTInfo *gi_host, gpuNUFFT::ThreadPool *threadPool = NULL,
+    gpuNUFFT::CpuConvolutionWorkspace *workspace = NULL);
+
+/**
+ * \brief Forward gridding convolution using the precomputed gridding matrix.
+ *
+ * Computes data = matrix * gdata.
+ */
+void performForwardConvolutionCPU(CufftType *data,
+                                  const gpuNUFFT::CpuGriddingMatrix &matrix,
+                                  CufftType *gdata,
+                                  gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                  gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Coil-batched forward gridding convolution using the precomputed
+ * gridding matrix, data and gdata hold coilCount interleaved channels */
+void performForwardConvolutionCPU(CufftType *data,
+                                  const gpuNUFFT::CpuGriddingMatrix &matrix,
+                                  CufftType *gdata, IndType coilCount,
+                                  gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                  gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/**
+ * \brief Sort the samples by sector on the host.
+ *
+ * Parallel counting sort of the precomputation: each thread assigns the
+ * samples of a contiguous block to their sectors and counts them in a
+ * private sector histogram. The prefix sum over the histograms yields
+ * sectorDataCount and the write position of each block and sector, then the
+ * coordinates, density compensation values and data indices are scattered.
+ * The sort is stable, i.e. the samples of a sector keep their original
+ * order. The sectors are the same as computed by computeSectorMapping.
+ *
+ * @param kSpaceTraj      unsorted sample coordinates, linearized array
+ *(x1,...,xn,y1,...,yn(,z1,...,zn))
+ * @param densCompData    unsorted density compensation values, NULL if not
+ *used
+ * @param coordCnt        amount of samples
+ * @param gridDims        dimensions of the oversampled grid, depth 0 for 2-d
+ *processing
+ * @param gridSectorDims  amount of sectors per dimension
+ * @param sectorWidth     sector width in grid units
+ * @param trajSorted      output sorted coordinates, same layout as kSpaceTraj
+ * @param densData        output sorted density compensation values, NULL if
+ *not used
+ * @param dataIndices     output original index of each sorted sample
+ * @param sectorDataCount output first sample of each sector, sector count + 1
+ *values
+ * @param threadPool      thread pool used for processing
+ */
+void sortSamplesBySectorCPU(DType *kSpaceTraj, DType *densCompData,
+                            IndType coordCnt, gpuNUFFT::Dimensions gridDims,
+                            gpuNUFFT::Dimensions gridSectorDims,
+                            IndType sectorWidth, DType *trajSorted,
+                            DType *densData, IndType *dataIndices,
+                            IndType *sectorDataCount,
+                            gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/**
+ * \brief Sector of each sample of a block of the trajectory.
+ *
+ * Same sector mapping as sortSamplesBySectorCPU, used by the out-of-core
+ * precomputation which sorts the trajectory block by block.
+ *
+ * @param kSpaceTraj      sample coordinates, linearized array
+ *(x1,...,xn,y1,...,yn(,z1,...,zn))
+ * @param first           first sample of the block
+ * @param count           amount of samples of the block
+ * @param coordCnt        amount of samples of the whole trajectory
+ * @param gridDims        dimensions of the oversampled grid, depth 0 for 2-d
+ *processing
+ * @param gridSectorDims  amount of sectors per dimension
+ * @param sectorWidth     sector width in grid units
+ * @param sampleSectors   output sector index of each sample of the block
+ * @param threadPool      thread pool used for processing
+ */
+void assignSampleSectorsCPU(DType *kSpaceTraj, IndType first, IndType count,
+                            IndType coordCnt, gpuNUFFT::Dimensions gridDims,
+                            gpuNUFFT::Dimensions gridSectorDims,
+                            IndType sectorWidth, IndType *sampleSectors,
+                            gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Position of a cell on a space-filling curve
+ *
+ * @param curve  MORTON_CURVE or HILBERT_CURVE, NO_CURVE yields the linear
+ *index (x fastest)
+ * @param cell   cell indices, z is ignored if is3D is false
+ * @param bits   curve resolution, cell indices have to be below 2^bits
+ */
+uint64_t computeCurveIndexCPU(gpuNUFFT::SpaceFillingCurve curve,
+                              IndType3 cell, unsigned bits, bool is3D);
+
+/** \brief Sort the samples of each sector along a space-filling curve
+ *
+ * The samples of each sector are ordered by the curve index of the
+ * oversampled grid cell they fall into, samples of the same cell keep their
+ * order. Coordinates, density compensation values and data indices are
+ * permuted alike, thus the data indices still map each sample to its
+ * position in acquisition order.
+ *
+ * @param curve           curve to use, NO_CURVE leaves the order unchanged
+ * @param trajSorted      coordinates sorted by sector, linearized array
+ *(x1,...,xn,y1,...,yn(,z1,...,zn))
+ * @param densData        density compensation values, NULL if not used
+ * @param dataIndices     original index of each sample
+ * @param coordCnt        amount of samples
+ * @param sectorDataCount first sample of each sector, sectorCount + 1 values
+ * @param sectorCount     amount of sectors
+ * @param gridDims        dimensions of the oversampled grid, depth 0 for 2-d
+ *processing
+ * @param threadPool      thread pool used for processing
+ */
+void sortSectorSamplesByCurveCPU(gpuNUFFT::SpaceFillingCurve curve,
+                                 DType *trajSorted, DType *densData,
+                                 IndType *dataIndices, IndType coordCnt,
+                                 IndType *sectorDataCount, IndType sectorCount,
+                                 gpuNUFFT::Dimensions gridDims,
+                                 gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Scale the first N values of data by 1/sqrt(im_width_dim) */
+void performFFTScalingCPU(CufftType *data, IndType N,
+                          gpuNUFFT::GpuNUFFTInfo *gi_host,
+                          gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Multiply the sample data with the square root of the density
+ * compensation values */
+void performDensityCompensationCPU(DType2 *data, DType *density_comp,
+                                   gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                   gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Multiply the image data with the (conjugate) coil sensitivity
+ * values */
+void performSensMulCPU(CufftType *imdata, DType2 *sens,
+                       gpuNUFFT::GpuNUFFTInfo *gi_host, bool conjugate,
+                       gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Add the image data to the coil combined image imdata_sum */
+void performSensSumCPU(CufftType *imdata, CufftType *imdata_sum,
+                       gpuNUFFT::GpuNUFFTInfo *gi_host,
+                       gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Cyclic shift of the grid data in order to move the zero frequency
+ * to the grid center and back
+ *
+ * Matches performFFTShift for even and odd grid dimensions.
+ *
+ * @param copy_gdata    buffer of the grid size holding the copy of the out
+ *of place shift, NULL allocates it per call
+ */
+void performFFTShiftCPU(CufftType *gdata, gpuNUFFT::FFTShiftDir shift_dir,
+                        gpuNUFFT::Dimensions gridDims,
+                        gpuNUFFT::GpuNUFFTInfo *gi_host,
+                        gpuNUFFT::ThreadPool *threadPool = NULL,
+                        CufftType *copy_gdata = NULL);
+
+/** \brief Crop the center (image dimensions) of the oversampled grid */
+void performCropCPU(CufftType *gdata, CufftType *imdata,
+                    gpuNUFFT::GpuNUFFTInfo *gi_host,
+                    gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Apply the deapodization to the image data
+ *
+ * Multiplies with the precomputed values deapo or, if deapo is NULL, with the
+ * outer product of the separable deapoVectors (see
+ * computeDeapodizationVectorsCPU). If both are NULL the image data is divided
+ * by the analytic deapodization function (see Beatty et al.).
+ */
+void performDeapodizationCPU(CufftType *imdata, DType *deapo,
+                             DType *deapoVectors,
+                             gpuNUFFT::GpuNUFFTInfo *gi_host,
+                             gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Fused post-processing of the adjoint operation
+ *
+ * Single pass over the image part of the Fourier transformed grid gdata,
+ * equivalent to performCropCPU, performFFTScalingCPU,
+ * performDeapodizationCPU and, if sens is set, performSensMulCPU
+ * (conjugate) and performSensSumCPU.
+ *
+ * @param gdata         Fourier transformed grid
+ * @param imdata        image of the coil, or coil combined image the result
+ *is added to if sens is set
+ * @param sens          sensitivity of the coil or NULL
+ * @param foldFFTShift  gdata is the transform of the unshifted grid, the
+ *performFFTShiftCPU passes before and after the FFT are folded into the crop
+ */
+void performCropDeapodizationCPU(CufftType *gdata, CufftType *imdata,
+                                 DType *deapo, DType *deapoVectors,
+                                 DType2 *sens, bool foldFFTShift,
+                                 gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                 gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Compute the separable deapodization factors of each image axis
+ *
+ * The interpolation kernel is separable, thus the gridded and Fourier
+ * transformed sample at k = 0 is the product of 1-d transforms. These are
+ * evaluated directly from the kernel lookup table in O(width + height +
+ * depth) instead of gridding a single sample on the full oversampled grid.
+ *
+ * @param kernel        kernel lookup table
+ * @param deapoVectors  output of width + height (+ depth) inverse magnitudes,
+ *                      the value of image position (x,y,z) is
+ *                      deapoVectors[x] * deapoVectors[width + y] *
+ *                      deapoVectors[width + height + z]
+ */
+void computeDeapodizationVectorsCPU(DType *kernel,
+                                    gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                    DType *deapoVectors);
+
+/** \brief Expand the separable deapodization factors to the image volume
+ * deapo of imgDims.count() values */
+void expandDeapodizationVectorsCPU(DType *deapoVectors,
+                                   gpuNUFFT::Dimensions imgDims, DType *deapo,
+                                   gpuNUFFT::ThreadPool *threadPool = NULL);
+
+// FORWARD Operations
+
+/** \brief Apply the deapodization to the image data before the forward
+ * gridding, see performDeapodizationCPU */
+void performForwardDeapodizationCPU(DType2 *imdata, DType *deapo,
+                                    DType *deapoVectors,
+                                    gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                    gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Copy the image data into the center of the (zeroed) oversampled
+ * grid */
+void performPaddingCPU(DType2 *imdata, CufftType *gdata,
+                       gpuNUFFT::GpuNUFFTInfo *gi_host,
+                       gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Fused pre-processing of the forward operation
+ *
+ * Writes each point of the oversampled grid gdata once, equivalent to
+ * performSensMulCPU (if sens is set), performForwardDeapodizationCPU and
+ * performPaddingCPU into a zeroed grid followed by the FFT scaling of the
+ * resampled data (performFFTScalingCPU), which is linear and applied to
+ * the image instead.
+ *
+ * @param imdata        image of the coil, read only
+ * @param sens          sensitivity of the coil or NULL
+ * @param foldFFTShift  write the grid whose FFT equals the FFT of the
+ *padded grid with the performFFTShiftCPU passes before and after it
+ */
+void performDeapodizationPaddingCPU(DType2 *imdata, DType2 *sens,
+                                    CufftType *gdata, DType *deapo,
+                                    DType *deapoVectors, bool foldFFTShift,
+                                    gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                    gpuNUFFT::ThreadPool *threadPool = NULL);
+
+/** \brief Grid points covered by the image as support of a pruned FFT
+ *
+ * The points written by performDeapodizationPaddingCPU before the forward
+ * FFT (padding) or read by performCropDeapodizationCPU after the adjoint FFT.
+ * With separate shift passes these are the points the image is moved to by
+ * the shift before respectively read from by the shift after the FFT, thus
+ * the support is the same with and without folded FFT shifts.
+ *
+ * @see gpuNUFFT::CpuFFTPlan::executePruned
+ */
+gpuNUFFT::CpuFFTPlan::Support
+computeImageSupportCPU(gpuNUFFT::GpuNUFFTInfo *gi_host, bool padding);
+
+#endif  // GPUNUFFT_CPU_KERNELS_H
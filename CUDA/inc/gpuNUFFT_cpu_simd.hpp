@@ -0,0 +1,91 @@
+#ifndef GPUNUFFT_CPU_SIMD_H_INCLUDED
+#define GPUNUFFT_CPU_SIMD_H_INCLUDED
+
+#include "config.hpp"
+
+/**
+ * @file
+ * \brief Vectorized row operations used by the host gridding routines
+ *
+ * The separable gridding kernel is applied row by row: the weights of one
+ * grid row (x direction) are computed once per sample, afterwards each row
+ * of the kernel window is updated by a single axpy operation on interleaved
+ * complex values (adjoint gridding) or reduced by a single dot product
+ * (forward gridding).
+ *
+ * The instruction set is selected at runtime. AVX-512 and AVX2/FMA versions
+ * are used if supported by the CPU and compiler, otherwise a scalar version
+ * is used. The environment variable GPUNUFFT_CPU_SIMD (scalar, avx2, avx512)
+ * limits the instruction set of the process. The same level selects the
+ * butterfly passes of the host FFT, which are compiled for the baseline and
+ * the AVX2 instruction set from a common implementation.
+ */
+
+// GPUNUFFT_TARGET_* compile a function for the instruction set, functions
+// declared GPUNUFFT_FORCE_INLINE are inlined into and compiled with the
+// instruction set of their caller
+#if (defined(__GNUC__) || defined(__clang__)) &&                             \
+    (defined(__x86_64__) || defined(__i386__))
+#define GPUNUFFT_X86_SIMD
+#define GPUNUFFT_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define GPUNUFFT_TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define GPUNUFFT_X86_SIMD
+#define GPUNUFFT_TARGET_AVX2
+#define GPUNUFFT_TARGET_AVX512
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define GPUNUFFT_FORCE_INLINE inline __attribute__((always_inline))
+#define GPUNUFFT_RESTRICT __restrict__
+#elif defined(_MSC_VER)
+#define GPUNUFFT_FORCE_INLINE __forceinline
+#define GPUNUFFT_RESTRICT __restrict
+#else
+#define GPUNUFFT_FORCE_INLINE inline
+#define GPUNUFFT_RESTRICT
+#endif
+
+namespace gpuNUFFT
+{
+/** \brief Instruction set used by the host row operations */
+enum CpuSimdLevel
+{
+  /** \brief Plain C++ loops */
+  SIMD_SCALAR,
+  /** \brief 256 bit AVX2 and FMA instructions */
+  SIMD_AVX2,
+  /** \brief 512 bit AVX-512F instructions */
+  SIMD_AVX512
+};
+
+/** \brief Highest instruction set supported by CPU and build */
+CpuSimdLevel getSupportedCpuSimdLevel();
+
+/** \brief Instruction set currently used by the row operations and the
+ * host FFT */
+CpuSimdLevel getCpuSimdLevel();
+
+/** \brief Select the instruction set used by the row operations
+ *
+ * Levels which are not supported fall back to the highest supported level.
+ * Not thread safe with respect to concurrently running row operations.
+ */
+void setCpuSimdLevel(CpuSimdLevel level);
+
+/** \brief Printable name of the instruction set level */
+const char *getCpuSimdLevelName(CpuSimdLevel level);
+
+/** \brief dst[n] += weight * src[n] for n in [0, count) */
+void simdAxpy(DType *dst, const DType *src, DType weight, int count);
+
+/** \brief Weighted sum of interleaved complex values
+ *
+ * Computes re = sum values[2n] * weights[2n] and
+ * im = sum values[2n+1] * weights[2n+1] for n in [0, count / 2).
+ */
+void simdComplexDot(const DType *values, const DType *weights, int count,
+                    DType &re, DType &im);
+}
+
+#endif  // GPUNUFFT_CPU_SIMD_H_INCLUDED
@@ -0,0 +1,136 @@
+#ifndef GPUNUFFT_INCREMENTAL_PLAN_H_INCLUDED
+#define GPUNUFFT_INCREMENTAL_PLAN_H_INCLUDED
+
+#include "gpuNUFFT_types.hpp"
+#include "cpuNUFFT_operator.hpp"
+#include "gpuNUFFT_load_balancer.hpp"
+#include <vector>
+
+namespace gpuNUFFT
+{
+/**
+ * \brief Incremental update of the sample layout of a CpuNUFFTOperator
+ *
+ * Appending or removing batches of samples, e.g. the spokes of a real-time
+ * radial acquisition, updates the sorted arrays of the operator in place
+ * instead of repeating the precomputation for the whole trajectory.
+ *
+ * The sorted arrays are kept as gap buffer: each sector owns a contiguous
+ * range of slots, unused slots (data index INVALID_DATA_INDEX) are gridded
+ * with zero data. Appended samples fill the free slots at the end of their
+ * sector, removed samples leave a gap. Once a sector runs out of slots or
+ * the gaps exceed slackRatio times the sample count, the arrays are
+ * compacted and each sector gets slackRatio times its sample count of free
+ * slots again. Thus an update costs time proportional to the batch size, the
+ * compaction is amortized like the growth of a std::vector.
+ *
+ * Data indices refer to the k-space data arrays of getDataCount() samples per
+ * coil. Appended samples may reuse the data indices of removed samples, e.g.
+ * for a sliding window. The samples of each sector are processed in insertion
+ * order, thus results match a newly created operator up to rounding. The
+ * processing order only depends on the slot ranges of the sectors and is
+ * recomputed without space-filling curve ranks after a compaction. A
+ * precomputed gridding matrix is released by updates changing the slots.
+ */
+class IncrementalPlan
+{
+ public:
+  /** \brief Take over the sorted arrays of the operator
+   *
+   * The arrays are compacted once to provide free slots. The operator has to
+   * own its arrays, i.e. must not be loaded from a plan file or share Matlab
+   * memory, and has to outlive the plan.
+   *
+   * @param gpuNUFFTOp    operator created by the GpuNUFFTOperatorFactory
+   * @param slackRatio    free slots of each sector after compaction relative
+   *to its sample count
+   * @param loadBalancer  policy computing the processing order, NULL selects a
+   *CostModelBalancer for the default ThreadPool. Not owned by the plan.
+   * @throws std::invalid_argument if the operator does not own its arrays
+   */
+  explicit IncrementalPlan(CpuNUFFTOperator *gpuNUFFTOp,
+                           DType slackRatio = 0.5,
+                           LoadBalancer *loadBalancer = NULL);
+
+  /** \brief Append a batch of samples with consecutive data indices
+   *
+   * @param kSpaceTraj      coordinates of the batch, linearized array
+   *(x1,...,xn,y1,...,yn(,z1,...,zn))
+   * @param densCompData    density compensation values of the batch,
+   *required if and only if the operator applies density compensation
+   * @param firstDataIndex  data index of the first sample, the indices of
+   *the batch must not be in use
+   * @throws std::invalid_argument if the batch does not match the operator
+   */
+  void appendSamples(Array<DType> &kSpaceTraj, Array<DType> &densCompData,
+                     IndType firstDataIndex);
+
+  /** \brief Append a batch of samples behind the last data index */
+  void appendSamples(Array<DType> &kSpaceTraj, Array<DType> &densCompData);
+
+  /** \brief Remove the samples of count consecutive data indices, indices
+   * not in use are ignored */
+  void removeSamples(IndType firstDataIndex, IndType count);
+
+  /** \brief Remove all gaps and provide slackRatio free slots per sector */
+  void compact();
+
+  /** \brief Amount of samples in use */
+  IndType getSampleCount() const
+  {
+    return sampleCount;
+  }
+
+  /** \brief Length of the sorted arrays including free slots and gaps */
+  IndType getSlotCount() const
+  {
+    return sectorStart(sectorCount);
+  }
+
+  /** \brief Amount of compactions performed so far */
+  IndType getCompactionCount() const
+  {
+    return compactionCount;
+  }
+
+ private:
+  IncrementalPlan(const IncrementalPlan &);
+  IncrementalPlan &operator=(const IncrementalPlan &);
+
+  /** \brief First slot of sector sec, sectorCount yields the slot count */
+  IndType sectorStart(IndType sec) const
+  {
+    return gpuNUFFTOp->getSectorDataCount().data[sec];
+  }
+
+  /** \brief Rebuild the sorted arrays with free slots, including a batch of
+   * samples not inserted yet */
+  void relayout(const DType *batchTraj, const DType *batchDens,
+                const IndType *batchSectors, IndType batchCount,
+                IndType firstDataIndex);
+
+  /** \brief Recompute the processing order after the slots changed */
+  void updateProcessingOrder();
+
+  CpuNUFFTOperator *gpuNUFFTOp;
+  DType slackRatio;
+  LoadBalancer *loadBalancer;
+  CostModelBalancer defaultBalancer;
+
+  int dimCount;
+  IndType sectorCount;
+
+  /** \brief Used slots (samples and gaps) at the beginning of each sector */
+  std::vector<IndType> sectorFill;
+  /** \brief Slot of each data index, INVALID_DATA_INDEX if not in use */
+  std::vector<IndType> slotOfIndex;
+
+  IndType sampleCount;
+  /** \brief Slots of removed samples */
+  IndType gapCount;
+  IndType compactionCount;
+};
+
+}  // namespace gpuNUFFT
+
+#endif  // GPUNUFFT_INCREMENTAL_PLAN_H_INCLUDED
@@ -0,0 +1,215 @@
+#ifndef GPUNUFFT_LOAD_BALANCER_H_INCLUDED
+#define GPUNUFFT_LOAD_BALANCER_H_INCLUDED
+
+#include "gpuNUFFT_types.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace gpuNUFFT
+{
+/**
+ * \brief Estimated processing cost of the chunks of a sector processing order
+ *
+ * Gridding a chunk of samples costs the evaluation of the kernel footprint
+ * (kernelWidth^d grid points) per sample plus clearing and merging the
+ * padded sector grid ((sectorWidth + 2 * floor(kernelWidth / 2))^d grid
+ * points) once per chunk. Costs are given in arbitrary units per grid point.
+ */
+struct SectorCostModel
+{
+  SectorCostModel() : kernelPointCost(1.0), mergePointCost(1.0)
+  {
+  }
+
+  /** \brief Cost of one kernel grid point of a sample */
+  double kernelPointCost;
+  /** \brief Cost of clearing and merging one padded sector grid point */
+  double mergePointCost;
+};
+
+/** \brief Gridding parameters the processing order is computed for */
+struct SectorGeometry
+{
+  SectorGeometry(IndType kernelWidth, IndType sectorWidth, bool is3D)
+    : kernelWidth(kernelWidth), sectorWidth(sectorWidth), is3D(is3D)
+  {
+  }
+
+  IndType kernelWidth;
+  IndType sectorWidth;
+  bool is3D;
+};
+
+/** \brief Predicted schedule of the last computed processing order */
+struct LoadBalancingReport
+{
+  LoadBalancingReport()
+    : workerCount(0), chunkSize(0), chunkCount(0), totalCost(0.0),
+      predictedMakespan(0.0)
+  {
+  }
+
+  /** \brief Ratio of predicted makespan to perfectly balanced load, 1 is
+   * optimal */
+  double getPredictedImbalance() const
+  {
+    return totalCost > 0.0 ? predictedMakespan * workerCount / totalCost
+                           : 1.0;
+  }
+
+  unsigned workerCount;
+  /** \brief Maximum amount of samples per chunk */
+  IndType chunkSize;
+  IndType chunkCount;
+  /** \brief Sum of the chunk costs */
+  double totalCost;
+  /** \brief Longest worker load if the chunks are processed in order by
+   * workerCount workers, each taking the next chunk once idle */
+  double predictedMakespan;
+};
+
+/**
+ * \brief Policy splitting sectors into chunks and ordering them for
+ * processing
+ *
+ * The resulting sector processing order holds pairs of sector index and
+ * sample offset inside of the sector. A chunk ends at the next larger offset
+ * of the same sector in the order or at the end of the sector.
+ *
+ * @see GpuNUFFTOperatorFactory::setLoadBalancer
+ */
+class LoadBalancer
+{
+ public:
+  /** \brief Use costModel for the predicted makespan of workerCount workers,
+   * 0 selects the thread count of the default ThreadPool */
+  explicit LoadBalancer(unsigned workerCount = 0,
+                        const SectorCostModel &costModel = SectorCostModel());
+
+  virtual ~LoadBalancer()
+  {
+  }
+
+  /** \brief Compute the processing order of all non-empty sectors
+   *
+   * If sector ranks are passed, chunks of similar cost (same power of two)
+   * are processed in ascending rank, e.g. along a space-filling curve, so
+   * that neighbouring sectors are processed together.
+   *
+   * @param sectorDataCount  cumulative sample count, sector_count + 1
+   *entries
+   * @param sectorCount      amount of sectors
+   * @param geometry         gridding parameters
+   * @param sectorRanks      optional traversal rank of each sector
+   */
+  std::vector<IndType2> computeProcessingOrder(
+      const IndType *sectorDataCount, IndType sectorCount,
+      const SectorGeometry &geometry, const uint64_t *sectorRanks = NULL);
+
+  /** \brief Schedule predicted for the last computed order */
+  const LoadBalancingReport &getReport() const
+  {
+    return report;
+  }
+
+  /** \brief Parameters identifying the computed orders, e.g. for plan
+   * caching */
+  virtual std::string getDescription() const = 0;
+
+  unsigned getWorkerCount() const
+  {
+    return workerCount;
+  }
+
+  const SectorCostModel &getCostModel() const
+  {
+    return costModel;
+  }
+
+  /** \brief Cost of a chunk of sampleCount samples */
+  double estimateChunkCost(IndType sampleCount,
+                           const SectorGeometry &geometry) const;
+
+ protected:
+  /** \brief Maximum amount of samples per chunk
+   *
+   * @param sectorLoads  sample count of each non-empty sector
+   */
+  virtual IndType selectChunkSize(const std::vector<IndType> &sectorLoads,
+                                  const SectorGeometry &geometry) = 0;
+
+  /** \brief Order the chunks for processing, default is descending sample
+   * count of the sectors */
+  virtual void sortChunks(std::vector<IndType2> &chunks,
+                          const IndType *sectorDataCount,
+                          const SectorGeometry &geometry);
+
+  /** \brief Longest load of workerCount workers processing the chunk costs
+   * in order, each taking the next chunk once idle */
+  double predictMakespan(const std::vector<double> &chunkCosts) const;
+
+ private:
+  unsigned workerCount;
+  SectorCostModel costModel;
+  LoadBalancingReport report;
+};
+
+/**
+ * \brief Fixed split of the sectors into chunks of chunkSize samples
+ *
+ * The chunks are ordered by descending sample count of their sector. The
+ * GPU kernels of the balanced operators require chunks of MAXIMUM_PAYLOAD
+ * samples.
+ */
+class FixedPayloadBalancer : public LoadBalancer
+{
+ public:
+  explicit FixedPayloadBalancer(
+      IndType chunkSize = MAXIMUM_PAYLOAD, unsigned workerCount = 0,
+      const SectorCostModel &costModel = SectorCostModel());
+
+  std::string getDescription() const;
+
+ protected:
+  IndType selectChunkSize(const std::vector<IndType> &sectorLoads,
+                          const SectorGeometry &geometry);
+
+ private:
+  IndType chunkSize;
+};
+
+/**
+ * \brief Cost model driven split and longest processing time first order
+ *
+ * The chunk size is selected from the histogram of the samples per sector:
+ * each candidate size (powers of two) is rated by the makespan bound
+ * max(total cost / workers, largest chunk cost), where the total cost grows
+ * with the amount of chunks due to the merge cost of the padded sectors.
+ * Small chunks balance the densely sampled k-space center but pay the merge
+ * cost more often, large chunks leave single workers with the hot sectors.
+ *
+ * The chunks are sorted by descending cost, thus workers taking the next
+ * chunk once idle result in the longest processing time (LPT) schedule.
+ */
+class CostModelBalancer : public LoadBalancer
+{
+ public:
+  explicit CostModelBalancer(
+      unsigned workerCount = 0,
+      const SectorCostModel &costModel = SectorCostModel());
+
+  std::string getDescription() const;
+
+ protected:
+  IndType selectChunkSize(const std::vector<IndType> &sectorLoads,
+                          const SectorGeometry &geometry);
+
+  void sortChunks(std::vector<IndType2> &chunks,
+                  const IndType *sectorDataCount,
+                  const SectorGeometry &geometry);
+};
+
+}  // namespace gpuNUFFT
+
+#endif  // GPUNUFFT_LOAD_BALANCER_H_INCLUDED
@@ -0,0 +1,153 @@
+#ifndef GPUNUFFT_MEMORY_PLANNER_H_INCLUDED
+#define GPUNUFFT_MEMORY_PLANNER_H_INCLUDED
+
+#include "gpuNUFFT_types.hpp"
+
+namespace gpuNUFFT
+{
+class GpuNUFFTOperator;
+
+/** \brief Memory the buffers of a MemoryPlanner are allocated in */
+enum MemoryTarget
+{
+  /** \brief Device memory of the GPU operators */
+  DEVICE_MEMORY,
+  /** \brief Host memory of the CpuNUFFTOperator */
+  HOST_MEMORY
+};
+
+/** \brief Bytes required by the processing stages of one coil batch */
+struct MemoryRequirements
+{
+  MemoryRequirements()
+    : planBytes(0), kspaceBytes(0), gridBytes(0), imageBytes(0),
+      fftScratchBytes(0), sensBytes(0)
+  {
+  }
+
+  /** \brief Sum of all stages */
+  size_t getTotalBytes() const
+  {
+    return planBytes + kspaceBytes + gridBytes + imageBytes +
+           fftScratchBytes + sensBytes;
+  }
+
+  /** \brief Trajectory, data indices, sector arrays, processing order,
+   * density compensation and deapodization */
+  size_t planBytes;
+  /** \brief Sorted k-space data of the coil batch */
+  size_t kspaceBytes;
+  /** \brief Oversampled grids of the coil batch */
+  size_t gridBytes;
+  /** \brief Image buffers of the coil batch */
+  size_t imageBytes;
+  /** \brief Work area of the FFT */
+  size_t fftScratchBytes;
+  /** \brief Coil sensitivities of the coil batch and coil summation image */
+  size_t sensBytes;
+};
+
+/**
+ * \brief Byte requirements and coil batch selection of an operator
+ * configuration
+ *
+ * The buffers follow the allocations of the execution paths:
+ *
+ * On the device the plan arrays are uploaded once, each coil of a batch
+ * holds its k-space data, grid, image and sensitivities. The FFT work area
+ * is estimated as one grid, the exact size is only known to cufft.
+ *
+ * On the host the plan arrays are the resident arrays of the operator, each
+ * coil of a batch holds its k-space data and grid in the workspace of the
+ * operator. FFT and the fused image stages are performed one coil at a time
+ * with a single grid, reading and writing the images of the caller directly
+ * and summing the coils in the output image. The FFT
+ * work area holds the pencil batches of each thread. A precomputed gridding
+ * matrix has its own memory budget and is not included.
+ *
+ * The requirements only depend on the configuration, thus the batch
+ * selection can be tested with synthetic capacities.
+ */
+class MemoryPlanner
+{
+ public:
+  /** \brief Planner of an operator configuration
+   *
+   * @param target       memory the buffers are allocated in
+   * @param imgDims      image dimensions, depth 0 for 2-d images
+   * @param osf          grid oversampling ratio
+   * @param sectorWidth  sector width of the grid
+   * @param dataCount    amount of samples per coil
+   * @param useDens      density compensation is applied
+   * @param useSens      coil sensitivities are applied
+   */
+  MemoryPlanner(MemoryTarget target, const Dimensions &imgDims, DType osf,
+                IndType sectorWidth, IndType dataCount, bool useDens,
+                bool useSens);
+
+  /** \brief Planner of the configuration of an existing operator, the
+   * target follows the operator type */
+  static MemoryPlanner forOperator(GpuNUFFTOperator *gpuNUFFTOp);
+
+  /** \brief Set the amount of sorted sample slots, default is the data
+   * count */
+  void setSlotCount(IndType slotCount)
+  {
+    this->slotCount = slotCount;
+  }
+
+  /** \brief Set the amount of chunks of the sector processing order, 0 if
+   * the operator has none */
+  void setProcessingOrderCount(IndType processingOrderCount)
+  {
+    this->processingOrderCount = processingOrderCount;
+  }
+
+  /** \brief Set whether the deapodization function is precomputed */
+  void setDeapodization(bool useDeapo)
+  {
+    this->useDeapo = useDeapo;
+  }
+
+  /** \brief Set the amount of threads sharing the host FFT */
+  void setThreadCount(unsigned threadCount)
+  {
+    this->threadCount = threadCount;
+  }
+
+  /** \brief Bytes required to process coilBatch coils at once */
+  MemoryRequirements getRequirements(IndType coilBatch) const;
+
+  /** \brief Largest coil batch of at most coilCnt coils fitting into
+   * capacity bytes
+   *
+   * @return 0 if not even a single coil fits
+   */
+  IndType selectCoilBatch(IndType coilCnt, size_t capacity) const;
+
+  MemoryTarget getTarget() const
+  {
+    return target;
+  }
+
+  Dimensions getGridDims() const
+  {
+    return gridDims;
+  }
+
+ private:
+  MemoryTarget target;
+  Dimensions imgDims;
+  Dimensions gridDims;
+  IndType sectorCount;
+  IndType slotCount;
+  IndType processingOrderCount;
+  bool useDens;
+  bool useSens;
+  bool useDeapo;
+  unsigned threadCount;
+};
+
+}  // namespace gpuNUFFT
+
+#endif  // GPUNUFFT_MEMORY_PLANNER_H_INCLUDED
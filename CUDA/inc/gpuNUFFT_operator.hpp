@@ -6,9 +6,12 @@
 #include "config.hpp"
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 
 namespace gpuNUFFT
 {
+class PlanFile;
+
 /**
  * \brief Main "Operator" used for gridding operations
  *
@@ -75,6 +78,7 @@ class GpuNUFFTOperator
   }
 
   friend class GpuNUFFTOperatorFactory;
+  friend class IncrementalPlan;
 
   // SETTER
   void setOsf(DType osf)
@@ -138,6 +142,10 @@ class GpuNUFFTOperator
   {
     return this->kernel;
   }
+  Array<DType> getDeapodizationFunction()
+  {
+    return this->deapo;
+  }
   Array<IndType> getSectorDataCount()
   {
     return this->sectorDataCount;
@@ -156,6 +164,10 @@ class GpuNUFFTOperator
   {
     return this->imgDims;
   }
+  DType getOsf()
+  {
+    return this->osf;
+  }
   Dimensions getGridDims()
   {
     return this->imgDims * osf;
@@ -184,6 +196,16 @@ class GpuNUFFTOperator
     return this->dataIndices;
   }
 
+  /** \brief Amount of samples per coil of the k-space data arrays
+   *
+   * Equals the length of the sorted trajectory unless the sorted arrays
+   * contain unused slots, see gpuNUFFT::IncrementalPlan.
+   */
+  virtual IndType getDataCount()
+  {
+    return this->kSpaceTraj.count();
+  }
+
   bool is2DProcessing()
   {
     return this->imgDims.depth == 0;
@@ -438,6 +460,10 @@ class GpuNUFFTOperator
   */
   bool matlabSharedMem;
 
+  /** \brief Mapped plan file holding the precomputed arrays of operators
+   * created by GpuNUFFTOperatorFactory::loadPlan, NULL otherwise */
+  std::shared_ptr<PlanFile> planFile;
+
   /** \brief Return Grid Width (ImageWidth * osf) */
   IndType getGridWidth()
   {
@@ -461,6 +487,12 @@ class GpuNUFFTOperator
     */
   GpuNUFFTInfo *initGpuNUFFTInfo(int n_coils_cc = 1);
 
+  /** \brief Compute the meta information into the passed struct
+    *
+    * @see initGpuNUFFTInfo
+    */
+  void initGpuNUFFTInfo(GpuNUFFTInfo *gi_host, int n_coils_cc);
+
   /** \brief Virtual method to perform precomputation of all neccessary meta
   *information used in the gridding steps.
   *
@@ -558,11 +590,11 @@ class GpuNUFFTOperator
 
   /** \brief Compute amount of coils which can be computed at once.
    *
-   * Depends primary on available GPU memory
+   * Largest coil batch of the MemoryPlanner fitting into the free GPU
+   * memory, at least one coil.
    *
    */
-  int computePossibleConcurrentCoilCount(int n_coils,
-                                         gpuNUFFT::Dimensions kSpaceDataDim);
+  int computePossibleConcurrentCoilCount(int n_coils);
 };
 }
 
@@ -6,6 +6,11 @@
 #include "balanced_gpuNUFFT_operator.hpp"
 #include "texture_gpuNUFFT_operator.hpp"
 #include "balanced_texture_gpuNUFFT_operator.hpp"
+#include "cpuNUFFT_operator.hpp"
+#include "gpuNUFFT_plan.hpp"
+#include "gpuNUFFT_plan_cache.hpp"
+#include "gpuNUFFT_load_balancer.hpp"
+#include "gpuNUFFT_memory_planner.hpp"
 #include <algorithm>  // std::sort
 #include <vector>     // std::vector
 #include <string>
@@ -52,13 +57,16 @@ class GpuNUFFTOperatorFactory
   /** \brief Constructor overload
     *
     * @param useTextures Flag to indicate texture interpolation
-    * @param useGpu Flag to indicate gpu usage for precomputation
+    * @param useGpu Flag to indicate gpu usage for precomputation and
+    *gridding, false creates a CpuNUFFTOperator
     * @param balanceWorkload Flag to indicate load balancing
     */
   GpuNUFFTOperatorFactory(const bool useTextures = true, const bool useGpu = true,
                           bool balanceWorkload = true, bool matlabSharedMem = false)
     : useTextures(useTextures), useGpu(useGpu), balanceWorkload(balanceWorkload),
-    matlabSharedMem(matlabSharedMem)
+    matlabSharedMem(matlabSharedMem), useGriddingMatrix(false),
+    griddingMatrixBudget(CpuNUFFTOperator::DEFAULT_GRIDDING_MATRIX_BUDGET),
+    planCache(NULL), loadBalancer(NULL), spaceFillingCurve(NO_CURVE)
   {
   }
 
@@ -171,10 +179,129 @@ class GpuNUFFTOperatorFactory
       Array<DType> &deapoData, const IndType &kernelWidth, const IndType &sectorWidth, 
       const DType &osf, Dimensions &imgDims);
 
+  /** \brief Save the precomputed arrays and parameters of the operator.
+    *
+    * Writes a versioned binary plan file (see gpuNUFFT::PlanFile) holding
+    *the sorted trajectory, density compensation, data indices, sector data
+    *count, sector processing order, sector centers and deapodization
+    *function together with osf, kernel width, sector width, image dimensions
+    *and operator type. Coil sensitivities are not part of the plan.
+    *
+    * @param gpuNUFFTOp  operator to save
+    * @param fileName    plan file, replaced if existing
+    * @throws std::invalid_argument if the operator has unused slots, e.g.
+    *after incremental updates
+    * @throws std::runtime_error on write errors
+    */
+  void savePlan(GpuNUFFTOperator *gpuNUFFTOp, const std::string &fileName);
+
+  /** \brief Load GpuNUFFT Operator from a plan file written by savePlan.
+    *
+    * The file is memory mapped and the precomputed arrays of the operator
+    *point directly into the mapping, which is released with the operator.
+    *The operator type is taken from the plan, coil sensitivities have to be
+    *set separately.
+    *
+    * @param fileName  plan file
+    * @throws std::runtime_error if the file is no valid plan of this build
+    */
+  GpuNUFFTOperator *loadPlan(const std::string &fileName);
+
+  /** \brief Precompute a plan file of a trajectory stored in a file.
+    *
+    * Out-of-core counterpart of createGpuNUFFTOperator and savePlan for
+    *trajectories larger than the memory. The trajectory file is memory mapped
+    *and sorted by sector in two passes over blocks of samples: the first pass
+    *counts the samples per sector, the second distributes the coordinates,
+    *density compensation values and data indices to buffers of consecutive
+    *sector ranges. A full buffer is written to the mapped plan file in
+    *ascending order. Apart from the arrays of grid size (sector data count,
+    *processing order, sector centers, deapodization, bucket and write offset
+    *of each sector) at most memoryBudget bytes are allocated for the sector
+    *indices of a block and the sample buffers, independent of the trajectory
+    *length. The samples of each sector keep their acquisition order, a
+    *space-filling curve only applies to the processing order. The plan is
+    *loaded with loadPlan.
+    *
+    * @param trajFileName  raw DType coordinates in host byte order, linearized
+    *array (x1,...,xn,y1,...,yn(,z1,...,zn))
+    * @param densFileName  raw DType density compensation values, empty if not
+    *used
+    * @param kernelWidth   interpolation kernel size in grid units
+    * @param sectorWidth   sector width
+    * @param osf           grid oversampling ratio
+    * @param imgDims       image dimensions (problem size)
+    * @param planFileName  plan file, replaced if existing
+    * @param memoryBudget  size of the sample block and bucket buffers in
+    *bytes, a larger budget results in fewer and longer writes
+    * @throws std::invalid_argument if the file sizes do not match
+    * @throws std::runtime_error on read or write errors
+    */
+  void createPlanFile(const std::string &trajFileName,
+                      const std::string &densFileName,
+                      const IndType &kernelWidth, const IndType &sectorWidth,
+                      const DType &osf, Dimensions &imgDims,
+                      const std::string &planFileName,
+                      size_t memoryBudget = DEFAULT_OUT_OF_CORE_BUDGET);
+
+  /** \brief Default buffer size of createPlanFile in bytes */
+  static const size_t DEFAULT_OUT_OF_CORE_BUDGET = 64 * 1024 * 1024;
+
+  /** \brief Reuse plans of previously created operators
+    *
+    * If set, createGpuNUFFTOperator hashes the trajectory and density
+    *compensation data together with the gridding parameters and the operator
+    *type. A plan stored for this key is loaded with loadPlan, otherwise the
+    *new operator is stored in the cache with savePlan. The key and the
+    *gridding parameters are stored in the plan header as well and compared on
+    *load, a plan which does not match is discarded and recomputed.
+    *
+    * @param planCache  cache to use, NULL disables caching. The cache is not
+    *owned by the factory and has to outlive its use.
+    */
+  void setPlanCache(PlanCache *planCache);
+
+  /** \brief Policy computing the sector processing order of CPU operators
+    *
+    * By default a gpuNUFFT::CostModelBalancer for the threads of the default
+    *ThreadPool is used. The balanced GPU operators always split the sectors
+    *into chunks of MAXIMUM_PAYLOAD samples as required by their kernels.
+    *
+    * @param loadBalancer  policy to use, NULL selects the default. The policy
+    *is not owned by the factory and has to outlive its use.
+    */
+  void setLoadBalancer(LoadBalancer *loadBalancer);
+
+  /** \brief Order sectors and samples along a space-filling curve
+    *
+    * The samples of each sector are sorted by the curve index of their grid
+    *cell and chunks of similar cost are processed in curve order of their
+    *sectors, thus consecutive samples and chunks touch neighbouring grid
+    *memory. The data indices are permuted alike, results are unchanged.
+    *Non-balanced GPU operators process the sectors by block index, thus only
+    *the sample order applies to them.
+    *
+    * @param curve  NO_CURVE (default), MORTON_CURVE or HILBERT_CURVE
+    */
+  void setSpaceFillingCurve(SpaceFillingCurve curve);
+
   void setUseTextures(bool useTextures);
 
   void setBalanceWorkload(bool balanceWorkload);
 
+  /** \brief Precompute the sparse gridding matrix of created CPU operators
+    *
+    * Only used if the factory creates CpuNUFFTOperators (useGpu = false). If
+    *the matrix exceeds the memory budget the operator falls back to on-the-fly
+    *kernel evaluation.
+    *
+    * @param useGriddingMatrix  Flag to indicate gridding matrix precomputation
+    * @param memoryBudget       maximum size of the matrix in bytes
+    */
+  void setUseGriddingMatrix(
+      bool useGriddingMatrix,
+      size_t memoryBudget = CpuNUFFTOperator::DEFAULT_GRIDDING_MATRIX_BUDGET);
+
  protected:
   /** \brief Assign the samples on the k-space trajectory to its corresponding
     *sector
@@ -187,6 +314,29 @@ class GpuNUFFTOperatorFactory
   /** \brief Init a linear array of size arrCount */
   template <typename T> Array<T> initLinArray(IndType arrCount);
 
+  /** \brief Describe the parameters and precomputed arrays of the operator
+   *as plan file header and sections */
+  std::vector<PlanFile::SectionData>
+  getPlanSections(GpuNUFFTOperator *gpuNUFFTOp, PlanFileHeader &header);
+
+  /** \brief Save a plan stored for the PlanCache key planKey */
+  void savePlan(GpuNUFFTOperator *gpuNUFFTOp, const std::string &fileName,
+                const std::string &planKey);
+
+  /** \brief Load a plan, the parameters and the cache key of the header have
+   *to match expected unless NULL
+   *
+   * @throws std::runtime_error if the plan does not match
+   */
+  GpuNUFFTOperator *loadPlan(const std::string &fileName,
+                             const PlanFileHeader *expected);
+
+  /** \brief Describe the array as plan file section of elementCount
+   *elements, array.count() elements if 0 */
+  template <typename T>
+  PlanFile::SectionData getPlanSection(Array<T> array,
+                                       IndType elementCount = 0);
+
   /** \brief Initialization method for the data indices array */
   virtual Array<IndType> initDataIndices(GpuNUFFTOperator *gpuNUFFTOp,
                                          IndType coordCnt);
@@ -258,12 +408,16 @@ class GpuNUFFTOperatorFactory
   /** \brief Method to compute the sector processing order.
     *
     * This method iterates over the previously performed sector mapping
-    * and splits any sectors which contain more samples than
-    * defined in MAXIMUM_PAYLOAD.
+    * and splits sectors with many samples into chunks, see
+    * setLoadBalancer.
     *
     */
   void computeProcessingOrder(GpuNUFFTOperator *gpuNUFFTOp);
 
+  /** \brief Compute the processing order, sector centers and deapodization
+    *of an operator with sector data count */
+  void computeSectorArrays(GpuNUFFTOperator *gpuNUFFTOp);
+
   /** \brief Compute sector centers array */
   Array<IndType> computeSectorCenters(GpuNUFFTOperator *gpuNUFFTOp, bool useLocalMemory = false);
   /** \brief Compute 2-d sector centers array */
@@ -283,6 +437,7 @@ class GpuNUFFTOperatorFactory
     * - balanceWorkload = true: BalancedGpuNUFFTOperator
     * - useTextures = true: TextureGpuNUFFTOperator
     * - balanceWorkload + useTextures = true: BalancedTextureGpuNUFFTOperator
+    * - useGpu = false: CpuNUFFTOperator
     *
     * @return New allocated GpuNUFFTOperator or sub class
     */
@@ -290,9 +445,36 @@ class GpuNUFFTOperatorFactory
                                               IndType sectorWidth, DType osf,
                                               Dimensions imgDims);
 
+  /** \brief Create a new GpuNUFFTOperator of the given type.
+    *
+    * @param sharedMem  Flag to indicate that the data arrays are owned
+    *externally and must not be freed by the operator
+    */
+  GpuNUFFTOperator *createNewGpuNUFFTOperator(OperatorType operatorType,
+                                              IndType kernelWidth,
+                                              IndType sectorWidth, DType osf,
+                                              Dimensions imgDims,
+                                              bool sharedMem);
+
+  /** \brief Operator type selected by the factory settings */
+  OperatorType getOperatorType();
+
+  /** \brief Set previously computed mappings on a new operator */
+  void initPrecomputedOperator(GpuNUFFTOperator *gpuNUFFTOp,
+                               Array<DType> &kSpaceTraj,
+                               Array<IndType> &dataIndices,
+                               Array<IndType> &sectorDataCount,
+                               Array<IndType2> &sectorProcessingOrder,
+                               Array<IndType> &sectorCenters,
+                               Array<DType2> &sensData,
+                               Array<DType> &deapoData);
+
   /**
    * \brief Function to check if the problem will fit into device memory
    *
+   * The MemoryPlanner requirements of a single coil are compared with the
+   * total memory of the device.
+   *
    * @throws Exception in case of too much required memory
    */
   void checkMemoryConsumption(Dimensions &kSpaceDims,
@@ -300,6 +482,18 @@ class GpuNUFFTOperatorFactory
                               Dimensions &imgDims, Dimensions &densDims,
                               Dimensions &sensDims);
 
+  /**
+   * \brief Function to check if the problem can be indexed by the CUDA kernels
+   *
+   * The GPU kernels address samples and grid points of a coil with int, also
+   * in GPU_INDEX64 builds. CPU operators are not limited.
+   *
+   * @throws std::invalid_argument if a GPU operator exceeds INT_MAX samples or
+   *grid points per coil
+   */
+  void checkIndexRange(OperatorType operatorType, IndType dataCount,
+                       const DType &osf, Dimensions &imgDims);
+
   /**
   * \brief Computation of the deapodization function
   * 
@@ -308,11 +502,29 @@ class GpuNUFFTOperatorFactory
   gpuNUFFT::Array<DType> computeDeapodizationFunction(const IndType &kernelWidth,
     const DType &osf, gpuNUFFT::Dimensions &imgDims);
 
+  /** \brief Computation of the separable deapodization factors
+  *
+  * @returns one vector per image axis, see computeDeapodizationVectorsCPU
+  */
+  gpuNUFFT::Array<DType> computeDeapodizationVectors(
+      const IndType &kernelWidth, const DType &osf,
+      gpuNUFFT::Dimensions &imgDims);
+
+  /** \brief Precompute the gridding matrix of CPU operators if enabled */
+  void initGriddingMatrix(GpuNUFFTOperator *gpuNUFFTOp);
+
+  /** \brief Key of the plan cache for the given operator inputs */
+  std::string computePlanKey(Array<DType> &kSpaceTraj,
+                             Array<DType> &densCompData,
+                             const IndType &kernelWidth,
+                             const IndType &sectorWidth, const DType &osf,
+                             Dimensions &imgDims);
+
  private:
   /** \brief Flag to indicate texture interpolation */
   bool useTextures;
 
-  /** \brief Flag to indicate gpu usage for precomputation */
+  /** \brief Flag to indicate gpu usage for precomputation and gridding */
   bool useGpu;
 
   /** \brief Flag to indicate load balancing */
@@ -320,6 +532,21 @@ class GpuNUFFTOperatorFactory
 
   /** \brief Flag to indicate shared memory usage with Matlab */
   bool matlabSharedMem;
+
+  /** \brief Flag to indicate gridding matrix precomputation (CPU only) */
+  bool useGriddingMatrix;
+
+  /** \brief Maximum size of the gridding matrix in bytes */
+  size_t griddingMatrixBudget;
+
+  /** \brief Optional cache of operator plans */
+  PlanCache *planCache;
+
+  /** \brief Optional processing order policy of CPU operators */
+  LoadBalancer *loadBalancer;
+
+  /** \brief Traversal order of sectors and samples */
+  SpaceFillingCurve spaceFillingCurve;
 };
 }
 
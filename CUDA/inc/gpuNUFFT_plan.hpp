@@ -0,0 +1,249 @@
+#ifndef GPUNUFFT_PLAN_H_INCLUDED
+#define GPUNUFFT_PLAN_H_INCLUDED
+
+#include "gpuNUFFT_types.hpp"
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace gpuNUFFT
+{
+/** \brief Version of the plan file layout written by PlanFile::write */
+const uint32_t PLAN_FILE_VERSION = 4;
+
+/** \brief Alignment of the array sections inside a plan file in bytes */
+const uint64_t PLAN_SECTION_ALIGNMENT = 64;
+
+/** \brief Size of the plan cache key in the plan file header, including the
+ * terminating null character */
+const size_t PLAN_KEY_SIZE = 48;
+
+/** \brief Precomputed arrays stored in a plan file */
+enum PlanSectionType
+{
+  /** \brief Sorted k-space trajectory (DType) */
+  PLAN_COORDS,
+  /** \brief Data indices (IndType) */
+  PLAN_DATA_INDICES,
+  /** \brief Sector data count (IndType) */
+  PLAN_SECTOR_DATA_COUNT,
+  /** \brief Sector processing order (IndType2) */
+  PLAN_SECTOR_PROCESSING_ORDER,
+  /** \brief Sector centers (IndType) */
+  PLAN_SECTOR_CENTERS,
+  /** \brief Sorted density compensation (DType) */
+  PLAN_DENSITY,
+  /** \brief Deapodization function (DType) */
+  PLAN_DEAPODIZATION,
+  /** \brief Separable deapodization factors of CPU operators (DType) */
+  PLAN_DEAPODIZATION_VECTORS,
+  PLAN_SECTION_COUNT
+};
+
+/** \brief Fixed size header at the beginning of a plan file
+ *
+ * The header is followed by PLAN_SECTION_COUNT PlanFileSection entries and
+ * the array sections, each starting at a multiple of PLAN_SECTION_ALIGNMENT.
+ * Arrays are stored in host byte order, the byteOrderMark and the type sizes
+ * are checked when the file is loaded.
+ */
+struct PlanFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrderMark;
+  uint32_t dTypeSize;
+  uint32_t indTypeSize;
+  /** \brief gpuNUFFT::OperatorType of the saved operator */
+  uint32_t operatorType;
+  uint32_t kernelWidth;
+  uint32_t sectorWidth;
+  uint32_t sectionCount;
+  /** \brief Image width, height and depth (0 for 2-d operators) */
+  uint32_t imgDims[3];
+  float osf;
+  uint64_t fileSize;
+  /** \brief Amount of samples of the trajectory */
+  uint64_t sampleCount;
+  /** \brief PlanCache key the plan was stored for, empty otherwise */
+  char planKey[PLAN_KEY_SIZE];
+};
+
+/** \brief Descriptor of one array section of a plan file */
+struct PlanFileSection
+{
+  /** \brief gpuNUFFT::PlanSectionType */
+  uint32_t type;
+  /** \brief width, height, depth, channels, frames and length of the
+   * array dimensions, 64-bit for GPU_INDEX64 builds */
+  uint64_t dims[6];
+  /** \brief Offset from the beginning of the file in bytes */
+  uint64_t offset;
+  /** \brief Section size in bytes, 0 for arrays not set */
+  uint64_t size;
+};
+
+/**
+ * \brief Memory mapped file
+ *
+ * The whole file is mapped into the address space of the process. Pages are
+ * loaded on first access and may be evicted by the operating system at any
+ * time, thus files larger than the physical memory can be processed.
+ */
+class MappedFile
+{
+ public:
+  enum Mode
+  {
+    /** \brief Read access only */
+    READ_ONLY,
+    /** \brief Modifications are private to the process and never written
+     * back to the file */
+    COPY_ON_WRITE,
+    /** \brief Modifications are written back to the file */
+    READ_WRITE
+  };
+
+  /** \brief Map the whole file.
+   *
+   * @throws std::runtime_error if the file cannot be opened or mapped
+   */
+  explicit MappedFile(const std::string &fileName, Mode mode = READ_ONLY);
+
+  ~MappedFile();
+
+  /** \brief Begin of the mapping, NULL for empty files */
+  char *getData() const
+  {
+    return base;
+  }
+
+  size_t getSize() const
+  {
+    return mappedSize;
+  }
+
+  /** \brief Write modified pages back to the file (READ_WRITE mode)
+   *
+   * @throws std::runtime_error on write errors
+   */
+  void flush();
+
+ private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+  /** \brief Release the mapping and close the file */
+  void unmap();
+
+  std::string fileName;
+  char *base;
+  size_t mappedSize;
+
+#ifdef _WIN32
+  void *fileHandle;
+  void *mappingHandle;
+#else
+  int fileDescriptor;
+#endif
+};
+
+/**
+ * \brief Memory mapped operator plan file
+ *
+ * A plan file holds the precomputed arrays of a GpuNUFFTOperator together with
+ * its gridding parameters, see GpuNUFFTOperatorFactory::savePlan and
+ * GpuNUFFTOperatorFactory::loadPlan.
+ *
+ * The file is mapped copy-on-write, thus the arrays returned by getSection
+ * point into the mapping and stay valid as long as the PlanFile exists.
+ * Modifications of the arrays are private to the process and never written
+ * back to the file, unless the file is opened writable to fill in sections
+ * reserved by write.
+ */
+class PlanFile
+{
+ public:
+  /** \brief Map the plan file and validate its header.
+   *
+   * @throws std::runtime_error if the file cannot be mapped or is no
+   *valid plan file of this build (version, byte order, type sizes)
+   *
+   * @param fileName  plan file
+   * @param writable  Flag to write modifications of the sections back to
+   *the file
+   */
+  explicit PlanFile(const std::string &fileName, bool writable = false);
+
+  const PlanFileHeader &getHeader() const
+  {
+    return *header;
+  }
+
+  /** \brief Wrap the section as array without copying.
+   *
+   * Sections not stored in the file result in an empty array (data NULL).
+   */
+  template <typename T> Array<T> getSection(PlanSectionType type) const
+  {
+    Array<T> array;
+    const PlanFileSection &section = sections[type];
+    if (section.size == 0)
+      return array;
+    array.data = reinterpret_cast<T *>(base + section.offset);
+    array.dim.width = section.dims[0];
+    array.dim.height = section.dims[1];
+    array.dim.depth = section.dims[2];
+    array.dim.channels = section.dims[3];
+    array.dim.frames = section.dims[4];
+    array.dim.length = section.dims[5];
+    return array;
+  }
+
+  /** \brief Array data written to a plan file section */
+  struct SectionData
+  {
+    SectionData() : data(NULL), size(0), reserve(false)
+    {
+    }
+    const void *data;
+    Dimensions dim;
+    /** \brief Size of data in bytes */
+    size_t size;
+    /** \brief Flag to allocate size bytes without data, filled in later
+     * through a writable PlanFile */
+    bool reserve;
+  };
+
+  /** \brief Write a plan file.
+   *
+   * @param fileName  target file, replaced if existing
+   * @param header    parameters of the plan, the format fields are set here
+   * @param data      PLAN_SECTION_COUNT arrays indexed by PlanSectionType,
+   *sections without data are skipped unless reserved
+   * @throws std::runtime_error on write errors
+   */
+  static void write(const std::string &fileName, PlanFileHeader header,
+                    const std::vector<SectionData> &data);
+
+  /** \brief Write modified sections of a writable plan file back to the
+   * file
+   *
+   * @throws std::runtime_error on write errors
+   */
+  void flush();
+
+ private:
+  PlanFile(const PlanFile &);
+  PlanFile &operator=(const PlanFile &);
+
+  MappedFile file;
+  char *base;
+  const PlanFileHeader *header;
+  const PlanFileSection *sections;
+};
+
+}  // namespace gpuNUFFT
+
+#endif  // GPUNUFFT_PLAN_H_INCLUDED
@@ -0,0 +1,148 @@
+#ifndef GPUNUFFT_PLAN_CACHE_H_INCLUDED
+#define GPUNUFFT_PLAN_CACHE_H_INCLUDED
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <functional>
+#include <mutex>
+
+namespace gpuNUFFT
+{
+/**
+ * \brief Incremental 128-bit hash of the inputs of a plan
+ *
+ * Used to build the keys of the PlanCache from the trajectory and density
+ * buffers and the gridding parameters. Buffers are consumed in 64-bit words,
+ * which are mixed into two independent 64-bit lanes.
+ */
+class PlanKey
+{
+ public:
+  PlanKey();
+
+  /** \brief Add size bytes of data to the hash */
+  void add(const void *data, size_t size);
+
+  /** \brief Add a scalar parameter to the hash */
+  template <typename T> void add(const T &value)
+  {
+    add(&value, sizeof(T));
+  }
+
+  /** \brief Hexadecimal representation of the hash, 32 digits */
+  std::string toString() const;
+
+ private:
+  void addWord(uint64_t word);
+
+  uint64_t hash[2];
+  uint64_t length;
+};
+
+/**
+ * \brief Content-addressed on-disk cache of operator plans
+ *
+ * Plans are stored as plan files (see PlanFile) named after their key in the
+ * cache directory. The directory may be shared by several processes: new
+ * plans are written to a temporary file first and renamed afterwards, so a
+ * plan is either complete or invisible to the other processes.
+ *
+ * The total size of the stored plans is limited. The modification time of a
+ * plan file is updated on each hit and the least recently used plans are
+ * removed once a new plan exceeds the limit.
+ *
+ * @see GpuNUFFTOperatorFactory::setPlanCache
+ */
+class PlanCache
+{
+ public:
+  /** \brief Default size limit of the cache directory in bytes (4 GiB) */
+  static const uint64_t DEFAULT_MAX_SIZE = 4ull << 30;
+
+  /** \brief Lookup and store counters */
+  struct Statistics
+  {
+    Statistics() : hits(0), misses(0), stores(0), evictions(0)
+    {
+    }
+
+    /** \brief Lookups which found a stored plan */
+    uint64_t hits;
+    /** \brief Lookups without stored plan */
+    uint64_t misses;
+    /** \brief Plans written to the cache */
+    uint64_t stores;
+    /** \brief Plans removed due to the size limit */
+    uint64_t evictions;
+  };
+
+  /** \brief Cache plans in directory, which is created if missing.
+   *
+   * @param directory  cache directory
+   * @param maxSize    size limit of the stored plans in bytes
+   */
+  explicit PlanCache(const std::string &directory,
+                     uint64_t maxSize = DEFAULT_MAX_SIZE);
+
+  /** \brief Path of the plan stored for key, empty string on a miss.
+   *
+   * A hit marks the plan as recently used.
+   */
+  std::string lookup(const std::string &key);
+
+  /** \brief Drop a plan returned by lookup which could not be loaded.
+   *
+   * The plan file is removed and the lookup is counted as miss.
+   */
+  void discard(const std::string &key);
+
+  /** \brief Store a new plan for key.
+   *
+   * writePlan is called with the name of a temporary file in the cache
+   * directory, which is renamed to the plan path afterwards. Least recently
+   * used plans are evicted if the size limit is exceeded.
+   */
+  void store(const std::string &key,
+             const std::function<void(const std::string &)> &writePlan);
+
+  /** \brief Remove all stored plans */
+  void clear();
+
+  const std::string &getDirectory() const
+  {
+    return directory;
+  }
+
+  uint64_t getMaxSize() const
+  {
+    return maxSize;
+  }
+
+  /** \brief Current total size of the stored plans in bytes */
+  uint64_t getSize() const;
+
+  Statistics getStatistics() const;
+
+  void resetStatistics();
+
+ private:
+  PlanCache(const PlanCache &);
+  PlanCache &operator=(const PlanCache &);
+
+  std::string getPlanPath(const std::string &key) const;
+
+  /** \brief Remove least recently used plans except keepPath until the size
+   *limit is met */
+  void evict(const std::string &keepPath);
+
+  std::string directory;
+  uint64_t maxSize;
+
+  mutable std::mutex statisticsMutex;
+  Statistics statistics;
+};
+
+}  // namespace gpuNUFFT
+
+#endif  // GPUNUFFT_PLAN_CACHE_H_INCLUDED
@@ -22,6 +22,13 @@
  */
 #define MAXIMUM_PAYLOAD 256
 
+/**
+ * \brief Data index of unused slots in the sorted sample arrays
+ *
+ * @see gpuNUFFT::IncrementalPlan
+ */
+#define INVALID_DATA_INDEX ((IndType)-1)
+
 /** \brief gpuNUFFT related classes
   */
 namespace gpuNUFFT
@@ -209,7 +216,21 @@ enum OperatorType
   BALANCED,
   /** \brief Gridding Operator using load balancing and Texture interpolation on
      GPU. */
-  BALANCED_TEXTURE
+  BALANCED_TEXTURE,
+  /** \brief Gridding Operator executed on the host CPU. */
+  CPU
+};
+
+/** \brief Space-filling curve ordering the sectors and the samples inside of
+  *each sector, see gpuNUFFT::GpuNUFFTOperatorFactory::setSpaceFillingCurve */
+enum SpaceFillingCurve
+{
+  /** \brief Sectors by linear index, samples in acquisition order. */
+  NO_CURVE,
+  /** \brief Morton (Z-order) curve, interleaved bits of the cell indices. */
+  MORTON_CURVE,
+  /** \brief Hilbert curve, consecutive cells are always adjacent. */
+  HILBERT_CURVE
 };
 
 /** \brief Struct containing meta information of the current Gridding Problem.
@@ -229,7 +250,7 @@ enum OperatorType
 struct GpuNUFFTInfo
 {
   /**\brief Total amount of data samples.*/
-  int data_count;
+  IndType data_count;
   /**\brief Width in grid units of gridding kernel.*/
   int kernel_width;
   /**\brief Squared kernel_width.*/
@@ -241,15 +262,15 @@ struct GpuNUFFTInfo
   /**\brief Radius of kernel relative to grid size.*/
   DType kernel_radius;
 
-  /**\brief Width of oversampled grid.*/
-  int grid_width_dim;
+  /**\brief Total amount of oversampled grid nodes.*/
+  IndType grid_width_dim;
   /**\brief .*/
   int grid_width_offset;
   /**\brief Reciprocal value of grid_width_dim.*/
   DType3 grid_width_inv;
 
   /**\brief Total amount of image nodes.*/
-  int im_width_dim;
+  IndType im_width_dim;
   /**\brief Image offset (imgDims / 2).*/
   IndType3 im_width_offset;  // used in deapodization
 
@@ -266,7 +287,8 @@ struct GpuNUFFTInfo
   /**\brief Maximum index per dimension of padded sector (sector_pad_width -
    * 1).*/
   int sector_pad_max;
-  /**\brief Total amount of elements in one padded sector.*/
+  /**\brief Total amount of elements in one padded sector, bounded by the
+   * sector and kernel width thus int also for GPU_INDEX64.*/
   int sector_dim;
   /**\brief Offset to zero position inside padded sector (sector_pad_width / 2).
    * Used in combination with the sector center in order to get to the starting
@@ -0,0 +1,169 @@
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+
+#include "config.hpp"
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+namespace gpuNUFFT
+{
+/**
+ * \brief Persistent pool of host worker threads used by the CPU code paths.
+ *
+ * The pool executes index ranges in parallel (parallelFor). The calling
+ * thread takes part in the processing as thread 0, thus a pool of n threads
+ * starts n-1 workers. Indices are handed out dynamically, so unevenly loaded
+ * items (e.g. sectors with different sample counts) are balanced
+ * automatically.
+ *
+ * parallelForStealing schedules items of very different cost, e.g. the
+ * entries of a sector processing order sorted by load. The items are
+ * distributed round-robin onto per-thread queues, each thread processes its
+ * own queue from the front and steals from the back of the other queues once
+ * it runs empty. Busy and idle times of these jobs are accumulated per
+ * thread (getThreadStatistics).
+ *
+ * Calls of parallelFor from inside a running task are executed serially by
+ * the calling thread, so nested parallel code is safe but does not spawn
+ * additional work.
+ *
+ * The number of threads of the shared default instance is taken from the
+ * environment variable GPUNUFFT_CPU_THREADS, if set, or from the number of
+ * available hardware threads otherwise.
+ */
+class ThreadPool
+{
+ public:
+  /** \brief Task signature: item index and id of the executing thread
+   * (0..getThreadCount()-1) */
+  typedef std::function<void(IndType, unsigned)> Task;
+
+  /** \brief Per thread counters of the parallelForStealing jobs */
+  struct ThreadStatistics
+  {
+    ThreadStatistics()
+      : tasks(0), stolenTasks(0), busySeconds(0.0), idleSeconds(0.0)
+    {
+    }
+
+    /** \brief Executed items */
+    IndType tasks;
+    /** \brief Executed items taken from the queue of another thread */
+    IndType stolenTasks;
+    /** \brief Time spent executing items */
+    double busySeconds;
+    /** \brief Time of the jobs not spent executing items */
+    double idleSeconds;
+  };
+
+  /** \brief Create pool with threadCount threads (including the caller).
+   *
+   * A threadCount of 0 selects the number of hardware threads.
+   */
+  explicit ThreadPool(unsigned threadCount = 0);
+
+  ~ThreadPool();
+
+  /** \brief Number of threads executing tasks, including the caller */
+  unsigned getThreadCount() const
+  {
+    return threadCount;
+  }
+
+  /** \brief Execute task(i, threadId) for all i in [0, count).
+   *
+   * Returns after all items have been processed. The first exception thrown
+   * by a task is rethrown in the calling thread after the remaining items
+   * are skipped.
+   */
+  void parallelFor(IndType count, const Task &task);
+
+  /** \brief Execute task(i, threadId) for all i in [0, count) using work
+   * stealing.
+   *
+   * Items are expected in descending order of cost. Item i is queued on
+   * thread i % getThreadCount(), so each thread starts with expensive items
+   * and the cheap ones at the queue ends balance the load at the end of the
+   * job. Exceptions are handled as by parallelFor.
+   */
+  void parallelForStealing(IndType count, const Task &task);
+
+  /** \brief Busy and idle counters per thread, accumulated since the
+   * creation of the pool or the last resetThreadStatistics call */
+  std::vector<ThreadStatistics> getThreadStatistics() const
+  {
+    return statistics;
+  }
+
+  /** \brief Reset the counters returned by getThreadStatistics */
+  void resetThreadStatistics();
+
+  /** \brief Shared pool instance used when no explicit pool is passed */
+  static ThreadPool &getDefault();
+
+ private:
+  ThreadPool(const ThreadPool &);
+  ThreadPool &operator=(const ThreadPool &);
+
+  /** \brief Item queue and job counters of one thread */
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    std::deque<IndType> items;
+    ThreadStatistics job;
+  };
+
+  void workerLoop(unsigned threadId);
+
+  /** \brief Distribute the job to the workers and wait for its completion */
+  void runJob(IndType count, const Task &task, bool stealing);
+
+  void processItems(unsigned threadId);
+
+  void processQueuedItems(unsigned threadId);
+
+  /** \brief Take the next item of the own queue or steal one */
+  bool takeItem(unsigned threadId, IndType &item, bool &stolen);
+
+  /** \brief Execute the item and record the first failure */
+  void executeItem(IndType item, unsigned threadId);
+
+  unsigned threadCount;
+
+  std::vector<std::thread> workers;
+
+  /** \brief Serializes concurrent parallelFor calls of different threads */
+  std::mutex submitMutex;
+
+  std::mutex stateMutex;
+  std::condition_variable startCondition;
+  std::condition_variable doneCondition;
+
+  /** \brief Incremented for each submitted job, wakes up the workers */
+  unsigned long generation;
+  bool shutdown;
+  /** \brief Set while the submitted job accepts additional workers */
+  bool jobOpen;
+  unsigned activeWorkers;
+
+  const Task *task;
+  IndType itemCount;
+  std::atomic<IndType> nextItem;
+  std::atomic<bool> failed;
+  std::exception_ptr failure;
+
+  /** \brief Set while the submitted job uses the work queues */
+  bool stealing;
+  std::vector<WorkQueue> queues;
+  std::vector<ThreadStatistics> statistics;
+};
+
+}  // namespace gpuNUFFT
+
+#endif  // THREAD_POOL_H_INCLUDED
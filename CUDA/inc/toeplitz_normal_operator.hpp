@@ -0,0 +1,124 @@
+#ifndef TOEPLITZ_NORMAL_OPERATOR_H_INCLUDED
+#define TOEPLITZ_NORMAL_OPERATOR_H_INCLUDED
+
+#include "gpuNUFFT_types.hpp"
+#include "gpuNUFFT_operator.hpp"
+#include "gpuNUFFT_cpu_fft.hpp"
+#include "thread_pool.hpp"
+#include <vector>
+
+namespace gpuNUFFT
+{
+/**
+ * \brief Normal operator A^H A of a GpuNUFFTOperator based on Toeplitz
+ *embedding
+ *
+ * The product of adjoint and forward NUFFT (including the density
+ * compensation) is a convolution of the image with the point spread
+ * function (PSF) of the trajectory. The PSF is computed once by an adjoint
+ * gridding of the density weights onto an image of twice the size. Then
+ * A^H A x is evaluated by
+ *
+ * - zero padding of x to twice the image size
+ * - FFT
+ * - multiplication with the transfer function (FFT of the PSF)
+ * - inverse FFT
+ * - cropping to the image size
+ *
+ * without any gridding convolution. Coil sensitivities of the operator are
+ * applied before and after the convolution, i.e. the result is
+ * sum_c conj(S_c) * PSF * (S_c x).
+ *
+ * The application is performed on the host using the threads of a
+ * gpuNUFFT::ThreadPool. The PSF is computed by an operator of the same type
+ * as the passed one, i.e. on the GPU for GPU operators. The embedding grid
+ * and the FFT scratch are allocated by the first application and reused,
+ * thus an operator must not be applied by concurrent threads.
+ */
+class ToeplitzNormalOperator
+{
+ public:
+  /** \brief ToeplitzNormalOperator ctor
+    *
+    * Computes the transfer function. The operator gpuNUFFTOp is not
+    *referenced afterwards, the coil sensitivities are copied.
+    *
+    * @param gpuNUFFTOp   NUFFT operator A
+    * @param threadPool   thread pool used for processing, NULL selects the
+    *default thread pool
+    */
+  ToeplitzNormalOperator(GpuNUFFTOperator *gpuNUFFTOp,
+                         ThreadPool *threadPool = NULL);
+
+  ~ToeplitzNormalOperator()
+  {
+  }
+
+  /** \brief Apply the normal operator A^H A
+    *
+    * @param imgData    image data, one channel with coil sensitivities, one
+    *channel per coil otherwise
+    * @param normalData preallocated output array of the size of imgData
+    */
+  void performNormal(Array<DType2> imgData, Array<CufftType> &normalData);
+
+  /** \brief Apply the normal operator A^H A
+    *
+    * The memory for the output array is allocated automatically but has to be
+    *freed manually.
+    *
+    * @param imgData image data
+    * @return A^H A imgData
+    */
+  Array<CufftType> performNormal(Array<DType2> imgData);
+
+  Dimensions getImageDims()
+  {
+    return imgDims;
+  }
+
+  /** \brief Dimensions of the embedding grid, twice the image dimensions */
+  Dimensions getEmbeddingDims()
+  {
+    return embeddingDims;
+  }
+
+  /** \brief Transfer function, the scaled FFT of the embedded PSF */
+  const std::vector<CufftType> &getTransferFunction() const
+  {
+    return transferFunction;
+  }
+
+ private:
+  /** \brief Compute the PSF by adjoint gridding onto twice the image size
+   * and transform it into the transfer function */
+  void computeTransferFunction(GpuNUFFTOperator *gpuNUFFTOp);
+
+  /** \brief Return thread pool used for processing */
+  ThreadPool *getThreadPool()
+  {
+    return (threadPool != NULL) ? threadPool : &ThreadPool::getDefault();
+  }
+
+  Dimensions imgDims;
+  Dimensions embeddingDims;
+
+  /** \brief FFT of the embedded PSF, scaled by the FFT normalization */
+  std::vector<CufftType> transferFunction;
+
+  /** \brief Embedding grid and FFT scratch of performNormal */
+  std::vector<CufftType> grid;
+  CpuFFTPlan::Scratch fftScratch;
+
+  /** \brief Copy of the coil sensitivities, empty if not applied */
+  std::vector<DType2> sens;
+
+  /** \brief Amount of coils of the sensitivity data */
+  IndType coilCount;
+
+  /** \brief Thread pool used for processing, NULL for the default pool */
+  ThreadPool *threadPool;
+};
+}
+
+#endif  // TOEPLITZ_NORMAL_OPERATOR_H_INCLUDED
@@ -45,9 +45,9 @@ void gpuNUFFT::BalancedGpuNUFFTOperator::performGpuNUFFTAdj(
     GpuNUFFTOutput gpuNUFFTOut)
 {
   if (DEBUG)
-    printf(
-        "BGpuNUFFT: allocate and copy sector processing order of size %d...\n",
-        this->sectorProcessingOrder.count());
+    printf("BGpuNUFFT: allocate and copy sector processing order of size "
+           "%llu...\n",
+           (unsigned long long)this->sectorProcessingOrder.count());
   allocateAndCopyToDeviceMem<IndType2>(&sector_processing_order_d,
                                        this->sectorProcessingOrder.data,
                                        this->sectorProcessingOrder.count());
@@ -62,9 +62,9 @@ void gpuNUFFT::BalancedGpuNUFFTOperator::performGpuNUFFTAdj(
     GpuNUFFTOutput gpuNUFFTOut)
 {
   if (DEBUG)
-    printf(
-        "BGpuNUFFT: allocate and copy sector processing order of size %d...\n",
-        this->sectorProcessingOrder.count());
+    printf("BGpuNUFFT: allocate and copy sector processing order of size "
+           "%llu...\n",
+           (unsigned long long)this->sectorProcessingOrder.count());
   allocateAndCopyToDeviceMem<IndType2>(&sector_processing_order_d,
                                        this->sectorProcessingOrder.data,
                                        this->sectorProcessingOrder.count());
@@ -79,9 +79,9 @@ void gpuNUFFT::BalancedGpuNUFFTOperator::performForwardGpuNUFFT(
     GpuNUFFTOutput gpuNUFFTOut)
 {
   if (DEBUG)
-    printf(
-        "BGpuNUFFT: allocate and copy sector processing order of size %d...\n",
-        this->sectorProcessingOrder.count());
+    printf("BGpuNUFFT: allocate and copy sector processing order of size "
+           "%llu...\n",
+           (unsigned long long)this->sectorProcessingOrder.count());
   allocateAndCopyToDeviceMem<IndType2>(&sector_processing_order_d,
                                        this->sectorProcessingOrder.data,
                                        this->sectorProcessingOrder.count());
@@ -96,9 +96,9 @@ void gpuNUFFT::BalancedGpuNUFFTOperator::performForwardGpuNUFFT(
     GpuNUFFTOutput gpuNUFFTOut)
 {
   if (DEBUG)
-    printf(
-        "BGpuNUFFT: allocate and copy sector processing order of size %d...\n",
-        this->sectorProcessingOrder.count());
+    printf("BGpuNUFFT: allocate and copy sector processing order of size "
+           "%llu...\n",
+           (unsigned long long)this->sectorProcessingOrder.count());
   allocateAndCopyToDeviceMem<IndType2>(&sector_processing_order_d,
                                        this->sectorProcessingOrder.data,
                                        this->sectorProcessingOrder.count());
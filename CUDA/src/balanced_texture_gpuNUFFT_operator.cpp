@@ -59,9 +59,9 @@ void gpuNUFFT::BalancedTextureGpuNUFFTOperator::performGpuNUFFTAdj(
     GpuNUFFTOutput gpuNUFFTOut)
 {
   if (DEBUG)
-    printf(
-        "BTGpuNUFFT: allocate and copy sector processing order of size %d...\n",
-        this->sectorProcessingOrder.count());
+    printf("BTGpuNUFFT: allocate and copy sector processing order of size "
+           "%llu...\n",
+           (unsigned long long)this->sectorProcessingOrder.count());
   allocateAndCopyToDeviceMem<IndType2>(&sector_processing_order_d,
                                        this->sectorProcessingOrder.data,
                                        this->sectorProcessingOrder.count());
@@ -76,9 +76,9 @@ void gpuNUFFT::BalancedTextureGpuNUFFTOperator::performGpuNUFFTAdj(
     GpuNUFFTOutput gpuNUFFTOut)
 {
   if (DEBUG)
-    printf(
-        "BTGpuNUFFT: allocate and copy sector processing order of size %d...\n",
-        this->sectorProcessingOrder.count());
+    printf("BTGpuNUFFT: allocate and copy sector processing order of size "
+           "%llu...\n",
+           (unsigned long long)this->sectorProcessingOrder.count());
   allocateAndCopyToDeviceMem<IndType2>(&sector_processing_order_d,
                                        this->sectorProcessingOrder.data,
                                        this->sectorProcessingOrder.count());
@@ -94,9 +94,9 @@ void gpuNUFFT::BalancedTextureGpuNUFFTOperator::performForwardGpuNUFFT(
     GpuNUFFTOutput gpuNUFFTOut)
 {
   if (DEBUG)
-    printf(
-        "BTGpuNUFFT: allocate and copy sector processing order of size %d...\n",
-        this->sectorProcessingOrder.count());
+    printf("BTGpuNUFFT: allocate and copy sector processing order of size "
+           "%llu...\n",
+           (unsigned long long)this->sectorProcessingOrder.count());
   allocateAndCopyToDeviceMem<IndType2>(&sector_processing_order_d,
                                        this->sectorProcessingOrder.data,
                                        this->sectorProcessingOrder.count());
@@ -112,9 +112,9 @@ void gpuNUFFT::BalancedTextureGpuNUFFTOperator::performForwardGpuNUFFT(
     gpuNUFFT::GpuArray<CufftType> &kspaceData, GpuNUFFTOutput gpuNUFFTOut)
 {
   if (DEBUG)
-    printf(
-        "BTGpuNUFFT: allocate and copy sector processing order of size %d...\n",
-        this->sectorProcessingOrder.count());
+    printf("BTGpuNUFFT: allocate and copy sector processing order of size "
+           "%llu...\n",
+           (unsigned long long)this->sectorProcessingOrder.count());
   allocateAndCopyToDeviceMem<IndType2>(&sector_processing_order_d,
                                        this->sectorProcessingOrder.data,
                                        this->sectorProcessingOrder.count());
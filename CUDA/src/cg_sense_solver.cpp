@@ -0,0 +1,271 @@
+#include "cg_sense_solver.hpp"
+#include "cpuNUFFT_operator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+/** \brief Image element count per work item */
+const IndType ELEMENTS_PER_TASK = 8192;
+
+inline IndType getTaskCount(IndType count)
+{
+  return (count + ELEMENTS_PER_TASK - 1) / ELEMENTS_PER_TASK;
+}
+
+/** \brief Execute f(begin, end) for consecutive blocks of [0, count) in
+ * parallel and return the sum of the results
+ *
+ * The partial sums are reduced in block order, thus the result does not
+ * depend on the amount of threads.
+ */
+template <typename Function>
+double parallelSum(IndType count, gpuNUFFT::ThreadPool *threadPool,
+                   std::vector<double> &partialSums, const Function &f)
+{
+  IndType taskCount = getTaskCount(count);
+  threadPool->parallelFor(taskCount, [&](IndType task, unsigned)
+                          {
+                            IndType begin = task * ELEMENTS_PER_TASK;
+                            partialSums[task] = f(
+                                begin,
+                                std::min(begin + ELEMENTS_PER_TASK, count));
+                          });
+  double sum = 0;
+  for (IndType task = 0; task < taskCount; task++)
+    sum += partialSums[task];
+  return sum;
+}
+
+/** \brief Sum of conj(S_c) * g_c over the coils, coil images and
+ * sensitivities at offsets of stride */
+inline CufftType combineCoils(const CufftType *g, const DType2 *s,
+                              IndType coilCount, IndType stride)
+{
+  CufftType value;
+  value.x = 0;
+  value.y = 0;
+  for (IndType c = 0; c < coilCount; c++)
+  {
+    const CufftType &gc = g[c * stride];
+    const DType2 &sc = s[c * stride];
+    value.x += gc.x * sc.x + gc.y * sc.y;
+    value.y += gc.y * sc.x - gc.x * sc.y;
+  }
+  return value;
+}
+
+/** \brief Real part of conj(a) * b */
+inline double dotReal(const CufftType &a, const CufftType &b)
+{
+  return (double)a.x * b.x + (double)a.y * b.y;
+}
+}
+
+gpuNUFFT::CgSenseSolver::CgSenseSolver(GpuNUFFTOperator *gpuNUFFTOp,
+                                       Array<DType2> sens,
+                                       ThreadPool *threadPool)
+  : gpuNUFFTOp(gpuNUFFTOp), sens(sens), imgDims(gpuNUFFTOp->getImageDims()),
+    coilCount(1), maxIterations(10), tolerance(0), alpha(0),
+    threadPool(threadPool)
+{
+  if (sens.data != NULL && gpuNUFFTOp->applySensData())
+    throw std::invalid_argument(
+        "Coil sensitivities are already applied by the operator!");
+  imgDims.channels = 1;
+}
+
+void gpuNUFFT::CgSenseSolver::reserveBuffers(IndType dataCount)
+{
+  IndType imgCount = imgDims.count();
+  x.resize(imgCount);
+  r.resize(imgCount);
+  p.resize(imgCount);
+  q.resize(imgCount);
+  partialSums.resize(getTaskCount(imgCount));
+  residualNorms.reserve(maxIterations + 1);
+
+  if (sens.data != NULL)
+  {
+    coilImages.resize(imgCount * coilCount);
+    coilNormal.resize(imgCount * coilCount);
+  }
+  if (dynamic_cast<CpuNUFFTOperator *>(gpuNUFFTOp) == NULL)
+    kspace.resize(dataCount * coilCount);
+}
+
+double gpuNUFFT::CgSenseSolver::applySystemMatrix()
+{
+  ThreadPool *pool = getThreadPool();
+  IndType imgCount = imgDims.count();
+  const DType2 *sensData = sens.data;
+
+  // coil images S_c p
+  if (sensData != NULL)
+    pool->parallelFor(getTaskCount(imgCount), [&](IndType task, unsigned)
+                      {
+                        IndType begin = task * ELEMENTS_PER_TASK;
+                        IndType end =
+                            std::min(begin + ELEMENTS_PER_TASK, imgCount);
+                        for (IndType c = 0; c < coilCount; c++)
+                        {
+                          const DType2 *s = sensData + c * imgCount;
+                          CufftType *coil = &coilImages[c * imgCount];
+                          for (IndType t = begin; t < end; t++)
+                          {
+                            coil[t].x = s[t].x * p[t].x - s[t].y * p[t].y;
+                            coil[t].y = s[t].x * p[t].y + s[t].y * p[t].x;
+                          }
+                        }
+                      });
+
+  Array<DType2> in;
+  in.data = (DType2 *)(sensData != NULL ? &coilImages[0] : &p[0]);
+  in.dim = imgDims;
+  in.dim.channels = sensData != NULL ? coilCount : 1;
+  Array<CufftType> out;
+  out.data = sensData != NULL ? &coilNormal[0] : &q[0];
+  out.dim = in.dim;
+
+  CpuNUFFTOperator *cpuOp = dynamic_cast<CpuNUFFTOperator *>(gpuNUFFTOp);
+  if (cpuOp != NULL)
+    cpuOp->performNormal(in, out);
+  else
+  {
+    Array<CufftType> kspaceData;
+    kspaceData.data = &kspace[0];
+    kspaceData.dim.length = gpuNUFFTOp->getDataCount();
+    kspaceData.dim.channels = coilCount;
+    gpuNUFFTOp->performForwardGpuNUFFT(in, kspaceData);
+    gpuNUFFTOp->performGpuNUFFTAdj(kspaceData, out);
+  }
+
+  // coil combination, regularization and p^H q in a single pass
+  DType alpha = this->alpha;
+  return parallelSum(
+      imgCount, pool, partialSums, [&](IndType begin, IndType end)
+      {
+        double sum = 0;
+        for (IndType t = begin; t < end; t++)
+        {
+          CufftType value = q[t];
+          if (sensData != NULL)
+            value = combineCoils(&coilNormal[t], sensData + t, coilCount,
+                                 imgCount);
+          value.x += alpha * p[t].x;
+          value.y += alpha * p[t].y;
+          q[t] = value;
+          sum += dotReal(p[t], value);
+        }
+        return sum;
+      });
+}
+
+int gpuNUFFT::CgSenseSolver::solve(Array<DType2> kspaceData,
+                                   Array<CufftType> &imgData)
+{
+  ThreadPool *pool = getThreadPool();
+  IndType imgCount = imgDims.count();
+  coilCount = kspaceData.dim.channels;
+  IndType opCoilCount = 1;
+  if (sens.data != NULL)
+    opCoilCount = sens.dim.channels;
+  else if (gpuNUFFTOp->applySensData())
+    opCoilCount = gpuNUFFTOp->getSens().dim.channels;
+
+  if (coilCount != opCoilCount)
+    throw std::invalid_argument(
+        "Channels of the k-space data do not match the coil count!");
+  if (imgData.count() < imgCount)
+    throw std::invalid_argument("Output image is too small!");
+
+  reserveBuffers(gpuNUFFTOp->getDataCount());
+  const DType2 *sensData = sens.data;
+
+  // right hand side A^H y, the solver sums the coil images
+  Array<CufftType> rhs;
+  rhs.data = sensData != NULL ? &coilNormal[0] : &r[0];
+  rhs.dim = imgDims;
+  rhs.dim.channels = sensData != NULL ? coilCount : 1;
+  gpuNUFFTOp->performGpuNUFFTAdj(kspaceData, rhs);
+
+  // r = p = A^H y, x = 0
+  double rr = parallelSum(
+      imgCount, pool, partialSums, [&](IndType begin, IndType end)
+      {
+        double sum = 0;
+        for (IndType t = begin; t < end; t++)
+        {
+          CufftType value = r[t];
+          if (sensData != NULL)
+            value = combineCoils(&coilNormal[t], sensData + t, coilCount,
+                                 imgCount);
+          r[t] = value;
+          p[t] = value;
+          x[t].x = 0;
+          x[t].y = 0;
+          sum += dotReal(value, value);
+        }
+        return sum;
+      });
+
+  residualNorms.clear();
+  residualNorms.push_back(std::sqrt(rr));
+  double stopNorm = tolerance * residualNorms[0];
+
+  int it = 0;
+  for (; it < maxIterations; it++)
+  {
+    if (rr == 0 || residualNorms.back() <= stopNorm)
+      break;
+
+    DType a = (DType)(rr / applySystemMatrix());
+
+    // x += a p, r -= a q and |r|^2 in a single pass
+    double rrNew = parallelSum(
+        imgCount, pool, partialSums, [&](IndType begin, IndType end)
+        {
+          double sum = 0;
+          for (IndType t = begin; t < end; t++)
+          {
+            x[t].x += a * p[t].x;
+            x[t].y += a * p[t].y;
+            r[t].x -= a * q[t].x;
+            r[t].y -= a * q[t].y;
+            sum += dotReal(r[t], r[t]);
+          }
+          return sum;
+        });
+
+    // p = r + b p
+    DType b = (DType)(rrNew / rr);
+    pool->parallelFor(getTaskCount(imgCount), [&](IndType task, unsigned)
+                      {
+                        IndType begin = task * ELEMENTS_PER_TASK;
+                        IndType end =
+                            std::min(begin + ELEMENTS_PER_TASK, imgCount);
+                        for (IndType t = begin; t < end; t++)
+                        {
+                          p[t].x = r[t].x + b * p[t].x;
+                          p[t].y = r[t].y + b * p[t].y;
+                        }
+                      });
+    rr = rrNew;
+    residualNorms.push_back(std::sqrt(rr));
+  }
+
+  std::copy(x.begin(), x.end(), imgData.data);
+  return it;
+}
+
+gpuNUFFT::Array<CufftType>
+gpuNUFFT::CgSenseSolver::solve(Array<DType2> kspaceData)
+{
+  Array<CufftType> imgData;
+  imgData.data = (CufftType *)calloc(imgDims.count(), sizeof(CufftType));
+  imgData.dim = imgDims;
+  solve(kspaceData, imgData);
+  return imgData;
+}
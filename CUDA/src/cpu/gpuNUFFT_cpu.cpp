@@ -1,160 +1,163 @@
 #include "gpuNUFFT_cpu.hpp"
+#include "gpuNUFFT_cpu_kernels.hpp"
+#include "gpuNUFFT_types.hpp"
+#include "precomp_utils.hpp"
+#include <vector>
 
-void gpuNUFFT_cpu(DType *data, DType *crds, DType *gdata, DType *kernel,
-                  int *sectors, int sector_count, int *sector_centers,
-                  int sector_width, int kernel_width, int kernel_count,
-                  int width)
+namespace
+{
+/** \brief Sector sorted samples of gpuNUFFT_cpu and gpuNUFFT_forward_cpu in
+ * the layout of the host gridding kernels
+ *
+ * The coordinates are converted from interleaved (x,y,z) per sample to the
+ * linearized layout (x1,...,xn,y1,...,yn,z1,...,zn), sectors and sector
+ * centers to IndType.
+ */
+struct HostTrajectory
 {
-  int imin, imax, jmin, jmax, kmin, kmax, i, j, k, ind;
-  DType x, y, z, ix, jy, kz;
+  HostTrajectory(DType *crds, int *sectors, int *sector_centers,
+                 gpuNUFFT::GpuNUFFTInfo *gi_host)
+    : info(*gi_host)
+  {
+    IndType dims = gi_host->is2Dprocessing ? 2 : 3;
+    IndType sector_count = gi_host->sector_count;
+    IndType data_count = sectors[sector_count];
+    info.data_count = data_count;
+
+    coords.resize(dims * data_count);
+    for (IndType data_cnt = 0; data_cnt < data_count; data_cnt++)
+      for (IndType d = 0; d < dims; d++)
+        coords[d * data_count + data_cnt] = crds[dims * data_cnt + d];
+    sectorOffsets.assign(sectors, sectors + sector_count + 1);
+    centers.assign(sector_centers, sector_centers + dims * sector_count);
+  }
 
-  /* kr */
-  DType dx_sqr, dy_sqr, dz_sqr, val;
-  int center_x, center_y, center_z, max_x, max_y, max_z;
+  std::vector<DType> coords;
+  std::vector<IndType> sectorOffsets;
+  std::vector<IndType> centers;
+  gpuNUFFT::GpuNUFFTInfo info;
+};
+}
 
-  DType kernel_radius = static_cast<DType>(kernel_width) / 2.0f;
-  DType radius = kernel_radius / static_cast<DType>(width);
+void initGpuNUFFTInfoCPU(gpuNUFFT::GpuNUFFTInfo *gi_host,
+                         gpuNUFFT::Dimensions gridDims, int sector_width,
+                         int kernel_width, int kernel_count)
+{
+  bool is2D = (gridDims.depth == 0);
+  gi_host->is2Dprocessing = is2D;
+
+  gi_host->gridDims.x = gridDims.width;
+  gi_host->gridDims.y = gridDims.height;
+  gi_host->gridDims.z = gridDims.depth;
+  gi_host->gridDims_count = gridDims.width * gridDims.height *
+                            DEFAULT_VALUE(gridDims.depth);
+  gi_host->grid_width_dim = gi_host->gridDims_count;
+
+  gi_host->grid_width_inv.x = (DType)1.0 / static_cast<DType>(gridDims.width);
+  gi_host->grid_width_inv.y =
+      (DType)1.0 / static_cast<DType>(gridDims.height);
+  gi_host->grid_width_inv.z =
+      (DType)1.0 / DEFAULT_VALUE(static_cast<DType>(gridDims.depth));
+
+  gi_host->sector_width = sector_width;
+  gi_host->sector_count =
+      (int)(((gridDims.width + sector_width - 1) / sector_width) *
+            ((gridDims.height + sector_width - 1) / sector_width) *
+            (is2D ? 1 : (gridDims.depth + sector_width - 1) / sector_width));
+
+  gi_host->kernel_width = kernel_width;
+  gi_host->kernel_widthSquared = kernel_width * kernel_width;
+  gi_host->kernel_count = kernel_count;
+
+  // The largest value of the grid dimensions determines the kernel radius
+  // (resolution) in k-space units
+  int max_grid_dim =
+      (int)MAX(MAX(gridDims.width, gridDims.height), gridDims.depth);
+
+  double kernel_radius = static_cast<double>(kernel_width) / 2.0;
+  double radius = kernel_radius / static_cast<double>(max_grid_dim);
+  double radiusSquared = radius * radius;
+  double kernelRadius_invSqr = 1.0 / radiusSquared;
+
+  gi_host->kernel_radius = (DType)kernel_radius;
+  gi_host->radiusSquared = (DType)radiusSquared;
+  gi_host->radiusSquared_inv = (DType)kernelRadius_invSqr;
+  gi_host->dist_multiplier =
+      (DType)((kernel_count - 1) * kernelRadius_invSqr);
 
-  if (DEBUG)
-    printf("radius rel. to grid width %f\n", radius);
-  DType radiusSquared = radius * radius;
-  DType kernelRadius_invSqr = 1 / radiusSquared;
+  int sector_pad_width = sector_width + 2 * (int)floor(kernel_width / 2.0f);
+  gi_host->sector_pad_width = sector_pad_width;
+  gi_host->sector_pad_max = sector_pad_width - 1;
+  gi_host->sector_dim = sector_pad_width * sector_pad_width *
+                        (is2D ? 1 : sector_pad_width);
+  gi_host->sector_offset = (int)floor(sector_pad_width / 2.0f);
+
+  gi_host->aniso_x_scale = (DType)gridDims.width / (DType)max_grid_dim;
+  gi_host->aniso_y_scale = (DType)gridDims.height / (DType)max_grid_dim;
+  gi_host->aniso_z_scale = (DType)gridDims.depth / (DType)max_grid_dim;
+
+  gi_host->sectorsToProcess = gi_host->sector_count;
+  gi_host->n_coils_cc = 1;
+}
 
-  DType dist_multiplier = (kernel_count - 1) * kernelRadius_invSqr;
-  // int sector_width = 10;
+void gpuNUFFT_cpu(DType *data, DType *crds, DType *gdata, DType *kernel,
+                  int *sectors, int *sector_centers,
+                  gpuNUFFT::GpuNUFFTInfo *gi_host,
+                  gpuNUFFT::ThreadPool *threadPool)
+{
+  assert(sectors != NULL);
+
+  HostTrajectory traj(crds, sectors, sector_centers, gi_host);
+  performConvolutionCPU((DType2 *)data, traj.coords.data(),
+                        (CufftType *)gdata, kernel, traj.sectorOffsets.data(),
+                        traj.centers.data(), NULL, 1, &traj.info, threadPool,
+                        gpuNUFFT::SKIP_GRID_BOUNDARY);
+}
+
+void gpuNUFFT_cpu(DType *data, DType *crds, DType *gdata, DType *kernel,
+                  int *sectors, int sector_count, int *sector_centers,
+                  int sector_width, int kernel_width, int kernel_count,
+                  int width, gpuNUFFT::ThreadPool *threadPool)
+{
+  gpuNUFFT::GpuNUFFTInfo gi_host;
+  initGpuNUFFTInfoCPU(&gi_host, gpuNUFFT::Dimensions(width, width, width),
+                      sector_width, kernel_width, kernel_count);
+  gi_host.sector_count = sector_count;
 
-  int sector_pad_width = sector_width + 2 * (int)floor(kernel_width / 2.0f);
-  int sector_dim = sector_pad_width * sector_pad_width * sector_pad_width;
-  int sector_offset = (int)floor(sector_pad_width / 2.0f);
   if (DEBUG)
-    printf("sector offset = %d", sector_offset);
-  DType **sdata = (DType **)malloc(sector_count * sizeof(DType *));
+    printf("radius rel. to grid width %f\n", sqrt(gi_host.radiusSquared));
+
+  gpuNUFFT_cpu(data, crds, gdata, kernel, sectors, sector_centers, &gi_host,
+               threadPool);
+}
 
+void gpuNUFFT_forward_cpu(DType *data, DType *crds, DType *gdata,
+                          DType *kernel, int *sectors, int *sector_centers,
+                          gpuNUFFT::GpuNUFFTInfo *gi_host,
+                          IndType *data_indices,
+                          gpuNUFFT::ThreadPool *threadPool)
+{
   assert(sectors != NULL);
 
-  for (int sec = 0; sec < sector_count; sec++)
-  {
-    sdata[sec] = (DType *)calloc(sector_dim * 2, sizeof(DType));  // 5*5*5 * 2
-    assert(sdata[sec] != NULL);
-
-    center_x = sector_centers[sec * 3];
-    center_y = sector_centers[sec * 3 + 1];
-    center_z = sector_centers[sec * 3 + 2];
-
-    if (DEBUG)
-      printf("handling center (%d,%d,%d) in sector %d\n", center_x, center_y,
-             center_z, sec);
-
-    for (int data_cnt = sectors[sec]; data_cnt < sectors[sec + 1]; data_cnt++)
-    {
-      if (DEBUG)
-        printf("handling %d data point = %f\n", data_cnt + 1,
-               data[2 * data_cnt]);
-
-      x = crds[3 * data_cnt];
-      y = crds[3 * data_cnt + 1];
-      z = crds[3 * data_cnt + 2];
-      if (DEBUG)
-        printf("data k-space coords (%f, %f, %f)\n", x, y, z);
-
-      max_x = sector_pad_width - 1;
-      max_y = sector_pad_width - 1;
-      max_z = sector_pad_width - 1;
-
-      /* set the boundaries of final dataset for gpuNUFFT this point */
-      ix = (x + 0.5f) * (width)-center_x + sector_offset;
-      set_minmax(&ix, &imin, &imax, max_x, kernel_radius);
-      if (DEBUG)
-        printf("ix=%f, imin = %d, imax = %d, max_x = %d\n", ix, imin, imax,
-               max_x);
-      jy = (y + 0.5f) * (width)-center_y + sector_offset;
-      set_minmax(&jy, &jmin, &jmax, max_y, kernel_radius);
-      kz = (z + 0.5f) * (width)-center_z + sector_offset;
-      set_minmax(&kz, &kmin, &kmax, max_z, kernel_radius);
-
-      if (DEBUG)
-        printf("sector grid position of data point: %f,%f,%f\n", ix, jy, kz);
-
-      /* grid this point onto the neighboring cartesian points */
-      for (k = kmin; k <= kmax; k++)
-      {
-        kz = static_cast<DType>((k + center_z - sector_offset)) /
-                 static_cast<DType>((width)) -
-             0.5f;  //(k - center_z) *width_inv;
-        dz_sqr = kz - z;
-        dz_sqr *= dz_sqr;
-        if (dz_sqr < radiusSquared)
-        {
-          for (j = jmin; j <= jmax; j++)
-          {
-            jy = static_cast<DType>(j + center_y - sector_offset) /
-                     static_cast<DType>((width)) -
-                 0.5f;  //(j - center_y) *width_inv;
-            dy_sqr = jy - y;
-            dy_sqr *= dy_sqr;
-            if (dy_sqr < radiusSquared)
-            {
-              for (i = imin; i <= imax; i++)
-              {
-                ix = static_cast<DType>(i + center_x - sector_offset) /
-                         static_cast<DType>((width)) -
-                     0.5f;  // (i - center_x) *width_inv;
-                dx_sqr = ix - x;
-                dx_sqr *= dx_sqr;
-                if (dx_sqr < radiusSquared)
-                {
-                  /* get kernel value */
-                  // separable Filters
-                  val = kernel[(int)round(dz_sqr * dist_multiplier)] *
-                        kernel[(int)round(dy_sqr * dist_multiplier)] *
-                        kernel[(int)round(dx_sqr * dist_multiplier)];
-                  ind = getIndex(i, j, k, sector_pad_width);
-
-                  /* multiply data by current kernel val */
-                  /* grid complex or scalar */
-                  sdata[sec][2 * ind] += val * data[2 * data_cnt];
-                  sdata[sec][2 * ind + 1] += val * data[2 * data_cnt + 1];
-                } /* kernel bounds check x, spherical support */
-              }   /* x 	 */
-            }     /* kernel bounds check y, spherical support */
-          }       /* y */
-        }         /*kernel bounds check z */
-      }           /* z */
-    }             /*data points per sector*/
-
-  } /*sectors*/
-
-  for (int sec = 0; sec < sector_count; sec++)
-  {
-    // printf("DEBUG: showing entries of sector %d in z = 5 plane...\n",sec);
-    center_x = sector_centers[sec * 3];
-    center_y = sector_centers[sec * 3 + 1];
-    center_z = sector_centers[sec * 3 + 2];
-
-    int sector_ind_offset =
-        getIndex(center_x - sector_offset, center_y - sector_offset,
-                 center_z - sector_offset, width);
-
-    // printf("sector index offset in resulting grid: %d\n", sector_ind_offset);
-    for (int z = 0; z < sector_pad_width; z++)
-      for (int y = 0; y < sector_pad_width; y++)
-      {
-        for (int x = 0; x < sector_pad_width; x++)
-        {
-          int s_ind = 2 * getIndex(x, y, z, sector_pad_width);
-          ind = 2 * (sector_ind_offset + getIndex(x, y, z, width));
-
-          if (isOutlier(x, y, z, center_x, center_y, center_z, width,
-                        sector_offset))
-            continue;
-
-          gdata[ind] += sdata[sec][s_ind];  // Re
-          gdata[ind + 1] += sdata[sec][s_ind + 1];  // Im
-        }
-      }
-    // printf("----------------------------------------------------\n");
-    free(sdata[sec]);
-  }
-  free(sdata);
+  HostTrajectory traj(crds, sectors, sector_centers, gi_host);
+  performForwardConvolutionCPU(
+      (CufftType *)data, traj.coords.data(), (CufftType *)gdata, kernel,
+      traj.sectorOffsets.data(), traj.centers.data(), NULL, 1, &traj.info,
+      threadPool, gpuNUFFT::SKIP_GRID_BOUNDARY, data_indices);
 }
 
+void gpuNUFFT_forward_cpu(DType *data, DType *crds, DType *gdata,
+                          DType *kernel, int *sectors, int sector_count,
+                          int *sector_centers, int sector_width,
+                          int kernel_width, int kernel_count, int width,
+                          IndType *data_indices,
+                          gpuNUFFT::ThreadPool *threadPool)
+{
+  gpuNUFFT::GpuNUFFTInfo gi_host;
+  initGpuNUFFTInfoCPU(&gi_host, gpuNUFFT::Dimensions(width, width, width),
+                      sector_width, kernel_width, kernel_count);
+  gi_host.sector_count = sector_count;
+
+  gpuNUFFT_forward_cpu(data, crds, gdata, kernel, sectors, sector_centers,
+                       &gi_host, data_indices, threadPool);
+}
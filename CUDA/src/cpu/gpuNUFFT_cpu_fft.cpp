@@ -0,0 +1,685 @@
+#include "gpuNUFFT_cpu_fft.hpp"
+#include "gpuNUFFT_cpu_simd.hpp"
+#include <vector>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+/** \brief Cache key: grid width, height, depth, direction and precision */
+typedef std::tuple<IndType, IndType, IndType, int, size_t> PlanKey;
+
+/** \brief Process wide plan cache, plans are released at program exit */
+struct PlanCache
+{
+  ~PlanCache()
+  {
+    for (std::map<PlanKey, gpuNUFFT::CpuFFTPlan *>::iterator it =
+             plans.begin();
+         it != plans.end(); ++it)
+      delete it->second;
+  }
+
+  std::mutex mutex;
+  std::map<PlanKey, gpuNUFFT::CpuFFTPlan *> plans;
+};
+
+PlanCache &getPlanCache()
+{
+  static PlanCache cache;
+  return cache;
+}
+
+/** \brief Split n into the radices of the passes, radix 4 first */
+std::vector<IndType> factorize(IndType n)
+{
+  std::vector<IndType> radices;
+  while (n % 4 == 0)
+  {
+    radices.push_back(4);
+    n /= 4;
+  }
+  for (IndType p = 2; p * p <= n; p++)
+  {
+    while (n % p == 0)
+    {
+      radices.push_back(p);
+      n /= p;
+    }
+  }
+  if (n > 1)
+    radices.push_back(n);
+  return radices;
+}
+
+GPUNUFFT_FORCE_INLINE void twiddle(DType &re, DType &im, DType wr, DType wi)
+{
+  DType t = re * wr - im * wi;
+  im = re * wi + im * wr;
+  re = t;
+}
+
+// Stockham passes on split complex buffers
+//
+// Each block of len = stride * LANES contiguous values holds one element of
+// all sub transforms of all pencils of a batch. Input element j of the
+// sub transform q is stored in block q + m * j, output r in block p * q + r.
+//
+// The passes are inlined into the per instruction set versions of
+// passes(), input and output buffers do not overlap.
+
+#define RP DType *GPUNUFFT_RESTRICT
+#define CRP const DType *GPUNUFFT_RESTRICT
+
+GPUNUFFT_FORCE_INLINE void radix2(IndType len, IndType m, CRP twRe,
+                                  CRP twIm, CRP xr, CRP xi, RP yr, RP yi)
+{
+  for (IndType q = 0; q < m; q++)
+  {
+    const DType *ar0 = xr + q * len;
+    const DType *ai0 = xi + q * len;
+    const DType *ar1 = xr + (q + m) * len;
+    const DType *ai1 = xi + (q + m) * len;
+    DType *br0 = yr + 2 * q * len;
+    DType *bi0 = yi + 2 * q * len;
+    DType *br1 = br0 + len;
+    DType *bi1 = bi0 + len;
+    DType w1r = twRe[q];
+    DType w1i = twIm[q];
+
+    for (IndType e = 0; e < len; e++)
+    {
+      DType dr = ar0[e] - ar1[e];
+      DType di = ai0[e] - ai1[e];
+      br0[e] = ar0[e] + ar1[e];
+      bi0[e] = ai0[e] + ai1[e];
+      br1[e] = dr * w1r - di * w1i;
+      bi1[e] = dr * w1i + di * w1r;
+    }
+  }
+}
+
+GPUNUFFT_FORCE_INLINE void radix3(IndType len, IndType m, CRP twRe,
+                                  CRP twIm, CRP xr, CRP xi, RP yr, RP yi,
+                                  DType sign)
+{
+  const DType h = sign * (DType)0.86602540378443864676;  // sin(2pi/3)
+  for (IndType q = 0; q < m; q++)
+  {
+    const DType *ar0 = xr + q * len;
+    const DType *ai0 = xi + q * len;
+    const DType *ar1 = xr + (q + m) * len;
+    const DType *ai1 = xi + (q + m) * len;
+    const DType *ar2 = xr + (q + 2 * m) * len;
+    const DType *ai2 = xi + (q + 2 * m) * len;
+    DType *br0 = yr + 3 * q * len;
+    DType *bi0 = yi + 3 * q * len;
+    DType *br1 = br0 + len;
+    DType *bi1 = bi0 + len;
+    DType *br2 = br1 + len;
+    DType *bi2 = bi1 + len;
+    DType w1r = twRe[2 * q];
+    DType w1i = twIm[2 * q];
+    DType w2r = twRe[2 * q + 1];
+    DType w2i = twIm[2 * q + 1];
+
+    for (IndType e = 0; e < len; e++)
+    {
+      DType sr = ar1[e] + ar2[e];
+      DType si = ai1[e] + ai2[e];
+      DType dr = ar1[e] - ar2[e];
+      DType di = ai1[e] - ai2[e];
+      DType cr = ar0[e] - (DType)0.5 * sr;
+      DType ci = ai0[e] - (DType)0.5 * si;
+      br0[e] = ar0[e] + sr;
+      bi0[e] = ai0[e] + si;
+
+      DType b1r = cr - h * di;
+      DType b1i = ci + h * dr;
+      DType b2r = cr + h * di;
+      DType b2i = ci - h * dr;
+      twiddle(b1r, b1i, w1r, w1i);
+      twiddle(b2r, b2i, w2r, w2i);
+      br1[e] = b1r;
+      bi1[e] = b1i;
+      br2[e] = b2r;
+      bi2[e] = b2i;
+    }
+  }
+}
+
+GPUNUFFT_FORCE_INLINE void radix4(IndType len, IndType m, CRP twRe,
+                                  CRP twIm, CRP xr, CRP xi, RP yr, RP yi,
+                                  DType sign)
+{
+  for (IndType q = 0; q < m; q++)
+  {
+    const DType *ar0 = xr + q * len;
+    const DType *ai0 = xi + q * len;
+    const DType *ar1 = xr + (q + m) * len;
+    const DType *ai1 = xi + (q + m) * len;
+    const DType *ar2 = xr + (q + 2 * m) * len;
+    const DType *ai2 = xi + (q + 2 * m) * len;
+    const DType *ar3 = xr + (q + 3 * m) * len;
+    const DType *ai3 = xi + (q + 3 * m) * len;
+    DType *br0 = yr + 4 * q * len;
+    DType *bi0 = yi + 4 * q * len;
+    DType *br1 = br0 + len;
+    DType *bi1 = bi0 + len;
+    DType *br2 = br1 + len;
+    DType *bi2 = bi1 + len;
+    DType *br3 = br2 + len;
+    DType *bi3 = bi2 + len;
+    DType w1r = twRe[3 * q];
+    DType w1i = twIm[3 * q];
+    DType w2r = twRe[3 * q + 1];
+    DType w2i = twIm[3 * q + 1];
+    DType w3r = twRe[3 * q + 2];
+    DType w3i = twIm[3 * q + 2];
+
+    for (IndType e = 0; e < len; e++)
+    {
+      DType s02r = ar0[e] + ar2[e];
+      DType s02i = ai0[e] + ai2[e];
+      DType d02r = ar0[e] - ar2[e];
+      DType d02i = ai0[e] - ai2[e];
+      DType s13r = ar1[e] + ar3[e];
+      DType s13i = ai1[e] + ai3[e];
+      // (a1 - a3) multiplied by the fourth root of unity sign * i
+      DType u13r = -sign * (ai1[e] - ai3[e]);
+      DType u13i = sign * (ar1[e] - ar3[e]);
+
+      br0[e] = s02r + s13r;
+      bi0[e] = s02i + s13i;
+
+      DType b1r = d02r + u13r;
+      DType b1i = d02i + u13i;
+      DType b2r = s02r - s13r;
+      DType b2i = s02i - s13i;
+      DType b3r = d02r - u13r;
+      DType b3i = d02i - u13i;
+      twiddle(b1r, b1i, w1r, w1i);
+      twiddle(b2r, b2i, w2r, w2i);
+      twiddle(b3r, b3i, w3r, w3i);
+      br1[e] = b1r;
+      bi1[e] = b1i;
+      br2[e] = b2r;
+      bi2[e] = b2i;
+      br3[e] = b3r;
+      bi3[e] = b3i;
+    }
+  }
+}
+
+GPUNUFFT_FORCE_INLINE void radix5(IndType len, IndType m, CRP twRe,
+                                  CRP twIm, CRP xr, CRP xi, RP yr, RP yi,
+                                  DType sign)
+{
+  const DType c1 = (DType)0.30901699437494742410;         // cos(2pi/5)
+  const DType c2 = (DType)-0.80901699437494742410;        // cos(4pi/5)
+  const DType s1 = sign * (DType)0.95105651629515357212;  // sin(2pi/5)
+  const DType s2 = sign * (DType)0.58778525229247312917;  // sin(4pi/5)
+  for (IndType q = 0; q < m; q++)
+  {
+    const DType *ar0 = xr + q * len;
+    const DType *ai0 = xi + q * len;
+    const DType *ar1 = xr + (q + m) * len;
+    const DType *ai1 = xi + (q + m) * len;
+    const DType *ar2 = xr + (q + 2 * m) * len;
+    const DType *ai2 = xi + (q + 2 * m) * len;
+    const DType *ar3 = xr + (q + 3 * m) * len;
+    const DType *ai3 = xi + (q + 3 * m) * len;
+    const DType *ar4 = xr + (q + 4 * m) * len;
+    const DType *ai4 = xi + (q + 4 * m) * len;
+    DType *br0 = yr + 5 * q * len;
+    DType *bi0 = yi + 5 * q * len;
+    DType *br1 = br0 + len;
+    DType *bi1 = bi0 + len;
+    DType *br2 = br1 + len;
+    DType *bi2 = bi1 + len;
+    DType *br3 = br2 + len;
+    DType *bi3 = bi2 + len;
+    DType *br4 = br3 + len;
+    DType *bi4 = bi3 + len;
+    const DType *wr = twRe + 4 * q;
+    const DType *wi = twIm + 4 * q;
+
+    for (IndType e = 0; e < len; e++)
+    {
+      DType s14r = ar1[e] + ar4[e];
+      DType s14i = ai1[e] + ai4[e];
+      DType d14r = ar1[e] - ar4[e];
+      DType d14i = ai1[e] - ai4[e];
+      DType s23r = ar2[e] + ar3[e];
+      DType s23i = ai2[e] + ai3[e];
+      DType d23r = ar2[e] - ar3[e];
+      DType d23i = ai2[e] - ai3[e];
+
+      br0[e] = ar0[e] + s14r + s23r;
+      bi0[e] = ai0[e] + s14i + s23i;
+
+      DType a1r = ar0[e] + c1 * s14r + c2 * s23r;
+      DType a1i = ai0[e] + c1 * s14i + c2 * s23i;
+      DType a2r = ar0[e] + c2 * s14r + c1 * s23r;
+      DType a2i = ai0[e] + c2 * s14i + c1 * s23i;
+      DType u1r = -(s1 * d14i + s2 * d23i);
+      DType u1i = s1 * d14r + s2 * d23r;
+      DType u2r = -(s2 * d14i - s1 * d23i);
+      DType u2i = s2 * d14r - s1 * d23r;
+
+      DType b1r = a1r + u1r;
+      DType b1i = a1i + u1i;
+      DType b4r = a1r - u1r;
+      DType b4i = a1i - u1i;
+      DType b2r = a2r + u2r;
+      DType b2i = a2i + u2i;
+      DType b3r = a2r - u2r;
+      DType b3i = a2i - u2i;
+      twiddle(b1r, b1i, wr[0], wi[0]);
+      twiddle(b2r, b2i, wr[1], wi[1]);
+      twiddle(b3r, b3i, wr[2], wi[2]);
+      twiddle(b4r, b4i, wr[3], wi[3]);
+      br1[e] = b1r;
+      bi1[e] = b1i;
+      br2[e] = b2r;
+      bi2[e] = b2i;
+      br3[e] = b3r;
+      bi3[e] = b3i;
+      br4[e] = b4r;
+      bi4[e] = b4i;
+    }
+  }
+}
+
+/** \brief Generic pass for odd prime radix p (7, 11, ...)
+ *
+ * Uses the symmetry of the roots of unity: with S = a_j + a_(p-j) and
+ * D = a_j - a_(p-j) the outputs r and p-r only differ in the sign of the
+ * sine terms.
+ */
+GPUNUFFT_FORCE_INLINE void radixOdd(IndType p, IndType len, IndType m,
+                                    CRP twRe, CRP twIm, CRP rootRe,
+                                    CRP rootIm, CRP xr, CRP xi, RP yr, RP yi)
+{
+  IndType half = (p - 1) / 2;
+  for (IndType q = 0; q < m; q++)
+  {
+    const DType *ar0 = xr + q * len;
+    const DType *ai0 = xi + q * len;
+    DType *br0 = yr + p * q * len;
+    DType *bi0 = yi + p * q * len;
+
+    for (IndType e = 0; e < len; e++)
+    {
+      br0[e] = ar0[e];
+      bi0[e] = ai0[e];
+    }
+    for (IndType j = 1; j < p; j++)
+    {
+      const DType *arj = xr + (q + j * m) * len;
+      const DType *aij = xi + (q + j * m) * len;
+      for (IndType e = 0; e < len; e++)
+      {
+        br0[e] += arj[e];
+        bi0[e] += aij[e];
+      }
+    }
+
+    for (IndType r = 1; r <= half; r++)
+    {
+      // accumulate cosine terms in output r and sine terms in output p-r
+      DType *bra = br0 + r * len;
+      DType *bia = bi0 + r * len;
+      DType *brb = br0 + (p - r) * len;
+      DType *bib = bi0 + (p - r) * len;
+      for (IndType e = 0; e < len; e++)
+      {
+        bra[e] = ar0[e];
+        bia[e] = ai0[e];
+        brb[e] = 0;
+        bib[e] = 0;
+      }
+      for (IndType j = 1; j <= half; j++)
+      {
+        const DType *arj = xr + (q + j * m) * len;
+        const DType *aij = xi + (q + j * m) * len;
+        const DType *ark = xr + (q + (p - j) * m) * len;
+        const DType *aik = xi + (q + (p - j) * m) * len;
+        DType c = rootRe[(j * r) % p];
+        DType s = rootIm[(j * r) % p];
+        for (IndType e = 0; e < len; e++)
+        {
+          bra[e] += c * (arj[e] + ark[e]);
+          bia[e] += c * (aij[e] + aik[e]);
+          brb[e] -= s * (aij[e] - aik[e]);
+          bib[e] += s * (arj[e] - ark[e]);
+        }
+      }
+      for (IndType e = 0; e < len; e++)
+      {
+        DType cr = bra[e];
+        DType ci = bia[e];
+        bra[e] = cr + brb[e];
+        bia[e] = ci + bib[e];
+        brb[e] = cr - brb[e];
+        bib[e] = ci - bib[e];
+      }
+    }
+
+    for (IndType r = 1; r < p; r++)
+    {
+      DType *brr = br0 + r * len;
+      DType *bir = bi0 + r * len;
+      DType wr = twRe[q * (p - 1) + r - 1];
+      DType wi = twIm[q * (p - 1) + r - 1];
+      for (IndType e = 0; e < len; e++)
+        twiddle(brr[e], bir[e], wr, wi);
+    }
+  }
+}
+
+#undef RP
+#undef CRP
+
+/** \brief All passes of an axis, the buffers are swapped after each pass
+ * such that xr and xi hold the result */
+template <typename Stages>
+GPUNUFFT_FORCE_INLINE void passes(const Stages &stages, DType sign,
+                                  DType *&xr, DType *&xi, DType *&yr,
+                                  DType *&yi)
+{
+  const IndType LANES = gpuNUFFT::CpuFFTPlan::LANES;
+  for (size_t s = 0; s < stages.size(); s++)
+  {
+    IndType len = stages[s].stride * LANES;
+    IndType m = stages[s].m;
+    const DType *twRe = &stages[s].twRe[0];
+    const DType *twIm = &stages[s].twIm[0];
+    switch (stages[s].radix)
+    {
+    case 2:
+      radix2(len, m, twRe, twIm, xr, xi, yr, yi);
+      break;
+    case 3:
+      radix3(len, m, twRe, twIm, xr, xi, yr, yi, sign);
+      break;
+    case 4:
+      radix4(len, m, twRe, twIm, xr, xi, yr, yi, sign);
+      break;
+    case 5:
+      radix5(len, m, twRe, twIm, xr, xi, yr, yi, sign);
+      break;
+    default:
+      radixOdd(stages[s].radix, len, m, twRe, twIm, &stages[s].rootRe[0],
+               &stages[s].rootIm[0], xr, xi, yr, yi);
+    }
+    std::swap(xr, yr);
+    std::swap(xi, yi);
+  }
+}
+
+template <typename Stages>
+void passesScalar(const Stages &stages, DType sign, DType *&xr, DType *&xi,
+                  DType *&yr, DType *&yi)
+{
+  passes(stages, sign, xr, xi, yr, yi);
+}
+
+#ifdef GPUNUFFT_X86_SIMD
+template <typename Stages>
+GPUNUFFT_TARGET_AVX2 void passesAvx2(const Stages &stages, DType sign,
+                                     DType *&xr, DType *&xi, DType *&yr,
+                                     DType *&yi)
+{
+  passes(stages, sign, xr, xi, yr, yi);
+}
+
+#endif
+
+/** \brief Run the passes compiled for the instruction set
+ *
+ * AVX-512 runs the AVX2 passes: the blocks of the first pass hold a single
+ * batch of LANES values, wider vectors do not speed up the transform.
+ */
+template <typename Stages>
+void runPasses(gpuNUFFT::CpuSimdLevel level, const Stages &stages,
+               DType sign, DType *&xr, DType *&xi, DType *&yr, DType *&yi)
+{
+  switch (level)
+  {
+#ifdef GPUNUFFT_X86_SIMD
+  case gpuNUFFT::SIMD_AVX512:
+  case gpuNUFFT::SIMD_AVX2:
+    passesAvx2(stages, sign, xr, xi, yr, yi);
+    break;
+#endif
+  default:
+    passesScalar(stages, sign, xr, xi, yr, yi);
+  }
+}
+}
+
+const IndType gpuNUFFT::CpuFFTPlan::LANES;
+
+gpuNUFFT::CpuFFTPlan::CpuFFTPlan(Dimensions gridDims, int direction)
+  : gridDims(gridDims), direction(direction)
+{
+  if (DEBUG)
+    printf("creating host FFT plan of size %u x %u x %u, direction %d\n",
+           (unsigned)gridDims.width, (unsigned)gridDims.height,
+           (unsigned)gridDims.depth, direction);
+
+  initAxisPlan(axes[0], gridDims.width);
+  initAxisPlan(axes[1], DEFAULT_VALUE(gridDims.height));
+  initAxisPlan(axes[2], DEFAULT_VALUE(gridDims.depth));
+}
+
+void gpuNUFFT::CpuFFTPlan::initAxisPlan(AxisPlan &axis, IndType n)
+{
+  axis.n = n;
+  if (n <= 1)
+    return;
+
+  std::vector<IndType> radices = factorize(n);
+  IndType stride = 1;
+  for (size_t i = 0; i < radices.size(); i++)
+  {
+    Stage stage;
+    stage.radix = radices[i];
+    stage.stride = stride;
+    stage.m = n / (stride * stage.radix);
+
+    // twiddles are computed in double precision
+    IndType p = stage.radix;
+    IndType subLength = p * stage.m;
+    stage.twRe.resize(stage.m * (p - 1));
+    stage.twIm.resize(stage.m * (p - 1));
+    for (IndType q = 0; q < stage.m; q++)
+      for (IndType r = 1; r < p; r++)
+      {
+        double phi =
+            direction * 2.0 * M_PI * (double)((q * r) % subLength) / subLength;
+        stage.twRe[q * (p - 1) + r - 1] = (DType)cos(phi);
+        stage.twIm[q * (p - 1) + r - 1] = (DType)sin(phi);
+      }
+
+    if (p > 5)
+    {
+      stage.rootRe.resize(p);
+      stage.rootIm.resize(p);
+      for (IndType k = 0; k < p; k++)
+      {
+        double phi = direction * 2.0 * M_PI * (double)k / p;
+        stage.rootRe[k] = (DType)cos(phi);
+        stage.rootIm[k] = (DType)sin(phi);
+      }
+    }
+
+    axis.stages.push_back(stage);
+    stride *= p;
+  }
+}
+
+void gpuNUFFT::CpuFFTPlan::transformAxis(const AxisPlan &axis,
+                                         CufftType *data, IndType inner,
+                                         ThreadPool *threadPool,
+                                         Scratch &scratch) const
+{
+  IndType n = axis.n;
+  if (n <= 1)
+    return;
+
+  // batches of LANES pencils: neighbouring lines for the x axis, neighbouring
+  // elements of the same row or slice for the y and z axes
+  const std::vector<IndType> &pencils = scratch.pencils;
+  IndType pencilCount = (IndType)pencils.size();
+  IndType batchCount = (pencilCount + LANES - 1) / LANES;
+  DType sign = (DType)direction;
+  CpuSimdLevel level = getCpuSimdLevel();
+
+  // the buffers of all threads are sized up front, the threads processing
+  // batches differ between calls
+  std::vector<std::vector<DType> > &buffers = scratch.buffers;
+  if (buffers.size() < threadPool->getThreadCount())
+    buffers.resize(threadPool->getThreadCount());
+  for (size_t t = 0; t < buffers.size(); t++)
+    if (buffers[t].size() < 4 * n * LANES)
+      buffers[t].resize(4 * n * LANES);
+
+  threadPool->parallelFor(
+      batchCount, [&](IndType batch, unsigned threadId)
+      {
+        const IndType *starts = &pencils[batch * LANES];
+        IndType lanes = std::min(LANES, pencilCount - batch * LANES);
+
+        DType *xr = &buffers[threadId][0];
+        DType *xi = xr + n * LANES;
+        DType *yr = xi + n * LANES;
+        DType *yi = yr + n * LANES;
+
+        for (IndType i = 0; i < n; i++)
+          for (IndType b = 0; b < LANES; b++)
+          {
+            if (b < lanes)
+            {
+              CufftType value = data[starts[b] + i * inner];
+              xr[i * LANES + b] = value.x;
+              xi[i * LANES + b] = value.y;
+            }
+            else
+            {
+              xr[i * LANES + b] = 0;
+              xi[i * LANES + b] = 0;
+            }
+          }
+
+        runPasses(level, axis.stages, sign, xr, xi, yr, yi);
+
+        for (IndType i = 0; i < n; i++)
+          for (IndType b = 0; b < lanes; b++)
+          {
+            CufftType &value = data[starts[b] + i * inner];
+            value.x = xr[i * LANES + b];
+            value.y = xi[i * LANES + b];
+          }
+      });
+}
+
+void gpuNUFFT::CpuFFTPlan::transform(CufftType *data, const Support *support,
+                                     Pruning pruning, ThreadPool *threadPool,
+                                     Scratch *scratch) const
+{
+  if (threadPool == NULL)
+    threadPool = &ThreadPool::getDefault();
+  Scratch localScratch;
+  if (scratch == NULL)
+    scratch = &localScratch;
+
+  IndType dims[3] = { axes[0].n, axes[1].n, axes[2].n };
+  IndType strides[3] = { 1, dims[0], dims[0] * dims[1] };
+
+  for (int a = 0; a < 3; a++)
+  {
+    if (dims[a] <= 1)
+      continue;
+
+    // the pencils along axis a run over the remaining axes b (fastest) and
+    // c, an axis is restricted to the support before it is transformed in
+    // case of input pruning and after it is transformed in case of output
+    // pruning
+    int b = (a == 0) ? 1 : 0;
+    int c = (a == 2) ? 1 : 2;
+    bool pruneB = support != NULL && ((b > a) == (pruning == PRUNE_INPUT));
+    bool pruneC = support != NULL && ((c > a) == (pruning == PRUNE_INPUT));
+
+    std::vector<IndType> &pencils = scratch->pencils;
+    pencils.clear();
+    pencils.reserve(dims[b] * dims[c]);
+    for (IndType j = 0; j < dims[c]; j++)
+    {
+      if (pruneC && !support->axes[c][j])
+        continue;
+      for (IndType i = 0; i < dims[b]; i++)
+        if (!pruneB || support->axes[b][i])
+          pencils.push_back(i * strides[b] + j * strides[c]);
+    }
+    transformAxis(axes[a], data, strides[a], threadPool, *scratch);
+  }
+}
+
+void gpuNUFFT::CpuFFTPlan::execute(CufftType *data, ThreadPool *threadPool,
+                                   Scratch *scratch) const
+{
+  transform(data, NULL, PRUNE_INPUT, threadPool, scratch);
+}
+
+void gpuNUFFT::CpuFFTPlan::executePruned(CufftType *data,
+                                         const Support &support,
+                                         Pruning pruning,
+                                         ThreadPool *threadPool,
+                                         Scratch *scratch) const
+{
+  transform(data, &support, pruning, threadPool, scratch);
+}
+
+size_t gpuNUFFT::CpuFFTPlan::Scratch::getBytes() const
+{
+  size_t bytes = pencils.capacity() * sizeof(IndType);
+  for (size_t t = 0; t < buffers.size(); t++)
+    bytes += buffers[t].capacity() * sizeof(DType);
+  return bytes;
+}
+
+const gpuNUFFT::CpuFFTPlan &
+gpuNUFFT::CpuFFTPlan::getPlan(Dimensions gridDims, int direction)
+{
+  PlanKey key(gridDims.width, DEFAULT_VALUE(gridDims.height),
+              DEFAULT_VALUE(gridDims.depth), direction, sizeof(DType));
+
+  PlanCache &cache = getPlanCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  std::map<PlanKey, CpuFFTPlan *>::iterator it = cache.plans.find(key);
+  if (it != cache.plans.end())
+    return *it->second;
+
+  CpuFFTPlan *plan = new CpuFFTPlan(gridDims, direction);
+  cache.plans[key] = plan;
+  return *plan;
+}
+
+IndType gpuNUFFT::CpuFFTPlan::getCachedPlanCount()
+{
+  PlanCache &cache = getPlanCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  return (IndType)cache.plans.size();
+}
+
+void performFFTCPU(CufftType *data, gpuNUFFT::Dimensions gridDims,
+                   int direction, gpuNUFFT::ThreadPool *threadPool)
+{
+  gpuNUFFT::CpuFFTPlan::getPlan(gridDims, direction)
+      .execute(data, threadPool);
+}
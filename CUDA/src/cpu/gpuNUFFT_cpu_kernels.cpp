@@ -0,0 +1,2060 @@
+#include "gpuNUFFT_cpu_kernels.hpp"
+#include "gpuNUFFT_load_balancer.hpp"
+#include "precomp_utils.hpp"
+#include "gpuNUFFT_cpu_simd.hpp"
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <limits>
+#include <new>
+#include <mutex>
+#include <functional>
+
+namespace
+{
+/** \brief Element count per work item of the element wise operations */
+const IndType ELEMENTS_PER_TASK = 8192;
+
+/** \brief Amount of locks serializing the merge of split sectors */
+const IndType MERGE_LOCK_COUNT = 64;
+
+/** \brief Minimum amount of samples per block of the sector sort */
+const IndType SORT_BLOCK_SIZE = 65536;
+
+gpuNUFFT::ThreadPool *selectThreadPool(gpuNUFFT::ThreadPool *threadPool)
+{
+  return (threadPool != NULL) ? threadPool
+                              : &gpuNUFFT::ThreadPool::getDefault();
+}
+
+/** \brief Execute f(begin, end) for consecutive blocks of [0, count) in
+ * parallel */
+template <typename Function>
+void parallelForRange(IndType count, gpuNUFFT::ThreadPool *threadPool,
+                      const Function &f)
+{
+  IndType taskCount = (count + ELEMENTS_PER_TASK - 1) / ELEMENTS_PER_TASK;
+  threadPool->parallelFor(taskCount, [&](IndType task, unsigned)
+                          {
+                            IndType begin = task * ELEMENTS_PER_TASK;
+                            f(begin,
+                              std::min(begin + ELEMENTS_PER_TASK, count));
+                          });
+}
+
+/** \brief Compute relative grid position of the passed k-space data point.
+ *
+ * Host version of mapKSpaceToGrid.
+ */
+inline DType mapKSpaceToGridCPU(DType pos, IndType gridDim,
+                                IndType sectorCenter, int sectorOffset)
+{
+  return (pos * (DType)gridDim) + ((DType)0.5 * ((DType)gridDim)) -
+         (DType)sectorCenter + (DType)sectorOffset;
+}
+
+/** \brief Compute relative k space position of the passed grid position.
+ *
+ * Host version of mapGridToKSpace.
+ */
+inline DType mapGridToKSpaceCPU(int gridPos, IndType gridDim,
+                                IndType sectorCenter, int sectorOffset)
+{
+  return static_cast<DType>((DType)gridPos + (DType)sectorCenter -
+                            (DType)sectorOffset) /
+             static_cast<DType>((DType)gridDim) -
+         (DType)0.5;
+}
+
+/** \brief Load the center of sector sec, z is 0 in the 2-d case */
+inline IndType3 getSectorCenter(IndType *sector_centers, IndType sec,
+                                gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  IndType3 center;
+  if (gi_host->is2Dprocessing)
+  {
+    center.x = sector_centers[sec * 2];
+    center.y = sector_centers[sec * 2 + 1];
+    center.z = 0;
+  }
+  else
+  {
+    center.x = sector_centers[sec * 3];
+    center.y = sector_centers[sec * 3 + 1];
+    center.z = sector_centers[sec * 3 + 2];
+  }
+  return center;
+}
+
+/** \brief Linear index of the grid position (x,y,z), z is 0 in the 2-d
+ * case
+ *
+ * Computed in IndType, grids may exceed 2^31 points if built with
+ * GPU_INDEX64.
+ */
+inline IndType computeGridIndex(int x, int y, int z, IndType3 gridDims)
+{
+  return (IndType)x + gridDims.x * ((IndType)y + gridDims.y * (IndType)z);
+}
+
+/** \brief Grid index of the position (x,y,z) of the padded sector grid
+ * located at center
+ *
+ * Positions outside of the grid are wrapped around or, with
+ * SKIP_GRID_BOUNDARY, yield INVALID_DATA_INDEX.
+ */
+inline IndType computeSectorGridIndex(int x, int y, int z, IndType3 center,
+                                      gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                      gpuNUFFT::GridBoundary boundary =
+                                          gpuNUFFT::WRAP_GRID_BOUNDARY)
+{
+  int offset = gi_host->sector_offset;
+  bool skip = boundary == gpuNUFFT::SKIP_GRID_BOUNDARY;
+  if (gi_host->is2Dprocessing)
+  {
+    if (isOutlier2D(x, y, center.x, center.y, gi_host->gridDims, offset))
+    {
+      if (skip)
+        return INVALID_DATA_INDEX;
+      return computeGridIndex(
+          calculateOppositeIndex(x, center.x, gi_host->gridDims.x, offset),
+          calculateOppositeIndex(y, center.y, gi_host->gridDims.y, offset), 0,
+          gi_host->gridDims);
+    }
+    return computeGridIndex(center.x - offset + x, center.y - offset + y, 0,
+                            gi_host->gridDims);
+  }
+
+  if (isOutlier(x, y, z, center.x, center.y, center.z, gi_host->gridDims,
+                offset))
+  {
+    if (skip)
+      return INVALID_DATA_INDEX;
+    return computeGridIndex(
+        calculateOppositeIndex(x, center.x, gi_host->gridDims.x, offset),
+        calculateOppositeIndex(y, center.y, gi_host->gridDims.y, offset),
+        calculateOppositeIndex(z, center.z, gi_host->gridDims.z, offset),
+        gi_host->gridDims);
+  }
+  return computeGridIndex(center.x - offset + x, center.y - offset + y,
+                          center.z - offset + z, gi_host->gridDims);
+}
+
+/** \brief Color the sectors along one grid axis
+ *
+ * Sectors of the same color do not share any grid point of their padded
+ * sector grids, including the points wrapped around the grid boundary.
+ */
+std::vector<int> colorSectorAxis(int sectorCount, int sectorWidth,
+                                 int gridWidth, int sectorPadWidth,
+                                 int &colorCount)
+{
+  std::vector<int> colors(sectorCount, 0);
+  colorCount = 0;
+  for (int i = 0; i < sectorCount; i++)
+  {
+    std::vector<bool> used(colorCount + 1, false);
+    for (int j = 0; j < i; j++)
+    {
+      int dist = (i - j) * sectorWidth;
+      if (std::min(dist, gridWidth - dist) < sectorPadWidth)
+        used[colors[j]] = true;
+    }
+    int color = 0;
+    while (used[color])
+      color++;
+    colors[i] = color;
+    colorCount = std::max(colorCount, color + 1);
+  }
+  return colors;
+}
+
+/** \brief Group all non-empty sectors by color
+ *
+ * Sectors of one group can be gridded concurrently.
+ */
+std::vector<std::vector<IndType> >
+groupSectorsByColor(IndType *sectors, IndType *sector_centers,
+                    gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  int sw = gi_host->sector_width;
+  int gridWidth[3] = { (int)gi_host->gridDims.x, (int)gi_host->gridDims.y,
+                       (int)DEFAULT_VALUE(gi_host->gridDims.z) };
+  int dimCount = gi_host->is2Dprocessing ? 2 : 3;
+
+  std::vector<int> axisColors[3];
+  int colorCount[3] = { 1, 1, 1 };
+  for (int d = 0; d < dimCount; d++)
+    axisColors[d] =
+        colorSectorAxis((gridWidth[d] + sw - 1) / sw, sw, gridWidth[d],
+                        gi_host->sector_pad_width, colorCount[d]);
+
+  std::vector<std::vector<IndType> > groups(colorCount[0] * colorCount[1] *
+                                            colorCount[2]);
+  for (int sec = 0; sec < gi_host->sector_count; sec++)
+  {
+    // nothing to grid in empty sectors
+    if (sectors[sec] == sectors[sec + 1])
+      continue;
+
+    IndType3 center = getSectorCenter(sector_centers, sec, gi_host);
+    int color = axisColors[0][center.x / sw] +
+                colorCount[0] * axisColors[1][center.y / sw];
+    if (dimCount == 3)
+      color += colorCount[0] * colorCount[1] * axisColors[2][center.z / sw];
+    groups[color].push_back(sec);
+  }
+  return groups;
+}
+
+/** \brief Kernel window of a single sample
+ *
+ * The separable kernel is evaluated once per sample and axis: weight n of an
+ * axis belongs to the position min + n of the padded sector grid and is zero
+ * outside of the kernel support. The weight of sector grid point (i,j,k) is
+ * the product of the axis weights, thus a single lookup table access per
+ * grid line and axis replaces three accesses per grid point. Along z a
+ * single weight of 1 is used in the 2-d case.
+ *
+ * The rows of the window along x are updated by gpuNUFFT::simdAxpy
+ * (gridding) and reduced by gpuNUFFT::simdComplexDot (interpolation).
+ */
+class KernelWindow
+{
+ public:
+  KernelWindow(gpuNUFFT::GpuNUFFTInfo *gi_host, IndType coilCount)
+    : row(2 * gi_host->sector_pad_width * coilCount),
+      complexWeights(2 * gi_host->sector_pad_width)
+  {
+    for (int d = 0; d < 3; d++)
+    {
+      weights[d].resize(gi_host->sector_pad_width);
+      gridPos[d].resize(gi_host->sector_pad_width);
+    }
+  }
+
+  /** \brief Return true if the window covers the padded sectors of gi_host
+   * and coilCount channels */
+  bool fits(gpuNUFFT::GpuNUFFTInfo *gi_host, IndType coilCount) const
+  {
+    size_t padWidth = gi_host->sector_pad_width;
+    return weights[0].size() >= padWidth &&
+           row.size() >= 2 * padWidth * coilCount;
+  }
+
+  /** \brief Allocated bytes */
+  size_t getMemorySize() const
+  {
+    size_t bytes = (row.capacity() + complexWeights.capacity()) * sizeof(DType);
+    for (int d = 0; d < 3; d++)
+      bytes += weights[d].capacity() * sizeof(DType) +
+               gridPos[d].capacity() * sizeof(int);
+    return bytes;
+  }
+
+  /** \brief Compute the window of sample data_cnt of the sector located at
+   * center
+   *
+   * @return false if the kernel support does not cover any grid point
+   */
+  bool compute(DType *crds, DType *kernel, IndType data_cnt, IndType3 center,
+               gpuNUFFT::GridBoundary boundary,
+               gpuNUFFT::GpuNUFFTInfo *gi_host)
+  {
+    int dimCount = gi_host->is2Dprocessing ? 2 : 3;
+    IndType centers[3] = { center.x, center.y, center.z };
+    IndType gridDims[3] = { gi_host->gridDims.x, gi_host->gridDims.y,
+                            gi_host->gridDims.z };
+    DType anisoScales[3] = { gi_host->aniso_x_scale, gi_host->aniso_y_scale,
+                             gi_host->aniso_z_scale };
+    int offset = gi_host->sector_offset;
+
+    min[2] = 0;
+    count[2] = 1;
+    weights[2][0] = 1;
+    gridPos[2][0] = 0;
+    for (int d = 0; d < dimCount; d++)
+    {
+      DType pos = crds[data_cnt + d * gi_host->data_count];
+
+      // set the boundaries of final dataset for gpuNUFFT this point
+      DType sectorPos =
+          mapKSpaceToGridCPU(pos, gridDims[d], centers[d], offset);
+      int lo, hi;
+      set_minmax(&sectorPos, &lo, &hi, gi_host->sector_pad_max,
+                 gi_host->kernel_radius);
+      min[d] = lo;
+      count[d] = hi - lo + 1;
+
+      bool inside = false;
+      int dim = (int)gridDims[d];
+      for (int n = 0; n < count[d]; n++)
+      {
+        DType dist =
+            (mapGridToKSpaceCPU(lo + n, gridDims[d], centers[d], offset) -
+             pos) *
+            anisoScales[d];
+        dist *= dist;
+        weights[d][n] = 0;
+        if (dist < gi_host->radiusSquared)
+        {
+          weights[d][n] =
+              kernel[(int)round(dist * gi_host->dist_multiplier)];
+          inside = true;
+        }
+
+        // positions outside of the grid are wrapped around or skipped
+        int g = (int)centers[d] - offset + lo + n;
+        if (g < 0 || g >= dim)
+          g = (boundary == gpuNUFFT::SKIP_GRID_BOUNDARY)
+                  ? -1
+                  : (g < 0 ? g + dim : g - dim);
+        gridPos[d][n] = g;
+      }
+      if (!inside)
+        return false;
+    }
+    return true;
+  }
+
+  /** \brief First padded sector grid position per axis */
+  int min[3];
+  /** \brief Window size per axis */
+  int count[3];
+  /** \brief Kernel weights per axis */
+  std::vector<DType> weights[3];
+  /** \brief Grid position per axis, -1 if skipped */
+  std::vector<int> gridPos[3];
+  /** \brief Weighted sample values of an x row, interleaved complex */
+  std::vector<DType> row;
+  /** \brief x weights duplicated for real and imaginary part */
+  std::vector<DType> complexWeights;
+};
+
+/** \brief Per-thread kernel windows of coilCount interleaved channels */
+std::vector<KernelWindow> createKernelWindows(gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                              IndType coilCount,
+                                              gpuNUFFT::ThreadPool *threadPool)
+{
+  return std::vector<KernelWindow>(threadPool->getThreadCount(),
+                                   KernelWindow(gi_host, coilCount));
+}
+
+/** \brief Grid the samples data_start..data_end-1 of the sector located at
+ * center onto the padded sector grid sdata
+ *
+ * data and sdata hold coilCount interleaved values per sample and grid point,
+ * the kernel values are evaluated once for all coils. Each x row of the
+ * window is a single axpy of the weighted sample values.
+ */
+void gridSector(DType2 *data, DType *crds, CufftType *sdata, DType *kernel,
+                IndType data_start, IndType data_end, IndType3 center,
+                IndType coilCount, KernelWindow &window,
+                gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  int pad = gi_host->sector_pad_width;
+  for (IndType data_cnt = data_start; data_cnt < data_end; data_cnt++)
+  {
+    if (!window.compute(crds, kernel, data_cnt, center,
+                        gpuNUFFT::WRAP_GRID_BOUNDARY, gi_host))
+      continue;
+
+    const DType2 *sample = data + data_cnt * coilCount;
+    const DType *wx = window.weights[0].data();
+    DType *row = window.row.data();
+    for (int n = 0; n < window.count[0]; n++)
+      for (IndType c = 0; c < coilCount; c++)
+      {
+        row[2 * (n * coilCount + c)] = wx[n] * sample[c].x;
+        row[2 * (n * coilCount + c) + 1] = wx[n] * sample[c].y;
+      }
+    int rowLength = 2 * window.count[0] * (int)coilCount;
+
+    // grid this point onto its cartesian points neighbors
+    for (int k = 0; k < window.count[2]; k++)
+    {
+      DType wz = window.weights[2][k];
+      if (wz == 0)
+        continue;
+      for (int j = 0; j < window.count[1]; j++)
+      {
+        DType val = wz * window.weights[1][j];
+        if (val == 0)
+          continue;
+        int ind = getIndex(window.min[0], window.min[1] + j,
+                           window.min[2] + k, pad);
+        gpuNUFFT::simdAxpy((DType *)(sdata + coilCount * ind), row, val,
+                           rowLength);
+      }  // y
+    }    // z
+  }      // data points per sector
+}
+
+/** \brief Add the padded sector grid sdata of the sector located at center to
+ * gdata, both holding coilCount interleaved values per grid point */
+void mergeSector(CufftType *sdata, CufftType *gdata, IndType3 center,
+                 IndType coilCount, gpuNUFFT::GridBoundary boundary,
+                 gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  int pad = gi_host->sector_pad_width;
+  int depth = gi_host->is2Dprocessing ? 1 : pad;
+  for (int z = 0; z < depth; z++)
+    for (int y = 0; y < pad; y++)
+      for (int x = 0; x < pad; x++)
+      {
+        IndType ind =
+            computeSectorGridIndex(x, y, z, center, gi_host, boundary);
+        if (ind == INVALID_DATA_INDEX)
+          continue;
+        CufftType *s_grid = sdata + coilCount * getIndex(x, y, z, pad);
+        CufftType *grid = gdata + coilCount * ind;
+        for (IndType c = 0; c < coilCount; c++)
+        {
+          grid[c].x += s_grid[c].x;
+          grid[c].y += s_grid[c].y;
+        }
+      }
+}
+
+/** \brief Interpolate the samples data_start..data_end-1 of the sector
+ * located at center from the grid gdata
+ *
+ * data and gdata hold coilCount interleaved values per sample and grid point.
+ * Sample data_cnt is written to position dataIndices[data_cnt] of data if
+ * dataIndices is set. The x rows of the window are split into runs of
+ * consecutive grid points, which are reduced by a single dot product for a
+ * single channel and accumulated by axpy operations over the channels
+ * otherwise.
+ */
+void interpolateSamples(CufftType *data, DType *crds, CufftType *gdata,
+                        DType *kernel, IndType data_start, IndType data_end,
+                        IndType3 center, IndType coilCount,
+                        gpuNUFFT::GridBoundary boundary, IndType *dataIndices,
+                        KernelWindow &window, gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  IndType width = gi_host->gridDims.x;
+  IndType height = gi_host->gridDims.y;
+  for (IndType data_cnt = data_start; data_cnt < data_end; data_cnt++)
+  {
+    IndType out = dataIndices != NULL ? dataIndices[data_cnt] : data_cnt;
+    CufftType *sample = data + out * coilCount;
+    for (IndType c = 0; c < coilCount; c++)
+    {
+      sample[c].x = 0;
+      sample[c].y = 0;
+    }
+    if (!window.compute(crds, kernel, data_cnt, center, boundary, gi_host))
+      continue;
+
+    const DType *wx = window.weights[0].data();
+    const int *gx = window.gridPos[0].data();
+    DType *complexWeights = window.complexWeights.data();
+    for (int n = 0; n < window.count[0]; n++)
+      complexWeights[2 * n] = complexWeights[2 * n + 1] = wx[n];
+
+    // convolve neighboring cartesian points to this data point
+    for (int k = 0; k < window.count[2]; k++)
+    {
+      DType wz = window.weights[2][k];
+      int gz = window.gridPos[2][k];
+      if (wz == 0 || gz < 0)
+        continue;
+      for (int j = 0; j < window.count[1]; j++)
+      {
+        DType val = wz * window.weights[1][j];
+        int gy = window.gridPos[1][j];
+        if (val == 0 || gy < 0)
+          continue;
+        const CufftType *line =
+            gdata + coilCount * width * ((IndType)gy + height * (IndType)gz);
+
+        int n = 0;
+        while (n < window.count[0])
+        {
+          if (gx[n] < 0)
+          {
+            n++;
+            continue;
+          }
+
+          // run of consecutive grid points up to a wrap around
+          int begin = n++;
+          while (n < window.count[0] && gx[n] == gx[n - 1] + 1)
+            n++;
+
+          const CufftType *grid = line + coilCount * (IndType)gx[begin];
+          if (coilCount == 1)
+          {
+            DType re, im;
+            gpuNUFFT::simdComplexDot((const DType *)grid,
+                                     complexWeights + 2 * begin,
+                                     2 * (n - begin), re, im);
+            sample[0].x += val * re;
+            sample[0].y += val * im;
+            continue;
+          }
+          for (int i = begin; i < n; i++)
+            gpuNUFFT::simdAxpy((DType *)sample,
+                               (const DType *)(grid + coilCount * (i - begin)),
+                               val * wx[i], 2 * (int)coilCount);
+        }
+      }  // y
+    }    // z
+  }      // data points
+}
+
+/** \brief Samples [begin, end) of one sector processed as one work item */
+struct SectorChunk
+{
+  IndType sector;
+  IndType begin;
+  IndType end;
+  /** \brief Set if other chunks of the sector exist */
+  bool split;
+};
+
+/** \brief Chunks of the sector processing order in the order given
+ *
+ * Uses the precomputed sectorProcessingOrder with
+ * gi_host->sectorsToProcess entries if passed, otherwise the sectors are
+ * split into chunks of MAXIMUM_PAYLOAD samples as by
+ * gpuNUFFT::FixedPayloadBalancer. A chunk ends at the next larger offset of
+ * its sector in the order or at the end of the sector.
+ */
+std::vector<SectorChunk> getProcessingOrder(IndType *sectors,
+                                            IndType2 *sectorProcessingOrder,
+                                            gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  std::vector<IndType2> order;
+  if (sectorProcessingOrder != NULL)
+    order.assign(sectorProcessingOrder,
+                 sectorProcessingOrder + gi_host->sectorsToProcess);
+  else
+    order = gpuNUFFT::FixedPayloadBalancer(MAXIMUM_PAYLOAD, 1)
+                .computeProcessingOrder(
+                    sectors, gi_host->sector_count,
+                    gpuNUFFT::SectorGeometry(gi_host->kernel_width,
+                                             gi_host->sector_width,
+                                             !gi_host->is2Dprocessing));
+
+  // chunk offsets of each sector in ascending order
+  std::vector<std::pair<IndType, IndType> > offsets(order.size());
+  for (size_t i = 0; i < order.size(); i++)
+    offsets[i] = std::make_pair(order[i].x, order[i].y);
+  std::sort(offsets.begin(), offsets.end());
+
+  std::vector<SectorChunk> chunks(order.size());
+  for (size_t i = 0; i < order.size(); i++)
+  {
+    IndType sec = order[i].x;
+    size_t next = std::upper_bound(offsets.begin(), offsets.end(),
+                                   std::make_pair(sec, order[i].y)) -
+                  offsets.begin();
+    chunks[i].sector = sec;
+    chunks[i].begin = sectors[sec] + order[i].y;
+    chunks[i].end = (next < offsets.size() && offsets[next].first == sec)
+                        ? sectors[sec] + offsets[next].second
+                        : sectors[sec + 1];
+    chunks[i].split =
+        chunks[i].begin > sectors[sec] || chunks[i].end < sectors[sec + 1];
+  }
+  return chunks;
+}
+
+/** \brief Split the processing order into the chunks of each sector color
+ * group, keeping the order inside of each group */
+std::vector<std::vector<SectorChunk> >
+splitOrderByColor(const std::vector<SectorChunk> &order,
+                  const std::vector<std::vector<IndType> > &groups,
+                  gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  std::vector<IndType> sectorColor(gi_host->sector_count, 0);
+  for (size_t color = 0; color < groups.size(); color++)
+    for (size_t i = 0; i < groups[color].size(); i++)
+      sectorColor[groups[color][i]] = (IndType)color;
+
+  std::vector<std::vector<SectorChunk> > colorOrder(groups.size());
+  for (size_t i = 0; i < order.size(); i++)
+    colorOrder[sectorColor[order[i].sector]].push_back(order[i]);
+  return colorOrder;
+}
+
+/** \brief Analytic deapodization value at image position t */
+inline DType computeDeapodizationAt(IndType t, DType beta, DType norm_val,
+                                    gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  // as getCoordsFromIndex, t may exceed the int range
+  IndType width = gi_host->imgDims.x;
+  IndType height = gi_host->imgDims.y;
+  int x = (int)(t % width);
+  if (gi_host->is2Dprocessing)
+  {
+    int y = (int)(t / width);
+    return calculateDeapodizationAt2D(x, y, gi_host->im_width_offset,
+                                      gi_host->grid_width_inv,
+                                      gi_host->kernel_width, beta, norm_val);
+  }
+  int y = (int)((t / width) % height);
+  int z = (int)(t / (width * height));
+  return calculateDeapodizationAt(x, y, z, gi_host->im_width_offset,
+                                  gi_host->grid_width_inv,
+                                  gi_host->kernel_width, beta, norm_val);
+}
+
+/** \brief Call f(line, factor) for each image line with the product of
+ * the y and z deapodization factors of the line */
+template <typename Function>
+void forEachDeapodizationLine(DType *deapoVectors, IndType3 imgDims,
+                              bool is2Dprocessing,
+                              gpuNUFFT::ThreadPool *threadPool,
+                              const Function &f)
+{
+  IndType height = imgDims.y;
+  IndType depth = is2Dprocessing ? 1 : imgDims.z;
+  const DType *deapoY = deapoVectors + imgDims.x;
+  const DType *deapoZ = deapoY + height;
+  threadPool->parallelFor(height * depth, [&](IndType line, unsigned)
+                          {
+                            DType factor = deapoY[line % height];
+                            if (!is2Dprocessing)
+                              factor *= deapoZ[line / height];
+                            f(line, factor);
+                          });
+}
+
+/** \brief Apply precomputed, separable or analytic deapodization to N image
+ * values */
+void applyDeapodization(CufftType *imdata, DType *deapo, DType *deapoVectors,
+                        IndType N, gpuNUFFT::GpuNUFFTInfo *gi_host,
+                        gpuNUFFT::ThreadPool *threadPool)
+{
+  if (deapo == NULL && deapoVectors != NULL)
+  {
+    if (DEBUG)
+      printf("running deapodization with separable values\n");
+
+    IndType width = gi_host->imgDims.x;
+    forEachDeapodizationLine(
+        deapoVectors, gi_host->imgDims, gi_host->is2Dprocessing, threadPool,
+        [&](IndType line, DType factor)
+        {
+          CufftType *row = imdata + line * width;
+          for (IndType x = 0; x < width; x++)
+          {
+            DType val = deapoVectors[x] * factor;
+            row[x].x = row[x].x * val;
+            row[x].y = row[x].y * val;
+          }
+        });
+    return;
+  }
+
+  if (deapo != NULL)
+  {
+    if (DEBUG)
+      printf("running deapodization with precomputed values\n");
+
+    parallelForRange(N, threadPool, [&](IndType begin, IndType end)
+                     {
+                       for (IndType t = begin; t < end; t++)
+                       {
+                         imdata[t].x = imdata[t].x * deapo[t];
+                         imdata[t].y = imdata[t].y * deapo[t];
+                       }
+                     });
+    return;
+  }
+
+  // see BEATTY et al.: RAPID GRIDDING RECONSTRUCTION
+  // eq. (4) and (5)
+  DType beta = (DType)BETA(gi_host->kernel_width, gi_host->osr);
+  DType norm_val = I0_BETA(gi_host->kernel_width, gi_host->osr) /
+                   (DType)gi_host->kernel_width;
+  if (gi_host->is2Dprocessing)
+    norm_val = norm_val * norm_val;
+  else
+    norm_val = norm_val * norm_val * norm_val;
+
+  if (DEBUG)
+    printf("running deapodization with norm_val %.2f\n", norm_val);
+
+  parallelForRange(N, threadPool, [&](IndType begin, IndType end)
+                   {
+                     for (IndType t = begin; t < end; t++)
+                     {
+                       DType val =
+                           computeDeapodizationAt(t, beta, norm_val, gi_host);
+                       // check if deapodization value is valid number
+                       if (!std::isnan(val))
+                       {
+                         imdata[t].x = imdata[t].x / val;
+                         imdata[t].y = imdata[t].y / val;
+                       }
+                     }
+                   });
+}
+
+/** \brief Scaled deapodization factors of single image lines, the
+ * per-thread counterpart of applyDeapodization for the fused stages */
+class DeapodizationLines
+{
+ public:
+  DeapodizationLines(DType *deapo, DType *deapoVectors, DType scale,
+                     gpuNUFFT::GpuNUFFTInfo *gi_host, unsigned threadCount)
+    : deapo(deapo), deapoVectors(deapoVectors), scale(scale),
+      gi_host(gi_host),
+      factors(threadCount, std::vector<DType>(gi_host->imgDims.x))
+  {
+    beta = (DType)BETA(gi_host->kernel_width, gi_host->osr);
+    normVal = I0_BETA(gi_host->kernel_width, gi_host->osr) /
+              (DType)gi_host->kernel_width;
+    normVal = gi_host->is2Dprocessing ? normVal * normVal
+                                      : normVal * normVal * normVal;
+  }
+
+  /** \brief Factors of the width values of image line, valid until the
+   * next call of the thread */
+  const DType *compute(IndType line, unsigned threadId)
+  {
+    IndType width = gi_host->imgDims.x;
+    IndType height = gi_host->imgDims.y;
+    DType *row = &factors[threadId][0];
+    if (deapo == NULL && deapoVectors != NULL)
+    {
+      DType factor = scale * deapoVectors[width + line % height];
+      if (!gi_host->is2Dprocessing)
+        factor *= deapoVectors[width + height + line / height];
+      for (IndType x = 0; x < width; x++)
+        row[x] = deapoVectors[x] * factor;
+    }
+    else if (deapo != NULL)
+    {
+      for (IndType x = 0; x < width; x++)
+        row[x] = deapo[line * width + x] * scale;
+    }
+    else
+    {
+      // analytic values, invalid values are skipped
+      for (IndType x = 0; x < width; x++)
+      {
+        DType val =
+            computeDeapodizationAt(line * width + x, beta, normVal, gi_host);
+        row[x] = std::isnan(val) ? scale : scale / val;
+      }
+    }
+    return row;
+  }
+
+ private:
+  DType *deapo;
+  DType *deapoVectors;
+  DType scale;
+  gpuNUFFT::GpuNUFFTInfo *gi_host;
+  DType beta;
+  DType normVal;
+  std::vector<std::vector<DType> > factors;
+};
+
+/** \brief Linear index of the sector containing sample cCnt, as computed
+ * by GpuNUFFTOperatorFactory::assignSectors */
+inline IndType computeSampleSector(DType *kSpaceTraj, IndType cCnt,
+                                   IndType coordCnt, bool is3DProcessing,
+                                   gpuNUFFT::Dimensions &gridDims,
+                                   gpuNUFFT::Dimensions &gridSectorDims,
+                                   DType sectorWidth)
+{
+  if (!is3DProcessing)
+  {
+    DType2 coord;
+    coord.x = kSpaceTraj[cCnt];
+    coord.y = kSpaceTraj[cCnt + coordCnt];
+    return computeInd22Lin(computeSectorMapping(coord, gridDims, sectorWidth),
+                           gridSectorDims);
+  }
+  DType3 coord;
+  coord.x = kSpaceTraj[cCnt];
+  coord.y = kSpaceTraj[cCnt + coordCnt];
+  coord.z = kSpaceTraj[cCnt + 2 * coordCnt];
+  return computeInd32Lin(computeSectorMapping(coord, gridDims, sectorWidth),
+                         gridSectorDims);
+}
+
+/** \brief Offset of the image inside the oversampled grid */
+IndType3 computeImageOffset(gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  IndType3 ind_off;
+  ind_off.x = (IndType)(gi_host->imgDims.x * ((DType)gi_host->osr - 1.0f) /
+                        (DType)2);
+  ind_off.y = (IndType)(gi_host->imgDims.y * ((DType)gi_host->osr - 1.0f) /
+                        (DType)2);
+  ind_off.z = (IndType)(gi_host->imgDims.z * ((DType)gi_host->osr - 1.0f) /
+                        (DType)2);
+  return ind_off;
+}
+
+/** \brief Grid positions and phases of the image points with the FFT shifts
+ * folded into crop and padding
+ *
+ * The cyclic shift of the grid before the FFT turns into a linear phase of
+ * the transformed grid, the shift after the FFT into a different index
+ * mapping. Along an axis of N grid points with h = floor(N/2) and c = N - h
+ * the crop reads image point i from grid point k = (i + offset + h) mod N
+ * and multiplies with exp(-2 pi i k h / N). The padding writes image point i
+ * to grid point m = (i + offset + c) mod N multiplied with
+ * exp(-2 pi i m c / N). For even N the phases are a checkerboard of signs.
+ */
+class FoldedFFTShift
+{
+ public:
+  FoldedFFTShift(gpuNUFFT::GpuNUFFTInfo *gi_host, bool padding,
+                 unsigned threadCount)
+    : weights(threadCount, std::vector<DType2>(gi_host->imgDims.x))
+  {
+    IndType3 ind_off = computeImageOffset(gi_host);
+    IndType imgDims[3] = { gi_host->imgDims.x, gi_host->imgDims.y,
+                           DEFAULT_VALUE(gi_host->imgDims.z) };
+    IndType offsets[3] = { ind_off.x, ind_off.y, ind_off.z };
+    gridDims[0] = gi_host->gridDims.x;
+    gridDims[1] = gi_host->gridDims.y;
+    gridDims[2] = DEFAULT_VALUE(gi_host->gridDims.z);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+      IndType n = gridDims[axis];
+      IndType shift = padding ? n - n / 2 : n / 2;
+      gridIndex[axis].resize(imgDims[axis]);
+      phase[axis].resize(imgDims[axis]);
+      imageIndex[axis].assign(n, INVALID_DATA_INDEX);
+      for (IndType i = 0; i < imgDims[axis]; i++)
+      {
+        IndType k = (i + offsets[axis] + shift) % n;
+        gridIndex[axis][i] = k;
+        imageIndex[axis][k] = i;
+        phase[axis][i] = computePhase(
+            (IndType)((unsigned long long)k * shift % n), n);
+      }
+    }
+  }
+
+  /** \brief Grid positions of the width values of an image line */
+  const IndType *getGridColumns() const
+  {
+    return &gridIndex[0][0];
+  }
+
+  /** \brief Grid line of image line */
+  IndType getGridLine(IndType line) const
+  {
+    IndType height = (IndType)gridIndex[1].size();
+    return gridIndex[1][line % height] +
+           gridDims[1] * gridIndex[2][line / height];
+  }
+
+  /** \brief Image line of grid line, INVALID_DATA_INDEX outside of the
+   * image */
+  IndType getImageLine(IndType gridLine) const
+  {
+    IndType y = imageIndex[1][gridLine % gridDims[1]];
+    IndType z = imageIndex[2][gridLine / gridDims[1]];
+    if (y == INVALID_DATA_INDEX || z == INVALID_DATA_INDEX)
+      return INVALID_DATA_INDEX;
+    return y + (IndType)gridIndex[1].size() * z;
+  }
+
+  /** \brief Flags of the grid indices along axis covered by the image */
+  std::vector<bool> getCoveredIndices(int axis) const
+  {
+    std::vector<bool> covered(gridDims[axis]);
+    for (IndType k = 0; k < gridDims[axis]; k++)
+      covered[k] = imageIndex[axis][k] != INVALID_DATA_INDEX;
+    return covered;
+  }
+
+  /** \brief Phases of the width values of image line multiplied with the
+   * real factors, valid until the next call of the thread */
+  const DType2 *computeWeights(IndType line, const DType *factors,
+                               unsigned threadId)
+  {
+    IndType height = (IndType)gridIndex[1].size();
+    DType2 py = phase[1][line % height];
+    DType2 pz = phase[2][line / height];
+    DType2 pyz;
+    pyz.x = py.x * pz.x - py.y * pz.y;
+    pyz.y = py.x * pz.y + py.y * pz.x;
+
+    DType2 *row = &weights[threadId][0];
+    const DType2 *px = &phase[0][0];
+    for (IndType x = 0; x < (IndType)phase[0].size(); x++)
+    {
+      row[x].x = (px[x].x * pyz.x - px[x].y * pyz.y) * factors[x];
+      row[x].y = (px[x].x * pyz.y + px[x].y * pyz.x) * factors[x];
+    }
+    return row;
+  }
+
+ private:
+  /** \brief exp(-2 pi i r / n), exact for the checkerboard signs */
+  static DType2 computePhase(IndType r, IndType n)
+  {
+    DType2 p;
+    if (r == 0 || 2 * r == n)
+    {
+      p.x = r == 0 ? (DType)1 : (DType)-1;
+      p.y = 0;
+      return p;
+    }
+    double phi = -2.0 * M_PI * (double)r / (double)n;
+    p.x = (DType)cos(phi);
+    p.y = (DType)sin(phi);
+    return p;
+  }
+
+  IndType gridDims[3];
+  std::vector<IndType> gridIndex[3];
+  std::vector<IndType> imageIndex[3];
+  std::vector<DType2> phase[3];
+  std::vector<std::vector<DType2> > weights;
+};
+}
+
+struct gpuNUFFT::CpuConvolutionWorkspace::State
+{
+  State()
+    : ordered(false), colored(false), sectors(NULL), order(NULL),
+      orderCount(0), mergeLocks(MERGE_LOCK_COUNT)
+  {
+  }
+
+  /** \brief Set if chunks and colorOrder are computed */
+  bool ordered;
+  bool colored;
+  /** \brief Sector mapping and processing order of the chunks */
+  const IndType *sectors;
+  const IndType2 *order;
+  IndType orderCount;
+  std::vector<SectorChunk> chunks;
+  std::vector<std::vector<SectorChunk> > colorOrder;
+
+  /** \brief Padded sector grid and kernel window per thread */
+  std::vector<std::vector<CufftType> > sdata;
+  std::vector<KernelWindow> windows;
+
+  /** \brief Locks serializing the merge of split sectors */
+  std::vector<std::mutex> mergeLocks;
+};
+
+void gpuNUFFT::CpuConvolutionWorkspace::invalidate()
+{
+  if (state == NULL)
+    return;
+  state->ordered = false;
+  state->colored = false;
+}
+
+void gpuNUFFT::CpuConvolutionWorkspace::clear()
+{
+  delete state;
+  state = NULL;
+}
+
+size_t gpuNUFFT::CpuConvolutionWorkspace::getMemorySize() const
+{
+  if (state == NULL)
+    return 0;
+  size_t bytes = state->chunks.capacity() * sizeof(SectorChunk);
+  for (size_t color = 0; color < state->colorOrder.size(); color++)
+    bytes += state->colorOrder[color].capacity() * sizeof(SectorChunk);
+  for (size_t t = 0; t < state->sdata.size(); t++)
+    bytes += state->sdata[t].capacity() * sizeof(CufftType);
+  for (size_t t = 0; t < state->windows.size(); t++)
+    bytes += state->windows[t].getMemorySize();
+  return bytes;
+}
+
+gpuNUFFT::CpuConvolutionWorkspace::State &
+gpuNUFFT::CpuConvolutionWorkspace::getState()
+{
+  if (state == NULL)
+    state = new State();
+  return *state;
+}
+
+namespace
+{
+typedef gpuNUFFT::CpuConvolutionWorkspace::State ConvolutionState;
+
+/** \brief Chunks of the processing order, computed on the first call and
+ * whenever sectors or processing order are changed */
+const std::vector<SectorChunk> &
+getCachedProcessingOrder(ConvolutionState &state, IndType *sectors,
+                         IndType2 *sectorProcessingOrder,
+                         gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  IndType orderCount =
+      sectorProcessingOrder != NULL ? gi_host->sectorsToProcess : 0;
+  if (!state.ordered || state.sectors != sectors ||
+      state.order != sectorProcessingOrder || state.orderCount != orderCount)
+  {
+    state.chunks = getProcessingOrder(sectors, sectorProcessingOrder, gi_host);
+    state.sectors = sectors;
+    state.order = sectorProcessingOrder;
+    state.orderCount = orderCount;
+    state.ordered = true;
+    state.colored = false;
+  }
+  return state.chunks;
+}
+
+/** \brief Chunks of the processing order split into the sector color
+ * groups, cached as the processing order */
+const std::vector<std::vector<SectorChunk> > &
+getCachedColorOrder(ConvolutionState &state, IndType *sectors,
+                    IndType *sector_centers, IndType2 *sectorProcessingOrder,
+                    gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  getCachedProcessingOrder(state, sectors, sectorProcessingOrder, gi_host);
+  if (!state.colored)
+  {
+    state.colorOrder = splitOrderByColor(
+        state.chunks, groupSectorsByColor(sectors, sector_centers, gi_host),
+        gi_host);
+    state.colored = true;
+  }
+  return state.colorOrder;
+}
+
+/** \brief Kernel windows of coilCount channels for all threads of the pool
+ * and their padded sector grids if sectorGrids is set
+ *
+ * The scratch of every thread is sized up front, as work stealing decides
+ * which threads process chunks.
+ */
+void reserveThreadScratch(ConvolutionState &state, IndType coilCount,
+                          bool sectorGrids, gpuNUFFT::GpuNUFFTInfo *gi_host,
+                          gpuNUFFT::ThreadPool *threadPool)
+{
+  unsigned threadCount = threadPool->getThreadCount();
+  if (sectorGrids)
+  {
+    if (state.sdata.size() < threadCount)
+      state.sdata.resize(threadCount);
+    size_t gridSize = (size_t)gi_host->sector_dim * coilCount;
+    for (unsigned t = 0; t < threadCount; t++)
+      if (state.sdata[t].size() < gridSize)
+        state.sdata[t].resize(gridSize);
+  }
+  // windows of larger coil batches are reused by smaller ones
+  if (state.windows.size() < threadCount ||
+      !state.windows[0].fits(gi_host, coilCount))
+    state.windows.assign(threadCount, KernelWindow(gi_host, coilCount));
+}
+}
+
+void performConvolutionCPU(DType2 *data, DType *crds, CufftType *gdata,
+                           DType *kernel, IndType *sectors,
+                           IndType *sector_centers,
+                           gpuNUFFT::GpuNUFFTInfo *gi_host,
+                           gpuNUFFT::ThreadPool *threadPool)
+{
+  performConvolutionCPU(data, crds, gdata, kernel, sectors, sector_centers,
+                        NULL, 1, gi_host, threadPool);
+}
+
+void performConvolutionCPU(DType2 *data, DType *crds, CufftType *gdata,
+                           DType *kernel, IndType *sectors,
+                           IndType *sector_centers,
+                           IndType2 *sectorProcessingOrder, IndType coilCount,
+                           gpuNUFFT::GpuNUFFTInfo *gi_host,
+                           gpuNUFFT::ThreadPool *threadPool,
+                           gpuNUFFT::GridBoundary boundary,
+                           gpuNUFFT::CpuConvolutionWorkspace *workspace)
+{
+  threadPool = selectThreadPool(threadPool);
+  gpuNUFFT::CpuConvolutionWorkspace localWorkspace;
+  ConvolutionState &state =
+      (workspace != NULL ? workspace : &localWorkspace)->getState();
+
+  const std::vector<std::vector<SectorChunk> > &colorOrder =
+      getCachedColorOrder(state, sectors, sector_centers,
+                          sectorProcessingOrder, gi_host);
+
+  if (DEBUG)
+    printf("host convolution of %d sectors and %u coils in %d colors using "
+           "%u threads\n",
+           gi_host->sector_count, (unsigned)coilCount, (int)colorOrder.size(),
+           threadPool->getThreadCount());
+
+  // one padded sector grid and kernel window per thread
+  reserveThreadScratch(state, coilCount, true, gi_host, threadPool);
+  std::vector<std::vector<CufftType> > &sdata = state.sdata;
+  std::vector<KernelWindow> &windows = state.windows;
+
+  // chunks of the same sector overlap, the sectors of one color do not
+  std::vector<std::mutex> &mergeLocks = state.mergeLocks;
+
+  for (size_t color = 0; color < colorOrder.size(); color++)
+  {
+    const std::vector<SectorChunk> &chunks = colorOrder[color];
+    threadPool->parallelForStealing(
+        (IndType)chunks.size(), [&](IndType item, unsigned threadId)
+        {
+          CufftType zero;
+          zero.x = 0;
+          zero.y = 0;
+          std::vector<CufftType> &sectorGrid = sdata[threadId];
+          std::fill(sectorGrid.begin(),
+                    sectorGrid.begin() + gi_host->sector_dim * coilCount,
+                    zero);
+
+          const SectorChunk &chunk = chunks[item];
+          IndType sec = chunk.sector;
+          IndType3 center = getSectorCenter(sector_centers, sec, gi_host);
+          gridSector(data, crds, sectorGrid.data(), kernel, chunk.begin,
+                     chunk.end, center, coilCount, windows[threadId],
+                     gi_host);
+
+          std::unique_lock<std::mutex> lock;
+          if (chunk.split)
+            lock = std::unique_lock<std::mutex>(
+                mergeLocks[sec % MERGE_LOCK_COUNT]);
+          mergeSector(sectorGrid.data(), gdata, center, coilCount, boundary,
+                      gi_host);
+        });
+  }
+}
+
+void performForwardConvolutionCPU(CufftType *data, DType *crds,
+                                  CufftType *gdata, DType *kernel,
+                                  IndType *sectors, IndType *sector_centers,
+                                  gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                  gpuNUFFT::ThreadPool *threadPool)
+{
+  performForwardConvolutionCPU(data, crds, gdata, kernel, sectors,
+                               sector_centers, NULL, 1, gi_host, threadPool);
+}
+
+void performForwardConvolutionCPU(CufftType *data, DType *crds,
+                                  CufftType *gdata, DType *kernel,
+                                  IndType *sectors, IndType *sector_centers,
+                                  IndType2 *sectorProcessingOrder,
+                                  IndType coilCount,
+                                  gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                  gpuNUFFT::ThreadPool *threadPool,
+                                  gpuNUFFT::GridBoundary boundary,
+                                  IndType *dataIndices,
+                                  gpuNUFFT::CpuConvolutionWorkspace *workspace)
+{
+  threadPool = selectThreadPool(threadPool);
+  gpuNUFFT::CpuConvolutionWorkspace localWorkspace;
+  ConvolutionState &state =
+      (workspace != NULL ? workspace : &localWorkspace)->getState();
+
+  const std::vector<SectorChunk> &chunks = getCachedProcessingOrder(
+      state, sectors, sectorProcessingOrder, gi_host);
+  reserveThreadScratch(state, coilCount, false, gi_host, threadPool);
+  std::vector<KernelWindow> &windows = state.windows;
+
+  threadPool->parallelForStealing(
+      (IndType)chunks.size(), [&](IndType item, unsigned threadId)
+      {
+        const SectorChunk &chunk = chunks[item];
+        interpolateSamples(
+            data, crds, gdata, kernel, chunk.begin, chunk.end,
+            getSectorCenter(sector_centers, chunk.sector, gi_host),
+            coilCount, boundary, dataIndices, windows[threadId], gi_host);
+      });
+}
+
+bool computeGriddingMatrixCPU(gpuNUFFT::CpuGriddingMatrix &matrix,
+                              DType *crds, DType *kernel, IndType *sectors,
+                              IndType *sector_centers,
+                              gpuNUFFT::GpuNUFFTInfo *gi_host,
+                              size_t memoryBudget,
+                              gpuNUFFT::ThreadPool *threadPool)
+{
+  threadPool = selectThreadPool(threadPool);
+  matrix.clear();
+
+  IndType data_count = sectors[gi_host->sector_count];
+  std::vector<SectorChunk> chunks =
+      getProcessingOrder(sectors, NULL, gi_host);
+  std::vector<KernelWindow> windows =
+      createKernelWindows(gi_host, 1, threadPool);
+
+  // count the grid points per sample and check the size of the matrix before
+  // any entry is allocated, the count is the product of the non-zero weights
+  // per axis
+  std::vector<IndType> rowOffsets(data_count + 1, 0);
+  threadPool->parallelForStealing(
+      (IndType)chunks.size(), [&](IndType item, unsigned threadId)
+      {
+        const SectorChunk &chunk = chunks[item];
+        KernelWindow &window = windows[threadId];
+        IndType3 center =
+            getSectorCenter(sector_centers, chunk.sector, gi_host);
+        for (IndType data_cnt = chunk.begin; data_cnt < chunk.end; data_cnt++)
+        {
+          if (!window.compute(crds, kernel, data_cnt, center,
+                              gpuNUFFT::WRAP_GRID_BOUNDARY, gi_host))
+            continue;
+          IndType points = 1;
+          for (int d = 0; d < 3; d++)
+            points *= (IndType)std::count_if(
+                window.weights[d].begin(),
+                window.weights[d].begin() + window.count[d],
+                [](DType w)
+                {
+                  return w != 0;
+                });
+          rowOffsets[data_cnt + 1] = points;
+        }
+      });
+
+  size_t entryCount = 0;
+  for (IndType data_cnt = 0; data_cnt < data_count; data_cnt++)
+    entryCount += rowOffsets[data_cnt + 1];
+
+  size_t requiredMemory = gpuNUFFT::CpuGriddingMatrix::computeMemorySize(
+      data_count, entryCount);
+  if (DEBUG)
+    printf("gridding matrix with %lu entries requires %lu bytes, budget %lu "
+           "bytes\n",
+           (unsigned long)entryCount, (unsigned long)requiredMemory,
+           (unsigned long)memoryBudget);
+  if (requiredMemory > memoryBudget ||
+      entryCount > (size_t)std::numeric_limits<IndType>::max())
+    return false;
+
+  for (IndType data_cnt = 0; data_cnt < data_count; data_cnt++)
+    rowOffsets[data_cnt + 1] += rowOffsets[data_cnt];
+
+  try
+  {
+    matrix.gridIndices.resize(entryCount);
+    matrix.weights.resize(entryCount);
+  }
+  catch (const std::bad_alloc &)
+  {
+    matrix.clear();
+    return false;
+  }
+  matrix.rowOffsets.swap(rowOffsets);
+
+  IndType width = gi_host->gridDims.x;
+  IndType height = gi_host->gridDims.y;
+  threadPool->parallelForStealing(
+      (IndType)chunks.size(), [&](IndType item, unsigned threadId)
+      {
+        const SectorChunk &chunk = chunks[item];
+        KernelWindow &window = windows[threadId];
+        IndType3 center =
+            getSectorCenter(sector_centers, chunk.sector, gi_host);
+        for (IndType data_cnt = chunk.begin; data_cnt < chunk.end; data_cnt++)
+        {
+          if (!window.compute(crds, kernel, data_cnt, center,
+                              gpuNUFFT::WRAP_GRID_BOUNDARY, gi_host))
+            continue;
+          IndType entry = matrix.rowOffsets[data_cnt];
+          for (int k = 0; k < window.count[2]; k++)
+          {
+            DType wz = window.weights[2][k];
+            if (wz == 0)
+              continue;
+            for (int j = 0; j < window.count[1]; j++)
+            {
+              DType val = wz * window.weights[1][j];
+              if (val == 0)
+                continue;
+              IndType line =
+                  width * ((IndType)window.gridPos[1][j] +
+                           height * (IndType)window.gridPos[2][k]);
+              for (int i = 0; i < window.count[0]; i++)
+              {
+                if (window.weights[0][i] == 0)
+                  continue;
+                matrix.gridIndices[entry] =
+                    line + (IndType)window.gridPos[0][i];
+                matrix.weights[entry] = val * window.weights[0][i];
+                entry++;
+              }
+            }
+          }
+        }
+      });
+  return true;
+}
+
+void performConvolutionCPU(DType2 *data,
+                           const gpuNUFFT::CpuGriddingMatrix &matrix,
+                           CufftType *gdata, IndType *sectors,
+                           IndType *sector_centers,
+                           gpuNUFFT::GpuNUFFTInfo *gi_host,
+                           gpuNUFFT::ThreadPool *threadPool)
+{
+  performConvolutionCPU(data, matrix, gdata, sectors, sector_centers, NULL,
+                        1, gi_host, threadPool);
+}
+
+void performConvolutionCPU(DType2 *data,
+                           const gpuNUFFT::CpuGriddingMatrix &matrix,
+                           CufftType *gdata, IndType *sectors,
+                           IndType *sector_centers,
+                           IndType2 *sectorProcessingOrder, IndType coilCount,
+                           gpuNUFFT::GpuNUFFTInfo *gi_host,
+                           gpuNUFFT::ThreadPool *threadPool,
+                           gpuNUFFT::CpuConvolutionWorkspace *workspace)
+{
+  threadPool = selectThreadPool(threadPool);
+  gpuNUFFT::CpuConvolutionWorkspace localWorkspace;
+  ConvolutionState &state =
+      (workspace != NULL ? workspace : &localWorkspace)->getState();
+
+  // the entries of the sectors of one color never address the same grid
+  // point, thus they can be added to gdata directly
+  const std::vector<std::vector<SectorChunk> > &colorOrder =
+      getCachedColorOrder(state, sectors, sector_centers,
+                          sectorProcessingOrder, gi_host);
+
+  // chunks of the same sector are added one after another
+  std::vector<std::mutex> &mergeLocks = state.mergeLocks;
+
+  for (size_t color = 0; color < colorOrder.size(); color++)
+  {
+    const std::vector<SectorChunk> &chunks = colorOrder[color];
+    threadPool->parallelForStealing(
+        (IndType)chunks.size(), [&](IndType item, unsigned)
+        {
+          const SectorChunk &chunk = chunks[item];
+
+          std::unique_lock<std::mutex> lock;
+          if (chunk.split)
+            lock = std::unique_lock<std::mutex>(
+                mergeLocks[chunk.sector % MERGE_LOCK_COUNT]);
+          for (IndType data_cnt = chunk.begin; data_cnt < chunk.end;
+               data_cnt++)
+          {
+            DType2 *sample = data + data_cnt * coilCount;
+            for (IndType e = matrix.rowOffsets[data_cnt];
+                 e < matrix.rowOffsets[data_cnt + 1]; e++)
+            {
+              CufftType *grid = gdata + coilCount * matrix.gridIndices[e];
+              for (IndType c = 0; c < coilCount; c++)
+              {
+                grid[c].x += matrix.weights[e] * sample[c].x;
+                grid[c].y += matrix.weights[e] * sample[c].y;
+              }
+            }
+          }
+        });
+  }
+}
+
+void performForwardConvolutionCPU(CufftType *data,
+                                  const gpuNUFFT::CpuGriddingMatrix &matrix,
+                                  CufftType *gdata,
+                                  gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                  gpuNUFFT::ThreadPool *threadPool)
+{
+  performForwardConvolutionCPU(data, matrix, gdata, 1, gi_host, threadPool);
+}
+
+void performForwardConvolutionCPU(CufftType *data,
+                                  const gpuNUFFT::CpuGriddingMatrix &matrix,
+                                  CufftType *gdata, IndType coilCount,
+                                  gpuNUFFT::GpuNUFFTInfo * /*gi_host*/,
+                                  gpuNUFFT::ThreadPool *threadPool)
+{
+  IndType data_count = (IndType)matrix.rowOffsets.size() - 1;
+  parallelForRange(
+      data_count, selectThreadPool(threadPool),
+      [&](IndType begin, IndType end)
+      {
+        for (IndType data_cnt = begin; data_cnt < end; data_cnt++)
+        {
+          CufftType *sample = data + data_cnt * coilCount;
+          for (IndType c = 0; c < coilCount; c++)
+          {
+            sample[c].x = 0;
+            sample[c].y = 0;
+          }
+          for (IndType e = matrix.rowOffsets[data_cnt];
+               e < matrix.rowOffsets[data_cnt + 1]; e++)
+          {
+            const CufftType *grid = gdata + coilCount * matrix.gridIndices[e];
+            for (IndType c = 0; c < coilCount; c++)
+            {
+              sample[c].x += matrix.weights[e] * grid[c].x;
+              sample[c].y += matrix.weights[e] * grid[c].y;
+            }
+          }
+        }
+      });
+}
+
+void sortSamplesBySectorCPU(DType *kSpaceTraj, DType *densCompData,
+                            IndType coordCnt, gpuNUFFT::Dimensions gridDims,
+                            gpuNUFFT::Dimensions gridSectorDims,
+                            IndType sectorWidth, DType *trajSorted,
+                            DType *densData, IndType *dataIndices,
+                            IndType *sectorDataCount,
+                            gpuNUFFT::ThreadPool *threadPool)
+{
+  threadPool = selectThreadPool(threadPool);
+
+  bool is3DProcessing = gridDims.depth > 0;
+  int dimCount = is3DProcessing ? 3 : 2;
+  IndType sectorCount = gridSectorDims.count();
+
+  // one block per thread, small problems are not split
+  IndType blockCount = std::max(
+      (IndType)1,
+      std::min((IndType)threadPool->getThreadCount(),
+               (coordCnt + SORT_BLOCK_SIZE - 1) / SORT_BLOCK_SIZE));
+  IndType blockSize = (coordCnt + blockCount - 1) / blockCount;
+
+  // sector histogram per block, turned into the write positions afterwards
+  std::vector<std::vector<IndType> > positions(blockCount);
+  std::vector<IndType> sampleSectors(coordCnt);
+  threadPool->parallelFor(
+      blockCount, [&](IndType block, unsigned)
+      {
+        std::vector<IndType> &histogram = positions[block];
+        histogram.assign(sectorCount, 0);
+        IndType end = std::min(coordCnt, (block + 1) * blockSize);
+        for (IndType cCnt = block * blockSize; cCnt < end; cCnt++)
+        {
+          IndType sec = computeSampleSector(
+              kSpaceTraj, cCnt, coordCnt, is3DProcessing, gridDims,
+              gridSectorDims, (DType)sectorWidth);
+          sampleSectors[cCnt] = sec;
+          histogram[sec]++;
+        }
+      });
+
+  sectorDataCount[0] = 0;
+  for (IndType sec = 0; sec < sectorCount; sec++)
+  {
+    IndType pos = sectorDataCount[sec];
+    for (IndType block = 0; block < blockCount; block++)
+    {
+      IndType count = positions[block][sec];
+      positions[block][sec] = pos;
+      pos += count;
+    }
+    sectorDataCount[sec + 1] = pos;
+  }
+
+  threadPool->parallelFor(
+      blockCount, [&](IndType block, unsigned)
+      {
+        std::vector<IndType> &position = positions[block];
+        IndType end = std::min(coordCnt, (block + 1) * blockSize);
+        for (IndType cCnt = block * blockSize; cCnt < end; cCnt++)
+        {
+          IndType pos = position[sampleSectors[cCnt]]++;
+          for (int d = 0; d < dimCount; d++)
+            trajSorted[pos + d * coordCnt] = kSpaceTraj[cCnt + d * coordCnt];
+          if (densCompData != NULL)
+            densData[pos] = densCompData[cCnt];
+          dataIndices[pos] = cCnt;
+        }
+      });
+}
+
+void assignSampleSectorsCPU(DType *kSpaceTraj, IndType first, IndType count,
+                            IndType coordCnt, gpuNUFFT::Dimensions gridDims,
+                            gpuNUFFT::Dimensions gridSectorDims,
+                            IndType sectorWidth, IndType *sampleSectors,
+                            gpuNUFFT::ThreadPool *threadPool)
+{
+  bool is3DProcessing = gridDims.depth > 0;
+  parallelForRange(count, selectThreadPool(threadPool),
+                   [&](IndType begin, IndType end)
+                   {
+                     for (IndType i = begin; i < end; i++)
+                       sampleSectors[i] = computeSampleSector(
+                           kSpaceTraj, first + i, coordCnt, is3DProcessing,
+                           gridDims, gridSectorDims, (DType)sectorWidth);
+                   });
+}
+
+uint64_t computeCurveIndexCPU(gpuNUFFT::SpaceFillingCurve curve,
+                              IndType3 cell, unsigned bits, bool is3D)
+{
+  int n = is3D ? 3 : 2;
+  uint32_t X[3] = { (uint32_t)cell.x, (uint32_t)cell.y,
+                    is3D ? (uint32_t)cell.z : 0 };
+  if (curve == gpuNUFFT::NO_CURVE)
+    return ((uint64_t)X[2] << (2 * bits)) | ((uint64_t)X[1] << bits) | X[0];
+
+  if (curve == gpuNUFFT::HILBERT_CURVE && bits > 0)
+  {
+    // transpose of the Hilbert index, see J. Skilling, "Programming the
+    // Hilbert curve", AIP Conf. Proc. 707 (2004)
+    uint32_t M = 1u << (bits - 1);
+    for (uint32_t Q = M; Q > 1; Q >>= 1)
+    {
+      uint32_t P = Q - 1;
+      for (int i = 0; i < n; i++)
+      {
+        if (X[i] & Q)
+          X[0] ^= P;
+        else
+        {
+          uint32_t t = (X[0] ^ X[i]) & P;
+          X[0] ^= t;
+          X[i] ^= t;
+        }
+      }
+    }
+    for (int i = 1; i < n; i++)
+      X[i] ^= X[i - 1];
+    uint32_t t = 0;
+    for (uint32_t Q = M; Q > 1; Q >>= 1)
+      if (X[n - 1] & Q)
+        t ^= Q - 1;
+    for (int i = 0; i < n; i++)
+      X[i] ^= t;
+  }
+  else
+    std::swap(X[0], X[n - 1]);  // Morton order, x in the lowest bit
+
+  // interleave the bits, most significant level first
+  uint64_t index = 0;
+  for (int b = (int)bits - 1; b >= 0; b--)
+    for (int i = 0; i < n; i++)
+      index = (index << 1) | ((X[i] >> b) & 1);
+  return index;
+}
+
+void sortSectorSamplesByCurveCPU(gpuNUFFT::SpaceFillingCurve curve,
+                                 DType *trajSorted, DType *densData,
+                                 IndType *dataIndices, IndType coordCnt,
+                                 IndType *sectorDataCount, IndType sectorCount,
+                                 gpuNUFFT::Dimensions gridDims,
+                                 gpuNUFFT::ThreadPool *threadPool)
+{
+  if (curve == gpuNUFFT::NO_CURVE || coordCnt == 0)
+    return;
+  threadPool = selectThreadPool(threadPool);
+
+  bool is3D = gridDims.depth > 0;
+  int dimCount = is3D ? 3 : 2;
+  IndType gridWidth[3] = { gridDims.width, gridDims.height,
+                           DEFAULT_VALUE(gridDims.depth) };
+  unsigned bits = 1;
+  while ((1u << bits) < std::max(gridWidth[0],
+                                 std::max(gridWidth[1], gridWidth[2])))
+    bits++;
+
+  // permuted copies, each sector is written by one task
+  std::vector<DType> traj(trajSorted, trajSorted + dimCount * coordCnt);
+  std::vector<DType> dens;
+  if (densData != NULL)
+    dens.assign(densData, densData + coordCnt);
+  std::vector<IndType> indices(dataIndices, dataIndices + coordCnt);
+
+  threadPool->parallelFor(
+      sectorCount, [&](IndType sec, unsigned)
+      {
+        IndType begin = sectorDataCount[sec];
+        IndType end = sectorDataCount[sec + 1];
+        if (end - begin < 2)
+          return;
+
+        std::vector<std::pair<uint64_t, IndType> > keys(end - begin);
+        for (IndType pos = begin; pos < end; pos++)
+        {
+          // grid cell as assigned by computeSectorMapping
+          IndType c[3] = { 0, 0, 0 };
+          for (int d = 0; d < dimCount; d++)
+          {
+            DType g = round(traj[pos + d * coordCnt] * (DType)gridWidth[d] +
+                            (DType)0.5 * (DType)gridWidth[d]);
+            c[d] = (IndType)std::max((DType)0.0,
+                                     std::min(g, (DType)gridWidth[d] - 1));
+          }
+          IndType3 cell;
+          cell.x = c[0];
+          cell.y = c[1];
+          cell.z = c[2];
+          keys[pos - begin] = std::make_pair(
+              computeCurveIndexCPU(curve, cell, bits, is3D), pos);
+        }
+        std::stable_sort(keys.begin(), keys.end(),
+                         [](const std::pair<uint64_t, IndType> &a,
+                            const std::pair<uint64_t, IndType> &b)
+                         {
+                           return a.first < b.first;
+                         });
+
+        for (IndType i = 0; i < end - begin; i++)
+        {
+          IndType src = keys[i].second;
+          for (int d = 0; d < dimCount; d++)
+            trajSorted[begin + i + d * coordCnt] = traj[src + d * coordCnt];
+          if (densData != NULL)
+            densData[begin + i] = dens[src];
+          dataIndices[begin + i] = indices[src];
+        }
+      });
+}
+
+void performFFTScalingCPU(CufftType *data, IndType N,
+                          gpuNUFFT::GpuNUFFTInfo *gi_host,
+                          gpuNUFFT::ThreadPool *threadPool)
+{
+  DType scaling_factor =
+      (DType)1.0 / (DType)sqrt((DType)gi_host->im_width_dim);
+
+  parallelForRange(N, selectThreadPool(threadPool),
+                   [&](IndType begin, IndType end)
+                   {
+                     for (IndType t = begin; t < end; t++)
+                     {
+                       data[t].x = data[t].x * scaling_factor;
+                       data[t].y = data[t].y * scaling_factor;
+                     }
+                   });
+}
+
+void performDensityCompensationCPU(DType2 *data, DType *density_comp,
+                                   gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                   gpuNUFFT::ThreadPool *threadPool)
+{
+  parallelForRange(gi_host->data_count, selectThreadPool(threadPool),
+                   [&](IndType begin, IndType end)
+                   {
+                     for (IndType t = begin; t < end; t++)
+                     {
+                       DType dens = sqrt(density_comp[t]);
+                       data[t].x = data[t].x * dens;
+                       data[t].y = data[t].y * dens;
+                     }
+                   });
+}
+
+void performSensMulCPU(CufftType *imdata, DType2 *sens,
+                       gpuNUFFT::GpuNUFFTInfo *gi_host, bool conjugate,
+                       gpuNUFFT::ThreadPool *threadPool)
+{
+  if (DEBUG)
+    printf("perform sensitivity multiplication \n");
+
+  parallelForRange(gi_host->im_width_dim, selectThreadPool(threadPool),
+                   [&](IndType begin, IndType end)
+                   {
+                     for (IndType t = begin; t < end; t++)
+                     {
+                       CufftType im_p = imdata[t];
+                       DType2 sen_p = sens[t];
+                       if (conjugate)
+                       {
+                         imdata[t].x = im_p.x * sen_p.x + im_p.y * sen_p.y;
+                         imdata[t].y = im_p.y * sen_p.x - im_p.x * sen_p.y;
+                       }
+                       else
+                       {
+                         imdata[t].x = im_p.x * sen_p.x - im_p.y * sen_p.y;
+                         imdata[t].y = im_p.x * sen_p.y + im_p.y * sen_p.x;
+                       }
+                     }
+                   });
+}
+
+void performSensSumCPU(CufftType *imdata, CufftType *imdata_sum,
+                       gpuNUFFT::GpuNUFFTInfo *gi_host,
+                       gpuNUFFT::ThreadPool *threadPool)
+{
+  if (DEBUG)
+    printf("perform sens coil summation\n");
+
+  parallelForRange(gi_host->im_width_dim, selectThreadPool(threadPool),
+                   [&](IndType begin, IndType end)
+                   {
+                     for (IndType t = begin; t < end; t++)
+                     {
+                       imdata_sum[t].x += imdata[t].x;
+                       imdata_sum[t].y += imdata[t].y;
+                     }
+                   });
+}
+
+void performFFTShiftCPU(CufftType *gdata, gpuNUFFT::FFTShiftDir shift_dir,
+                        gpuNUFFT::Dimensions gridDims,
+                        gpuNUFFT::GpuNUFFTInfo * /*gi_host*/,
+                        gpuNUFFT::ThreadPool *threadPool,
+                        CufftType *copy_gdata)
+{
+  IndType3 offset;
+  if (shift_dir == gpuNUFFT::FORWARD)
+  {
+    offset.x = (int)ceil((DType)(gridDims.width / (DType)2.0));
+    offset.y = (int)ceil((DType)(gridDims.height / (DType)2.0));
+    offset.z = (int)ceil((DType)(gridDims.depth / (DType)2.0));
+  }
+  else
+  {
+    offset.x = (int)floor((DType)(gridDims.width / (DType)2.0));
+    offset.y = (int)floor((DType)(gridDims.height / (DType)2.0));
+    offset.z = (int)floor((DType)(gridDims.depth / (DType)2.0));
+  }
+
+  IndType width = gridDims.width;
+  IndType height = DEFAULT_VALUE(gridDims.height);
+  IndType depth = DEFAULT_VALUE(gridDims.depth);
+
+  // out of place shift, valid for even and odd dimensions
+  IndType grid_count = width * height * depth;
+  std::vector<CufftType> local_copy;
+  if (copy_gdata == NULL)
+  {
+    local_copy.resize(grid_count);
+    copy_gdata = local_copy.data();
+  }
+  threadPool = selectThreadPool(threadPool);
+  parallelForRange(grid_count, threadPool, [&](IndType begin, IndType end)
+                   {
+                     std::copy(gdata + begin, gdata + end, copy_gdata + begin);
+                   });
+
+  threadPool->parallelFor(
+      height * depth, [&](IndType line, unsigned)
+      {
+        IndType y = line % height;
+        IndType z = line / height;
+        IndType y_opp = (y + offset.y) % height;
+        IndType z_opp = (z + offset.z) % depth;
+
+        const CufftType *src = copy_gdata + (y_opp + height * z_opp) * width;
+        CufftType *dst = gdata + line * width;
+        IndType split = width - offset.x % width;
+        std::copy(src + offset.x % width, src + width, dst);
+        std::copy(src, src + offset.x % width, dst + split);
+      });
+}
+
+void performCropCPU(CufftType *gdata, CufftType *imdata,
+                    gpuNUFFT::GpuNUFFTInfo *gi_host,
+                    gpuNUFFT::ThreadPool *threadPool)
+{
+  IndType3 ind_off = computeImageOffset(gi_host);
+  if (DEBUG)
+    printf("start cropping image with offset %u\n", (unsigned)ind_off.x);
+
+  IndType width = gi_host->imgDims.x;
+  IndType height = gi_host->imgDims.y;
+  IndType depth = DEFAULT_VALUE(gi_host->imgDims.z);
+
+  selectThreadPool(threadPool)->parallelFor(
+      height * depth, [&](IndType line, unsigned)
+      {
+        IndType y = line % height;
+        IndType z = line / height;
+        IndType grid_ind = computeGridIndex(ind_off.x, ind_off.y + y,
+                                            ind_off.z + z, gi_host->gridDims);
+        std::copy(gdata + grid_ind, gdata + grid_ind + width,
+                  imdata + line * width);
+      });
+}
+
+void performDeapodizationCPU(CufftType *imdata, DType *deapo,
+                             DType *deapoVectors,
+                             gpuNUFFT::GpuNUFFTInfo *gi_host,
+                             gpuNUFFT::ThreadPool *threadPool)
+{
+  applyDeapodization(imdata, deapo, deapoVectors, gi_host->im_width_dim,
+                     gi_host, selectThreadPool(threadPool));
+}
+
+void performForwardDeapodizationCPU(DType2 *imdata, DType *deapo,
+                                    DType *deapoVectors,
+                                    gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                    gpuNUFFT::ThreadPool *threadPool)
+{
+  applyDeapodization((CufftType *)imdata, deapo, deapoVectors,
+                     gi_host->im_width_dim, gi_host,
+                     selectThreadPool(threadPool));
+}
+
+void performCropDeapodizationCPU(CufftType *gdata, CufftType *imdata,
+                                 DType *deapo, DType *deapoVectors,
+                                 DType2 *sens, bool foldFFTShift,
+                                 gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                 gpuNUFFT::ThreadPool *threadPool)
+{
+  IndType3 ind_off = computeImageOffset(gi_host);
+  IndType width = gi_host->imgDims.x;
+  IndType height = gi_host->imgDims.y;
+  IndType depth = DEFAULT_VALUE(gi_host->imgDims.z);
+  IndType gridWidth = gi_host->gridDims.x;
+  DType scaling_factor =
+      (DType)1.0 / (DType)sqrt((DType)gi_host->im_width_dim);
+
+  threadPool = selectThreadPool(threadPool);
+  DeapodizationLines lines(deapo, deapoVectors, scaling_factor, gi_host,
+                           threadPool->getThreadCount());
+  if (foldFFTShift)
+  {
+    FoldedFFTShift shift(gi_host, false, threadPool->getThreadCount());
+    const IndType *columns = shift.getGridColumns();
+    threadPool->parallelFor(
+        height * depth, [&](IndType line, unsigned threadId)
+        {
+          const DType2 *w = shift.computeWeights(
+              line, lines.compute(line, threadId), threadId);
+          const CufftType *src = gdata + shift.getGridLine(line) * gridWidth;
+          CufftType *dst = imdata + line * width;
+          for (IndType x = 0; x < width; x++)
+          {
+            CufftType val = src[columns[x]];
+            DType re = val.x * w[x].x - val.y * w[x].y;
+            DType im = val.x * w[x].y + val.y * w[x].x;
+            if (sens == NULL)
+            {
+              dst[x].x = re;
+              dst[x].y = im;
+              continue;
+            }
+            DType2 sen = sens[line * width + x];
+            dst[x].x += re * sen.x + im * sen.y;
+            dst[x].y += im * sen.x - re * sen.y;
+          }
+        });
+    return;
+  }
+
+  threadPool->parallelFor(
+      height * depth, [&](IndType line, unsigned threadId)
+      {
+        const DType *factors = lines.compute(line, threadId);
+        IndType y = line % height;
+        IndType z = line / height;
+        const CufftType *src =
+            gdata + computeGridIndex(ind_off.x, ind_off.y + y, ind_off.z + z,
+                                     gi_host->gridDims);
+        CufftType *dst = imdata + line * width;
+        if (sens == NULL)
+        {
+          for (IndType x = 0; x < width; x++)
+          {
+            dst[x].x = src[x].x * factors[x];
+            dst[x].y = src[x].y * factors[x];
+          }
+          return;
+        }
+
+        // accumulate conj(sens) * value into the coil combined image
+        const DType2 *sen = sens + line * width;
+        for (IndType x = 0; x < width; x++)
+        {
+          DType re = src[x].x * factors[x];
+          DType im = src[x].y * factors[x];
+          dst[x].x += re * sen[x].x + im * sen[x].y;
+          dst[x].y += im * sen[x].x - re * sen[x].y;
+        }
+      });
+}
+
+void performDeapodizationPaddingCPU(DType2 *imdata, DType2 *sens,
+                                    CufftType *gdata, DType *deapo,
+                                    DType *deapoVectors, bool foldFFTShift,
+                                    gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                    gpuNUFFT::ThreadPool *threadPool)
+{
+  IndType3 ind_off = computeImageOffset(gi_host);
+  IndType width = gi_host->imgDims.x;
+  IndType height = gi_host->imgDims.y;
+  IndType depth = DEFAULT_VALUE(gi_host->imgDims.z);
+  IndType gridWidth = gi_host->gridDims.x;
+  IndType gridHeight = gi_host->gridDims.y;
+  IndType gridDepth = DEFAULT_VALUE(gi_host->gridDims.z);
+  DType scaling_factor =
+      (DType)1.0 / (DType)sqrt((DType)gi_host->im_width_dim);
+
+  CufftType zero;
+  zero.x = 0;
+  zero.y = 0;
+
+  threadPool = selectThreadPool(threadPool);
+  DeapodizationLines lines(deapo, deapoVectors, scaling_factor, gi_host,
+                           threadPool->getThreadCount());
+  if (foldFFTShift)
+  {
+    FoldedFFTShift shift(gi_host, true, threadPool->getThreadCount());
+    const IndType *columns = shift.getGridColumns();
+    threadPool->parallelFor(
+        gridHeight * gridDepth, [&](IndType gridLine, unsigned threadId)
+        {
+          CufftType *dst = gdata + gridLine * gridWidth;
+          std::fill(dst, dst + gridWidth, zero);
+          IndType line = shift.getImageLine(gridLine);
+          if (line == INVALID_DATA_INDEX)
+            return;
+
+          const DType2 *w = shift.computeWeights(
+              line, lines.compute(line, threadId), threadId);
+          const DType2 *src = imdata + line * width;
+          for (IndType x = 0; x < width; x++)
+          {
+            DType2 val = src[x];
+            if (sens != NULL)
+            {
+              DType2 sen = sens[line * width + x];
+              val.x = src[x].x * sen.x - src[x].y * sen.y;
+              val.y = src[x].x * sen.y + src[x].y * sen.x;
+            }
+            dst[columns[x]].x = val.x * w[x].x - val.y * w[x].y;
+            dst[columns[x]].y = val.x * w[x].y + val.y * w[x].x;
+          }
+        });
+    return;
+  }
+
+  threadPool->parallelFor(
+      gridHeight * gridDepth, [&](IndType gridLine, unsigned threadId)
+      {
+        CufftType *dst = gdata + gridLine * gridWidth;
+        IndType y = gridLine % gridHeight - ind_off.y;
+        IndType z = gridLine / gridHeight - ind_off.z;
+        // unsigned wrap around for lines before the image
+        if (y >= height || z >= depth)
+        {
+          std::fill(dst, dst + gridWidth, zero);
+          return;
+        }
+
+        IndType line = y + height * z;
+        const DType *factors = lines.compute(line, threadId);
+        const DType2 *src = imdata + line * width;
+        std::fill(dst, dst + ind_off.x, zero);
+        std::fill(dst + ind_off.x + width, dst + gridWidth, zero);
+        dst += ind_off.x;
+        if (sens == NULL)
+        {
+          for (IndType x = 0; x < width; x++)
+          {
+            dst[x].x = src[x].x * factors[x];
+            dst[x].y = src[x].y * factors[x];
+          }
+          return;
+        }
+
+        const DType2 *sen = sens + line * width;
+        for (IndType x = 0; x < width; x++)
+        {
+          dst[x].x = (src[x].x * sen[x].x - src[x].y * sen[x].y) * factors[x];
+          dst[x].y = (src[x].x * sen[x].y + src[x].y * sen[x].x) * factors[x];
+        }
+      });
+}
+
+gpuNUFFT::CpuFFTPlan::Support
+computeImageSupportCPU(gpuNUFFT::GpuNUFFTInfo *gi_host, bool padding)
+{
+  FoldedFFTShift shift(gi_host, padding, 1);
+  gpuNUFFT::CpuFFTPlan::Support support;
+  for (int axis = 0; axis < 3; axis++)
+    support.axes[axis] = shift.getCoveredIndices(axis);
+  return support;
+}
+
+void computeDeapodizationVectorsCPU(DType *kernel,
+                                    gpuNUFFT::GpuNUFFTInfo *gi_host,
+                                    DType *deapoVectors)
+{
+  int axisCount = gi_host->is2Dprocessing ? 2 : 3;
+  IndType3 ind_off = computeImageOffset(gi_host);
+  IndType imgDims[3] = { gi_host->imgDims.x, gi_host->imgDims.y,
+                         gi_host->imgDims.z };
+  IndType gridDims[3] = { gi_host->gridDims.x, gi_host->gridDims.y,
+                          gi_host->gridDims.z };
+  IndType offsets[3] = { ind_off.x, ind_off.y, ind_off.z };
+  DType anisoScales[3] = { gi_host->aniso_x_scale, gi_host->aniso_y_scale,
+                           gi_host->aniso_z_scale };
+
+  for (int axis = 0; axis < axisCount; axis++)
+  {
+    int gridDim = (int)gridDims[axis];
+    int shift = gridDim / 2;
+
+    // kernel values along the axis of a sample at k = 0, as evaluated by
+    // KernelWindow
+    std::vector<std::pair<int, double> > points;
+    for (int g = 0; g < gridDim; g++)
+    {
+      DType dist = mapGridToKSpaceCPU(g, gridDim, 0, 0) * anisoScales[axis];
+      dist *= dist;
+      if (dist < gi_host->radiusSquared)
+        points.push_back(std::make_pair(
+            g, (double)kernel[(int)round(dist * gi_host->dist_multiplier)]));
+    }
+
+    // inverse DFT of the shifted kernel values at the cropped and shifted
+    // image positions, the FFT scaling is compensated by the scaling of the
+    // adjoint operation
+    for (IndType i = 0; i < imgDims[axis]; i++)
+    {
+      int q = (int)((i + offsets[axis] + shift) % gridDim);
+      double re = 0.0;
+      double im = 0.0;
+      for (size_t p = 0; p < points.size(); p++)
+      {
+        double phi = 2.0 * M_PI *
+                     (double)(((points[p].first - shift) * q) % gridDim) /
+                     (double)gridDim;
+        re += points[p].second * cos(phi);
+        im += points[p].second * sin(phi);
+      }
+      *deapoVectors++ = (DType)(1.0 / sqrt(re * re + im * im));
+    }
+  }
+}
+
+void expandDeapodizationVectorsCPU(DType *deapoVectors,
+                                   gpuNUFFT::Dimensions imgDims, DType *deapo,
+                                   gpuNUFFT::ThreadPool *threadPool)
+{
+  IndType3 dims;
+  dims.x = imgDims.width;
+  dims.y = imgDims.height;
+  dims.z = imgDims.depth;
+  IndType width = dims.x;
+  forEachDeapodizationLine(deapoVectors, dims, imgDims.depth == 0,
+                           selectThreadPool(threadPool),
+                           [&](IndType line, DType factor)
+                           {
+                             for (IndType x = 0; x < width; x++)
+                               deapo[line * width + x] =
+                                   deapoVectors[x] * factor;
+                           });
+}
+
+void performPaddingCPU(DType2 *imdata, CufftType *gdata,
+                       gpuNUFFT::GpuNUFFTInfo *gi_host,
+                       gpuNUFFT::ThreadPool *threadPool)
+{
+  IndType3 ind_off = computeImageOffset(gi_host);
+  if (DEBUG)
+    printf("start padding image with offset (%u,%u,%u)\n",
+           (unsigned)ind_off.x, (unsigned)ind_off.y, (unsigned)ind_off.z);
+
+  IndType width = gi_host->imgDims.x;
+  IndType height = gi_host->imgDims.y;
+  IndType depth = DEFAULT_VALUE(gi_host->imgDims.z);
+
+  selectThreadPool(threadPool)->parallelFor(
+      height * depth, [&](IndType line, unsigned)
+      {
+        IndType y = line % height;
+        IndType z = line / height;
+        IndType grid_ind = computeGridIndex(ind_off.x, ind_off.y + y,
+                                            ind_off.z + z, gi_host->gridDims);
+        for (IndType x = 0; x < width; x++)
+        {
+          gdata[grid_ind + x].x = imdata[line * width + x].x;
+          gdata[grid_ind + x].y = imdata[line * width + x].y;
+        }
+      });
+}
@@ -0,0 +1,318 @@
+#include "gpuNUFFT_cpu_simd.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef GPUNUFFT_X86_SIMD
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+namespace
+{
+typedef void (*AxpyFunction)(DType *, const DType *, DType, int);
+typedef void (*ComplexDotFunction)(const DType *, const DType *, int, DType &,
+                                   DType &);
+
+void axpyScalar(DType *dst, const DType *src, DType weight, int count)
+{
+  for (int n = 0; n < count; n++)
+    dst[n] += weight * src[n];
+}
+
+void complexDotScalar(const DType *values, const DType *weights, int count,
+                      DType &re, DType &im)
+{
+  re = 0;
+  im = 0;
+  for (int n = 0; n + 1 < count; n += 2)
+  {
+    re += values[n] * weights[n];
+    im += values[n + 1] * weights[n + 1];
+  }
+}
+
+#ifdef GPUNUFFT_X86_SIMD
+
+#ifdef GPU_DOUBLE_PREC
+#define AVX2_WIDTH 4
+#define AVX2_TYPE __m256d
+#define AVX2_SET1 _mm256_set1_pd
+#define AVX2_ZERO _mm256_setzero_pd
+#define AVX2_LOAD _mm256_loadu_pd
+#define AVX2_STORE _mm256_storeu_pd
+#define AVX2_FMADD _mm256_fmadd_pd
+#define AVX512_WIDTH 8
+#define AVX512_TYPE __m512d
+#define AVX512_MASK __mmask8
+#define AVX512_SET1 _mm512_set1_pd
+#define AVX512_ZERO _mm512_setzero_pd
+#define AVX512_LOAD _mm512_loadu_pd
+#define AVX512_STORE _mm512_storeu_pd
+#define AVX512_MASKZ_LOAD _mm512_maskz_loadu_pd
+#define AVX512_MASK_STORE _mm512_mask_storeu_pd
+#define AVX512_FMADD _mm512_fmadd_pd
+#else
+#define AVX2_WIDTH 8
+#define AVX2_TYPE __m256
+#define AVX2_SET1 _mm256_set1_ps
+#define AVX2_ZERO _mm256_setzero_ps
+#define AVX2_LOAD _mm256_loadu_ps
+#define AVX2_STORE _mm256_storeu_ps
+#define AVX2_FMADD _mm256_fmadd_ps
+#define AVX512_WIDTH 16
+#define AVX512_TYPE __m512
+#define AVX512_MASK __mmask16
+#define AVX512_SET1 _mm512_set1_ps
+#define AVX512_ZERO _mm512_setzero_ps
+#define AVX512_LOAD _mm512_loadu_ps
+#define AVX512_STORE _mm512_storeu_ps
+#define AVX512_MASKZ_LOAD _mm512_maskz_loadu_ps
+#define AVX512_MASK_STORE _mm512_mask_storeu_ps
+#define AVX512_FMADD _mm512_fmadd_ps
+#endif
+
+GPUNUFFT_TARGET_AVX2 void axpyAVX2(DType *dst, const DType *src,
+                                   DType weight, int count)
+{
+  AVX2_TYPE w = AVX2_SET1(weight);
+  int n = 0;
+  for (; n + AVX2_WIDTH <= count; n += AVX2_WIDTH)
+    AVX2_STORE(dst + n, AVX2_FMADD(w, AVX2_LOAD(src + n), AVX2_LOAD(dst + n)));
+  for (; n < count; n++)
+    dst[n] += weight * src[n];
+}
+
+/** \brief Sums of the even (real) and odd (imaginary) lanes of acc */
+#ifdef GPU_DOUBLE_PREC
+GPUNUFFT_TARGET_AVX2 inline void reduceComplexAVX2(__m256d acc, DType &re,
+                                                   DType &im)
+{
+  __m128d v =
+      _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+  re = _mm_cvtsd_f64(v);
+  im = _mm_cvtsd_f64(_mm_unpackhi_pd(v, v));
+}
+#else
+GPUNUFFT_TARGET_AVX2 inline void reduceComplexAVX2(__m256 acc, DType &re,
+                                                   DType &im)
+{
+  __m128 v =
+      _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  re = _mm_cvtss_f32(v);
+  im = _mm_cvtss_f32(_mm_shuffle_ps(v, v, 1));
+}
+#endif
+
+GPUNUFFT_TARGET_AVX2 void complexDotAVX2(const DType *values,
+                                         const DType *weights, int count,
+                                         DType &re, DType &im)
+{
+  AVX2_TYPE acc = AVX2_ZERO();
+  int n = 0;
+  for (; n + AVX2_WIDTH <= count; n += AVX2_WIDTH)
+    acc = AVX2_FMADD(AVX2_LOAD(values + n), AVX2_LOAD(weights + n), acc);
+
+  // even lanes hold real, odd lanes imaginary parts
+  reduceComplexAVX2(acc, re, im);
+  for (; n + 1 < count; n += 2)
+  {
+    re += values[n] * weights[n];
+    im += values[n + 1] * weights[n + 1];
+  }
+}
+
+GPUNUFFT_TARGET_AVX512 void axpyAVX512(DType *dst, const DType *src,
+                                       DType weight, int count)
+{
+  AVX512_TYPE w = AVX512_SET1(weight);
+  int n = 0;
+  for (; n + AVX512_WIDTH <= count; n += AVX512_WIDTH)
+    AVX512_STORE(dst + n,
+                 AVX512_FMADD(w, AVX512_LOAD(src + n), AVX512_LOAD(dst + n)));
+  if (n < count)
+  {
+    // masked tail, typical kernel rows fit into a single vector
+    AVX512_MASK mask = (AVX512_MASK)((1u << (count - n)) - 1u);
+    AVX512_MASK_STORE(dst + n, mask,
+                      AVX512_FMADD(w, AVX512_MASKZ_LOAD(mask, src + n),
+                                   AVX512_MASKZ_LOAD(mask, dst + n)));
+  }
+}
+
+// the unmasked AVX-512 intrinsics of GCC 12 pass an undefined source
+// vector, which triggers false -Wuninitialized warnings
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+GPUNUFFT_TARGET_AVX512 void complexDotAVX512(const DType *values,
+                                             const DType *weights, int count,
+                                             DType &re, DType &im)
+{
+  AVX512_TYPE acc = AVX512_ZERO();
+  int n = 0;
+  for (; n + AVX512_WIDTH <= count; n += AVX512_WIDTH)
+    acc = AVX512_FMADD(AVX512_LOAD(values + n), AVX512_LOAD(weights + n), acc);
+  if (n < count)
+  {
+    AVX512_MASK mask = (AVX512_MASK)((1u << (count - n)) - 1u);
+    acc = AVX512_FMADD(AVX512_MASKZ_LOAD(mask, values + n),
+                       AVX512_MASKZ_LOAD(mask, weights + n), acc);
+  }
+
+  // even lanes hold real, odd lanes imaginary parts
+#ifdef GPU_DOUBLE_PREC
+  re = _mm512_mask_reduce_add_pd((__mmask8)0x55, acc);
+  im = _mm512_mask_reduce_add_pd((__mmask8)0xaa, acc);
+#else
+  re = _mm512_mask_reduce_add_ps((__mmask16)0x5555, acc);
+  im = _mm512_mask_reduce_add_ps((__mmask16)0xaaaa, acc);
+#endif
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+gpuNUFFT::CpuSimdLevel detectCpuSimdLevel()
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return gpuNUFFT::SIMD_SCALAR;
+  __cpuid(info, 1);
+  bool fma = (info[2] & (1 << 12)) != 0;
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  if (!osxsave)
+    return gpuNUFFT::SIMD_SCALAR;
+  unsigned long long xcr0 = _xgetbv(0);
+  __cpuidex(info, 7, 0);
+  bool avx2 = fma && (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+  bool avx512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+#else
+  __builtin_cpu_init();
+  bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  bool avx512 = __builtin_cpu_supports("avx512f");
+#endif
+  if (avx512)
+    return gpuNUFFT::SIMD_AVX512;
+  if (avx2)
+    return gpuNUFFT::SIMD_AVX2;
+  return gpuNUFFT::SIMD_SCALAR;
+}
+
+#else
+
+gpuNUFFT::CpuSimdLevel detectCpuSimdLevel()
+{
+  return gpuNUFFT::SIMD_SCALAR;
+}
+
+#endif  // GPUNUFFT_X86_SIMD
+
+/** \brief Supported level, limited by the GPUNUFFT_CPU_SIMD environment
+ * variable */
+gpuNUFFT::CpuSimdLevel initSupportedLevel()
+{
+  gpuNUFFT::CpuSimdLevel level = detectCpuSimdLevel();
+  const char *env = getenv("GPUNUFFT_CPU_SIMD");
+  if (env != NULL)
+  {
+    gpuNUFFT::CpuSimdLevel limit = level;
+    if (strcmp(env, "scalar") == 0)
+      limit = gpuNUFFT::SIMD_SCALAR;
+    else if (strcmp(env, "avx2") == 0)
+      limit = gpuNUFFT::SIMD_AVX2;
+    if (limit < level)
+      level = limit;
+  }
+  if (DEBUG)
+    printf("host SIMD level: %s\n", gpuNUFFT::getCpuSimdLevelName(level));
+  return level;
+}
+
+struct SimdDispatch
+{
+  SimdDispatch()
+    : supported(initSupportedLevel()), active(gpuNUFFT::SIMD_SCALAR),
+      axpy(axpyScalar), complexDot(complexDotScalar)
+  {
+    select(supported);
+  }
+
+  void select(gpuNUFFT::CpuSimdLevel level)
+  {
+    active = (level > supported) ? supported : level;
+    switch (active)
+    {
+#ifdef GPUNUFFT_X86_SIMD
+    case gpuNUFFT::SIMD_AVX512:
+      axpy = axpyAVX512;
+      complexDot = complexDotAVX512;
+      break;
+    case gpuNUFFT::SIMD_AVX2:
+      axpy = axpyAVX2;
+      complexDot = complexDotAVX2;
+      break;
+#endif
+    default:
+      axpy = axpyScalar;
+      complexDot = complexDotScalar;
+    }
+  }
+
+  gpuNUFFT::CpuSimdLevel supported;
+  gpuNUFFT::CpuSimdLevel active;
+  AxpyFunction axpy;
+  ComplexDotFunction complexDot;
+};
+
+SimdDispatch &getDispatch()
+{
+  static SimdDispatch dispatch;
+  return dispatch;
+}
+}
+
+gpuNUFFT::CpuSimdLevel gpuNUFFT::getSupportedCpuSimdLevel()
+{
+  return getDispatch().supported;
+}
+
+gpuNUFFT::CpuSimdLevel gpuNUFFT::getCpuSimdLevel()
+{
+  return getDispatch().active;
+}
+
+void gpuNUFFT::setCpuSimdLevel(CpuSimdLevel level)
+{
+  getDispatch().select(level);
+}
+
+const char *gpuNUFFT::getCpuSimdLevelName(CpuSimdLevel level)
+{
+  switch (level)
+  {
+  case SIMD_AVX512:
+    return "avx512";
+  case SIMD_AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+void gpuNUFFT::simdAxpy(DType *dst, const DType *src, DType weight, int count)
+{
+  getDispatch().axpy(dst, src, weight, count);
+}
+
+void gpuNUFFT::simdComplexDot(const DType *values, const DType *weights,
+                              int count, DType &re, DType &im)
+{
+  getDispatch().complexDot(values, weights, count, re, im);
+}
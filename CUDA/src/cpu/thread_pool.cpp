@@ -0,0 +1,274 @@
+#include "thread_pool.hpp"
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+
+namespace
+{
+/** \brief Set while the current thread executes tasks of a pool */
+thread_local bool insideParallelRegion = false;
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+unsigned getDefaultThreadCount()
+{
+  const char *env = getenv("GPUNUFFT_CPU_THREADS");
+  if (env != NULL)
+  {
+    int count = atoi(env);
+    if (count > 0)
+      return (unsigned)count;
+  }
+  unsigned hwThreads = std::thread::hardware_concurrency();
+  return hwThreads > 0 ? hwThreads : 1;
+}
+}
+
+gpuNUFFT::ThreadPool::ThreadPool(unsigned threadCount)
+  : threadCount(threadCount > 0 ? threadCount : getDefaultThreadCount()),
+    generation(0), shutdown(false), jobOpen(false), activeWorkers(0),
+    task(NULL), itemCount(0), nextItem(0), failed(false), stealing(false),
+    queues(this->threadCount), statistics(this->threadCount)
+{
+  if (DEBUG)
+    printf("starting thread pool with %u threads\n", this->threadCount);
+
+  for (unsigned t = 1; t < this->threadCount; t++)
+    workers.push_back(std::thread(&ThreadPool::workerLoop, this, t));
+}
+
+gpuNUFFT::ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    shutdown = true;
+  }
+  startCondition.notify_all();
+  for (size_t t = 0; t < workers.size(); t++)
+    workers[t].join();
+}
+
+gpuNUFFT::ThreadPool &gpuNUFFT::ThreadPool::getDefault()
+{
+  static ThreadPool defaultPool;
+  return defaultPool;
+}
+
+void gpuNUFFT::ThreadPool::resetThreadStatistics()
+{
+  std::lock_guard<std::mutex> submitLock(submitMutex);
+  statistics.assign(threadCount, ThreadStatistics());
+}
+
+void gpuNUFFT::ThreadPool::executeItem(IndType item, unsigned threadId)
+{
+  try
+  {
+    (*task)(item, threadId);
+  }
+  catch (...)
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (!failed.load())
+    {
+      failure = std::current_exception();
+      failed.store(true);
+    }
+  }
+}
+
+void gpuNUFFT::ThreadPool::processItems(unsigned threadId)
+{
+  IndType item;
+  while (!failed.load(std::memory_order_relaxed) &&
+         (item = nextItem.fetch_add(1, std::memory_order_relaxed)) <
+             itemCount)
+    executeItem(item, threadId);
+}
+
+bool gpuNUFFT::ThreadPool::takeItem(unsigned threadId, IndType &item,
+                                    bool &stolen)
+{
+  {
+    WorkQueue &own = queues[threadId];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.items.empty())
+    {
+      item = own.items.front();
+      own.items.pop_front();
+      stolen = false;
+      return true;
+    }
+  }
+
+  // no items are added during a job, thus all queues being empty means
+  // that the remaining items are already in progress
+  for (unsigned v = 1; v < threadCount; v++)
+  {
+    WorkQueue &victim = queues[(threadId + v) % threadCount];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.items.empty())
+    {
+      item = victim.items.back();
+      victim.items.pop_back();
+      stolen = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+void gpuNUFFT::ThreadPool::processQueuedItems(unsigned threadId)
+{
+  ThreadStatistics &job = queues[threadId].job;
+  IndType item;
+  bool stolen;
+  while (!failed.load(std::memory_order_relaxed) &&
+         takeItem(threadId, item, stolen))
+  {
+    Clock::time_point start = Clock::now();
+    executeItem(item, threadId);
+    job.busySeconds += secondsSince(start);
+    job.tasks++;
+    if (stolen)
+      job.stolenTasks++;
+  }
+}
+
+void gpuNUFFT::ThreadPool::workerLoop(unsigned threadId)
+{
+  unsigned long lastGeneration = 0;
+  insideParallelRegion = true;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(stateMutex);
+      while (!shutdown && generation == lastGeneration)
+        startCondition.wait(lock);
+      if (shutdown)
+        return;
+      lastGeneration = generation;
+      // job already finished by the remaining threads
+      if (!jobOpen)
+        continue;
+      activeWorkers++;
+    }
+
+    if (stealing)
+      processQueuedItems(threadId);
+    else
+      processItems(threadId);
+
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      activeWorkers--;
+    }
+    doneCondition.notify_all();
+  }
+}
+
+void gpuNUFFT::ThreadPool::parallelFor(IndType count, const Task &task)
+{
+  if (count == 0)
+    return;
+
+  // serial execution for nested calls, single items or single threaded pools
+  if (insideParallelRegion || count == 1 || workers.empty())
+  {
+    for (IndType item = 0; item < count; item++)
+      task(item, 0);
+    return;
+  }
+
+  runJob(count, task, false);
+}
+
+void gpuNUFFT::ThreadPool::parallelForStealing(IndType count,
+                                               const Task &task)
+{
+  if (count == 0)
+    return;
+
+  if (insideParallelRegion || count == 1 || workers.empty())
+  {
+    for (IndType item = 0; item < count; item++)
+      task(item, 0);
+    return;
+  }
+
+  runJob(count, task, true);
+}
+
+void gpuNUFFT::ThreadPool::runJob(IndType count, const Task &task,
+                                  bool stealing)
+{
+  std::lock_guard<std::mutex> submitLock(submitMutex);
+  if (stealing)
+  {
+    // the workers are idle, the queues need no locking here
+    for (unsigned t = 0; t < threadCount; t++)
+    {
+      queues[t].items.clear();
+      queues[t].job = ThreadStatistics();
+    }
+    for (IndType item = 0; item < count; item++)
+      queues[item % threadCount].items.push_back(item);
+  }
+
+  Clock::time_point start = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    this->task = &task;
+    this->itemCount = count;
+    this->nextItem.store(0);
+    this->failed.store(false);
+    this->failure = std::exception_ptr();
+    this->stealing = stealing;
+    jobOpen = true;
+    generation++;
+  }
+  startCondition.notify_all();
+
+  insideParallelRegion = true;
+  if (stealing)
+    processQueuedItems(0);
+  else
+    processItems(0);
+  insideParallelRegion = false;
+
+  std::exception_ptr error;
+  {
+    // all items are taken, workers waking up late must not join anymore
+    std::unique_lock<std::mutex> lock(stateMutex);
+    jobOpen = false;
+    while (activeWorkers > 0)
+      doneCondition.wait(lock);
+    error = failure;
+    failure = std::exception_ptr();
+    this->task = NULL;
+  }
+
+  if (stealing)
+  {
+    double jobSeconds = secondsSince(start);
+    for (unsigned t = 0; t < threadCount; t++)
+    {
+      const ThreadStatistics &job = queues[t].job;
+      statistics[t].tasks += job.tasks;
+      statistics[t].stolenTasks += job.stolenTasks;
+      statistics[t].busySeconds += job.busySeconds;
+      statistics[t].idleSeconds +=
+          std::max(0.0, jobSeconds - job.busySeconds);
+      // skipped items after a failure
+      queues[t].items.clear();
+    }
+  }
+
+  if (error)
+    std::rethrow_exception(error);
+}
@@ -0,0 +1,592 @@
+
+#include "cpuNUFFT_operator.hpp"
+#include "gpuNUFFT_cpu_fft.hpp"
+#include "gpuNUFFT_memory_planner.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+/** \brief Element count per work item of the coil interleaving */
+const IndType ELEMENTS_PER_TASK = 8192;
+
+/** \brief Execute f(begin, end) for consecutive blocks of [0, count) in
+ * parallel */
+template <typename Function>
+void parallelForRange(IndType count, gpuNUFFT::ThreadPool *threadPool,
+                      const Function &f)
+{
+  IndType taskCount = (count + ELEMENTS_PER_TASK - 1) / ELEMENTS_PER_TASK;
+  threadPool->parallelFor(taskCount, [&](IndType task, unsigned)
+                          {
+                            IndType begin = task * ELEMENTS_PER_TASK;
+                            f(begin,
+                              std::min(begin + ELEMENTS_PER_TASK, count));
+                          });
+}
+
+inline bool sameExtent(const gpuNUFFT::Dimensions &a,
+                       const gpuNUFFT::Dimensions &b)
+{
+  return a.width == b.width && a.height == b.height && a.depth == b.depth;
+}
+}
+
+gpuNUFFT::GpuNUFFTInfo *
+gpuNUFFT::CpuNUFFTOperator::initAndCopyGpuNUFFTInfo(int n_coils_cc)
+{
+  GpuNUFFTInfo *gi_host = initGpuNUFFTInfo(n_coils_cc);
+
+  gi_host->sectorsToProcess = sectorProcessingOrder.data != NULL
+                                 ? sectorProcessingOrder.count()
+                                 : gi_host->sector_count;
+
+  return gi_host;
+}
+
+gpuNUFFT::GpuNUFFTInfo *gpuNUFFT::CpuNUFFTOperator::updateHostInfo()
+{
+  initGpuNUFFTInfo(&hostInfo, 1);
+  hostInfo.sectorsToProcess = sectorProcessingOrder.data != NULL
+                                  ? sectorProcessingOrder.count()
+                                  : hostInfo.sector_count;
+  return &hostInfo;
+}
+
+bool gpuNUFFT::CpuNUFFTOperator::precomputeGriddingMatrix(size_t memoryBudget)
+{
+  GpuNUFFTInfo *gi_host = initAndCopyGpuNUFFTInfo(1);
+  bool fits = computeGriddingMatrixCPU(
+      griddingMatrix, this->kSpaceTraj.data, this->kernel.data,
+      this->sectorDataCount.data, this->getSectorCentersData(), gi_host,
+      memoryBudget, getThreadPool());
+  free(gi_host);
+
+  if (DEBUG)
+    printf("gridding matrix %s (%lu bytes)\n",
+           fits ? "precomputed" : "exceeds memory budget",
+           (unsigned long)griddingMatrix.getMemorySize());
+  return fits;
+}
+
+gpuNUFFT::Array<DType>
+gpuNUFFT::CpuNUFFTOperator::computeDeapodizationVectors()
+{
+  GpuNUFFTInfo *gi_host = initGpuNUFFTInfo(1);
+  Array<DType> vectors;
+  vectors.dim.length = imgDims.width + imgDims.height + imgDims.depth;
+  vectors.data = (DType *)malloc(vectors.count() * sizeof(DType));
+  computeDeapodizationVectorsCPU(this->kernel.data, gi_host, vectors.data);
+  free(gi_host);
+  return vectors;
+}
+
+void gpuNUFFT::CpuNUFFTOperator::adjConvolution(
+    DType2 *data_d, DType *crds_d, CufftType *gdata_d, DType *kernel_d,
+    IndType *sectors_d, IndType *sector_centers_d,
+    gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  if (hasGriddingMatrix())
+  {
+    performConvolutionCPU(data_d, griddingMatrix, gdata_d, sectors_d,
+                          sector_centers_d, this->sectorProcessingOrder.data,
+                          1, gi_host, getThreadPool(),
+                          &workspace.convolution);
+    return;
+  }
+  performConvolutionCPU(data_d, crds_d, gdata_d, kernel_d, sectors_d,
+                        sector_centers_d, this->sectorProcessingOrder.data, 1,
+                        gi_host, getThreadPool(), WRAP_GRID_BOUNDARY,
+                        &workspace.convolution);
+}
+
+void gpuNUFFT::CpuNUFFTOperator::forwardConvolution(
+    CufftType *data_d, DType *crds_d, CufftType *gdata_d, DType *kernel_d,
+    IndType *sectors_d, IndType *sector_centers_d,
+    gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  if (hasGriddingMatrix())
+  {
+    performForwardConvolutionCPU(data_d, griddingMatrix, gdata_d, gi_host,
+                                 getThreadPool());
+    return;
+  }
+  performForwardConvolutionCPU(
+      data_d, crds_d, gdata_d, kernel_d, sectors_d, sector_centers_d,
+      this->sectorProcessingOrder.data, 1, gi_host, getThreadPool(),
+      WRAP_GRID_BOUNDARY, NULL, &workspace.convolution);
+}
+
+void gpuNUFFT::CpuNUFFTOperator::adjConvolutionBatch(
+    DType2 *data, CufftType *gdata, IndType coilCount,
+    gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  if (hasGriddingMatrix())
+  {
+    performConvolutionCPU(data, griddingMatrix, gdata,
+                          this->sectorDataCount.data,
+                          this->getSectorCentersData(),
+                          this->sectorProcessingOrder.data, coilCount,
+                          gi_host, getThreadPool(), &workspace.convolution);
+    return;
+  }
+  performConvolutionCPU(data, this->kSpaceTraj.data, gdata, this->kernel.data,
+                        this->sectorDataCount.data,
+                        this->getSectorCentersData(),
+                        this->sectorProcessingOrder.data, coilCount, gi_host,
+                        getThreadPool(), WRAP_GRID_BOUNDARY,
+                        &workspace.convolution);
+}
+
+void gpuNUFFT::CpuNUFFTOperator::forwardConvolutionBatch(
+    CufftType *data, CufftType *gdata, IndType coilCount,
+    gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+  if (hasGriddingMatrix())
+  {
+    performForwardConvolutionCPU(data, griddingMatrix, gdata, coilCount,
+                                 gi_host, getThreadPool());
+    return;
+  }
+  performForwardConvolutionCPU(
+      data, this->kSpaceTraj.data, gdata, this->kernel.data,
+      this->sectorDataCount.data, this->getSectorCentersData(),
+      this->sectorProcessingOrder.data, coilCount, gi_host, getThreadPool(),
+      WRAP_GRID_BOUNDARY, NULL, &workspace.convolution);
+}
+
+IndType gpuNUFFT::CpuNUFFTOperator::selectCoilBatchSize(IndType n_coils)
+{
+  IndType batchSize = coilBatchSize;
+  if (batchSize == 0)
+  {
+    // the selection only changes with the parameters of the planner
+    CoilBatchSelection selection;
+    selection.coilCount = n_coils;
+    selection.dataCount = getDataCount();
+    selection.slotCount = dataIndices.count();
+    selection.orderCount = sectorProcessingOrder.count();
+    selection.threadCount = getThreadPool()->getThreadCount();
+    selection.densComp = applyDensComp();
+    selection.sensData = applySensData();
+    if (!(selection == coilBatchSelection))
+    {
+      // the plan arrays are resident, the budget limits the call buffers
+      MemoryPlanner planner = MemoryPlanner::forOperator(this);
+      selection.batchSize = planner.selectCoilBatch(
+          n_coils,
+          planner.getRequirements(0).planBytes + DEFAULT_COIL_BATCH_MEMORY);
+      coilBatchSelection = selection;
+    }
+    batchSize = coilBatchSelection.batchSize;
+  }
+  return std::max((IndType)1, std::min(batchSize, n_coils));
+}
+
+void gpuNUFFT::CpuNUFFTOperator::reserveWorkspace(IndType batch_size,
+                                                  GpuNUFFTInfo *gi_host)
+{
+  // buffers only grow, thus repeated calls do not allocate
+  IndType data_count = this->kSpaceTraj.count();
+  IndType grid_count = gi_host->grid_width_dim;
+  if (workspace.kspaceBatch.size() < data_count * batch_size)
+    workspace.kspaceBatch.resize(data_count * batch_size);
+  if (workspace.gridBatch.size() < grid_count * batch_size)
+    workspace.gridBatch.resize(grid_count * batch_size);
+  if (workspace.grid.size() < grid_count)
+    workspace.grid.resize(grid_count);
+
+  // the image supports of the pruned FFTs follow image and grid size
+  Dimensions gridDims = getGridDims();
+  if (!sameExtent(workspace.imgDims, this->imgDims) ||
+      !sameExtent(workspace.gridDims, gridDims))
+  {
+    workspace.supports[0] = computeImageSupportCPU(gi_host, false);
+    workspace.supports[1] = computeImageSupportCPU(gi_host, true);
+    workspace.imgDims = this->imgDims;
+    workspace.gridDims = gridDims;
+  }
+}
+
+void gpuNUFFT::CpuNUFFTOperator::applyFFTShift(CufftType *gdata,
+                                               FFTShiftDir shift_dir,
+                                               GpuNUFFTInfo *gi_host)
+{
+  // only allocated if the shifts are not folded into crop and padding
+  if (workspace.shiftGrid.size() < gi_host->grid_width_dim)
+    workspace.shiftGrid.resize(gi_host->grid_width_dim);
+  performFFTShiftCPU(gdata, shift_dir, getGridDims(), gi_host,
+                     getThreadPool(), workspace.shiftGrid.data());
+}
+
+size_t gpuNUFFT::CpuNUFFTOperator::getWorkspaceBytes() const
+{
+  return (workspace.kspaceBatch.capacity() + workspace.gridBatch.capacity() +
+          workspace.grid.capacity() + workspace.shiftGrid.capacity()) *
+             sizeof(CufftType) +
+         workspace.fft.getBytes() + workspace.convolution.getMemorySize();
+}
+
+void gpuNUFFT::CpuNUFFTOperator::releaseWorkspace()
+{
+  // assignment keeps the capacity of the vectors, swap releases it
+  Workspace().swap(workspace);
+}
+
+bool gpuNUFFT::CpuNUFFTOperator::adjointBatch(int batch_it,
+                                              IndType batch_count,
+                                              Array<CufftType> &imgData,
+                                              GpuNUFFTOutput gpuNUFFTOut,
+                                              GpuNUFFTInfo *gi_host)
+{
+  ThreadPool *pool = getThreadPool();
+  IndType imdata_count = this->imgDims.count();
+  IndType grid_count = gi_host->grid_width_dim;
+  CufftType *gdata_batch = workspace.gridBatch.data();
+  CufftType *gdata = workspace.grid.data();
+  const CpuFFTPlan &fftPlan = CpuFFTPlan::getPlan(getGridDims(), CUFFT_INVERSE);
+
+  CufftType zero;
+  zero.x = 0;
+  zero.y = 0;
+  std::fill(gdata_batch, gdata_batch + grid_count * batch_count, zero);
+
+  adjConvolutionBatch((DType2 *)workspace.kspaceBatch.data(), gdata_batch,
+                      batch_count, gi_host);
+
+  for (IndType c = 0; c < batch_count; c++)
+  {
+    int coil_it = batch_it + (int)c;
+    IndType im_coil_offset = coil_it * imdata_count;
+
+    CufftType *coilGrid = gpuNUFFTOut == CONVOLUTION
+                              ? imgData.data + coil_it * grid_count
+                              : gdata;
+    parallelForRange(grid_count, pool, [&](IndType begin, IndType end)
+                     {
+                       for (IndType g = begin; g < end; g++)
+                         coilGrid[g] = gdata_batch[g * batch_count + c];
+                     });
+
+    // get output (per coil)
+    if (gpuNUFFTOut == CONVOLUTION)
+      continue;
+
+    // the output of the FFT step is shifted explicitly
+    bool foldShift = foldFFTShift && gpuNUFFTOut != FFT;
+    if (!foldShift)
+      applyFFTShift(gdata, INVERSE, gi_host);
+    // only the cropped image is required
+    if (prunedFFT)
+      fftPlan.executePruned(gdata, workspace.supports[0],
+                            CpuFFTPlan::PRUNE_OUTPUT, pool, &workspace.fft);
+    else
+      fftPlan.execute(gdata, pool, &workspace.fft);
+    if (!foldShift)
+      applyFFTShift(gdata, INVERSE, gi_host);
+
+    if (gpuNUFFTOut == FFT)
+    {
+      if (DEBUG)
+        printf("stopping output after FFT step\n");
+      performCropCPU(gdata, imgData.data, gi_host, pool);
+      performFFTScalingCPU(imgData.data, gi_host->im_width_dim, gi_host,
+                           pool);
+      return false;
+    }
+
+    // crop, scaling, deapodization and coil summation into the (zeroed)
+    // output in a single pass, no summation is performed in absence of
+    // sensitity data
+    if (this->applySensData())
+      performCropDeapodizationCPU(gdata, imgData.data, this->deapo.data,
+                                  this->deapoVectors.data,
+                                  this->sens.data + im_coil_offset, foldShift,
+                                  gi_host, pool);
+    else
+      performCropDeapodizationCPU(gdata, imgData.data + im_coil_offset,
+                                  this->deapo.data, this->deapoVectors.data,
+                                  NULL, foldShift, gi_host, pool);
+  }  // iterate over coils of batch
+  return true;
+}
+
+void gpuNUFFT::CpuNUFFTOperator::forwardBatch(Array<DType2> imgData,
+                                              int batch_it,
+                                              IndType batch_count,
+                                              GpuNUFFTInfo *gi_host)
+{
+  ThreadPool *pool = getThreadPool();
+  IndType imdata_count = this->imgDims.count();
+  IndType grid_count = gi_host->grid_width_dim;
+  CufftType *gdata_batch = workspace.gridBatch.data();
+  CufftType *gdata = workspace.grid.data();
+  const CpuFFTPlan &fftPlan = CpuFFTPlan::getPlan(getGridDims(), CUFFT_FORWARD);
+
+  for (IndType c = 0; c < batch_count; c++)
+  {
+    IndType im_coil_offset = (batch_it + c) * imdata_count;
+
+    // perform automatically "repeating" of input image in case
+    // of existing sensitivity data
+    DType2 *imgCoilData = this->applySensData()
+                              ? imgData.data
+                              : imgData.data + im_coil_offset;
+    DType2 *sensCoilData =
+        this->applySensData() ? this->sens.data + im_coil_offset : NULL;
+
+    // sensitivity, apodization correction, FFT scaling and zero padding
+    // to the oversampled grid in a single pass
+    performDeapodizationPaddingCPU(imgCoilData, sensCoilData, gdata,
+                                   this->deapo.data, this->deapoVectors.data,
+                                   foldFFTShift, gi_host, pool);
+
+    // shift image to get correct zero frequency position
+    if (!foldFFTShift)
+      applyFFTShift(gdata, INVERSE, gi_host);
+    // the grid is zero outside of the padded image
+    if (prunedFFT)
+      fftPlan.executePruned(gdata, workspace.supports[1],
+                            CpuFFTPlan::PRUNE_INPUT, pool, &workspace.fft);
+    else
+      fftPlan.execute(gdata, pool, &workspace.fft);
+    if (!foldFFTShift)
+      applyFFTShift(gdata, FORWARD, gi_host);
+
+    parallelForRange(grid_count, pool, [&](IndType begin, IndType end)
+                     {
+                       for (IndType g = begin; g < end; g++)
+                         gdata_batch[g * batch_count + c] = gdata[g];
+                     });
+  }  // iterate over coils of batch
+
+  // convolution and resampling to non-standard trajectory
+  forwardConvolutionBatch(workspace.kspaceBatch.data(), gdata_batch,
+                          batch_count, gi_host);
+}
+
+// ----------------------------------------------------------------------------
+// performGpuNUFFTAdj: NUFFT^H on the host
+//
+// Same processing steps as gpuNUFFT::GpuNUFFTOperator::performGpuNUFFTAdj,
+// performed in host memory. The convolution grids a batch of coils at once,
+// the remaining steps are performed one coil at a time.
+//
+void gpuNUFFT::CpuNUFFTOperator::performGpuNUFFTAdj(
+    gpuNUFFT::Array<DType2> kspaceData, gpuNUFFT::Array<CufftType> &imgData,
+    GpuNUFFTOutput gpuNUFFTOut)
+{
+  if (DEBUG)
+  {
+    std::cout << "performing gpuNUFFT adjoint on host!!!" << std::endl;
+    std::cout << "dataCount: " << kSpaceTraj.count()
+              << " chnCount: " << kspaceData.dim.channels << std::endl;
+    std::cout << "imgCount: " << imgData.count()
+              << " gridWidth: " << this->getGridWidth() << std::endl;
+    std::cout << "apply density comp: " << this->applyDensComp() << std::endl;
+    std::cout << "apply sens data: " << this->applySensData() << std::endl;
+  }
+
+  IndType data_count = this->kSpaceTraj.count();
+  IndType coil_data_count = getDataCount();
+  int n_coils = (int)kspaceData.dim.channels;
+
+  ThreadPool *pool = getThreadPool();
+  GpuNUFFTInfo *gi_host = updateHostInfo();
+  IndType batch_size = selectCoilBatchSize(n_coils);
+  reserveWorkspace(batch_size, gi_host);
+
+  CufftType zero;
+  zero.x = 0;
+  zero.y = 0;
+
+  // the coils are summed up in the output
+  if (this->applySensData() && gpuNUFFTOut == DEAPODIZATION)
+    std::fill(imgData.data, imgData.data + this->imgDims.count(), zero);
+
+  // iterate over coil batches and compute result
+  CufftType *data_sorted = workspace.kspaceBatch.data();
+  for (int batch_it = 0; batch_it < n_coils; batch_it += batch_size)
+  {
+    IndType batch_count = std::min(batch_size, (IndType)(n_coils - batch_it));
+    if (DEBUG)
+      printf("process coils %d - %d / %d\n", batch_it + 1,
+             batch_it + (int)batch_count, n_coils);
+
+    // select data ordered and coil-interleaved and apply the density
+    // compensation, unused slots are zero
+    DType2 *batchData = kspaceData.data + batch_it * coil_data_count;
+    parallelForRange(
+        data_count, pool, [&](IndType begin, IndType end)
+        {
+          for (IndType i = begin; i < end; i++)
+          {
+            CufftType *sample = data_sorted + i * batch_count;
+            IndType index = dataIndices.data[i];
+            if (index == INVALID_DATA_INDEX)
+            {
+              std::fill(sample, sample + batch_count, zero);
+              continue;
+            }
+            DType dens =
+                this->applyDensComp() ? sqrt(this->dens.data[i]) : (DType)1;
+            for (IndType c = 0; c < batch_count; c++)
+            {
+              const DType2 &value = batchData[c * coil_data_count + index];
+              sample[c].x = value.x * dens;
+              sample[c].y = value.y * dens;
+            }
+          }
+        });
+
+    if (!adjointBatch(batch_it, batch_count, imgData, gpuNUFFTOut, gi_host))
+      break;
+  }  // iterate over coil batches
+}
+
+void gpuNUFFT::CpuNUFFTOperator::performGpuNUFFTAdj(
+    gpuNUFFT::GpuArray<DType2> /*kspaceData_gpu*/,
+    gpuNUFFT::GpuArray<CufftType> & /*imgData_gpu*/,
+    gpuNUFFT::GpuNUFFTOutput /*gpuNUFFTOut*/)
+{
+  throw std::runtime_error(
+      "CpuNUFFTOperator does not support data residing in GPU memory!");
+}
+
+// ----------------------------------------------------------------------------
+// performForwardGpuNUFFT: NUFFT on the host
+//
+// Same processing steps as
+// gpuNUFFT::GpuNUFFTOperator::performForwardGpuNUFFT, performed in host
+// memory. The convolution interpolates a batch of coils at once, the
+// remaining steps are performed one coil at a time.
+//
+void gpuNUFFT::CpuNUFFTOperator::performForwardGpuNUFFT(
+    gpuNUFFT::Array<DType2> imgData, gpuNUFFT::Array<CufftType> &kspaceData,
+    GpuNUFFTOutput /*gpuNUFFTOut*/)
+{
+  if (DEBUG)
+  {
+    std::cout << "performing forward gpuNUFFT on host!!!" << std::endl;
+    std::cout << "dataCount: " << kspaceData.count()
+              << " chnCount: " << kspaceData.dim.channels << std::endl;
+    std::cout << "imgCount: " << imgData.count()
+              << " gridWidth: " << this->getGridWidth() << std::endl;
+  }
+
+  IndType data_count = this->kSpaceTraj.count();
+  IndType coil_data_count = getDataCount();
+  int n_coils = (int)kspaceData.dim.channels;
+
+  ThreadPool *pool = getThreadPool();
+  GpuNUFFTInfo *gi_host = updateHostInfo();
+  IndType batch_size = selectCoilBatchSize(n_coils);
+  reserveWorkspace(batch_size, gi_host);
+
+  // iterate over coil batches and compute result
+  const CufftType *data_batch = workspace.kspaceBatch.data();
+  for (int batch_it = 0; batch_it < n_coils; batch_it += batch_size)
+  {
+    IndType batch_count = std::min(batch_size, (IndType)(n_coils - batch_it));
+    forwardBatch(imgData, batch_it, batch_count, gi_host);
+
+    // apply density compensation and write result in correct order back
+    // into output array
+    CufftType *batchData = kspaceData.data + batch_it * coil_data_count;
+    parallelForRange(
+        data_count, pool, [&](IndType begin, IndType end)
+        {
+          for (IndType i = begin; i < end; i++)
+          {
+            IndType index = dataIndices.data[i];
+            if (index == INVALID_DATA_INDEX)
+              continue;
+            const CufftType *sample = data_batch + i * batch_count;
+            DType dens =
+                this->applyDensComp() ? sqrt(this->dens.data[i]) : (DType)1;
+            for (IndType c = 0; c < batch_count; c++)
+            {
+              CufftType &value = batchData[c * coil_data_count + index];
+              value.x = sample[c].x * dens;
+              value.y = sample[c].y * dens;
+            }
+          }
+        });
+  }  // iterate over coil batches
+}
+
+void gpuNUFFT::CpuNUFFTOperator::performForwardGpuNUFFT(
+    gpuNUFFT::GpuArray<DType2> /*imgData_gpu*/,
+    gpuNUFFT::GpuArray<CufftType> & /*kspaceData_gpu*/,
+    GpuNUFFTOutput /*gpuNUFFTOut*/)
+{
+  throw std::runtime_error(
+      "CpuNUFFTOperator does not support data residing in GPU memory!");
+}
+
+// ----------------------------------------------------------------------------
+// performNormal: NUFFT^H W NUFFT on the host
+//
+// Forward and adjoint processing steps of a coil batch are performed back
+// to back, the interpolated k-space data of the batch stays in sorted and
+// coil-interleaved order in the workspace and is weighted in place.
+//
+void gpuNUFFT::CpuNUFFTOperator::performNormal(Array<DType2> imgData,
+                                               Array<CufftType> &normalData,
+                                               Array<DType> weights)
+{
+  if (weights.data != NULL && weights.count() != getDataCount())
+    throw std::invalid_argument(
+        "Weights do not match the amount of samples per coil!");
+
+  IndType data_count = this->kSpaceTraj.count();
+  int n_coils = this->applySensData() ? (int)this->sens.dim.channels
+                                      : (int)imgData.dim.channels;
+
+  ThreadPool *pool = getThreadPool();
+  GpuNUFFTInfo *gi_host = updateHostInfo();
+  IndType batch_size = selectCoilBatchSize(n_coils);
+  reserveWorkspace(batch_size, gi_host);
+
+  if (this->applySensData())
+  {
+    CufftType zero;
+    zero.x = 0;
+    zero.y = 0;
+    std::fill(normalData.data, normalData.data + this->imgDims.count(), zero);
+  }
+
+  CufftType *data_batch = workspace.kspaceBatch.data();
+  for (int batch_it = 0; batch_it < n_coils; batch_it += batch_size)
+  {
+    IndType batch_count = std::min(batch_size, (IndType)(n_coils - batch_it));
+    forwardBatch(imgData, batch_it, batch_count, gi_host);
+
+    // density compensation of forward and adjoint operation and weights,
+    // unused slots are zero
+    parallelForRange(
+        data_count, pool, [&](IndType begin, IndType end)
+        {
+          for (IndType i = begin; i < end; i++)
+          {
+            DType factor = 0;
+            if (dataIndices.data[i] != INVALID_DATA_INDEX)
+            {
+              factor = this->applyDensComp() ? this->dens.data[i] : (DType)1;
+              if (weights.data != NULL)
+                factor *= weights.data[dataIndices.data[i]];
+            }
+            for (IndType c = 0; c < batch_count; c++)
+            {
+              data_batch[i * batch_count + c].x *= factor;
+              data_batch[i * batch_count + c].y *= factor;
+            }
+          }
+        });
+
+    adjointBatch(batch_it, batch_count, normalData, DEAPODIZATION, gi_host);
+  }
+}
@@ -55,11 +55,11 @@ void assignSectorsGPU(gpuNUFFT::GpuNUFFTOperator* gpuNUFFTOp, gpuNUFFT::Array<DT
   IndType* assignedSectors_d;
 
   if (DEBUG)
-    printf("allocate and copy trajectory of size %d...\n",gpuNUFFTOp->getImageDimensionCount()*coordCnt);
+    printf("allocate and copy trajectory of size %llu...\n",(unsigned long long)gpuNUFFTOp->getImageDimensionCount()*coordCnt);
   allocateAndCopyToDeviceMem<DType>(&kSpaceTraj_d,kSpaceTraj.data,gpuNUFFTOp->getImageDimensionCount()*coordCnt);
 
   if (DEBUG)
-    printf("allocate and copy data of size %d...\n",coordCnt);
+    printf("allocate and copy data of size %llu...\n",(unsigned long long)coordCnt);
   allocateDeviceMem<IndType>(&assignedSectors_d,coordCnt);
 
   assignSectorsKernel<<<grid_dim,block_dim>>>(kSpaceTraj_d,
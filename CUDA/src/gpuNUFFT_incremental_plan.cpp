@@ -0,0 +1,278 @@
+#include "gpuNUFFT_incremental_plan.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+
+gpuNUFFT::IncrementalPlan::IncrementalPlan(CpuNUFFTOperator *gpuNUFFTOp,
+                                           DType slackRatio,
+                                           LoadBalancer *loadBalancer)
+  : gpuNUFFTOp(gpuNUFFTOp), slackRatio(std::max((DType)0, slackRatio)),
+    loadBalancer(loadBalancer), sampleCount(0), gapCount(0),
+    compactionCount(0)
+{
+  GpuNUFFTOperator *op = gpuNUFFTOp;
+  if (op->matlabSharedMem || op->planFile)
+    throw std::invalid_argument(
+        "Incremental updates require an operator owning its arrays!");
+
+  dimCount = gpuNUFFTOp->getImageDimensionCount();
+  sectorCount = gpuNUFFTOp->getGridSectorDims().count();
+
+  // all slots of the precomputed layout are in use
+  Array<IndType> dataIndices = gpuNUFFTOp->getDataIndices();
+  slotOfIndex.assign(gpuNUFFTOp->getDataCount(), INVALID_DATA_INDEX);
+  for (IndType slot = 0; slot < getSlotCount(); slot++)
+    if (dataIndices.data[slot] != INVALID_DATA_INDEX)
+    {
+      slotOfIndex[dataIndices.data[slot]] = slot;
+      sampleCount++;
+    }
+    else
+      gapCount++;
+
+  sectorFill.resize(sectorCount);
+  for (IndType sec = 0; sec < sectorCount; sec++)
+    sectorFill[sec] = sectorStart(sec + 1) - sectorStart(sec);
+
+  compact();
+}
+
+void gpuNUFFT::IncrementalPlan::appendSamples(Array<DType> &kSpaceTraj,
+                                              Array<DType> &densCompData)
+{
+  appendSamples(kSpaceTraj, densCompData, (IndType)slotOfIndex.size());
+}
+
+void gpuNUFFT::IncrementalPlan::appendSamples(Array<DType> &kSpaceTraj,
+                                              Array<DType> &densCompData,
+                                              IndType firstDataIndex)
+{
+  IndType batchCount = kSpaceTraj.count();
+  if ((densCompData.data != NULL) != gpuNUFFTOp->applyDensComp())
+    throw std::invalid_argument(
+        "Density compensation of the batch does not match the operator!");
+  if (densCompData.data != NULL && densCompData.count() != batchCount)
+    throw std::invalid_argument(
+        "Density compensation does not match the batch size!");
+  for (IndType i = 0; i < batchCount; i++)
+    if (firstDataIndex + i < slotOfIndex.size() &&
+        slotOfIndex[firstDataIndex + i] != INVALID_DATA_INDEX)
+      throw std::invalid_argument("Data index of the batch is in use!");
+  if (batchCount == 0)
+    return;
+
+  std::vector<IndType> batchSectors(batchCount);
+  assignSampleSectorsCPU(kSpaceTraj.data, 0, batchCount, batchCount,
+                         gpuNUFFTOp->getGridDims(),
+                         gpuNUFFTOp->getGridSectorDims(),
+                         gpuNUFFTOp->getSectorWidth(), &batchSectors[0],
+                         gpuNUFFTOp->getThreadPool());
+
+  if (firstDataIndex + batchCount > slotOfIndex.size())
+  {
+    slotOfIndex.resize(firstDataIndex + batchCount, INVALID_DATA_INDEX);
+    gpuNUFFTOp->setDataCount((IndType)slotOfIndex.size());
+  }
+
+  // free slots required per touched sector
+  std::map<IndType, IndType> batchLoads;
+  for (IndType i = 0; i < batchCount; i++)
+    batchLoads[batchSectors[i]]++;
+  bool fits = true;
+  for (std::map<IndType, IndType>::const_iterator it = batchLoads.begin();
+       it != batchLoads.end(); ++it)
+    if (sectorFill[it->first] + it->second >
+        sectorStart(it->first + 1) - sectorStart(it->first))
+      fits = false;
+
+  if (!fits)
+  {
+    relayout(kSpaceTraj.data, densCompData.data, &batchSectors[0], batchCount,
+             firstDataIndex);
+    // the processing order depends on the slot ranges of the sectors, which
+    // only change by a relayout
+    updateProcessingOrder();
+  }
+  else
+  {
+    IndType slotCount = getSlotCount();
+    DType *traj = gpuNUFFTOp->getKSpaceTraj().data;
+    IndType *dataIndices = gpuNUFFTOp->getDataIndices().data;
+    DType *dens = gpuNUFFTOp->getDens().data;
+    for (IndType i = 0; i < batchCount; i++)
+    {
+      IndType sec = batchSectors[i];
+      IndType slot = sectorStart(sec) + sectorFill[sec]++;
+      for (int d = 0; d < dimCount; d++)
+        traj[slot + d * slotCount] = kSpaceTraj.data[i + d * batchCount];
+      if (dens != NULL)
+        dens[slot] = densCompData.data[i];
+      dataIndices[slot] = firstDataIndex + i;
+      slotOfIndex[firstDataIndex + i] = slot;
+    }
+    sampleCount += batchCount;
+  }
+
+  gpuNUFFTOp->releaseGriddingMatrix();
+}
+
+void gpuNUFFT::IncrementalPlan::removeSamples(IndType firstDataIndex,
+                                              IndType count)
+{
+  IndType *dataIndices = gpuNUFFTOp->getDataIndices().data;
+  DType *dens = gpuNUFFTOp->getDens().data;
+  IndType end = std::min(firstDataIndex + count, (IndType)slotOfIndex.size());
+  for (IndType ind = firstDataIndex; ind < end; ind++)
+  {
+    IndType slot = slotOfIndex[ind];
+    if (slot == INVALID_DATA_INDEX)
+      continue;
+    // the coordinates stay inside of the sector, the slot is gridded with
+    // zero data
+    dataIndices[slot] = INVALID_DATA_INDEX;
+    if (dens != NULL)
+      dens[slot] = 0;
+    slotOfIndex[ind] = INVALID_DATA_INDEX;
+    sampleCount--;
+    gapCount++;
+  }
+
+  if (gapCount > slackRatio * sampleCount)
+    compact();
+}
+
+void gpuNUFFT::IncrementalPlan::compact()
+{
+  relayout(NULL, NULL, NULL, 0, 0);
+  updateProcessingOrder();
+  gpuNUFFTOp->releaseGriddingMatrix();
+}
+
+void gpuNUFFT::IncrementalPlan::relayout(const DType *batchTraj,
+                                         const DType *batchDens,
+                                         const IndType *batchSectors,
+                                         IndType batchCount,
+                                         IndType firstDataIndex)
+{
+  Array<DType> traj = gpuNUFFTOp->getKSpaceTraj();
+  Array<IndType> dataIndices = gpuNUFFTOp->getDataIndices();
+  Array<DType> dens = gpuNUFFTOp->getDens();
+  IndType *sectorDataCount = gpuNUFFTOp->getSectorDataCount().data;
+  IndType slotCount = getSlotCount();
+
+  std::vector<IndType> counts(sectorCount, 0);
+  for (IndType sec = 0; sec < sectorCount; sec++)
+  {
+    IndType end = sectorStart(sec) + sectorFill[sec];
+    for (IndType slot = sectorStart(sec); slot < end; slot++)
+      if (dataIndices.data[slot] != INVALID_DATA_INDEX)
+        counts[sec]++;
+  }
+  for (IndType i = 0; i < batchCount; i++)
+    counts[batchSectors[i]]++;
+
+  // empty sectors get no slots, the slack of the others is at least one
+  std::vector<IndType> starts(sectorCount + 1, 0);
+  for (IndType sec = 0; sec < sectorCount; sec++)
+  {
+    IndType slack = 0;
+    if (counts[sec] > 0)
+      slack = std::max((IndType)1,
+                       (IndType)std::ceil(counts[sec] * slackRatio));
+    starts[sec + 1] = starts[sec] + counts[sec] + slack;
+  }
+  IndType newSlotCount = starts[sectorCount];
+
+  Array<DType> newTraj;
+  newTraj.data = (DType *)malloc(dimCount * newSlotCount * sizeof(DType));
+  newTraj.dim.length = newSlotCount;
+  Array<IndType> newIndices;
+  newIndices.data = (IndType *)malloc(newSlotCount * sizeof(IndType));
+  newIndices.dim.length = newSlotCount;
+  Array<DType> newDens;
+  if (dens.data != NULL)
+  {
+    newDens.data = (DType *)malloc(newSlotCount * sizeof(DType));
+    newDens.dim.length = newSlotCount;
+  }
+
+  // samples in use keep their order, followed by the batch
+  std::vector<IndType> cursors(starts.begin(), starts.end() - 1);
+  for (IndType sec = 0; sec < sectorCount; sec++)
+  {
+    IndType end = sectorStart(sec) + sectorFill[sec];
+    for (IndType slot = sectorStart(sec); slot < end; slot++)
+    {
+      IndType ind = dataIndices.data[slot];
+      if (ind == INVALID_DATA_INDEX)
+        continue;
+      IndType pos = cursors[sec]++;
+      for (int d = 0; d < dimCount; d++)
+        newTraj.data[pos + d * newSlotCount] = traj.data[slot + d * slotCount];
+      if (newDens.data != NULL)
+        newDens.data[pos] = dens.data[slot];
+      newIndices.data[pos] = ind;
+      slotOfIndex[ind] = pos;
+    }
+  }
+  for (IndType i = 0; i < batchCount; i++)
+  {
+    IndType pos = cursors[batchSectors[i]]++;
+    for (int d = 0; d < dimCount; d++)
+      newTraj.data[pos + d * newSlotCount] = batchTraj[i + d * batchCount];
+    if (newDens.data != NULL)
+      newDens.data[pos] = batchDens[i];
+    newIndices.data[pos] = firstDataIndex + i;
+    slotOfIndex[firstDataIndex + i] = pos;
+  }
+
+  // free slots repeat the first sample of the sector, thus their kernel
+  // footprint stays inside of the sector
+  for (IndType sec = 0; sec < sectorCount; sec++)
+  {
+    sectorFill[sec] = counts[sec];
+    for (IndType pos = cursors[sec]; pos < starts[sec + 1]; pos++)
+    {
+      for (int d = 0; d < dimCount; d++)
+        newTraj.data[pos + d * newSlotCount] =
+            newTraj.data[starts[sec] + d * newSlotCount];
+      if (newDens.data != NULL)
+        newDens.data[pos] = 0;
+      newIndices.data[pos] = INVALID_DATA_INDEX;
+    }
+  }
+
+  std::copy(starts.begin(), starts.end(), sectorDataCount);
+  free(traj.data);
+  free(dataIndices.data);
+  free(dens.data);
+  gpuNUFFTOp->setKSpaceTraj(newTraj);
+  gpuNUFFTOp->setDataIndices(newIndices);
+  gpuNUFFTOp->setDens(newDens);
+  gpuNUFFTOp->setDataCount((IndType)slotOfIndex.size());
+
+  sampleCount += batchCount;
+  gapCount = 0;
+  compactionCount++;
+}
+
+void gpuNUFFT::IncrementalPlan::updateProcessingOrder()
+{
+  LoadBalancer *balancer =
+      (loadBalancer != NULL) ? loadBalancer : &defaultBalancer;
+  SectorGeometry geometry(gpuNUFFTOp->getKernelWidth(),
+                          gpuNUFFTOp->getSectorWidth(),
+                          gpuNUFFTOp->is3DProcessing());
+  std::vector<IndType2> processingOrder = balancer->computeProcessingOrder(
+      gpuNUFFTOp->getSectorDataCount().data, sectorCount, geometry);
+
+  Array<IndType2> sectorProcessingOrder;
+  sectorProcessingOrder.data =
+      (IndType2 *)malloc(processingOrder.size() * sizeof(IndType2));
+  sectorProcessingOrder.dim.length = processingOrder.size();
+  std::copy(processingOrder.begin(), processingOrder.end(),
+            sectorProcessingOrder.data);
+  free(gpuNUFFTOp->getSectorProcessingOrder().data);
+  gpuNUFFTOp->setSectorProcessingOrder(sectorProcessingOrder);
+}
@@ -0,0 +1,246 @@
+#include "gpuNUFFT_load_balancer.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <queue>
+#include <sstream>
+
+namespace
+{
+/** \brief Amount of chunks of a sector with load samples */
+inline IndType getChunkCount(IndType load, IndType chunkSize)
+{
+  return (load + chunkSize - 1) / chunkSize;
+}
+
+inline double power(IndType base, bool is3D)
+{
+  double result = (double)base * base;
+  return is3D ? result * base : result;
+}
+}
+
+gpuNUFFT::LoadBalancer::LoadBalancer(unsigned workerCount,
+                                     const SectorCostModel &costModel)
+  : workerCount(workerCount), costModel(costModel)
+{
+  if (this->workerCount == 0)
+    this->workerCount = ThreadPool::getDefault().getThreadCount();
+}
+
+double gpuNUFFT::LoadBalancer::estimateChunkCost(
+    IndType sampleCount, const SectorGeometry &geometry) const
+{
+  IndType padWidth = geometry.sectorWidth + 2 * (geometry.kernelWidth / 2);
+  return sampleCount * power(geometry.kernelWidth, geometry.is3D) *
+             costModel.kernelPointCost +
+         power(padWidth, geometry.is3D) * costModel.mergePointCost;
+}
+
+std::vector<IndType2> gpuNUFFT::LoadBalancer::computeProcessingOrder(
+    const IndType *sectorDataCount, IndType sectorCount,
+    const SectorGeometry &geometry, const uint64_t *sectorRanks)
+{
+  std::vector<IndType> sectorLoads;
+  for (IndType sec = 0; sec < sectorCount; sec++)
+    if (sectorDataCount[sec + 1] > sectorDataCount[sec])
+      sectorLoads.push_back(sectorDataCount[sec + 1] - sectorDataCount[sec]);
+
+  report = LoadBalancingReport();
+  report.workerCount = workerCount;
+  report.chunkSize =
+      std::max((IndType)1, selectChunkSize(sectorLoads, geometry));
+
+  // sectors by descending sample count, split into chunks of chunkSize
+  std::vector<IndPair> countPerSector;
+  for (IndType sec = 0; sec < sectorCount; sec++)
+    if (sectorDataCount[sec + 1] > sectorDataCount[sec])
+      countPerSector.push_back(
+          IndPair(sec, sectorDataCount[sec + 1] - sectorDataCount[sec]));
+  std::sort(countPerSector.begin(), countPerSector.end(),
+            std::greater<IndPair>());
+
+  std::vector<IndType2> chunks;
+  for (size_t i = 0; i < countPerSector.size(); i++)
+    for (IndType offset = 0; offset < countPerSector[i].second;
+         offset += report.chunkSize)
+      chunks.push_back(IndType2(countPerSector[i].first, offset));
+  sortChunks(chunks, sectorDataCount, geometry);
+
+  std::vector<double> chunkCosts(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++)
+  {
+    IndType load =
+        sectorDataCount[chunks[i].x + 1] - sectorDataCount[chunks[i].x];
+    chunkCosts[i] = estimateChunkCost(
+        std::min(report.chunkSize, load - chunks[i].y), geometry);
+  }
+
+  if (sectorRanks != NULL)
+  {
+    // descending cost class, ascending rank inside of each class
+    std::vector<std::pair<std::pair<int, uint64_t>, size_t> > keys(
+        chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+      keys[i] = std::make_pair(
+          std::make_pair(-(int)std::floor(std::log2(chunkCosts[i])),
+                         sectorRanks[chunks[i].x]),
+          i);
+    std::stable_sort(keys.begin(), keys.end());
+
+    std::vector<IndType2> rankedChunks(chunks.size());
+    std::vector<double> rankedCosts(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+      rankedChunks[i] = chunks[keys[i].second];
+      rankedCosts[i] = chunkCosts[keys[i].second];
+    }
+    chunks.swap(rankedChunks);
+    chunkCosts.swap(rankedCosts);
+  }
+
+  for (size_t i = 0; i < chunks.size(); i++)
+    report.totalCost += chunkCosts[i];
+  report.chunkCount = (IndType)chunks.size();
+  report.predictedMakespan = predictMakespan(chunkCosts);
+  return chunks;
+}
+
+void gpuNUFFT::LoadBalancer::sortChunks(std::vector<IndType2> &,
+                                        const IndType *,
+                                        const SectorGeometry &)
+{
+}
+
+double gpuNUFFT::LoadBalancer::predictMakespan(
+    const std::vector<double> &chunkCosts) const
+{
+  // the next chunk is taken by the worker with the lowest load
+  std::priority_queue<double, std::vector<double>, std::greater<double> >
+      workerLoads;
+  for (unsigned w = 0; w < workerCount; w++)
+    workerLoads.push(0.0);
+
+  double makespan = 0.0;
+  for (size_t i = 0; i < chunkCosts.size(); i++)
+  {
+    double load = workerLoads.top() + chunkCosts[i];
+    workerLoads.pop();
+    workerLoads.push(load);
+    makespan = std::max(makespan, load);
+  }
+  return makespan;
+}
+
+gpuNUFFT::FixedPayloadBalancer::FixedPayloadBalancer(
+    IndType chunkSize, unsigned workerCount, const SectorCostModel &costModel)
+  : LoadBalancer(workerCount, costModel), chunkSize(chunkSize)
+{
+}
+
+std::string gpuNUFFT::FixedPayloadBalancer::getDescription() const
+{
+  std::stringstream ss;
+  ss << "fixed payload " << chunkSize;
+  return ss.str();
+}
+
+IndType gpuNUFFT::FixedPayloadBalancer::selectChunkSize(
+    const std::vector<IndType> &, const SectorGeometry &)
+{
+  return chunkSize;
+}
+
+gpuNUFFT::CostModelBalancer::CostModelBalancer(
+    unsigned workerCount, const SectorCostModel &costModel)
+  : LoadBalancer(workerCount, costModel)
+{
+}
+
+std::string gpuNUFFT::CostModelBalancer::getDescription() const
+{
+  std::stringstream ss;
+  ss << "cost model " << getWorkerCount() << " workers, kernel point cost "
+     << getCostModel().kernelPointCost << ", merge point cost "
+     << getCostModel().mergePointCost;
+  return ss.str();
+}
+
+IndType gpuNUFFT::CostModelBalancer::selectChunkSize(
+    const std::vector<IndType> &sectorLoads, const SectorGeometry &geometry)
+{
+  // histogram of the samples per sector
+  std::map<IndType, IndType> histogram;
+  IndType maxLoad = 0;
+  for (size_t i = 0; i < sectorLoads.size(); i++)
+  {
+    histogram[sectorLoads[i]]++;
+    maxLoad = std::max(maxLoad, sectorLoads[i]);
+  }
+  if (maxLoad == 0)
+    return MAXIMUM_PAYLOAD;
+
+  double chunkOverhead = estimateChunkCost(0, geometry);
+  double sampleCost = estimateChunkCost(1, geometry) - chunkOverhead;
+  double totalSampleCost = 0.0;
+  for (std::map<IndType, IndType>::const_iterator it = histogram.begin();
+       it != histogram.end(); ++it)
+    totalSampleCost += (double)it->first * it->second * sampleCost;
+
+  // candidates from unsplit sectors down to single samples, ties keep the
+  // larger chunks
+  IndType bestChunkSize = maxLoad;
+  double bestBound = 0.0;
+  for (IndType chunkSize = maxLoad; chunkSize > 0;)
+  {
+    IndType chunkCount = 0;
+    for (std::map<IndType, IndType>::const_iterator it = histogram.begin();
+         it != histogram.end(); ++it)
+      chunkCount += it->second * getChunkCount(it->first, chunkSize);
+
+    double totalCost = totalSampleCost + chunkCount * chunkOverhead;
+    double bound = std::max(totalCost / getWorkerCount(),
+                            estimateChunkCost(chunkSize, geometry));
+    if (chunkSize == maxLoad || bound < bestBound)
+    {
+      bestBound = bound;
+      bestChunkSize = chunkSize;
+    }
+
+    // next smaller power of two
+    IndType next = 1;
+    while (next * 2 < chunkSize)
+      next *= 2;
+    chunkSize = (next < chunkSize) ? next : 0;
+  }
+  return bestChunkSize;
+}
+
+void gpuNUFFT::CostModelBalancer::sortChunks(std::vector<IndType2> &chunks,
+                                             const IndType *sectorDataCount,
+                                             const SectorGeometry &)
+{
+  // longest processing time first, the cost of a chunk grows with its
+  // sample count
+  IndType chunkSize = getReport().chunkSize;
+  std::vector<std::pair<IndType, size_t> > samples(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++)
+  {
+    IndType load =
+        sectorDataCount[chunks[i].x + 1] - sectorDataCount[chunks[i].x];
+    samples[i] = std::make_pair(std::min(chunkSize, load - chunks[i].y), i);
+  }
+  std::stable_sort(samples.begin(), samples.end(),
+                   [](const std::pair<IndType, size_t> &a,
+                      const std::pair<IndType, size_t> &b)
+                   {
+                     return a.first > b.first;
+                   });
+
+  std::vector<IndType2> sorted(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++)
+    sorted[i] = chunks[samples[i].second];
+  chunks.swap(sorted);
+}
@@ -0,0 +1,126 @@
+#include "gpuNUFFT_memory_planner.hpp"
+#include "gpuNUFFT_operator.hpp"
+#include "cpuNUFFT_operator.hpp"
+#include "balanced_operator.hpp"
+#include "gpuNUFFT_cpu_fft.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+inline IndType getSectorCount(IndType dim, IndType sectorWidth)
+{
+  return (IndType)std::ceil(static_cast<DType>(dim) / sectorWidth);
+}
+}
+
+gpuNUFFT::MemoryPlanner::MemoryPlanner(MemoryTarget target,
+                                       const Dimensions &imgDims, DType osf,
+                                       IndType sectorWidth, IndType dataCount,
+                                       bool useDens, bool useSens)
+  : target(target), imgDims(imgDims), slotCount(dataCount),
+    processingOrderCount(0), useDens(useDens), useSens(useSens),
+    useDeapo(false), threadCount(1)
+{
+  this->imgDims.channels = 0;
+  gridDims = this->imgDims * osf;
+
+  // same sector split as the GpuNUFFTOperatorFactory
+  Dimensions sectorDims;
+  sectorDims.width = getSectorCount(gridDims.width, sectorWidth);
+  sectorDims.height = getSectorCount(gridDims.height, sectorWidth);
+  sectorDims.depth = getSectorCount(gridDims.depth, sectorWidth);
+  sectorCount = sectorDims.count();
+}
+
+gpuNUFFT::MemoryPlanner
+gpuNUFFT::MemoryPlanner::forOperator(GpuNUFFTOperator *gpuNUFFTOp)
+{
+  MemoryTarget target =
+      gpuNUFFTOp->getType() == gpuNUFFT::CPU ? HOST_MEMORY : DEVICE_MEMORY;
+  MemoryPlanner planner(target, gpuNUFFTOp->getImageDims(),
+                        gpuNUFFTOp->getOsf(), gpuNUFFTOp->getSectorWidth(),
+                        gpuNUFFTOp->getDataCount(),
+                        gpuNUFFTOp->applyDensComp(),
+                        gpuNUFFTOp->applySensData());
+  planner.setSlotCount(gpuNUFFTOp->getDataIndices().count());
+  planner.setDeapodization(gpuNUFFTOp->getDeapodizationFunction().data !=
+                           NULL);
+
+  BalancedOperator *balancedOp = dynamic_cast<BalancedOperator *>(gpuNUFFTOp);
+  if (balancedOp != NULL)
+    planner.setProcessingOrderCount(
+        balancedOp->getSectorProcessingOrder().count());
+
+  if (target == HOST_MEMORY)
+    planner.setThreadCount(static_cast<CpuNUFFTOperator *>(gpuNUFFTOp)
+                               ->getThreadPool()
+                               ->getThreadCount());
+  return planner;
+}
+
+gpuNUFFT::MemoryRequirements
+gpuNUFFT::MemoryPlanner::getRequirements(IndType coilBatch) const
+{
+  int dimCount = imgDims.depth > 0 ? 3 : 2;
+  Dimensions img = imgDims;
+  Dimensions grid = gridDims;
+  size_t imgCount = img.count();
+  size_t gridCount = grid.count();
+
+  MemoryRequirements req;
+  req.planBytes = (size_t)slotCount * dimCount * sizeof(DType) +
+                  (size_t)slotCount * sizeof(IndType) +
+                  (size_t)(sectorCount + 1) * sizeof(IndType) +
+                  (size_t)sectorCount * dimCount * sizeof(IndType) +
+                  (size_t)processingOrderCount * sizeof(IndType2);
+  if (useDens)
+    req.planBytes += (size_t)slotCount * sizeof(DType);
+
+  if (target == DEVICE_MEMORY)
+  {
+    if (useDeapo)
+      req.planBytes += imgCount * sizeof(DType);
+    req.kspaceBytes = (size_t)coilBatch * slotCount * sizeof(DType2);
+    req.gridBytes = (size_t)coilBatch * gridCount * sizeof(CufftType);
+    req.imageBytes = (size_t)coilBatch * imgCount * sizeof(CufftType);
+    req.fftScratchBytes = gridCount * sizeof(CufftType);
+    if (useSens)
+      req.sensBytes = (size_t)coilBatch * imgCount * sizeof(DType2) +
+                      imgCount * sizeof(CufftType);
+  }
+  else
+  {
+    // separable deapodization vectors
+    req.planBytes += (size_t)(imgDims.width + imgDims.height +
+                              imgDims.depth) *
+                     sizeof(DType);
+    // workspace of the operator: batched buffers of the convolution plus
+    // the single coil grid of the FFT, the fused image stages need no image
+    // buffer and sum the coils in the output
+    req.kspaceBytes = (size_t)coilBatch * slotCount * sizeof(DType2);
+    req.gridBytes = (size_t)(coilBatch + 1) * gridCount * sizeof(CufftType);
+    IndType maxAxis = std::max(std::max(gridDims.width, gridDims.height),
+                               gridDims.depth);
+    req.fftScratchBytes = (size_t)threadCount * 4 * maxAxis *
+                          CpuFFTPlan::LANES * sizeof(DType);
+  }
+  return req;
+}
+
+IndType gpuNUFFT::MemoryPlanner::selectCoilBatch(IndType coilCnt,
+                                                 size_t capacity) const
+{
+  // the requirements grow with the batch, bisect the largest fitting one
+  IndType lower = 0;
+  IndType upper = coilCnt;
+  while (lower < upper)
+  {
+    IndType batch = upper - (upper - lower) / 2;
+    if (getRequirements(batch).getTotalBytes() <= capacity)
+      lower = batch;
+    else
+      upper = batch - 1;
+  }
+  return lower;
+}
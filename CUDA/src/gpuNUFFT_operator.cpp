@@ -4,6 +4,7 @@
 #include "cufft_config.hpp"
 #include "cuda_utils.hpp"
 #include "precomp_kernels.hpp"
+#include "gpuNUFFT_memory_planner.hpp"
 
 #include <iostream>
 #include <algorithm>
@@ -54,8 +55,14 @@ gpuNUFFT::GpuNUFFTOperator::initGpuNUFFTInfo(int n_coils_cc)
 {
   gpuNUFFT::GpuNUFFTInfo *gi_host =
       (gpuNUFFT::GpuNUFFTInfo *)malloc(sizeof(gpuNUFFT::GpuNUFFTInfo));
+  initGpuNUFFTInfo(gi_host, n_coils_cc);
+  return gi_host;
+}
 
-  gi_host->data_count = (int)this->kSpaceTraj.count();
+void gpuNUFFT::GpuNUFFTOperator::initGpuNUFFTInfo(GpuNUFFTInfo *gi_host,
+                                                  int n_coils_cc)
+{
+  gi_host->data_count = this->kSpaceTraj.count();
   gi_host->sector_count = (int)this->gridSectorDims.count();
   gi_host->sector_width = (int)sectorDims.width;
 
@@ -63,11 +70,11 @@ gpuNUFFT::GpuNUFFTOperator::initGpuNUFFTInfo(int n_coils_cc)
   gi_host->kernel_widthSquared = (int)(this->kernelWidth * this->kernelWidth);
   gi_host->kernel_count = (int)this->kernel.count();
 
-  gi_host->grid_width_dim = (int)this->getGridDims().count();
+  gi_host->grid_width_dim = this->getGridDims().count();
   gi_host->grid_width_offset =
       (int)(floor(this->getGridDims().width / (DType)2.0));
 
-  gi_host->im_width_dim = (int)imgDims.count();
+  gi_host->im_width_dim = imgDims.count();
   gi_host->im_width_offset.x = (int)(floor(imgDims.width / (DType)2.0));
   gi_host->im_width_offset.y = (int)(floor(imgDims.height / (DType)2.0));
   gi_host->im_width_offset.z = (int)(floor(imgDims.depth / (DType)2.0));
@@ -141,7 +148,6 @@ gpuNUFFT::GpuNUFFTOperator::initGpuNUFFTInfo(int n_coils_cc)
   gi_host->is2Dprocessing = this->is2DProcessing();
 
   gi_host->n_coils_cc = n_coils_cc;
-  return gi_host;
 }
 
 gpuNUFFT::GpuNUFFTInfo *
@@ -211,34 +217,35 @@ void gpuNUFFT::GpuNUFFTOperator::initDeviceMemory(int n_coils, int n_coils_cc)
   gi_host = initAndCopyGpuNUFFTInfo(n_coils_cc);
   this->allocatedCoils = n_coils_cc;
 
-  int data_count = (int)this->kSpaceTraj.count();
+  IndType data_count = this->kSpaceTraj.count();
   IndType imdata_count = this->imgDims.count();
   int sector_count = (int)this->gridSectorDims.count();
 
   if (DEBUG)
-    printf("allocate and copy data indices of size %d...\n",
-           dataIndices.count());
+    printf("allocate and copy data indices of size %llu...\n",
+           (unsigned long long)dataIndices.count());
   allocateAndCopyToDeviceMem<IndType>(&data_indices_d, dataIndices.data,
                                       dataIndices.count());
 
   if (DEBUG)
-    printf("allocate and copy data of size %d...\n", data_count * n_coils_cc);
+    printf("allocate and copy data of size %llu...\n",
+           (unsigned long long)data_count * n_coils_cc);
   allocateDeviceMem<DType2>(&data_sorted_d, data_count * n_coils_cc);
 
   if (DEBUG)
-    printf("allocate and copy gdata of size %d...\n",
-           gi_host->grid_width_dim * n_coils_cc);
+    printf("allocate and copy gdata of size %llu...\n",
+           (unsigned long long)gi_host->grid_width_dim * n_coils_cc);
   allocateDeviceMem<CufftType>(&gdata_d, gi_host->grid_width_dim * n_coils_cc);
 
   if (DEBUG)
-    printf("allocate and copy coords of size %d...\n",
-           getImageDimensionCount() * data_count);
+    printf("allocate and copy coords of size %llu...\n",
+           (unsigned long long)getImageDimensionCount() * data_count);
   allocateAndCopyToDeviceMem<DType>(&crds_d, this->kSpaceTraj.data,
                                     getImageDimensionCount() * data_count);
 
   if (DEBUG)
-    printf("allocate and copy kernel in const memory of size %d...\n",
-           this->kernel.count());
+    printf("allocate and copy kernel in const memory of size %llu...\n",
+           (unsigned long long)this->kernel.count());
 
   initLookupTable();
 
@@ -258,8 +265,8 @@ void gpuNUFFT::GpuNUFFTOperator::initDeviceMemory(int n_coils, int n_coils_cc)
   if (this->applyDensComp())
   {
     if (DEBUG)
-      printf("allocate and copy density compensation of size %d...\n",
-             data_count);
+      printf("allocate and copy density compensation of size %llu...\n",
+             (unsigned long long)data_count);
     allocateAndCopyToDeviceMem<DType>(&density_comp_d, this->dens.data,
                                       data_count);
   }
@@ -267,7 +274,8 @@ void gpuNUFFT::GpuNUFFTOperator::initDeviceMemory(int n_coils, int n_coils_cc)
   if (this->applySensData())
   {
     if (DEBUG)
-      printf("allocate sens data of size %d...\n", imdata_count * n_coils_cc);
+      printf("allocate sens data of size %llu...\n",
+             (unsigned long long)imdata_count * n_coils_cc);
     allocateDeviceMem<DType2>(&sens_d, imdata_count * n_coils_cc);
   }
 
@@ -275,7 +283,8 @@ void gpuNUFFT::GpuNUFFTOperator::initDeviceMemory(int n_coils, int n_coils_cc)
   if (this->deapo.data)
   {
     if (DEBUG)
-      printf("allocate precomputed deapofunction of size %d...\n", imdata_count);
+      printf("allocate precomputed deapofunction of size %llu...\n",
+             (unsigned long long)imdata_count);
     allocateAndCopyToDeviceMem<DType>(&deapo_d, this->deapo.data, imdata_count);
   }
   if (DEBUG)
@@ -283,9 +292,10 @@ void gpuNUFFT::GpuNUFFTOperator::initDeviceMemory(int n_coils, int n_coils_cc)
 
   // Inverse fft plan and execution
   if (DEBUG)
-    printf("creating cufft plan with %d,%d,%d dimensions\n",
-           DEFAULT_VALUE(gi_host->gridDims.z), gi_host->gridDims.y,
-           gi_host->gridDims.x);
+    printf("creating cufft plan with %llu,%llu,%llu dimensions\n",
+           (unsigned long long)DEFAULT_VALUE(gi_host->gridDims.z),
+           (unsigned long long)gi_host->gridDims.y,
+           (unsigned long long)gi_host->gridDims.x);
   cufftResult res = cufftPlan3d(
       &fft_plan, (int)DEFAULT_VALUE(gi_host->gridDims.z),
       (int)gi_host->gridDims.y, (int)gi_host->gridDims.x, CufftTransformType);
@@ -324,32 +334,25 @@ void gpuNUFFT::GpuNUFFTOperator::freeDeviceMemory()
 }
 
 int gpuNUFFT::GpuNUFFTOperator::computePossibleConcurrentCoilCount(
-    int n_coils, gpuNUFFT::Dimensions kSpaceDataDim)
+    int n_coils)
 {
   size_t free_mem = 0;
   size_t total_mem = 0;
   cudaMemGetInfo(&free_mem, &total_mem);
 
-  int possibleCoilCount = n_coils;
-
-  // estimated memory required per coil
-  float requiredMemoryPerCoil =
-      kSpaceDataDim.length * 8.0 * 2.0 +
-      this->imgDims.width * this->imgDims.height * 8.0 * 2.0 +
-      this->getGridDims().width * this->getGridDims().height * 8.0;
-
-  while ((free_mem / (possibleCoilCount * requiredMemoryPerCoil)) < 1.0 &&
-         possibleCoilCount-- > 1)
-    ;
+  // plan arrays already uploaded are part of the available memory
+  MemoryPlanner planner = MemoryPlanner::forOperator(this);
+  size_t capacity = free_mem;
+  if (gpuMemAllocated)
+    capacity += planner.getRequirements(0).planBytes;
 
-  // if (DEBUG)
-  // printf("Free memory: %lu - possible "
-  //        "coils: %d - required "
-  //        "coil memory: %lu\n",
-  //        free_mem, possibleCoilCount,
-  //        (unsigned)(possibleCoilCount * requiredMemoryPerCoil));
+  int possibleCoilCount =
+      (int)planner.selectCoilBatch((IndType)n_coils, capacity);
+  if (DEBUG)
+    printf("Free memory: %lu - possible coils: %d\n",
+           (unsigned long)free_mem, possibleCoilCount);
 
-  return possibleCoilCount;
+  return std::max(possibleCoilCount, 1);
 }
 
 void gpuNUFFT::GpuNUFFTOperator::updateConcurrentCoilCount(int coil_it,
@@ -386,17 +389,16 @@ void gpuNUFFT::GpuNUFFTOperator::performGpuNUFFTAdj(
 
   showMemoryInfo();
 
-  int data_count = (int)this->kSpaceTraj.count();
+  IndType data_count = this->kSpaceTraj.count();
   int n_coils = (int)kspaceData_gpu.dim.channels;
   IndType imdata_count = this->imgDims.count();
 
   // more than 2 coil sets are not sensible to reconstruct in one
   // adjoint kernel call , since the used shared memory is limited
-  int n_coils_cc = this->is2DProcessing()
-                       ? std::min(this->computePossibleConcurrentCoilCount(
-                                      n_coils, kspaceData_gpu.dim),
-                                  2)
-                       : 1;
+  int n_coils_cc =
+      this->is2DProcessing()
+          ? std::min(this->computePossibleConcurrentCoilCount(n_coils), 2)
+          : 1;
   if (DEBUG)
     printf("Computing %d coils concurrently.\n", n_coils_cc);
 
@@ -406,7 +408,8 @@ void gpuNUFFT::GpuNUFFTOperator::performGpuNUFFTAdj(
   if (this->applySensData())
   {
     if (DEBUG)
-      printf("allocate and copy temp imdata of size %d...\n", imdata_count);
+      printf("allocate and copy temp imdata of size %llu...\n",
+             (unsigned long long)imdata_count);
     allocateDeviceMem<CufftType>(&imdata_sum_d, imdata_count);
     cudaMemset(imdata_sum_d, 0, imdata_count * sizeof(CufftType));
   }
@@ -419,8 +422,8 @@ void gpuNUFFT::GpuNUFFTOperator::performGpuNUFFTAdj(
   // iterate over coils and compute result
   for (int coil_it = 0; coil_it < n_coils; coil_it += n_coils_cc)
   {
-    int im_coil_offset = coil_it * imdata_count;  // gi_host->width_dim;
-    int data_coil_offset = coil_it * data_count;
+    IndType im_coil_offset = coil_it * imdata_count;  // gi_host->width_dim;
+    IndType data_coil_offset = coil_it * data_count;
 
     this->updateConcurrentCoilCount(coil_it, n_coils, n_coils_cc);
 
@@ -629,17 +632,16 @@ void gpuNUFFT::GpuNUFFTOperator::performGpuNUFFTAdj(
 
   showMemoryInfo();
 
-  int data_count = (int)this->kSpaceTraj.count();
+  IndType data_count = this->kSpaceTraj.count();
   int n_coils = (int)kspaceData.dim.channels;
   IndType imdata_count = this->imgDims.count();
 
   // more than 2 coil sets are not sensible to reconstruct in one
   // adjoint kernel call , since the used shared memory is limited
-  int n_coils_cc = this->is2DProcessing()
-                       ? std::min(this->computePossibleConcurrentCoilCount(
-                                      n_coils, kspaceData.dim),
-                                  2)
-                       : 1;
+  int n_coils_cc =
+      this->is2DProcessing()
+          ? std::min(this->computePossibleConcurrentCoilCount(n_coils), 2)
+          : 1;
 
   if (DEBUG)
     printf("Computing %d coils concurrently.\n", n_coils_cc);
@@ -648,20 +650,22 @@ void gpuNUFFT::GpuNUFFTOperator::performGpuNUFFTAdj(
   DType2 *data_d;
 
   if (DEBUG)
-    printf("allocate data of size %d...\n", data_count * n_coils_cc);
+    printf("allocate data of size %llu...\n",
+           (unsigned long long)data_count * n_coils_cc);
   allocateDeviceMem<DType2>(&data_d, data_count * n_coils_cc);
 
   CufftType *imdata_d, *imdata_sum_d = NULL;
 
   if (DEBUG)
-    printf("allocate and copy imdata of size %d...\n",
-           imdata_count * n_coils_cc);
+    printf("allocate and copy imdata of size %llu...\n",
+           (unsigned long long)imdata_count * n_coils_cc);
   allocateDeviceMem<CufftType>(&imdata_d, imdata_count * n_coils_cc);
 
   if (this->applySensData())
   {
     if (DEBUG)
-      printf("allocate and copy temp imdata of size %d...\n", imdata_count);
+      printf("allocate and copy temp imdata of size %llu...\n",
+             (unsigned long long)imdata_count);
     allocateDeviceMem<CufftType>(&imdata_sum_d, imdata_count);
     cudaMemset(imdata_sum_d, 0, imdata_count * sizeof(CufftType));
   }
@@ -678,8 +682,8 @@ void gpuNUFFT::GpuNUFFTOperator::performGpuNUFFTAdj(
     if (DEBUG)
       printf("process coil no %d / %d (%d concurrently)\n", coil_it + 1,
              n_coils, n_coils_cc);
-    unsigned data_coil_offset = coil_it * data_count;
-    unsigned im_coil_offset = coil_it * imdata_count;  // gi_host->width_dim;
+    IndType data_coil_offset = coil_it * data_count;
+    IndType im_coil_offset = coil_it * imdata_count;  // gi_host->width_dim;
 
     this->updateConcurrentCoilCount(coil_it, n_coils, n_coils_cc);
 
@@ -880,15 +884,14 @@ void gpuNUFFT::GpuNUFFTOperator::performForwardGpuNUFFT(
   if (debugTiming)
     startTiming();
 
-  int data_count = (int)this->kSpaceTraj.count();
+  IndType data_count = this->kSpaceTraj.count();
   int n_coils = (int)kspaceData_gpu.dim.channels;
   IndType imdata_count = this->imgDims.count();
 
-  int n_coils_cc = this->is2DProcessing()
-                       ? std::min(this->computePossibleConcurrentCoilCount(
-                                      n_coils, kspaceData_gpu.dim),
-                                  16)
-                       : 1;
+  int n_coils_cc =
+      this->is2DProcessing()
+          ? std::min(this->computePossibleConcurrentCoilCount(n_coils), 16)
+          : 1;
 
   if (DEBUG)
     printf("Computing %d coils concurrently.\n", n_coils_cc);
@@ -899,8 +902,8 @@ void gpuNUFFT::GpuNUFFTOperator::performForwardGpuNUFFT(
   DType2 *imdata_d = NULL;
   CufftType *data_d = NULL;
   if (DEBUG)
-    printf("allocate and copy imdata of size %d...\n",
-           imdata_count * n_coils_cc);
+    printf("allocate and copy imdata of size %llu...\n",
+           (unsigned long long)imdata_count * n_coils_cc);
   allocateDeviceMem<DType2>(&imdata_d, imdata_count * n_coils_cc);
 
   if (debugTiming)
@@ -911,8 +914,8 @@ void gpuNUFFT::GpuNUFFTOperator::performForwardGpuNUFFT(
   // iterate over coils and compute result
   for (int coil_it = 0; coil_it < n_coils; coil_it += n_coils_cc)
   {
-    int data_coil_offset = coil_it * data_count;
-    int im_coil_offset = coil_it * (int)imdata_count;
+    IndType data_coil_offset = coil_it * data_count;
+    IndType im_coil_offset = coil_it * imdata_count;
 
     data_d = kspaceData_gpu.data + data_coil_offset;
 
@@ -1077,15 +1080,14 @@ void gpuNUFFT::GpuNUFFTOperator::performForwardGpuNUFFT(
   if (debugTiming)
     startTiming();
 
-  int data_count = (int)this->kSpaceTraj.count();
+  IndType data_count = this->kSpaceTraj.count();
   int n_coils = (int)kspaceData.dim.channels;
   IndType imdata_count = this->imgDims.count();
 
-  int n_coils_cc = this->is2DProcessing()
-                       ? std::min(this->computePossibleConcurrentCoilCount(
-                                      n_coils, kspaceData.dim),
-                                  16)
-                       : 1;
+  int n_coils_cc =
+      this->is2DProcessing()
+          ? std::min(this->computePossibleConcurrentCoilCount(n_coils), 16)
+          : 1;
   if (DEBUG)
     printf("Computing %d coils concurrently.\n", n_coils_cc);
 
@@ -1094,12 +1096,13 @@ void gpuNUFFT::GpuNUFFTOperator::performForwardGpuNUFFT(
   CufftType *data_d;
 
   if (DEBUG)
-    printf("allocate and copy imdata of size %d...\n",
-           imdata_count * n_coils_cc);
+    printf("allocate and copy imdata of size %llu...\n",
+           (unsigned long long)imdata_count * n_coils_cc);
   allocateDeviceMem<DType2>(&imdata_d, imdata_count * n_coils_cc);
 
   if (DEBUG)
-    printf("allocate and copy data of size %d...\n", data_count * n_coils_cc);
+    printf("allocate and copy data of size %llu...\n",
+           (unsigned long long)data_count * n_coils_cc);
   allocateDeviceMem<CufftType>(&data_d, data_count * n_coils_cc);
 
   // cuda mem allocation
@@ -1113,8 +1116,8 @@ void gpuNUFFT::GpuNUFFTOperator::performForwardGpuNUFFT(
   // iterate over coils and compute result
   for (int coil_it = 0; coil_it < n_coils; coil_it += n_coils_cc)
   {
-    int data_coil_offset = coil_it * data_count;
-    int im_coil_offset = coil_it * (int)imdata_count;
+    IndType data_coil_offset = coil_it * data_count;
+    IndType im_coil_offset = coil_it * imdata_count;
 
     this->updateConcurrentCoilCount(coil_it, n_coils, n_coils_cc);
 
@@ -1235,6 +1238,7 @@ gpuNUFFT::GpuNUFFTOperator::performForwardGpuNUFFT(Array<DType2> imgData,
 {
   gpuNUFFT::Array<CufftType> kspaceData;
   kspaceData.dim = this->kSpaceTraj.dim;
+  kspaceData.dim.length = getDataCount();
 
   if (this->applySensData())
     kspaceData.dim.channels = this->sens.dim.channels;
@@ -1242,7 +1246,7 @@ gpuNUFFT::GpuNUFFTOperator::performForwardGpuNUFFT(Array<DType2> imgData,
     kspaceData.dim.channels = imgData.dim.channels;
 
   kspaceData.data = (CufftType *)calloc(
-      this->kSpaceTraj.count() * kspaceData.dim.channels, sizeof(CufftType));
+      getDataCount() * kspaceData.dim.channels, sizeof(CufftType));
 
   performForwardGpuNUFFT(imgData, kspaceData, gpuNUFFTOut);
 
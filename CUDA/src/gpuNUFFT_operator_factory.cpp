@@ -8,6 +8,15 @@
 #include <sstream>
 #include "precomp_kernels.hpp"
 #include <limits>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+/** \brief Minimum amount of samples buffered per bucket by createPlanFile,
+ * bounds the amount of buckets for small budgets */
+const IndType MIN_BUCKET_CAPACITY = 256;
+}
 
 void gpuNUFFT::GpuNUFFTOperatorFactory::setUseTextures(bool useTextures)
 {
@@ -19,6 +28,76 @@ void gpuNUFFT::GpuNUFFTOperatorFactory::setBalanceWorkload(bool balanceWorkload)
   this->balanceWorkload = balanceWorkload;
 }
 
+void gpuNUFFT::GpuNUFFTOperatorFactory::setUseGriddingMatrix(
+    bool useGriddingMatrix, size_t memoryBudget)
+{
+  this->useGriddingMatrix = useGriddingMatrix;
+  this->griddingMatrixBudget = memoryBudget;
+}
+
+void gpuNUFFT::GpuNUFFTOperatorFactory::setPlanCache(PlanCache *planCache)
+{
+  this->planCache = planCache;
+}
+
+void gpuNUFFT::GpuNUFFTOperatorFactory::setLoadBalancer(
+    LoadBalancer *loadBalancer)
+{
+  this->loadBalancer = loadBalancer;
+}
+
+void gpuNUFFT::GpuNUFFTOperatorFactory::setSpaceFillingCurve(
+    SpaceFillingCurve curve)
+{
+  this->spaceFillingCurve = curve;
+}
+
+std::string gpuNUFFT::GpuNUFFTOperatorFactory::computePlanKey(
+    Array<DType> &kSpaceTraj, Array<DType> &densCompData,
+    const IndType &kernelWidth, const IndType &sectorWidth, const DType &osf,
+    Dimensions &imgDims)
+{
+  IndType coordCnt = kSpaceTraj.dim.count();
+  size_t dimCount = imgDims.depth > 0 ? 3 : 2;
+
+  PlanKey key;
+  key.add(PLAN_FILE_VERSION);
+  key.add((uint32_t)getOperatorType());
+  key.add(kernelWidth);
+  key.add(sectorWidth);
+  key.add(osf);
+  key.add(imgDims.width);
+  key.add(imgDims.height);
+  key.add(imgDims.depth);
+  key.add(kSpaceTraj.data, dimCount * coordCnt * sizeof(DType));
+  key.add(densCompData.data != NULL);
+  if (densCompData.data != NULL)
+    key.add(densCompData.data, coordCnt * sizeof(DType));
+  if (getOperatorType() == gpuNUFFT::CPU)
+  {
+    // the processing order depends on the balancing policy
+    std::string balancing = (loadBalancer != NULL)
+                                ? loadBalancer->getDescription()
+                                : CostModelBalancer().getDescription();
+    key.add(balancing.data(), balancing.size());
+  }
+  key.add((uint32_t)spaceFillingCurve);
+  return key.toString();
+}
+
+void gpuNUFFT::GpuNUFFTOperatorFactory::initGriddingMatrix(
+    GpuNUFFTOperator *gpuNUFFTOp)
+{
+  if (!useGriddingMatrix || gpuNUFFTOp->getType() != gpuNUFFT::CPU)
+    return;
+
+  debug("precompute gridding matrix\n");
+  if (!static_cast<CpuNUFFTOperator *>(gpuNUFFTOp)
+           ->precomputeGriddingMatrix(griddingMatrixBudget))
+    debug("gridding matrix exceeds memory budget, using on-the-fly "
+          "convolution\n");
+}
+
 IndType gpuNUFFT::GpuNUFFTOperatorFactory::computeSectorCountPerDimension(
     IndType dim, IndType sectorWidth)
 {
@@ -35,6 +114,18 @@ gpuNUFFT::GpuNUFFTOperatorFactory::initLinArray(IndType arrCount)
   return new_array;
 }
 
+template <typename T>
+gpuNUFFT::PlanFile::SectionData
+gpuNUFFT::GpuNUFFTOperatorFactory::getPlanSection(Array<T> array,
+                                                  IndType elementCount)
+{
+  PlanFile::SectionData section;
+  section.data = array.data;
+  section.dim = array.dim;
+  section.size = (elementCount > 0 ? elementCount : array.count()) * sizeof(T);
+  return section;
+}
+
 gpuNUFFT::Dimensions
 gpuNUFFT::GpuNUFFTOperatorFactory::computeSectorCountPerDimension(
     gpuNUFFT::Dimensions dim, IndType sectorWidth)
@@ -74,40 +165,54 @@ void gpuNUFFT::GpuNUFFTOperatorFactory::computeProcessingOrder(
     gpuNUFFT::GpuNUFFTOperator *gpuNUFFTOp)
 {
   Array<IndType> sectorDataCount = gpuNUFFTOp->getSectorDataCount();
-  std::vector<IndPair> countPerSector;
-
-  for (unsigned i = 0; i < sectorDataCount.count() - 1; i++)
+  SectorGeometry geometry(gpuNUFFTOp->getKernelWidth(),
+                          gpuNUFFTOp->getSectorWidth(),
+                          gpuNUFFTOp->is3DProcessing());
+
+  // the GPU kernels process chunks of at most MAXIMUM_PAYLOAD samples
+  FixedPayloadBalancer fixedPayloadBalancer;
+  CostModelBalancer costModelBalancer;
+  LoadBalancer *balancer = &fixedPayloadBalancer;
+  if (gpuNUFFTOp->getType() == gpuNUFFT::CPU)
+    balancer = (loadBalancer != NULL) ? loadBalancer : &costModelBalancer;
+
+  // rank of each sector along the space-filling curve
+  std::vector<uint64_t> sectorRanks;
+  if (spaceFillingCurve != NO_CURVE)
   {
-    countPerSector.push_back(
-        IndPair(i, sectorDataCount.data[i + 1] - sectorDataCount.data[i]));
-  }
-
-  std::sort(countPerSector.begin(), countPerSector.end(),
-            std::greater<IndPair>());
-  std::vector<IndType2> processingOrder;
-
-  for (unsigned i = 0; i < countPerSector.size(); i++)
-  {
-    if (countPerSector[i].second > 0)
+    Dimensions sectorDims = gpuNUFFTOp->getGridSectorDims();
+    bool is3D = gpuNUFFTOp->is3DProcessing();
+    IndType maxDim = std::max(sectorDims.width, sectorDims.height);
+    if (is3D)
+      maxDim = std::max(maxDim, sectorDims.depth);
+    unsigned bits = 1;
+    while ((1u << bits) < maxDim)
+      bits++;
+
+    sectorRanks.resize(sectorDims.count());
+    for (IndType ind = 0; ind < sectorRanks.size(); ind++)
     {
-      processingOrder.push_back(IndType2(countPerSector[i].first, 0));
-      if (countPerSector[i].second > MAXIMUM_PAYLOAD)
-      {
-        int remaining = (int)countPerSector[i].second;
-        int offset = 1;
-        // split sector
-        while ((remaining - MAXIMUM_PAYLOAD) > 0)
-        {
-          remaining -= MAXIMUM_PAYLOAD;
-          processingOrder.push_back(
-              IndType2(countPerSector[i].first, (offset++) * MAXIMUM_PAYLOAD));
-        }
-      }
+      IndType3 sector;
+      sector.x = ind % sectorDims.width;
+      sector.y = (ind / sectorDims.width) % sectorDims.height;
+      sector.z = is3D ? ind / (sectorDims.width * sectorDims.height) : 0;
+      sectorRanks[ind] =
+          computeCurveIndexCPU(spaceFillingCurve, sector, bits, is3D);
     }
-    else
-      break;
   }
 
+  std::vector<IndType2> processingOrder = balancer->computeProcessingOrder(
+      sectorDataCount.data, sectorDataCount.count() - 1, geometry,
+      sectorRanks.empty() ? NULL : &sectorRanks[0]);
+  const LoadBalancingReport &report = balancer->getReport();
+  std::stringstream ss;
+  ss << "processing order (" << balancer->getDescription()
+     << "): " << report.chunkCount << " chunks of at most "
+     << report.chunkSize << " samples, predicted imbalance "
+     << report.getPredictedImbalance() << " on " << report.workerCount
+     << " workers";
+  debug(ss.str());
+
   Array<IndType2> sectorProcessingOrder =
       initSectorProcessingOrder(gpuNUFFTOp, processingOrder.size());
   std::copy(processingOrder.begin(), processingOrder.end(),
@@ -115,6 +220,9 @@ void gpuNUFFT::GpuNUFFTOperatorFactory::computeProcessingOrder(
   if (gpuNUFFTOp->getType() == gpuNUFFT::BALANCED)
     static_cast<BalancedGpuNUFFTOperator *>(gpuNUFFTOp)
         ->setSectorProcessingOrder(sectorProcessingOrder);
+  else if (gpuNUFFTOp->getType() == gpuNUFFT::CPU)
+    static_cast<CpuNUFFTOperator *>(gpuNUFFTOp)
+        ->setSectorProcessingOrder(sectorProcessingOrder);
   else
     static_cast<BalancedTextureGpuNUFFTOperator *>(gpuNUFFTOp)
         ->setSectorProcessingOrder(sectorProcessingOrder);
@@ -317,123 +425,105 @@ gpuNUFFT::Array<DType> gpuNUFFT::GpuNUFFTOperatorFactory::initDeapoData(
   return deapoData;
 }
 
+gpuNUFFT::OperatorType gpuNUFFT::GpuNUFFTOperatorFactory::getOperatorType()
+{
+  if (!useGpu)
+    return gpuNUFFT::CPU;
+  if (balanceWorkload)
+    return useTextures ? gpuNUFFT::BALANCED_TEXTURE : gpuNUFFT::BALANCED;
+  return useTextures ? gpuNUFFT::TEXTURE : gpuNUFFT::DEFAULT;
+}
+
 gpuNUFFT::GpuNUFFTOperator *
 gpuNUFFT::GpuNUFFTOperatorFactory::createNewGpuNUFFTOperator(
     IndType kernelWidth, IndType sectorWidth, DType osf, Dimensions imgDims)
 {
-  if (balanceWorkload)
-  {
-    if (useTextures)
-    {
-      debug("creating Balanced 2D TextureLookup Operator!\n");
-      return new gpuNUFFT::BalancedTextureGpuNUFFTOperator(
-          kernelWidth, sectorWidth, osf, imgDims, TEXTURE2D_LOOKUP,
-          this->matlabSharedMem);
-    }
-    else
-    {
-      debug("creating Balanced GpuNUFFT Operator!\n");
-      return new gpuNUFFT::BalancedGpuNUFFTOperator(kernelWidth, sectorWidth,
-        osf, imgDims, this->matlabSharedMem);
-    }
-  }
+  return createNewGpuNUFFTOperator(getOperatorType(), kernelWidth, sectorWidth,
+                                   osf, imgDims, this->matlabSharedMem);
+}
 
-  if (useTextures)
+gpuNUFFT::GpuNUFFTOperator *
+gpuNUFFT::GpuNUFFTOperatorFactory::createNewGpuNUFFTOperator(
+    OperatorType operatorType, IndType kernelWidth, IndType sectorWidth,
+    DType osf, Dimensions imgDims, bool sharedMem)
+{
+  switch (operatorType)
   {
+  case gpuNUFFT::CPU:
+    debug("creating CPU Operator!\n");
+    return new gpuNUFFT::CpuNUFFTOperator(kernelWidth, sectorWidth, osf,
+                                          imgDims, sharedMem);
+  case gpuNUFFT::BALANCED_TEXTURE:
+    debug("creating Balanced 2D TextureLookup Operator!\n");
+    return new gpuNUFFT::BalancedTextureGpuNUFFTOperator(
+        kernelWidth, sectorWidth, osf, imgDims, TEXTURE2D_LOOKUP, sharedMem);
+  case gpuNUFFT::BALANCED:
+    debug("creating Balanced GpuNUFFT Operator!\n");
+    return new gpuNUFFT::BalancedGpuNUFFTOperator(kernelWidth, sectorWidth,
+                                                  osf, imgDims, sharedMem);
+  case gpuNUFFT::TEXTURE:
     debug("creating 2D TextureLookup Operator!\n");
-    return new gpuNUFFT::TextureGpuNUFFTOperator(kernelWidth, sectorWidth, osf,
-      imgDims, TEXTURE2D_LOOKUP, this->matlabSharedMem);
-  }
-  else
-  {
+    return new gpuNUFFT::TextureGpuNUFFTOperator(
+        kernelWidth, sectorWidth, osf, imgDims, TEXTURE2D_LOOKUP, sharedMem);
+  default:
     debug("creating DEFAULT GpuNUFFT Operator!\n");
     return new gpuNUFFT::GpuNUFFTOperator(kernelWidth, sectorWidth, osf,
                                           imgDims, true, DEFAULT, true);
   }
 }
 
+gpuNUFFT::Array<DType>
+gpuNUFFT::GpuNUFFTOperatorFactory::computeDeapodizationVectors(
+    const IndType &kernelWidth, const DType &osf, gpuNUFFT::Dimensions &imgDims)
+{
+  debug("compute deapodization vectors\n");
+
+  // simple operator providing kernel lookup table and gridding parameters
+  IndType sectorWidth = 8;
+  gpuNUFFT::CpuNUFFTOperator deapoGpuNUFFTOp(kernelWidth, sectorWidth, osf,
+                                             imgDims);
+  return deapoGpuNUFFTOp.computeDeapodizationVectors();
+}
+
 gpuNUFFT::Array<DType> gpuNUFFT::GpuNUFFTOperatorFactory::computeDeapodizationFunction(
   const IndType &kernelWidth, const DType &osf, gpuNUFFT::Dimensions &imgDims)
 {
   debug("compute deapodization function\n");
-  
-  // Create simple gpuNUFFT Operator
-  IndType sectorWidth = 8;
-  gpuNUFFT::GpuNUFFTOperator *deapoGpuNUFFTOp;
-  
-  if (useTextures)
-    deapoGpuNUFFTOp = new gpuNUFFT::TextureGpuNUFFTOperator(kernelWidth, sectorWidth, osf,
-    imgDims, TEXTURE2D_LOOKUP);
-  else
-    deapoGpuNUFFTOp = new gpuNUFFT::GpuNUFFTOperator(kernelWidth, sectorWidth, osf, imgDims);
-  
-  // Data
-  gpuNUFFT::Array<DType2> dataArray;
-  dataArray.data = (DType2*)calloc(1, sizeof(DType2)); // re + im
-  dataArray.dim.length = 1;
-  dataArray.data[0].x = 1;
-  dataArray.data[0].y = 0;
-  
-  // Coord triplet (x,y,z)
-  // should result in k-space center (0,0,0)
-  gpuNUFFT::Array<DType> kSpaceTraj;
-  if (deapoGpuNUFFTOp->is3DProcessing())
-    kSpaceTraj.data = (DType*)calloc(3, sizeof(DType)); // x,y,z
-  else
-    kSpaceTraj.data = (DType*)calloc(2, sizeof(DType)); // x,y
-  kSpaceTraj.dim.length = 1;
-  deapoGpuNUFFTOp->setKSpaceTraj(kSpaceTraj);
-  
-  // assign according sector to k-Space position
-  gpuNUFFT::Array<IndType> assignedSectors =
-    assignSectors(deapoGpuNUFFTOp, kSpaceTraj);
-  deapoGpuNUFFTOp->setSectorDataCount(
-    computeSectorDataCount(deapoGpuNUFFTOp, assignedSectors, true));
-  
-  // only one data entry, data index = 0
-  Array<IndType> dataIndices;
-  dataIndices.data = (IndType*)calloc(1, sizeof(IndType));
-  dataIndices.dim.length = 1;
-  deapoGpuNUFFTOp->setDataIndices(dataIndices);
-  
-  // sector centers
-  if (deapoGpuNUFFTOp->is3DProcessing())
-    deapoGpuNUFFTOp->setSectorCenters(computeSectorCenters(deapoGpuNUFFTOp, true));
-  else
-    deapoGpuNUFFTOp->setSectorCenters(computeSectorCenters2D(deapoGpuNUFFTOp, true));
-  debug("finished creation of gpuNUFFT operator for deapo computation\n");
-
-  // Compute deapodization function by gridding of a single value positioned 
-  // in the center of k-space and by using the intended oversampling factor
-  // and interpolation kernel width
-  gpuNUFFT::Array<CufftType> deapoFunction =
-    deapoGpuNUFFTOp->performGpuNUFFTAdj(dataArray,FFT);
-  
-  // cleanup locally initialized arrays here
-  free(dataArray.data);
-  free(assignedSectors.data);
-  delete deapoGpuNUFFTOp;
-
-  // Compute abs values of deapo function and compensate
-  // FFT scaling sqrt(N)
-  Array<DType> deapoAbs = initDeapoData(deapoFunction.count());
-
-  DType maxDeapoVal = 0;
-  DType minDeapoVal = std::numeric_limits<DType>::max();
-  double fft_scaling_factor = std::sqrt(imgDims.count()); 
-  for (unsigned cnt = 0; cnt < deapoFunction.count(); cnt++)
-  {
-    deapoFunction.data[cnt].x = deapoFunction.data[cnt].x * fft_scaling_factor;
-    deapoFunction.data[cnt].y = deapoFunction.data[cnt].y * fft_scaling_factor;
-    deapoAbs.data[cnt] = 1.0 / std::sqrt(std::pow(deapoFunction.data[cnt].x, 2.0) + std::pow(deapoFunction.data[cnt].y, 2.0));
-    if (deapoAbs.data[cnt] > maxDeapoVal)
-      maxDeapoVal = deapoAbs.data[cnt];
-    if (deapoAbs.data[cnt] < minDeapoVal)
-      minDeapoVal = deapoAbs.data[cnt];
+
+  // outer product of the separable deapodization factors
+  Array<DType> deapoVectors =
+      computeDeapodizationVectors(kernelWidth, osf, imgDims);
+  Array<DType> deapoData = initDeapoData(imgDims.count());
+  expandDeapodizationVectorsCPU(deapoVectors.data, imgDims, deapoData.data);
+  free(deapoVectors.data);
+  return deapoData;
+}
+
+void gpuNUFFT::GpuNUFFTOperatorFactory::computeSectorArrays(
+    GpuNUFFTOperator *gpuNUFFTOp)
+{
+  if (gpuNUFFTOp->getType() == gpuNUFFT::BALANCED ||
+    gpuNUFFTOp->getType() == gpuNUFFT::BALANCED_TEXTURE ||
+    gpuNUFFTOp->getType() == gpuNUFFT::CPU) {
+    computeProcessingOrder(gpuNUFFTOp);
   }
 
-  free(deapoFunction.data);
-  return deapoAbs;
+  if (gpuNUFFTOp->is3DProcessing())
+    gpuNUFFTOp->setSectorCenters(computeSectorCenters(gpuNUFFTOp));
+  else
+    gpuNUFFTOp->setSectorCenters(computeSectorCenters2D(gpuNUFFTOp));
+
+  // the CPU operator applies the separable deapodization directly
+  IndType kernelWidth = gpuNUFFTOp->getKernelWidth();
+  DType osf = gpuNUFFTOp->getOsf();
+  Dimensions imgDims = gpuNUFFTOp->getImageDims();
+  if (gpuNUFFTOp->getType() == gpuNUFFT::CPU)
+    static_cast<CpuNUFFTOperator *>(gpuNUFFTOp)
+        ->setDeapodizationVectors(
+            computeDeapodizationVectors(kernelWidth, osf, imgDims));
+  else
+    gpuNUFFTOp->setDeapodizationFunction(
+        this->computeDeapodizationFunction(kernelWidth, osf, imgDims));
 }
 
 gpuNUFFT::GpuNUFFTOperator *
@@ -442,9 +532,10 @@ gpuNUFFT::GpuNUFFTOperatorFactory::createGpuNUFFTOperator(
     gpuNUFFT::Array<DType2> &sensData, const IndType &kernelWidth,
     const IndType &sectorWidth, const DType &osf, gpuNUFFT::Dimensions &imgDims)
 {
-  // validate arguments
-  checkMemoryConsumption(kSpaceTraj.dim, sectorWidth, osf, imgDims,
-                         densCompData.dim, sensData.dim);
+  // validate arguments, the memory consumption is only limited on the GPU
+  if (useGpu)
+    checkMemoryConsumption(kSpaceTraj.dim, sectorWidth, osf, imgDims,
+                           densCompData.dim, sensData.dim);
 
   if (kSpaceTraj.dim.channels > 1)
     throw std::invalid_argument(
@@ -454,21 +545,51 @@ gpuNUFFT::GpuNUFFTOperatorFactory::createGpuNUFFTOperator(
     throw std::invalid_argument(
         "Image dimensions must not contain a channel size greater than 1!");
 
+  std::string planKey;
+  if (planCache != NULL)
+  {
+    planKey = computePlanKey(kSpaceTraj, densCompData, kernelWidth,
+                             sectorWidth, osf, imgDims);
+    std::string planPath = planCache->lookup(planKey);
+    if (!planPath.empty())
+    {
+      // the plan has to match the parameters, not only their hash
+      PlanFileHeader expected;
+      memset(&expected, 0, sizeof(expected));
+      expected.operatorType = getOperatorType();
+      expected.kernelWidth = (uint32_t)kernelWidth;
+      expected.sectorWidth = (uint32_t)sectorWidth;
+      expected.osf = osf;
+      expected.imgDims[0] = (uint32_t)imgDims.width;
+      expected.imgDims[1] = (uint32_t)imgDims.height;
+      expected.imgDims[2] = (uint32_t)imgDims.depth;
+      expected.sampleCount = kSpaceTraj.dim.count();
+      strncpy(expected.planKey, planKey.c_str(), PLAN_KEY_SIZE - 1);
+      try
+      {
+        debug("load cached gpuNUFFT plan\n");
+        gpuNUFFT::GpuNUFFTOperator *gpuNUFFTOp =
+            loadPlan(planPath, &expected);
+        if (sensData.data != NULL)
+          gpuNUFFTOp->setSens(sensData);
+        return gpuNUFFTOp;
+      }
+      catch (const std::runtime_error &)
+      {
+        debug("invalid cached gpuNUFFT plan, recomputing\n");
+        planCache->discard(planKey);
+      }
+    }
+  }
+
   debug("create gpuNUFFT operator...");
 
+  IndType coordCnt = kSpaceTraj.dim.count();
+  checkIndexRange(getOperatorType(), coordCnt, osf, imgDims);
+
   gpuNUFFT::GpuNUFFTOperator *gpuNUFFTOp =
       createNewGpuNUFFTOperator(kernelWidth, sectorWidth, osf, imgDims);
 
-  // assign according sector to k-Space position
-  gpuNUFFT::Array<IndType> assignedSectors =
-      assignSectors(gpuNUFFTOp, kSpaceTraj);
-
-  // order the assigned sectors and memorize index
-  std::vector<IndPair> assignedSectorsAndIndicesSorted =
-      sortVector<IndType>(assignedSectors);
-
-  IndType coordCnt = kSpaceTraj.dim.count();
-
   Array<DType> trajSorted = initCoordsData(gpuNUFFTOp, coordCnt);
   Array<IndType> dataIndices = initDataIndices(gpuNUFFTOp, coordCnt);
 
@@ -481,59 +602,74 @@ gpuNUFFT::GpuNUFFTOperatorFactory::createGpuNUFFTOperator(
 
   if (useGpu)
   {
+    // assign according sector to k-Space position
+    gpuNUFFT::Array<IndType> assignedSectors =
+        assignSectors(gpuNUFFTOp, kSpaceTraj);
+
+    // order the assigned sectors and memorize index
+    std::vector<IndPair> assignedSectorsAndIndicesSorted =
+        sortVector<IndType>(assignedSectors);
+
     sortArrays(gpuNUFFTOp, assignedSectorsAndIndicesSorted,
                assignedSectors.data, dataIndices.data, kSpaceTraj,
                trajSorted.data, densCompData.data, densData.data);
+
+    gpuNUFFTOp->setSectorDataCount(
+        computeSectorDataCount(gpuNUFFTOp, assignedSectors));
+
+    // free temporary array
+    free(assignedSectors.data);
   }
   else
   {
-    // sort kspace data coords
-    for (unsigned i = 0; i < coordCnt; i++)
-    {
-      trajSorted.data[i] =
-          kSpaceTraj.data[assignedSectorsAndIndicesSorted[i].first];
-      trajSorted.data[i + 1 * coordCnt] =
-          kSpaceTraj
-              .data[assignedSectorsAndIndicesSorted[i].first + 1 * coordCnt];
-      if (gpuNUFFTOp->is3DProcessing())
-        trajSorted.data[i + 2 * coordCnt] =
-            kSpaceTraj
-                .data[assignedSectorsAndIndicesSorted[i].first + 2 * coordCnt];
-
-      // sort density compensation
-      if (densCompData.data != NULL)
-        densData.data[i] =
-            densCompData.data[assignedSectorsAndIndicesSorted[i].first];
-
-      dataIndices.data[i] = assignedSectorsAndIndicesSorted[i].first;
-      assignedSectors.data[i] = assignedSectorsAndIndicesSorted[i].second;
-    }
+    // counting sort by sector, yields the sector data count directly
+    gpuNUFFTOp->setGridSectorDims(computeSectorCountPerDimension(
+        gpuNUFFTOp->getGridDims(), gpuNUFFTOp->getSectorWidth()));
+    Array<IndType> sectorDataCount = initSectorDataCount(
+        gpuNUFFTOp, gpuNUFFTOp->getGridSectorDims().count() + 1);
+    sortSamplesBySectorCPU(kSpaceTraj.data, densCompData.data, coordCnt,
+                           gpuNUFFTOp->getGridDims(),
+                           gpuNUFFTOp->getGridSectorDims(),
+                           gpuNUFFTOp->getSectorWidth(), trajSorted.data,
+                           densData.data, dataIndices.data,
+                           sectorDataCount.data);
+    gpuNUFFTOp->setSectorDataCount(sectorDataCount);
   }
 
-  gpuNUFFTOp->setSectorDataCount(
-      computeSectorDataCount(gpuNUFFTOp, assignedSectors));
-
-  if (gpuNUFFTOp->getType() == gpuNUFFT::BALANCED ||
-    gpuNUFFTOp->getType() == gpuNUFFT::BALANCED_TEXTURE) {
-    computeProcessingOrder(gpuNUFFTOp);
+  if (spaceFillingCurve != NO_CURVE)
+  {
+    Array<IndType> sectorDataCount = gpuNUFFTOp->getSectorDataCount();
+    sortSectorSamplesByCurveCPU(
+        spaceFillingCurve, trajSorted.data, densData.data, dataIndices.data,
+        coordCnt, sectorDataCount.data, sectorDataCount.count() - 1,
+        gpuNUFFTOp->getGridDims());
   }
 
+  computeSectorArrays(gpuNUFFTOp);
+
   gpuNUFFTOp->setDataIndices(dataIndices);
 
   gpuNUFFTOp->setKSpaceTraj(trajSorted);
 
   gpuNUFFTOp->setDens(densData);
 
-  if (gpuNUFFTOp->is3DProcessing())
-    gpuNUFFTOp->setSectorCenters(computeSectorCenters(gpuNUFFTOp));
-  else
-    gpuNUFFTOp->setSectorCenters(computeSectorCenters2D(gpuNUFFTOp));
+  initGriddingMatrix(gpuNUFFTOp);
 
-  // free temporary array
-  free(assignedSectors.data);
-
-  gpuNUFFTOp->setDeapodizationFunction(
-    this->computeDeapodizationFunction(kernelWidth, osf, imgDims));
+  if (planCache != NULL)
+  {
+    // the operator is usable even if the plan cannot be stored
+    try
+    {
+      planCache->store(planKey,
+                       [this, gpuNUFFTOp, &planKey](const std::string &file) {
+                         savePlan(gpuNUFFTOp, file, planKey);
+                       });
+    }
+    catch (const std::runtime_error &)
+    {
+      debug("storing of gpuNUFFT plan failed\n");
+    }
+  }
     
   debug("finished creation of gpuNUFFT operator\n");
   
@@ -571,8 +707,22 @@ gpuNUFFT::GpuNUFFTOperatorFactory::loadPrecomputedGpuNUFFTOperator(
     const IndType &sectorWidth, const DType &osf,
     gpuNUFFT::Dimensions &imgDims)
 {
+  checkIndexRange(getOperatorType(), dataIndices.count(), osf, imgDims);
+
   GpuNUFFTOperator *gpuNUFFTOp =
       createNewGpuNUFFTOperator(kernelWidth, sectorWidth, osf, imgDims);
+  initPrecomputedOperator(gpuNUFFTOp, kSpaceTraj, dataIndices, sectorDataCount,
+                          sectorProcessingOrder, sectorCenters, sensData,
+                          deapoData);
+  return gpuNUFFTOp;
+}
+
+void gpuNUFFT::GpuNUFFTOperatorFactory::initPrecomputedOperator(
+    GpuNUFFTOperator *gpuNUFFTOp, Array<DType> &kSpaceTraj,
+    Array<IndType> &dataIndices, Array<IndType> &sectorDataCount,
+    Array<IndType2> &sectorProcessingOrder, Array<IndType> &sectorCenters,
+    Array<DType2> &sensData, Array<DType> &deapoData)
+{
   gpuNUFFTOp->setGridSectorDims(
       GpuNUFFTOperatorFactory::computeSectorCountPerDimension(
           gpuNUFFTOp->getGridDims(), gpuNUFFTOp->getSectorWidth()));
@@ -587,11 +737,16 @@ gpuNUFFT::GpuNUFFTOperatorFactory::loadPrecomputedGpuNUFFTOperator(
   else if (gpuNUFFTOp->getType() == gpuNUFFT::BALANCED_TEXTURE)
     static_cast<BalancedTextureGpuNUFFTOperator *>(gpuNUFFTOp)
         ->setSectorProcessingOrder(sectorProcessingOrder);
+  else if (gpuNUFFTOp->getType() == gpuNUFFT::CPU &&
+           sectorProcessingOrder.data != NULL)
+    static_cast<CpuNUFFTOperator *>(gpuNUFFTOp)
+        ->setSectorProcessingOrder(sectorProcessingOrder);
 
   gpuNUFFTOp->setSectorCenters(sectorCenters);
   gpuNUFFTOp->setSens(sensData);
   gpuNUFFTOp->setDeapodizationFunction(deapoData);
-  return gpuNUFFTOp;
+
+  initGriddingMatrix(gpuNUFFTOp);
 }
 
 gpuNUFFT::GpuNUFFTOperator *
@@ -613,28 +768,360 @@ gpuNUFFT::GpuNUFFTOperatorFactory::loadPrecomputedGpuNUFFTOperator(
   return gpuNUFFTOp;
 }
 
-void gpuNUFFT::GpuNUFFTOperatorFactory::checkMemoryConsumption(
-    Dimensions &kSpaceDims, const IndType &sectorWidth, const DType &osf,
-    Dimensions &imgDims, Dimensions &densDims, Dimensions &sensDims)
+std::vector<gpuNUFFT::PlanFile::SectionData>
+gpuNUFFT::GpuNUFFTOperatorFactory::getPlanSections(
+    GpuNUFFTOperator *gpuNUFFTOp, PlanFileHeader &header)
+{
+  memset(&header, 0, sizeof(header));
+  header.operatorType = gpuNUFFTOp->getType();
+  header.kernelWidth = gpuNUFFTOp->getKernelWidth();
+  header.sectorWidth = gpuNUFFTOp->getSectorWidth();
+  header.osf = gpuNUFFTOp->getOsf();
+  header.imgDims[0] = gpuNUFFTOp->getImageDims().width;
+  header.imgDims[1] = gpuNUFFTOp->getImageDims().height;
+  header.imgDims[2] = gpuNUFFTOp->getImageDims().depth;
+
+  // the trajectory holds one coordinate per dimension and sample
+  IndType coordCnt = gpuNUFFTOp->getDataIndices().count();
+  // the header holds no data count besides the slot count
+  if (gpuNUFFTOp->getDataCount() != coordCnt)
+    throw std::invalid_argument(
+        "Plans of operators with unused slots are not supported!");
+  header.sampleCount = coordCnt;
+  std::vector<PlanFile::SectionData> sections(PLAN_SECTION_COUNT);
+  sections[PLAN_COORDS] =
+      getPlanSection(gpuNUFFTOp->getKSpaceTraj(),
+                     gpuNUFFTOp->getImageDimensionCount() * coordCnt);
+  sections[PLAN_DATA_INDICES] = getPlanSection(gpuNUFFTOp->getDataIndices());
+  sections[PLAN_SECTOR_DATA_COUNT] =
+      getPlanSection(gpuNUFFTOp->getSectorDataCount());
+  sections[PLAN_SECTOR_CENTERS] =
+      getPlanSection(gpuNUFFTOp->getSectorCenters());
+  sections[PLAN_DENSITY] = getPlanSection(gpuNUFFTOp->getDens());
+  sections[PLAN_DEAPODIZATION] =
+      getPlanSection(gpuNUFFTOp->getDeapodizationFunction());
+
+  if (gpuNUFFTOp->getType() == gpuNUFFT::CPU)
+    sections[PLAN_DEAPODIZATION_VECTORS] = getPlanSection(
+        static_cast<CpuNUFFTOperator *>(gpuNUFFTOp)->getDeapodizationVectors());
+
+  BalancedOperator *balancedOp = dynamic_cast<BalancedOperator *>(gpuNUFFTOp);
+  if (balancedOp != NULL)
+    sections[PLAN_SECTOR_PROCESSING_ORDER] =
+        getPlanSection(balancedOp->getSectorProcessingOrder());
+  return sections;
+}
+
+void gpuNUFFT::GpuNUFFTOperatorFactory::savePlan(
+    GpuNUFFTOperator *gpuNUFFTOp, const std::string &fileName)
 {
-  size_t multiplier = sizeof(DType);
-  size_t complexMultiplier = 2 * multiplier;
+  savePlan(gpuNUFFTOp, fileName, std::string());
+}
+
+void gpuNUFFT::GpuNUFFTOperatorFactory::savePlan(
+    GpuNUFFTOperator *gpuNUFFTOp, const std::string &fileName,
+    const std::string &planKey)
+{
+  debug("save gpuNUFFT plan...");
+
+  PlanFileHeader header;
+  std::vector<PlanFile::SectionData> sections =
+      getPlanSections(gpuNUFFTOp, header);
+  strncpy(header.planKey, planKey.c_str(), PLAN_KEY_SIZE - 1);
+  PlanFile::write(fileName, header, sections);
+  debug("finished saving of gpuNUFFT plan\n");
+}
 
-  size_t estMem = 2 * imgDims.count() * std::pow(osf, 3) *
-                  complexMultiplier;  //< oversampled grid, and fft
-  estMem += kSpaceDims.count() *
-            (3 * multiplier +
-             complexMultiplier);  //< 3 components of trajectory + complex data
+gpuNUFFT::GpuNUFFTOperator *
+gpuNUFFT::GpuNUFFTOperatorFactory::loadPlan(const std::string &fileName)
+{
+  return loadPlan(fileName, NULL);
+}
 
-  estMem += densDims.count() * multiplier;  //<density compensation
+gpuNUFFT::GpuNUFFTOperator *
+gpuNUFFT::GpuNUFFTOperatorFactory::loadPlan(const std::string &fileName,
+                                            const PlanFileHeader *expected)
+{
+  debug("load gpuNUFFT plan...");
+
+  std::shared_ptr<PlanFile> plan(new PlanFile(fileName));
+  const PlanFileHeader &header = plan->getHeader();
+  if (header.operatorType > gpuNUFFT::CPU)
+    throw std::runtime_error("Unknown operator type in plan file: " +
+                             fileName);
+  if (expected != NULL &&
+      (header.operatorType != expected->operatorType ||
+       header.kernelWidth != expected->kernelWidth ||
+       header.sectorWidth != expected->sectorWidth ||
+       header.osf != expected->osf ||
+       memcmp(header.imgDims, expected->imgDims, sizeof(header.imgDims)) !=
+           0 ||
+       header.sampleCount != expected->sampleCount ||
+       strncmp(header.planKey, expected->planKey, PLAN_KEY_SIZE) != 0))
+    throw std::runtime_error("Plan file does not match the parameters: " +
+                             fileName);
+
+  Dimensions imgDims(header.imgDims[0], header.imgDims[1], header.imgDims[2]);
+  Array<DType> kSpaceTraj = plan->getSection<DType>(PLAN_COORDS);
+  Array<IndType> dataIndices = plan->getSection<IndType>(PLAN_DATA_INDICES);
+  Array<IndType> sectorDataCount =
+      plan->getSection<IndType>(PLAN_SECTOR_DATA_COUNT);
+  Array<IndType2> sectorProcessingOrder =
+      plan->getSection<IndType2>(PLAN_SECTOR_PROCESSING_ORDER);
+  Array<IndType> sectorCenters =
+      plan->getSection<IndType>(PLAN_SECTOR_CENTERS);
+  Array<DType> deapoData = plan->getSection<DType>(PLAN_DEAPODIZATION);
+  Array<DType2> sensData;
+  if (dataIndices.count() != header.sampleCount)
+    throw std::runtime_error("Corrupt plan file: " + fileName);
+  checkIndexRange((OperatorType)header.operatorType, dataIndices.count(),
+                  header.osf, imgDims);
+
+  // the arrays are owned by the mapping, thus they must not be freed by the
+  // operator
+  GpuNUFFTOperator *gpuNUFFTOp = createNewGpuNUFFTOperator(
+      (OperatorType)header.operatorType, header.kernelWidth,
+      header.sectorWidth, header.osf, imgDims, true);
+  gpuNUFFTOp->planFile = plan;
+
+  initPrecomputedOperator(gpuNUFFTOp, kSpaceTraj, dataIndices, sectorDataCount,
+                          sectorProcessingOrder, sectorCenters, sensData,
+                          deapoData);
+  gpuNUFFTOp->setDens(plan->getSection<DType>(PLAN_DENSITY));
+  if (gpuNUFFTOp->getType() == gpuNUFFT::CPU)
+    static_cast<CpuNUFFTOperator *>(gpuNUFFTOp)
+        ->setDeapodizationVectors(
+            plan->getSection<DType>(PLAN_DEAPODIZATION_VECTORS));
+
+  debug("finished loading of gpuNUFFT plan\n");
+  return gpuNUFFTOp;
+}
 
-  if (sensDims.count() > 0)
+void gpuNUFFT::GpuNUFFTOperatorFactory::createPlanFile(
+    const std::string &trajFileName, const std::string &densFileName,
+    const IndType &kernelWidth, const IndType &sectorWidth, const DType &osf,
+    gpuNUFFT::Dimensions &imgDims, const std::string &planFileName,
+    size_t memoryBudget)
+{
+  debug("create gpuNUFFT plan out-of-core...");
+
+  if (imgDims.channels > 1)
+    throw std::invalid_argument(
+        "Image dimensions must not contain a channel size greater than 1!");
+
+  std::unique_ptr<GpuNUFFTOperator> gpuNUFFTOp(
+      createNewGpuNUFFTOperator(kernelWidth, sectorWidth, osf, imgDims));
+  int dimCount = gpuNUFFTOp->getImageDimensionCount();
+
+  MappedFile trajFile(trajFileName);
+  size_t sampleSize = dimCount * sizeof(DType);
+  if (trajFile.getSize() == 0 || trajFile.getSize() % sampleSize != 0)
+    throw std::invalid_argument(
+        "Trajectory file does not match the image dimensions: " +
+        trajFileName);
+  IndType coordCnt = (IndType)(trajFile.getSize() / sampleSize);
+  checkIndexRange(gpuNUFFTOp->getType(), coordCnt, osf, imgDims);
+  DType *kSpaceTraj = reinterpret_cast<DType *>(trajFile.getData());
+
+  std::unique_ptr<MappedFile> densFile;
+  DType *densCompData = NULL;
+  if (!densFileName.empty())
+  {
+    densFile.reset(new MappedFile(densFileName));
+    if (densFile->getSize() != coordCnt * sizeof(DType))
+      throw std::invalid_argument(
+          "Density compensation file does not match the trajectory: " +
+          densFileName);
+    densCompData = reinterpret_cast<DType *>(densFile->getData());
+  }
+
+  Dimensions gridDims = gpuNUFFTOp->getGridDims();
+  gpuNUFFTOp->setGridSectorDims(
+      computeSectorCountPerDimension(gridDims, sectorWidth));
+  Dimensions gridSectorDims = gpuNUFFTOp->getGridSectorDims();
+  IndType sectorCount = gridSectorDims.count();
+
+  // half of the budget holds the sector index of each sample of a block,
+  // the rest the buffered samples of the second pass
+  IndType blockSize = (IndType)std::min(
+      (size_t)coordCnt,
+      std::max((size_t)1, memoryBudget / (2 * sizeof(IndType))));
+  std::vector<IndType> sampleSectors(blockSize);
+
+  // first pass counts the samples per sector
+  std::vector<IndType> positions(sectorCount, 0);
+  for (IndType first = 0; first < coordCnt; first += blockSize)
+  {
+    IndType count = std::min(blockSize, coordCnt - first);
+    assignSampleSectorsCPU(kSpaceTraj, first, count, coordCnt, gridDims,
+                           gridSectorDims, sectorWidth, &sampleSectors[0]);
+    for (IndType i = 0; i < count; i++)
+      positions[sampleSectors[i]]++;
+  }
+
+  Array<IndType> sectorDataCount =
+      initSectorDataCount(gpuNUFFTOp.get(), sectorCount + 1);
+  sectorDataCount.data[0] = 0;
+  for (IndType sec = 0; sec < sectorCount; sec++)
+  {
+    sectorDataCount.data[sec + 1] = sectorDataCount.data[sec] + positions[sec];
+    positions[sec] = sectorDataCount.data[sec];
+  }
+  gpuNUFFTOp->setSectorDataCount(sectorDataCount);
+  computeSectorArrays(gpuNUFFTOp.get());
+
+  // the sorted samples are written to reserved sections of the plan file
+  Array<DType> trajSorted;
+  trajSorted.dim.length = coordCnt;
+  Array<IndType> dataIndices;
+  dataIndices.dim.length = coordCnt;
+  Array<DType> densData;
+  densData.dim.length = coordCnt;
+  gpuNUFFTOp->setKSpaceTraj(trajSorted);
+  gpuNUFFTOp->setDataIndices(dataIndices);
+
+  PlanFileHeader header;
+  std::vector<PlanFile::SectionData> sections =
+      getPlanSections(gpuNUFFTOp.get(), header);
+  sections[PLAN_COORDS].reserve = true;
+  sections[PLAN_DATA_INDICES].reserve = true;
+  if (densCompData != NULL)
   {
-    estMem += imgDims.count() *
-              complexMultiplier;  //< only one coil is stored on the device
-    estMem += imgDims.count() * complexMultiplier;  //< precomputed deapo
-    estMem += imgDims.count() * complexMultiplier;  //< coil summation
+    sections[PLAN_DENSITY] = getPlanSection(densData);
+    sections[PLAN_DENSITY].reserve = true;
   }
+  PlanFile::write(planFileName, header, sections);
+
+  // second pass distributes the samples to buckets of consecutive sectors
+  // with about the same sample count. A full bucket is written in ascending
+  // order, thus the plan file is not accessed sample by sample.
+  size_t bufferedSize = (dimCount + (densCompData != NULL ? 1 : 0)) *
+                            sizeof(DType) +
+                        3 * sizeof(IndType);
+  size_t blockBytes = blockSize * sizeof(IndType);
+  IndType capacity = (IndType)std::min(
+      (size_t)coordCnt,
+      std::max((size_t)1, (memoryBudget > blockBytes ? memoryBudget - blockBytes
+                                                     : 0) /
+                              bufferedSize));
+  IndType bucketCount = std::min(
+      sectorCount, std::max((IndType)1, capacity / MIN_BUCKET_CAPACITY));
+  IndType bucketCapacity = capacity / bucketCount;
+
+  std::vector<IndType> bucketOfSector(sectorCount);
+  std::vector<IndType> bucketSectors(bucketCount + 1, sectorCount);
+  bucketSectors[0] = 0;
+  for (IndType sec = 0, bucket = 0; sec < sectorCount; sec++)
+  {
+    while (bucket + 1 < bucketCount &&
+           sectorDataCount.data[sec] >=
+               (bucket + 1) * (coordCnt / bucketCount))
+      bucketSectors[++bucket] = sec;
+    bucketOfSector[sec] = bucket;
+  }
+  std::vector<IndType> sectorOffsets(sectorCount, 0);
+
+  // samples are buffered as sector, data index and the coordinates
+  std::vector<IndType> bucketFill(bucketCount, 0);
+  std::vector<IndType> bufferSectors(bucketCount * bucketCapacity);
+  std::vector<IndType> bufferIndices(bucketCount * bucketCapacity);
+  std::vector<DType> bufferCoords(dimCount * bucketCount * bucketCapacity);
+  std::vector<DType> bufferDens(densCompData != NULL
+                                    ? bucketCount * bucketCapacity
+                                    : 0);
+  std::vector<IndType> order(bucketCapacity);
+
+  PlanFile plan(planFileName, true);
+  trajSorted = plan.getSection<DType>(PLAN_COORDS);
+  dataIndices = plan.getSection<IndType>(PLAN_DATA_INDICES);
+  densData = plan.getSection<DType>(PLAN_DENSITY);
+
+  // a counting sort by sector keeps the acquisition order of each sector
+  // like sortSamplesBySectorCPU
+  auto flushBucket = [&](IndType bucket)
+  {
+    IndType base = bucket * bucketCapacity;
+    IndType fill = bucketFill[bucket];
+    for (IndType e = 0; e < fill; e++)
+      sectorOffsets[bufferSectors[base + e]]++;
+    IndType offset = 0;
+    for (IndType sec = bucketSectors[bucket]; sec < bucketSectors[bucket + 1];
+         sec++)
+    {
+      IndType count = sectorOffsets[sec];
+      sectorOffsets[sec] = offset;
+      offset += count;
+    }
+    for (IndType e = 0; e < fill; e++)
+      order[sectorOffsets[bufferSectors[base + e]]++] = base + e;
+    std::fill(sectorOffsets.begin() + bucketSectors[bucket],
+              sectorOffsets.begin() + bucketSectors[bucket + 1], 0);
+
+    for (IndType e = 0; e < fill; e++)
+    {
+      IndType entry = order[e];
+      IndType pos = positions[bufferSectors[entry]]++;
+      for (int d = 0; d < dimCount; d++)
+        trajSorted.data[pos + d * coordCnt] =
+            bufferCoords[entry * dimCount + d];
+      if (densCompData != NULL)
+        densData.data[pos] = bufferDens[entry];
+      dataIndices.data[pos] = bufferIndices[entry];
+    }
+    bucketFill[bucket] = 0;
+  };
+
+  for (IndType first = 0; first < coordCnt; first += blockSize)
+  {
+    IndType count = std::min(blockSize, coordCnt - first);
+    assignSampleSectorsCPU(kSpaceTraj, first, count, coordCnt, gridDims,
+                           gridSectorDims, sectorWidth, &sampleSectors[0]);
+    for (IndType i = 0; i < count; i++)
+    {
+      IndType cCnt = first + i;
+      IndType bucket = bucketOfSector[sampleSectors[i]];
+      if (bucketFill[bucket] == bucketCapacity)
+        flushBucket(bucket);
+      IndType entry = bucket * bucketCapacity + bucketFill[bucket]++;
+      bufferSectors[entry] = sampleSectors[i];
+      bufferIndices[entry] = cCnt;
+      for (int d = 0; d < dimCount; d++)
+        bufferCoords[entry * dimCount + d] = kSpaceTraj[cCnt + d * coordCnt];
+      if (densCompData != NULL)
+        bufferDens[entry] = densCompData[cCnt];
+    }
+  }
+  for (IndType bucket = 0; bucket < bucketCount; bucket++)
+    flushBucket(bucket);
+  plan.flush();
+  debug("finished out-of-core creation of gpuNUFFT plan\n");
+}
+
+void gpuNUFFT::GpuNUFFTOperatorFactory::checkIndexRange(
+    OperatorType operatorType, IndType dataCount, const DType &osf,
+    Dimensions &imgDims)
+{
+  if (operatorType == gpuNUFFT::CPU)
+    return;
+
+  const IndType maxCount = (IndType)std::numeric_limits<int>::max();
+  if (dataCount > maxCount)
+    throw std::invalid_argument(
+        "Sample count exceeds the int range of the GPU kernels!");
+  if ((imgDims * osf).count() > maxCount)
+    throw std::invalid_argument(
+        "Grid size exceeds the int range of the GPU kernels!");
+}
+
+void gpuNUFFT::GpuNUFFTOperatorFactory::checkMemoryConsumption(
+    Dimensions &kSpaceDims, const IndType &sectorWidth, const DType &osf,
+    Dimensions &imgDims, Dimensions &densDims, Dimensions &sensDims)
+{
+  // GPU operators precompute the deapodization function
+  MemoryPlanner planner(DEVICE_MEMORY, imgDims, osf, sectorWidth,
+                        kSpaceDims.count(), densDims.count() > 0,
+                        sensDims.count() > 0);
+  planner.setDeapodization(true);
 
   cudaDeviceProp prop;
   cudaGetDeviceProperties(&prop, 0);
@@ -644,8 +1131,10 @@ void gpuNUFFT::GpuNUFFTOperatorFactory::checkMemoryConsumption(
   std::stringstream ss(
       "Required device memory too large for selected device!\n");
   ss << "Total available memory: " << total << std::endl;
-  ss << "Required memory: " << estMem << std::endl;
+  ss << "Required memory: " << planner.getRequirements(1).getTotalBytes()
+     << std::endl;
 
-  if (total < estMem)
+  // at least a single coil has to fit
+  if (planner.selectCoilBatch(1, total) == 0)
     throw std::runtime_error(ss.str());
 }
@@ -0,0 +1,266 @@
+#include "gpuNUFFT_plan.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char PLAN_MAGIC[8] = { 'G', 'P', 'U', 'N', 'U', 'F', 'F', 'T' };
+
+const uint32_t PLAN_BYTE_ORDER_MARK = 0x01020304;
+
+uint64_t alignSection(uint64_t offset)
+{
+  return (offset + gpuNUFFT::PLAN_SECTION_ALIGNMENT - 1) /
+         gpuNUFFT::PLAN_SECTION_ALIGNMENT * gpuNUFFT::PLAN_SECTION_ALIGNMENT;
+}
+
+void throwPlanError(const std::string &message, const std::string &fileName)
+{
+  throw std::runtime_error(message + ": " + fileName);
+}
+}
+
+void gpuNUFFT::PlanFile::write(const std::string &fileName,
+                               PlanFileHeader header,
+                               const std::vector<SectionData> &data)
+{
+  if (data.size() != PLAN_SECTION_COUNT)
+    throw std::invalid_argument("Plan file requires one entry per section!");
+
+  memcpy(header.magic, PLAN_MAGIC, sizeof(PLAN_MAGIC));
+  header.version = PLAN_FILE_VERSION;
+  header.byteOrderMark = PLAN_BYTE_ORDER_MARK;
+  header.dTypeSize = sizeof(DType);
+  header.indTypeSize = sizeof(IndType);
+  header.sectionCount = PLAN_SECTION_COUNT;
+
+  std::vector<PlanFileSection> sections(PLAN_SECTION_COUNT);
+  uint64_t offset =
+      sizeof(PlanFileHeader) + PLAN_SECTION_COUNT * sizeof(PlanFileSection);
+  for (unsigned s = 0; s < PLAN_SECTION_COUNT; s++)
+  {
+    const SectionData &section = data[s];
+    memset(&sections[s], 0, sizeof(PlanFileSection));
+    sections[s].type = s;
+    if ((section.data == NULL && !section.reserve) || section.size == 0)
+      continue;
+    sections[s].dims[0] = section.dim.width;
+    sections[s].dims[1] = section.dim.height;
+    sections[s].dims[2] = section.dim.depth;
+    sections[s].dims[3] = section.dim.channels;
+    sections[s].dims[4] = section.dim.frames;
+    sections[s].dims[5] = section.dim.length;
+    sections[s].offset = alignSection(offset);
+    sections[s].size = section.size;
+    offset = sections[s].offset + section.size;
+  }
+  header.fileSize = offset;
+
+  std::ofstream file(fileName.c_str(), std::ios::binary | std::ios::trunc);
+  if (!file)
+    throwPlanError("Cannot create plan file", fileName);
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(&sections[0]),
+             PLAN_SECTION_COUNT * sizeof(PlanFileSection));
+  uint64_t position =
+      sizeof(PlanFileHeader) + PLAN_SECTION_COUNT * sizeof(PlanFileSection);
+  const char padding[PLAN_SECTION_ALIGNMENT] = { 0 };
+  for (unsigned s = 0; s < PLAN_SECTION_COUNT; s++)
+  {
+    if (sections[s].size == 0 || data[s].data == NULL)
+      continue;
+    // gaps of reserved sections are skipped and read as zeros
+    if (sections[s].offset - position < PLAN_SECTION_ALIGNMENT)
+      file.write(padding, sections[s].offset - position);
+    else
+      file.seekp(sections[s].offset);
+    file.write(static_cast<const char *>(data[s].data), sections[s].size);
+    position = sections[s].offset + sections[s].size;
+  }
+
+  // reserved sections at the end, not allocated on file systems supporting
+  // sparse files
+  if (position < header.fileSize)
+  {
+    file.seekp(header.fileSize - 1);
+    file.write(padding, 1);
+  }
+
+  if (!file)
+    throwPlanError("Cannot write plan file", fileName);
+}
+
+gpuNUFFT::MappedFile::MappedFile(const std::string &fileName, Mode mode)
+  : fileName(fileName), base(NULL), mappedSize(0)
+{
+#ifdef _WIN32
+  mappingHandle = NULL;
+  DWORD access = GENERIC_READ;
+  DWORD protection = PAGE_READONLY;
+  DWORD mapAccess = FILE_MAP_READ;
+  if (mode == COPY_ON_WRITE)
+  {
+    protection = PAGE_WRITECOPY;
+    mapAccess = FILE_MAP_COPY;
+  }
+  else if (mode == READ_WRITE)
+  {
+    access |= GENERIC_WRITE;
+    protection = PAGE_READWRITE;
+    mapAccess = FILE_MAP_WRITE;
+  }
+  fileHandle = CreateFileA(fileName.c_str(), access, FILE_SHARE_READ, NULL,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+    throwPlanError("Cannot open file", fileName);
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(fileHandle, &size))
+  {
+    unmap();
+    throwPlanError("Cannot read file", fileName);
+  }
+  mappedSize = (size_t)size.QuadPart;
+  if (mappedSize == 0)
+    return;
+
+  mappingHandle =
+      CreateFileMappingA(fileHandle, NULL, protection, 0, 0, NULL);
+  if (mappingHandle != NULL)
+    base = static_cast<char *>(
+        MapViewOfFile(mappingHandle, mapAccess, 0, 0, 0));
+#else
+  fileDescriptor =
+      open(fileName.c_str(), mode == READ_WRITE ? O_RDWR : O_RDONLY);
+  if (fileDescriptor < 0)
+    throwPlanError("Cannot open file", fileName);
+
+  struct stat fileStat;
+  if (fstat(fileDescriptor, &fileStat) != 0)
+  {
+    unmap();
+    throwPlanError("Cannot read file", fileName);
+  }
+  mappedSize = (size_t)fileStat.st_size;
+  if (mappedSize == 0)
+    return;
+
+  int protection = PROT_READ;
+  int flags = MAP_SHARED;
+  if (mode == COPY_ON_WRITE)
+  {
+    protection |= PROT_WRITE;
+    flags = MAP_PRIVATE;
+  }
+  else if (mode == READ_WRITE)
+    protection |= PROT_WRITE;
+  void *mapping =
+      mmap(NULL, mappedSize, protection, flags, fileDescriptor, 0);
+  if (mapping != MAP_FAILED)
+    base = static_cast<char *>(mapping);
+#endif
+
+  if (base == NULL)
+  {
+    unmap();
+    throwPlanError("Cannot map file", fileName);
+  }
+}
+
+gpuNUFFT::MappedFile::~MappedFile()
+{
+  unmap();
+}
+
+void gpuNUFFT::MappedFile::flush()
+{
+  if (base == NULL)
+    return;
+#ifdef _WIN32
+  bool flushed = FlushViewOfFile(base, 0) && FlushFileBuffers(fileHandle);
+#else
+  bool flushed = msync(base, mappedSize, MS_SYNC) == 0;
+#endif
+  if (!flushed)
+    throwPlanError("Cannot write file", fileName);
+}
+
+void gpuNUFFT::MappedFile::unmap()
+{
+#ifdef _WIN32
+  if (base != NULL)
+    UnmapViewOfFile(base);
+  if (mappingHandle != NULL)
+    CloseHandle(mappingHandle);
+  if (fileHandle != INVALID_HANDLE_VALUE)
+    CloseHandle(fileHandle);
+  mappingHandle = NULL;
+  fileHandle = INVALID_HANDLE_VALUE;
+#else
+  if (base != NULL)
+    munmap(base, mappedSize);
+  if (fileDescriptor >= 0)
+    close(fileDescriptor);
+  fileDescriptor = -1;
+#endif
+  base = NULL;
+}
+
+gpuNUFFT::PlanFile::PlanFile(const std::string &fileName, bool writable)
+  : file(fileName,
+         writable ? MappedFile::READ_WRITE : MappedFile::COPY_ON_WRITE),
+    base(file.getData()), header(NULL), sections(NULL)
+{
+  size_t mappedSize = file.getSize();
+  if (mappedSize < sizeof(PlanFileHeader))
+    throwPlanError("No gpuNUFFT plan file", fileName);
+
+  header = reinterpret_cast<const PlanFileHeader *>(base);
+  std::string error;
+  if (memcmp(header->magic, PLAN_MAGIC, sizeof(PLAN_MAGIC)) != 0)
+    error = "No gpuNUFFT plan file";
+  else if (header->version != PLAN_FILE_VERSION)
+    error = "Unsupported plan file version";
+  else if (header->byteOrderMark != PLAN_BYTE_ORDER_MARK)
+    error = "Plan file byte order does not match";
+  else if (header->dTypeSize != sizeof(DType) ||
+           header->indTypeSize != sizeof(IndType))
+    error = "Plan file precision does not match";
+  else if (header->sectionCount != PLAN_SECTION_COUNT ||
+           header->fileSize != mappedSize ||
+           mappedSize < sizeof(PlanFileHeader) +
+                            PLAN_SECTION_COUNT * sizeof(PlanFileSection))
+    error = "Corrupt plan file";
+
+  if (error.empty())
+  {
+    sections = reinterpret_cast<const PlanFileSection *>(
+        base + sizeof(PlanFileHeader));
+    for (unsigned s = 0; s < PLAN_SECTION_COUNT; s++)
+    {
+      if (sections[s].type != s ||
+          sections[s].offset % PLAN_SECTION_ALIGNMENT != 0 ||
+          sections[s].offset + sections[s].size > mappedSize)
+        error = "Corrupt plan file";
+    }
+  }
+
+  if (!error.empty())
+    throwPlanError(error, fileName);
+}
+
+void gpuNUFFT::PlanFile::flush()
+{
+  file.flush();
+}
@@ -0,0 +1,327 @@
+#include "gpuNUFFT_plan_cache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+namespace
+{
+const char PLAN_EXTENSION[] = ".plan";
+
+inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+/** \brief Cached plan file found in the cache directory */
+struct PlanEntry
+{
+  std::string path;
+  uint64_t size;
+  time_t lastUse;
+
+  bool operator<(const PlanEntry &other) const
+  {
+    return lastUse < other.lastUse;
+  }
+};
+
+bool endsWith(const std::string &name, const char *suffix)
+{
+  size_t length = strlen(suffix);
+  return name.size() > length &&
+         name.compare(name.size() - length, length, suffix) == 0;
+}
+
+bool getPlanEntry(const std::string &path, PlanEntry &entry)
+{
+  struct stat fileStat;
+  if (stat(path.c_str(), &fileStat) != 0)
+    return false;
+  entry.path = path;
+  entry.size = (uint64_t)fileStat.st_size;
+  entry.lastUse = fileStat.st_mtime;
+  return true;
+}
+
+/** \brief Plan files of the cache directory, temporary files are skipped */
+std::vector<PlanEntry> listPlans(const std::string &directory)
+{
+  std::vector<PlanEntry> plans;
+  PlanEntry entry;
+#ifdef _WIN32
+  WIN32_FIND_DATAA findData;
+  HANDLE find =
+      FindFirstFileA((directory + "/*" + PLAN_EXTENSION).c_str(), &findData);
+  if (find == INVALID_HANDLE_VALUE)
+    return plans;
+  do
+  {
+    std::string name(findData.cFileName);
+    if (endsWith(name, PLAN_EXTENSION) &&
+        getPlanEntry(directory + "/" + name, entry))
+      plans.push_back(entry);
+  } while (FindNextFileA(find, &findData));
+  FindClose(find);
+#else
+  DIR *dir = opendir(directory.c_str());
+  if (dir == NULL)
+    return plans;
+  struct dirent *dirEntry;
+  while ((dirEntry = readdir(dir)) != NULL)
+  {
+    std::string name(dirEntry->d_name);
+    if (endsWith(name, PLAN_EXTENSION) &&
+        getPlanEntry(directory + "/" + name, entry))
+      plans.push_back(entry);
+  }
+  closedir(dir);
+#endif
+  return plans;
+}
+
+/** \brief Unique name of a temporary file among threads and processes */
+std::string getTemporaryPath(const std::string &path)
+{
+  static std::atomic<unsigned> counter(0);
+#ifdef _WIN32
+  int processId = _getpid();
+#else
+  int processId = (int)getpid();
+#endif
+  std::stringstream ss;
+  ss << path << ".tmp." << processId << "." << counter++;
+  return ss.str();
+}
+
+/** \brief Set the modification time of the file to now */
+void touch(const std::string &path)
+{
+#ifdef _WIN32
+  _utime(path.c_str(), NULL);
+#else
+  utime(path.c_str(), NULL);
+#endif
+}
+}
+
+gpuNUFFT::PlanKey::PlanKey() : length(0)
+{
+  hash[0] = 0x9e3779b97f4a7c15ull;
+  hash[1] = 0x6a09e667f3bcc909ull;
+}
+
+void gpuNUFFT::PlanKey::addWord(uint64_t word)
+{
+  // the lanes use the constants of the murmur3 x64 128-bit hash in swapped
+  // order, thus they are independent
+  uint64_t k0 = rotateLeft(word * 0x87c37b91114253d5ull, 31);
+  hash[0] ^= k0 * 0x4cf5ad432745937full;
+  hash[0] = rotateLeft(hash[0], 27) * 5 + 0x52dce729;
+
+  uint64_t k1 = rotateLeft(word * 0x4cf5ad432745937full, 33);
+  hash[1] ^= k1 * 0x87c37b91114253d5ull;
+  hash[1] = rotateLeft(hash[1], 31) * 5 + 0x38495ab5;
+}
+
+void gpuNUFFT::PlanKey::add(const void *data, size_t size)
+{
+  const char *bytes = static_cast<const char *>(data);
+  size_t words = size / sizeof(uint64_t);
+  uint64_t word;
+  for (size_t i = 0; i < words; i++)
+  {
+    memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+    addWord(word);
+  }
+  size_t remaining = size - words * sizeof(uint64_t);
+  if (remaining > 0)
+  {
+    word = 0;
+    memcpy(&word, bytes + words * sizeof(uint64_t), remaining);
+    addWord(word);
+  }
+  // separates consecutive buffers, e.g. (ab, c) from (a, bc)
+  addWord(size);
+  length += size;
+}
+
+std::string gpuNUFFT::PlanKey::toString() const
+{
+  // final avalanche of the murmur3 hash
+  uint64_t result[2] = { hash[0] ^ length, hash[1] ^ length };
+  result[0] += result[1];
+  result[1] += result[0];
+  for (int lane = 0; lane < 2; lane++)
+  {
+    result[lane] ^= result[lane] >> 33;
+    result[lane] *= 0xff51afd7ed558ccdull;
+    result[lane] ^= result[lane] >> 33;
+    result[lane] *= 0xc4ceb9fe1a85ec53ull;
+    result[lane] ^= result[lane] >> 33;
+  }
+  result[0] += result[1];
+  result[1] += result[0];
+
+  std::stringstream ss;
+  ss << std::hex << std::setfill('0') << std::setw(16) << result[0]
+     << std::setw(16) << result[1];
+  return ss.str();
+}
+
+gpuNUFFT::PlanCache::PlanCache(const std::string &directory,
+                               uint64_t maxSize)
+  : directory(directory), maxSize(maxSize)
+{
+  struct stat dirStat;
+  if (stat(directory.c_str(), &dirStat) != 0)
+  {
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0777);
+#endif
+  }
+  if (stat(directory.c_str(), &dirStat) != 0 || !(dirStat.st_mode & S_IFDIR))
+    throw std::runtime_error("Cannot create plan cache directory: " +
+                             directory);
+}
+
+std::string gpuNUFFT::PlanCache::getPlanPath(const std::string &key) const
+{
+  return directory + "/" + key + PLAN_EXTENSION;
+}
+
+std::string gpuNUFFT::PlanCache::lookup(const std::string &key)
+{
+  std::string path = getPlanPath(key);
+  PlanEntry entry;
+  bool hit = getPlanEntry(path, entry);
+  if (hit)
+    touch(path);
+
+  std::lock_guard<std::mutex> lock(statisticsMutex);
+  if (hit)
+    statistics.hits++;
+  else
+    statistics.misses++;
+  return hit ? path : std::string();
+}
+
+void gpuNUFFT::PlanCache::discard(const std::string &key)
+{
+  remove(getPlanPath(key).c_str());
+
+  std::lock_guard<std::mutex> lock(statisticsMutex);
+  if (statistics.hits > 0)
+    statistics.hits--;
+  statistics.misses++;
+}
+
+void gpuNUFFT::PlanCache::store(
+    const std::string &key,
+    const std::function<void(const std::string &)> &writePlan)
+{
+  std::string path = getPlanPath(key);
+  std::string temporaryPath = getTemporaryPath(path);
+  try
+  {
+    writePlan(temporaryPath);
+  }
+  catch (...)
+  {
+    remove(temporaryPath.c_str());
+    throw;
+  }
+
+  // another process may have stored the same plan in the meantime, which
+  // is identical to this one
+#ifdef _WIN32
+  bool renamed = MoveFileExA(temporaryPath.c_str(), path.c_str(),
+                             MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  bool renamed = rename(temporaryPath.c_str(), path.c_str()) == 0;
+#endif
+  if (!renamed)
+    remove(temporaryPath.c_str());
+
+  {
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    if (renamed)
+      statistics.stores++;
+  }
+  evict(path);
+}
+
+void gpuNUFFT::PlanCache::evict(const std::string &keepPath)
+{
+  std::vector<PlanEntry> plans = listPlans(directory);
+  uint64_t size = 0;
+  for (size_t i = 0; i < plans.size(); i++)
+    size += plans[i].size;
+  if (size <= maxSize)
+    return;
+
+  std::sort(plans.begin(), plans.end());
+  uint64_t evicted = 0;
+  for (size_t i = 0; i < plans.size() && size > maxSize; i++)
+  {
+    if (plans[i].path == keepPath)
+      continue;
+    // removing may fail if the plan is in use on Windows
+    if (remove(plans[i].path.c_str()) == 0)
+    {
+      size -= plans[i].size;
+      evicted++;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(statisticsMutex);
+  statistics.evictions += evicted;
+}
+
+void gpuNUFFT::PlanCache::clear()
+{
+  std::vector<PlanEntry> plans = listPlans(directory);
+  for (size_t i = 0; i < plans.size(); i++)
+    remove(plans[i].path.c_str());
+}
+
+uint64_t gpuNUFFT::PlanCache::getSize() const
+{
+  std::vector<PlanEntry> plans = listPlans(directory);
+  uint64_t size = 0;
+  for (size_t i = 0; i < plans.size(); i++)
+    size += plans[i].size;
+  return size;
+}
+
+gpuNUFFT::PlanCache::Statistics gpuNUFFT::PlanCache::getStatistics() const
+{
+  std::lock_guard<std::mutex> lock(statisticsMutex);
+  return statistics;
+}
+
+void gpuNUFFT::PlanCache::resetStatistics()
+{
+  std::lock_guard<std::mutex> lock(statisticsMutex);
+  statistics = Statistics();
+}
@@ -0,0 +1,232 @@
+#include "toeplitz_normal_operator.hpp"
+#include "gpuNUFFT_operator_factory.hpp"
+#include "gpuNUFFT_cpu_fft.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+/** \brief Image element count per work item */
+const IndType ELEMENTS_PER_TASK = 8192;
+
+/** \brief Execute f(begin, end) for consecutive blocks of [0, count) in
+ * parallel */
+template <typename Function>
+void parallelForRange(IndType count, gpuNUFFT::ThreadPool *threadPool,
+                      const Function &f)
+{
+  IndType taskCount = (count + ELEMENTS_PER_TASK - 1) / ELEMENTS_PER_TASK;
+  threadPool->parallelFor(taskCount, [&](IndType task, unsigned)
+                          {
+                            IndType begin = task * ELEMENTS_PER_TASK;
+                            f(begin,
+                              std::min(begin + ELEMENTS_PER_TASK, count));
+                          });
+}
+
+/** \brief Index of image position ind inside of the embedding grid */
+inline IndType computeEmbeddingIndex(IndType ind, gpuNUFFT::Dimensions &img,
+                                     gpuNUFFT::Dimensions &grid)
+{
+  IndType x = ind % img.width;
+  IndType y = (ind / img.width) % img.height;
+  IndType z = ind / (img.width * img.height);
+  return x + grid.width * (y + grid.height * z);
+}
+}
+
+gpuNUFFT::ToeplitzNormalOperator::ToeplitzNormalOperator(
+    GpuNUFFTOperator *gpuNUFFTOp, ThreadPool *threadPool)
+  : imgDims(gpuNUFFTOp->getImageDims()), coilCount(1), threadPool(threadPool)
+{
+  imgDims.channels = 1;
+  embeddingDims = Dimensions(2 * imgDims.width, 2 * imgDims.height,
+                             2 * imgDims.depth);
+
+  if (gpuNUFFTOp->applySensData())
+  {
+    Array<DType2> sensData = gpuNUFFTOp->getSens();
+    coilCount = sensData.dim.channels;
+    sens.assign(sensData.data, sensData.data + imgDims.count() * coilCount);
+  }
+
+  computeTransferFunction(gpuNUFFTOp);
+}
+
+void gpuNUFFT::ToeplitzNormalOperator::computeTransferFunction(
+    GpuNUFFTOperator *gpuNUFFTOp)
+{
+  ThreadPool *pool = getThreadPool();
+
+  // operator of the same type and trajectory for twice the image size, the
+  // trajectory is already sorted by sector
+  GpuNUFFTOperatorFactory factory(false, gpuNUFFTOp->getType() != CPU,
+                                  false);
+  Array<DType> kSpaceTraj = gpuNUFFTOp->getKSpaceTraj();
+  IndType dataCount = kSpaceTraj.count();
+  IndType coordCount = dataCount * gpuNUFFTOp->getImageDimensionCount();
+  Array<DType> trajCopy;
+  trajCopy.dim = kSpaceTraj.dim;
+  trajCopy.data = (DType *)malloc(coordCount * sizeof(DType));
+  memcpy(trajCopy.data, kSpaceTraj.data, coordCount * sizeof(DType));
+
+  Dimensions psfDims = embeddingDims;
+  GpuNUFFTOperator *psfOp = factory.createGpuNUFFTOperator(
+      trajCopy, gpuNUFFTOp->getKernelWidth(), gpuNUFFTOp->getSectorWidth(),
+      gpuNUFFTOp->getOsf(), psfDims);
+  free(trajCopy.data);
+
+  // the density compensation is applied by forward and adjoint operation
+  // with the square root of the weights each, unused slots do not contribute
+  Array<DType> dens = gpuNUFFTOp->getDens();
+  Array<IndType> dataIndices = gpuNUFFTOp->getDataIndices();
+  Array<DType2> weights;
+  weights.data = (DType2 *)malloc(dataCount * sizeof(DType2));
+  weights.dim.length = dataCount;
+  for (IndType i = 0; i < dataCount; i++)
+  {
+    weights.data[i].x = gpuNUFFTOp->applyDensComp() ? dens.data[i] : 1;
+    if (dataIndices.data[i] == INVALID_DATA_INDEX)
+      weights.data[i].x = 0;
+    weights.data[i].y = 0;
+  }
+
+  Array<CufftType> psf = psfOp->performGpuNUFFTAdj(weights);
+  free(weights.data);
+  delete psfOp;
+
+  // PSF(d) for d in [-N, N) is located at image position d + N of psf. Both
+  // NUFFTs scale by 1 / sqrt(N), the PSF operator by 1 / sqrt(2^dim N) and
+  // the inverse FFT of the application is not normalized.
+  IndType embeddingCount = embeddingDims.count();
+  DType scale = (DType)(1.0 / ((double)imgDims.count() *
+                               std::sqrt((double)embeddingCount)));
+  IndType depth = DEFAULT_VALUE(embeddingDims.depth);
+
+  IndType width = embeddingDims.width;
+  IndType height = embeddingDims.height;
+  transferFunction.resize(embeddingCount);
+  pool->parallelFor(depth, [&](IndType z, unsigned)
+                    {
+                      IndType psf_z = (z + depth / 2) % depth;
+                      for (IndType y = 0; y < height; y++)
+                      {
+                        IndType psf_y = (y + height / 2) % height;
+                        for (IndType x = 0; x < width; x++)
+                        {
+                          IndType psf_x = (x + width / 2) % width;
+                          IndType psf_ind =
+                              psf_x + width * (psf_y + height * psf_z);
+                          IndType ind = x + width * (y + height * z);
+                          transferFunction[ind].x = psf.data[psf_ind].x * scale;
+                          transferFunction[ind].y = psf.data[psf_ind].y * scale;
+                        }
+                      }
+                    });
+  free(psf.data);
+
+  CpuFFTPlan::getPlan(embeddingDims, CUFFT_FORWARD)
+      .execute(transferFunction.data(), pool, &fftScratch);
+}
+
+void gpuNUFFT::ToeplitzNormalOperator::performNormal(
+    Array<DType2> imgData, Array<CufftType> &normalData)
+{
+  ThreadPool *pool = getThreadPool();
+  bool applySens = !sens.empty();
+  IndType imgCount = imgDims.count();
+  IndType channels = applySens ? coilCount : imgData.dim.channels;
+  IndType outChannels = applySens ? 1 : channels;
+
+  if (imgData.count() != imgCount * outChannels ||
+      normalData.count() < imgCount * outChannels)
+    throw std::invalid_argument(
+        "Image dimensions do not match the Toeplitz normal operator!");
+
+  const CpuFFTPlan &forwardPlan =
+      CpuFFTPlan::getPlan(embeddingDims, CUFFT_FORWARD);
+  const CpuFFTPlan &inversePlan =
+      CpuFFTPlan::getPlan(embeddingDims, CUFFT_INVERSE);
+
+  CufftType zero;
+  zero.x = 0;
+  zero.y = 0;
+  grid.resize(embeddingDims.count());
+  if (applySens)
+    std::fill(normalData.data, normalData.data + imgCount, zero);
+
+  for (IndType c = 0; c < channels; c++)
+  {
+    DType2 *img = applySens ? imgData.data : imgData.data + c * imgCount;
+    CufftType *out =
+        applySens ? normalData.data : normalData.data + c * imgCount;
+    DType2 *coilSens = applySens ? sens.data() + c * imgCount : NULL;
+
+    // zero pad (S_c) x
+    std::fill(grid.begin(), grid.end(), zero);
+    parallelForRange(imgCount, pool, [&](IndType begin, IndType end)
+                     {
+                       for (IndType t = begin; t < end; t++)
+                       {
+                         CufftType &g = grid[computeEmbeddingIndex(
+                             t, imgDims, embeddingDims)];
+                         g.x = img[t].x;
+                         g.y = img[t].y;
+                         if (coilSens != NULL)
+                         {
+                           g.x = img[t].x * coilSens[t].x -
+                                 img[t].y * coilSens[t].y;
+                           g.y = img[t].x * coilSens[t].y +
+                                 img[t].y * coilSens[t].x;
+                         }
+                       }
+                     });
+
+    forwardPlan.execute(grid.data(), pool, &fftScratch);
+    parallelForRange(embeddingDims.count(), pool,
+                     [&](IndType begin, IndType end)
+                     {
+                       for (IndType t = begin; t < end; t++)
+                       {
+                         CufftType g = grid[t];
+                         const CufftType &h = transferFunction[t];
+                         grid[t].x = g.x * h.x - g.y * h.y;
+                         grid[t].y = g.x * h.y + g.y * h.x;
+                       }
+                     });
+    inversePlan.execute(grid.data(), pool, &fftScratch);
+
+    // crop and apply conj(S_c)
+    parallelForRange(imgCount, pool, [&](IndType begin, IndType end)
+                     {
+                       for (IndType t = begin; t < end; t++)
+                       {
+                         const CufftType &g = grid[computeEmbeddingIndex(
+                             t, imgDims, embeddingDims)];
+                         if (coilSens == NULL)
+                         {
+                           out[t] = g;
+                           continue;
+                         }
+                         out[t].x += g.x * coilSens[t].x +
+                                     g.y * coilSens[t].y;
+                         out[t].y += g.y * coilSens[t].x -
+                                     g.x * coilSens[t].y;
+                       }
+                     });
+  }
+}
+
+gpuNUFFT::Array<CufftType>
+gpuNUFFT::ToeplitzNormalOperator::performNormal(Array<DType2> imgData)
+{
+  Array<CufftType> normalData;
+  normalData.dim = imgData.dim;
+  normalData.data = (CufftType *)calloc(imgData.count(), sizeof(CufftType));
+
+  performNormal(imgData, normalData);
+  return normalData;
+}
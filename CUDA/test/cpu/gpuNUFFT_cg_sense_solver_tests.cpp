@@ -0,0 +1,308 @@
+#include <limits.h>
+#include <vector>
+#include <complex>
+#include <cmath>
+#include "cg_sense_solver.hpp"
+#include "gpuNUFFT_operator_factory.hpp"
+
+#include "gtest/gtest.h"
+
+namespace
+{
+typedef std::complex<double> Complex;
+
+const double PI = 3.14159265358979323846;
+
+// radial spokes through the k-space center, 3-d spokes are tilted
+gpuNUFFT::Array<DType> createRadialTrajectory(IndType spokeCnt, IndType readoutCnt, int dimCount)
+{
+	IndType coordCnt = spokeCnt * readoutCnt;
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = (DType*)calloc(coordCnt * dimCount, sizeof(DType));
+	kSpaceTraj.dim.length = coordCnt;
+	for (IndType s = 0; s < spokeCnt; s++)
+	{
+		double phi = PI * s / spokeCnt;
+		double theta = PI * (0.5 + 0.3 * std::sin(7.0 * phi));
+		for (IndType r = 0; r < readoutCnt; r++)
+		{
+			IndType i = s * readoutCnt + r;
+			double radius = (double)r / readoutCnt - 0.5;
+			double planar = dimCount == 3 ? std::sin(theta) : 1.0;
+			kSpaceTraj.data[i] = (DType)(radius * planar * std::cos(phi));
+			kSpaceTraj.data[coordCnt + i] = (DType)(radius * planar * std::sin(phi));
+			if (dimCount == 3)
+				kSpaceTraj.data[2 * coordCnt + i] = (DType)(radius * std::cos(theta));
+		}
+	}
+	return kSpaceTraj;
+}
+
+// ramp density compensation of the radial spokes
+gpuNUFFT::Array<DType> createRampDensity(IndType spokeCnt, IndType readoutCnt)
+{
+	gpuNUFFT::Array<DType> densData;
+	densData.data = (DType*)calloc(spokeCnt * readoutCnt, sizeof(DType));
+	densData.dim.length = spokeCnt * readoutCnt;
+	for (IndType i = 0; i < spokeCnt * readoutCnt; i++)
+	{
+		double radius = std::fabs((double)(i % readoutCnt) / readoutCnt - 0.5);
+		densData.data[i] = (DType)(radius + 0.5 / readoutCnt);
+	}
+	return densData;
+}
+
+// Shepp-Logan like phantom of ellipses (ellipsoids in 3-d)
+gpuNUFFT::Array<DType2> createPhantom(gpuNUFFT::Dimensions imgDims)
+{
+	const double ellipses[5][5] = {
+		// intensity, center x, center y, half axis x, half axis y
+		{ 1.0, 0.0, 0.0, 0.69, 0.92 },
+		{ -0.8, 0.0, -0.02, 0.62, 0.87 },
+		{ -0.2, 0.22, 0.0, 0.11, 0.31 },
+		{ -0.2, -0.22, 0.0, 0.16, 0.41 },
+		{ 0.3, 0.0, 0.35, 0.21, 0.25 } };
+	IndType depth = DEFAULT_VALUE(imgDims.depth);
+	gpuNUFFT::Array<DType2> phantom;
+	phantom.data = (DType2*)calloc(imgDims.count(), sizeof(DType2));
+	phantom.dim = imgDims;
+	for (IndType i = 0; i < imgDims.count(); i++)
+	{
+		double x = 2.0 * (i % imgDims.width) / imgDims.width - 1.0;
+		double y = 2.0 * ((i / imgDims.width) % imgDims.height) / imgDims.height - 1.0;
+		double z = imgDims.depth > 0 ? 2.0 * (i / (imgDims.width * imgDims.height)) / depth - 1.0 : 0.0;
+		for (int e = 0; e < 5; e++)
+		{
+			double dx = (x - ellipses[e][1]) / ellipses[e][3];
+			double dy = (y - ellipses[e][2]) / ellipses[e][4];
+			double dz = z / 0.9;
+			if (dx * dx + dy * dy + dz * dz <= 1.0)
+				phantom.data[i].x += (DType)ellipses[e][0];
+		}
+	}
+	return phantom;
+}
+
+// smooth complex coil sensitivities placed around the field of view
+gpuNUFFT::Array<DType2> createSensitivities(gpuNUFFT::Dimensions imgDims, IndType coilCnt)
+{
+	IndType imgCount = imgDims.count();
+	gpuNUFFT::Array<DType2> sens;
+	sens.data = (DType2*)calloc(imgCount * coilCnt, sizeof(DType2));
+	sens.dim = imgDims;
+	sens.dim.channels = coilCnt;
+	for (IndType c = 0; c < coilCnt; c++)
+	{
+		double angle = 2.0 * PI * c / coilCnt;
+		for (IndType i = 0; i < imgCount; i++)
+		{
+			double x = (double)(i % imgDims.width) / imgDims.width - 0.5 - 0.7 * std::cos(angle);
+			double y = (double)((i / imgDims.width) % imgDims.height) / imgDims.height - 0.5 - 0.7 * std::sin(angle);
+			double magnitude = std::exp(-(x * x + y * y));
+			double phase = angle + x - y;
+			sens.data[c * imgCount + i].x = (DType)(magnitude * std::cos(phase));
+			sens.data[c * imgCount + i].y = (DType)(magnitude * std::sin(phase));
+		}
+	}
+	return sens;
+}
+
+// Port of the CG iterations of matlab/demo/utils/cg_sense_2d.m (coil loop
+// variant): every coil is processed by separate forward and adjoint
+// operations of the single coil operator FT, as done by the MEX files
+std::vector<Complex> solveMatlabCG(gpuNUFFT::GpuNUFFTOperator *FT, gpuNUFFT::Array<DType2> data, gpuNUFFT::Array<DType2> c, double alpha, int maxit)
+{
+	gpuNUFFT::Dimensions imgDims = FT->getImageDims();
+	IndType n = imgDims.count();
+	IndType nc = c.dim.channels;
+	IndType dataCount = data.dim.length;
+
+	// right hand side: sum_c conj(c_c) .* FT' * data_c
+	std::vector<Complex> y(n);
+	for (IndType ii = 0; ii < nc; ii++)
+	{
+		gpuNUFFT::Array<DType2> coilData;
+		coilData.data = data.data + ii * dataCount;
+		coilData.dim.length = dataCount;
+		gpuNUFFT::Array<CufftType> adj = FT->performGpuNUFFTAdj(coilData);
+		for (IndType i = 0; i < n; i++)
+			y[i] += std::conj(Complex(c.data[ii * n + i].x, c.data[ii * n + i].y)) * Complex(adj.data[i].x, adj.data[i].y);
+		free(adj.data);
+	}
+
+	// system matrix: sum_c conj(c_c) .* FT' * (FT * (c_c .* x)) + alpha x
+	std::vector<DType2> coilImage(n);
+	gpuNUFFT::Array<DType2> dx;
+	dx.data = &coilImage[0];
+	dx.dim = imgDims;
+	std::vector<Complex> x(n), r(y), p(r), Ap(n);
+	double rr = 0;
+	for (IndType i = 0; i < n; i++)
+		rr += std::norm(r[i]);
+	for (int it = 0; it < maxit; it++)
+	{
+		for (IndType i = 0; i < n; i++)
+			Ap[i] = alpha * p[i];
+		for (IndType ii = 0; ii < nc; ii++)
+		{
+			for (IndType i = 0; i < n; i++)
+			{
+				Complex v = Complex(c.data[ii * n + i].x, c.data[ii * n + i].y) * p[i];
+				coilImage[i].x = (DType)v.real();
+				coilImage[i].y = (DType)v.imag();
+			}
+			gpuNUFFT::Array<CufftType> forw = FT->performForwardGpuNUFFT(dx);
+			gpuNUFFT::Array<CufftType> adj = FT->performGpuNUFFTAdj(forw);
+			for (IndType i = 0; i < n; i++)
+				Ap[i] += std::conj(Complex(c.data[ii * n + i].x, c.data[ii * n + i].y)) * Complex(adj.data[i].x, adj.data[i].y);
+			free(forw.data);
+			free(adj.data);
+		}
+
+		Complex pAp = 0;
+		for (IndType i = 0; i < n; i++)
+			pAp += std::conj(p[i]) * Ap[i];
+		Complex a = rr / pAp;
+		double rnew = 0;
+		for (IndType i = 0; i < n; i++)
+		{
+			x[i] += a * p[i];
+			r[i] -= a * Ap[i];
+			rnew += std::norm(r[i]);
+		}
+		double b = rnew / rr;
+		rr = rnew;
+		for (IndType i = 0; i < n; i++)
+			p[i] = r[i] + b * p[i];
+	}
+	return x;
+}
+
+void expectNearSolution(const std::vector<Complex> &expected, gpuNUFFT::Array<CufftType> actual, double tolerance)
+{
+	double maxAbs = 0;
+	for (size_t i = 0; i < expected.size(); i++)
+		maxAbs = std::max(maxAbs, std::abs(expected[i]));
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		EXPECT_NEAR(expected[i].real(), actual.data[i].x, tolerance * maxAbs) << "at " << i;
+		EXPECT_NEAR(expected[i].imag(), actual.data[i].y, tolerance * maxAbs) << "at " << i;
+	}
+}
+
+// solver result matches the MATLAB CG for the sensitivities applied by the
+// operator and by the solver
+void checkCgSense(gpuNUFFT::Dimensions imgDims, IndType coilCnt, DType alpha, int maxit)
+{
+	IndType spokeCnt = 2 * imgDims.width;
+	IndType readoutCnt = 2 * imgDims.width;
+	int dimCount = imgDims.depth > 0 ? 3 : 2;
+	gpuNUFFT::Array<DType2> sens = createSensitivities(imgDims, coilCnt);
+	gpuNUFFT::Array<DType2> phantom = createPhantom(imgDims);
+	gpuNUFFT::Array<DType2> noSens;
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::Array<DType> senseTraj = createRadialTrajectory(spokeCnt, readoutCnt, dimCount);
+	gpuNUFFT::Array<DType> senseDens = createRampDensity(spokeCnt, readoutCnt);
+	gpuNUFFT::GpuNUFFTOperator *senseOp = factory.createGpuNUFFTOperator(senseTraj, senseDens, sens, 3, 8, (DType)2.0, imgDims);
+	gpuNUFFT::Array<DType> coilTraj = createRadialTrajectory(spokeCnt, readoutCnt, dimCount);
+	gpuNUFFT::Array<DType> coilDens = createRampDensity(spokeCnt, readoutCnt);
+	gpuNUFFT::GpuNUFFTOperator *coilOp = factory.createGpuNUFFTOperator(coilTraj, coilDens, noSens, 3, 8, (DType)2.0, imgDims);
+
+	// density compensated coil data of the phantom
+	gpuNUFFT::Array<CufftType> kspace = senseOp->performForwardGpuNUFFT(phantom);
+	gpuNUFFT::Array<DType2> kspaceData;
+	kspaceData.data = kspace.data;
+	kspaceData.dim = kspace.dim;
+
+	std::vector<Complex> expected = solveMatlabCG(coilOp, kspaceData, sens, alpha, maxit);
+
+	gpuNUFFT::CgSenseSolver senseSolver(senseOp);
+	senseSolver.setMaxIterations(maxit);
+	senseSolver.setRegularization(alpha);
+	gpuNUFFT::Array<CufftType> senseResult = senseSolver.solve(kspaceData);
+	EXPECT_EQ((size_t)maxit + 1, senseSolver.getResidualNorms().size());
+	expectNearSolution(expected, senseResult, 1e-3);
+
+	gpuNUFFT::CgSenseSolver coilSolver(coilOp, sens);
+	coilSolver.setMaxIterations(maxit);
+	coilSolver.setRegularization(alpha);
+	gpuNUFFT::Array<CufftType> coilResult = coilSolver.solve(kspaceData);
+	expectNearSolution(expected, coilResult, 1e-3);
+
+	free(coilResult.data);
+	free(senseResult.data);
+	free(kspace.data);
+	free(phantom.data);
+	free(sens.data);
+	free(senseTraj.data);
+	free(senseDens.data);
+	free(coilTraj.data);
+	free(coilDens.data);
+	delete senseOp;
+	delete coilOp;
+}
+}
+
+TEST(CgSenseSolverTest, MatchesMatlabCG2D)
+{
+	checkCgSense(gpuNUFFT::Dimensions(32, 32), 4, (DType)0.0, 10);
+}
+
+TEST(CgSenseSolverTest, MatchesMatlabCGTikhonov2D)
+{
+	checkCgSense(gpuNUFFT::Dimensions(32, 24), 3, (DType)0.05, 8);
+}
+
+TEST(CgSenseSolverTest, MatchesMatlabCG3D)
+{
+	checkCgSense(gpuNUFFT::Dimensions(16, 16, 8), 4, (DType)0.01, 5);
+}
+
+TEST(CgSenseSolverTest, ToleranceAndRepeatedSolves)
+{
+	gpuNUFFT::Dimensions imgDims(32, 32);
+	IndType coilCnt = 4;
+	gpuNUFFT::Array<DType2> sens = createSensitivities(imgDims, coilCnt);
+	gpuNUFFT::Array<DType2> phantom = createPhantom(imgDims);
+	gpuNUFFT::Array<DType> kSpaceTraj = createRadialTrajectory(64, 64, 2);
+	gpuNUFFT::Array<DType> densData = createRampDensity(64, 64);
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::GpuNUFFTOperator *op = factory.createGpuNUFFTOperator(kSpaceTraj, densData, sens, 3, 8, (DType)2.0, imgDims);
+	gpuNUFFT::Array<CufftType> kspace = op->performForwardGpuNUFFT(phantom);
+	gpuNUFFT::Array<DType2> kspaceData;
+	kspaceData.data = kspace.data;
+	kspaceData.dim = kspace.dim;
+
+	gpuNUFFT::CgSenseSolver solver(op);
+	solver.setMaxIterations(50);
+	solver.setTolerance((DType)1e-2);
+	gpuNUFFT::Array<CufftType> first = solver.solve(kspaceData);
+	std::vector<double> norms = solver.getResidualNorms();
+	int iterations = (int)norms.size() - 1;
+	EXPECT_LT(iterations, 50);
+	EXPECT_LE(norms.back(), 1e-2 * norms.front());
+	EXPECT_GT(norms[iterations - 1], 1e-2 * norms.front());
+
+	// buffers are reused, the result is reproduced exactly
+	gpuNUFFT::Array<CufftType> second = solver.solve(kspaceData);
+	EXPECT_EQ(norms, solver.getResidualNorms());
+	for (IndType i = 0; i < imgDims.count(); i++)
+	{
+		EXPECT_EQ(first.data[i].x, second.data[i].x);
+		EXPECT_EQ(first.data[i].y, second.data[i].y);
+	}
+
+	// the sensitivities must not be applied twice
+	EXPECT_THROW(gpuNUFFT::CgSenseSolver(op, sens), std::invalid_argument);
+
+	free(second.data);
+	free(first.data);
+	free(kspace.data);
+	free(phantom.data);
+	free(sens.data);
+	free(kSpaceTraj.data);
+	free(densData.data);
+	delete op;
+}
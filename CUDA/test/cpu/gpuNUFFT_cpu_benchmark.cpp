@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+#include "gpuNUFFT_cpu.hpp"
+#include "gpuNUFFT_cpu_kernels.hpp"
+#include "gpuNUFFT_cpu_simd.hpp"
+
+//Microbenchmark of the host gridding inner loop.
+//
+//Reports grid updates per second of the former per grid point loop (three
+//kernel lookups per grid point) and of the convolutions of the CPU operator
+//(performConvolutionCPU and performForwardConvolutionCPU) for each supported
+//instruction set level.
+//
+//usage: runCpuBenchmark [grid width] [kernel width] [samples per sector] [threads]
+
+//sector sorted random samples, every sector contains samples_per_sector
+void createSamples(gpuNUFFT::GpuNUFFTInfo *gi_host, int samples_per_sector, std::vector<DType> &data, std::vector<DType> &coords, std::vector<int> &sectors, std::vector<int> &sector_centers)
+{
+	int grid = gi_host->gridDims.x;
+	int sw = gi_host->sector_width;
+	int spd = grid / sw;
+	int sector_count = gi_host->sector_count;
+
+	data.resize(2*sector_count*samples_per_sector);
+	coords.resize(3*sector_count*samples_per_sector);
+	sectors.resize(sector_count+1);
+	sector_centers.resize(3*sector_count);
+
+	int data_cnt = 0;
+	for (int sec = 0; sec < sector_count; sec++)
+	{
+		int s[3] = {sec % spd, (sec / spd) % spd, sec / (spd*spd)};
+		sectors[sec] = data_cnt;
+		for (int d = 0; d < 3; d++)
+			sector_centers[3*sec+d] = s[d] * sw + sw / 2;
+		for (int i = 0; i < samples_per_sector; i++, data_cnt++)
+		{
+			for (int d = 0; d < 3; d++)
+				coords[3*data_cnt+d] = ((s[d] + 0.99f * (DType)rand() / RAND_MAX) * sw - 0.49f) / (DType)grid - 0.5f;
+			data[2*data_cnt] = (DType)rand() / RAND_MAX - 0.5f;
+			data[2*data_cnt+1] = (DType)rand() / RAND_MAX - 0.5f;
+		}
+	}
+	sectors[sector_count] = data_cnt;
+}
+
+//former scalar gridding loop, returns the amount of grid updates
+long gridScalarReference(DType *data, DType *crds, DType *gdata, DType *kernel, int *sectors, int *sector_centers, gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+	int width = gi_host->gridDims.x;
+	int pad = gi_host->sector_pad_width;
+	int offset = gi_host->sector_offset;
+	DType radiusSquared = gi_host->radiusSquared;
+	DType dist_multiplier = gi_host->dist_multiplier;
+	std::vector<DType> sdata(2*gi_host->sector_dim);
+	long updates = 0;
+
+	for (int sec = 0; sec < gi_host->sector_count; sec++)
+	{
+		std::fill(sdata.begin(), sdata.end(), (DType)0.0);
+		int *center = &sector_centers[3*sec];
+		for (int data_cnt = sectors[sec]; data_cnt < sectors[sec+1]; data_cnt++)
+		{
+			DType x = crds[3*data_cnt], y = crds[3*data_cnt+1], z = crds[3*data_cnt+2];
+			int imin, imax, jmin, jmax, kmin, kmax;
+			DType ix = (x + 0.5f) * width - center[0] + offset;
+			set_minmax(&ix, &imin, &imax, gi_host->sector_pad_max, gi_host->kernel_radius);
+			DType jy = (y + 0.5f) * width - center[1] + offset;
+			set_minmax(&jy, &jmin, &jmax, gi_host->sector_pad_max, gi_host->kernel_radius);
+			DType kz = (z + 0.5f) * width - center[2] + offset;
+			set_minmax(&kz, &kmin, &kmax, gi_host->sector_pad_max, gi_host->kernel_radius);
+
+			for (int k = kmin; k <= kmax; k++)
+			{
+				DType dz_sqr = (DType)(k + center[2] - offset) / (DType)width - 0.5f - z;
+				dz_sqr *= dz_sqr;
+				if (dz_sqr >= radiusSquared)
+					continue;
+				for (int j = jmin; j <= jmax; j++)
+				{
+					DType dy_sqr = (DType)(j + center[1] - offset) / (DType)width - 0.5f - y;
+					dy_sqr *= dy_sqr;
+					if (dy_sqr >= radiusSquared)
+						continue;
+					for (int i = imin; i <= imax; i++)
+					{
+						DType dx_sqr = (DType)(i + center[0] - offset) / (DType)width - 0.5f - x;
+						dx_sqr *= dx_sqr;
+						if (dx_sqr >= radiusSquared)
+							continue;
+						DType val = kernel[(int)round(dz_sqr * dist_multiplier)] *
+							kernel[(int)round(dy_sqr * dist_multiplier)] *
+							kernel[(int)round(dx_sqr * dist_multiplier)];
+						int ind = getIndex(i, j, k, pad);
+						sdata[2*ind] += val * data[2*data_cnt];
+						sdata[2*ind+1] += val * data[2*data_cnt+1];
+						updates++;
+					}
+				}
+			}
+		}
+		//merge sector
+		for (int z = 0; z < pad; z++)
+			for (int y = 0; y < pad; y++)
+				for (int x = 0; x < pad; x++)
+				{
+					if (isOutlier(x, y, z, center[0], center[1], center[2], width, offset))
+						continue;
+					int s_ind = 2*getIndex(x, y, z, pad);
+					int ind = 2*getIndex(center[0] - offset + x, center[1] - offset + y, center[2] - offset + z, width);
+					gdata[ind] += sdata[s_ind];
+					gdata[ind+1] += sdata[s_ind+1];
+				}
+	}
+	return updates;
+}
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	int width = argc > 1 ? atoi(argv[1]) : 64;
+	int kernel_width = argc > 2 ? atoi(argv[2]) : 5;
+	int samples_per_sector = argc > 3 ? atoi(argv[3]) : 400;
+	unsigned threads = argc > 4 ? (unsigned)atoi(argv[4]) : 1;
+	int repetitions = 3;
+
+	float osr = DEFAULT_OVERSAMPLING_RATIO;
+	long kernel_entries = calculateGrid3KernelSize(osr, kernel_width);
+	std::vector<DType> kern(kernel_entries);
+	load1DKernel(kern.data(), kernel_entries, kernel_width, osr);
+
+	gpuNUFFT::GpuNUFFTInfo gi_host;
+	initGpuNUFFTInfoCPU(&gi_host, gpuNUFFT::Dimensions(width, width, width), 8, kernel_width, kernel_entries);
+
+	std::vector<DType> data, coords;
+	std::vector<int> sectors, sector_centers;
+	srand(1);
+	createSamples(&gi_host, samples_per_sector, data, coords, sectors, sector_centers);
+	std::vector<DType> gdata(2*gi_host.gridDims_count);
+
+	//layout of the operator: linearized coordinates and IndType sectors
+	IndType data_count = sectors.back();
+	gi_host.data_count = data_count;
+	std::vector<DType> crds(3*data_count);
+	for (IndType i = 0; i < data_count; i++)
+		for (int d = 0; d < 3; d++)
+			crds[d*data_count+i] = coords[3*i+d];
+	std::vector<IndType> sectorOffsets(sectors.begin(), sectors.end());
+	std::vector<IndType> centers(sector_centers.begin(), sector_centers.end());
+	std::vector<CufftType> samples(data_count);
+
+	printf("grid %d^3, kernel width %d, %d samples\n", width, kernel_width, sectors.back());
+
+	long updates = 0;
+	double best = 1e30;
+	for (int r = 0; r < repetitions; r++)
+	{
+		std::fill(gdata.begin(), gdata.end(), (DType)0.0);
+		Clock::time_point start = Clock::now();
+		updates = gridScalarReference(data.data(), coords.data(), gdata.data(), kern.data(), sectors.data(), sector_centers.data(), &gi_host);
+		best = std::min(best, secondsSince(start));
+	}
+	double reference = updates / best;
+	printf("%-16s %10.2f Mupdates/s\n", "reference loop", reference * 1e-6);
+
+	gpuNUFFT::ThreadPool pool(threads);
+	printf("%u threads\n", pool.getThreadCount());
+	gpuNUFFT::CpuSimdLevel defaultLevel = gpuNUFFT::getCpuSimdLevel();
+	for (int level = gpuNUFFT::SIMD_SCALAR; level <= gpuNUFFT::getSupportedCpuSimdLevel(); level++)
+	{
+		gpuNUFFT::setCpuSimdLevel((gpuNUFFT::CpuSimdLevel)level);
+		double adjoint = 1e30;
+		double forward = 1e30;
+		for (int r = 0; r < repetitions; r++)
+		{
+			std::fill(gdata.begin(), gdata.end(), (DType)0.0);
+			Clock::time_point start = Clock::now();
+			performConvolutionCPU((DType2*)data.data(), crds.data(), (CufftType*)gdata.data(), kern.data(), sectorOffsets.data(), centers.data(), &gi_host, &pool);
+			adjoint = std::min(adjoint, secondsSince(start));
+			start = Clock::now();
+			performForwardConvolutionCPU(samples.data(), crds.data(), (CufftType*)gdata.data(), kern.data(), sectorOffsets.data(), centers.data(), &gi_host, &pool);
+			forward = std::min(forward, secondsSince(start));
+		}
+		printf("%-16s adjoint %10.2f Mupdates/s (%.2fx), forward %10.2f Mupdates/s\n", gpuNUFFT::getCpuSimdLevelName((gpuNUFFT::CpuSimdLevel)level), updates / adjoint * 1e-6, updates / adjoint / reference, updates / forward * 1e-6);
+	}
+	gpuNUFFT::setCpuSimdLevel(defaultLevel);
+	return 0;
+}
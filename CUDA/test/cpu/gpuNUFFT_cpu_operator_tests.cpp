@@ -0,0 +1,2086 @@
+#include <limits.h>
+
+#include "gtest/gtest.h"
+#include "gpuNUFFT_operator_factory.hpp"
+#include "gpuNUFFT_cpu_fft.hpp"
+#include "gpuNUFFT_cpu_simd.hpp"
+#include "toeplitz_normal_operator.hpp"
+#include "gpuNUFFT_incremental_plan.hpp"
+
+#include <vector>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#ifdef _WIN32
+#include <direct.h>
+#define rmdir _rmdir
+#else
+#include <unistd.h>
+#endif
+
+#define EPS 0.0001
+
+namespace
+{
+// simple deterministic random numbers in [-0.5,0.5)
+DType nextRandom(unsigned &state)
+{
+	state = state * 1664525u + 1013904223u;
+	return (DType)((state >> 8) & 0xFFFF) / (DType)65536.0 - (DType)0.5;
+}
+
+gpuNUFFT::Array<DType> createRandomTrajectory(IndType coordCnt, int dimCount, unsigned seed)
+{
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = (DType*)calloc(coordCnt * dimCount, sizeof(DType));
+	kSpaceTraj.dim.length = coordCnt;
+	for (IndType i = 0; i < coordCnt * dimCount; i++)
+		kSpaceTraj.data[i] = nextRandom(seed);
+	return kSpaceTraj;
+}
+
+gpuNUFFT::Array<DType2> createRandomData(IndType count, IndType channels, unsigned seed)
+{
+	gpuNUFFT::Array<DType2> data;
+	data.data = (DType2*)calloc(count * channels, sizeof(DType2));
+	data.dim.length = count;
+	data.dim.channels = channels;
+	for (IndType i = 0; i < count * channels; i++)
+	{
+		data.data[i].x = nextRandom(seed);
+		data.data[i].y = nextRandom(seed);
+	}
+	return data;
+}
+
+std::vector<DType2> createRandomVector(IndType count, unsigned seed)
+{
+	std::vector<DType2> data(count);
+	for (IndType i = 0; i < count; i++)
+	{
+		data[i].x = nextRandom(seed);
+		data[i].y = nextRandom(seed);
+	}
+	return data;
+}
+
+// copies the result of an operator and frees it
+std::vector<CufftType> takeArray(gpuNUFFT::Array<CufftType> array)
+{
+	std::vector<CufftType> values(array.data, array.data + array.count());
+	free(array.data);
+	return values;
+}
+
+// random trajectory, density compensation, coil sensitivities, image and
+// k-space data of a CPU operator, released together with the operator
+struct RandomProblem
+{
+	RandomProblem(gpuNUFFT::Dimensions imgDims, IndType coordCnt, IndType coilCnt, bool useDens, bool useSens, unsigned seed)
+		: imgDims(imgDims), coordCnt(coordCnt), coilCnt(coilCnt), op(NULL)
+	{
+		kSpaceTraj = createRandomTrajectory(coordCnt, imgDims.depth > 0 ? 3 : 2, seed);
+		if (useDens)
+		{
+			densData.data = (DType*)malloc(coordCnt * sizeof(DType));
+			densData.dim.length = coordCnt;
+			unsigned densSeed = seed + 1;
+			for (IndType i = 0; i < coordCnt; i++)
+				densData.data[i] = nextRandom(densSeed) + (DType)1.0;
+		}
+		if (useSens)
+		{
+			sensData = createRandomData(imgDims.count(), coilCnt, seed + 2);
+			sensData.dim = imgDims;
+			sensData.dim.channels = coilCnt;
+		}
+		// one image channel with sens data, coilCnt channels otherwise
+		imgData = createRandomData(imgDims.count(), useSens ? 1 : coilCnt, seed + 3);
+		imgData.dim = imgDims;
+		imgData.dim.channels = useSens ? 1 : coilCnt;
+		kspaceData = createRandomData(coordCnt, coilCnt, seed + 4);
+	}
+
+	~RandomProblem()
+	{
+		delete op;
+		free(kspaceData.data);
+		free(imgData.data);
+		free(sensData.data);
+		free(densData.data);
+		free(kSpaceTraj.data);
+	}
+
+	gpuNUFFT::CpuNUFFTOperator *createOperator(IndType kernelWidth, DType osf)
+	{
+		gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+		op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, densData, sensData, kernelWidth, 8, osf, imgDims));
+		return op;
+	}
+
+	gpuNUFFT::Dimensions imgDims;
+	IndType coordCnt;
+	IndType coilCnt;
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	gpuNUFFT::Array<DType> densData;
+	gpuNUFFT::Array<DType2> sensData;
+	gpuNUFFT::Array<DType2> imgData;
+	gpuNUFFT::Array<DType2> kspaceData;
+	gpuNUFFT::CpuNUFFTOperator *op;
+
+ private:
+	RandomProblem(const RandomProblem &);
+	RandomProblem &operator=(const RandomProblem &);
+};
+
+// sum over conj(a) * b
+std::complex<double> innerProduct(DType2 *a, CufftType *b, IndType count)
+{
+	std::complex<double> sum(0.0, 0.0);
+	for (IndType i = 0; i < count; i++)
+		sum += std::conj(std::complex<double>(a[i].x, a[i].y)) * std::complex<double>(b[i].x, b[i].y);
+	return sum;
+}
+
+// checks <A x, y> = <x, A^H y> for random x, y
+void checkAdjointness(gpuNUFFT::Dimensions imgDims, IndType coordCnt, IndType coilCnt, bool useDens, bool useSens)
+{
+	int dimCount = imgDims.depth > 0 ? 3 : 2;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, dimCount, 42);
+
+	gpuNUFFT::Array<DType> densData;
+	if (useDens)
+	{
+		densData.data = (DType*)calloc(coordCnt, sizeof(DType));
+		densData.dim.length = coordCnt;
+		unsigned seed = 7;
+		for (IndType i = 0; i < coordCnt; i++)
+			densData.data[i] = nextRandom(seed) + (DType)1.0;
+	}
+
+	gpuNUFFT::Array<DType2> sensData;
+	if (useSens)
+	{
+		sensData = createRandomData(imgDims.count(), coilCnt, 11);
+		sensData.dim = imgDims;
+		sensData.dim.channels = coilCnt;
+	}
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::GpuNUFFTOperator *op = factory.createGpuNUFFTOperator(kSpaceTraj, densData, sensData, 3, 8, (DType)1.5, imgDims);
+	EXPECT_EQ(gpuNUFFT::CPU, op->getType());
+
+	// x: image (one channel with sens data, coilCnt channels otherwise)
+	gpuNUFFT::Array<DType2> imgData = createRandomData(imgDims.count(), useSens ? 1 : coilCnt, 3);
+	imgData.dim = imgDims;
+	imgData.dim.channels = useSens ? 1 : coilCnt;
+
+	// y: k-space data of all coils
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, coilCnt, 5);
+
+	gpuNUFFT::Array<CufftType> Ax = op->performForwardGpuNUFFT(imgData);
+	gpuNUFFT::Array<CufftType> AHy = op->performGpuNUFFTAdj(kspaceData);
+
+	EXPECT_EQ(coordCnt * coilCnt, Ax.count());
+	EXPECT_EQ(imgData.count(), AHy.count());
+
+	std::complex<double> lhs = innerProduct(kspaceData.data, Ax.data, coordCnt * coilCnt);
+	std::complex<double> rhs = std::conj(innerProduct(imgData.data, AHy.data, imgData.count()));
+
+	EXPECT_GT(std::abs(lhs), 0.0);
+	EXPECT_NEAR(0.0, std::abs(lhs - rhs) / std::abs(lhs), 1e-4);
+
+	free(Ax.data);
+	free(AHy.data);
+	free(imgData.data);
+	free(kspaceData.data);
+	free(kSpaceTraj.data);
+	if (useSens)
+		free(sensData.data);
+	if (useDens)
+		free(densData.data);
+	delete op;
+}
+}
+
+TEST(CpuOperatorTest, AdjointConvolutionCenterSample)
+{
+	// single sample in the k-space center
+	DType coords[3] = {0, 0, 0};
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = coords;
+	kSpaceTraj.dim.length = 1;
+
+	DType2 value;
+	value.x = 1;
+	value.y = 0;
+	gpuNUFFT::Array<DType2> dataArray;
+	dataArray.data = &value;
+	dataArray.dim.length = 1;
+
+	int im_width = 10;
+	gpuNUFFT::Dimensions imgDims(im_width, im_width, im_width);
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::GpuNUFFTOperator *op = factory.createGpuNUFFTOperator(kSpaceTraj, 3, 5, (DType)1.0, imgDims);
+
+	gpuNUFFT::Array<CufftType> gdataArray = op->performGpuNUFFTAdj(dataArray, gpuNUFFT::CONVOLUTION);
+	CufftType *gdata = gdataArray.data;
+
+	int center = 5 + im_width * (5 + im_width * 5);
+	EXPECT_NEAR(1.0f, gdata[center].x, EPS);
+	EXPECT_NEAR(0.4502, gdata[center - 1].x, EPS * 10.0f);
+	EXPECT_NEAR(0.4502, gdata[center + im_width].x, EPS * 10.0f);
+	EXPECT_NEAR(0.4502, gdata[center - im_width * im_width].x, EPS * 10.0f);
+	EXPECT_NEAR(0.2027, gdata[center + 1 + im_width].x, EPS * 10.0f);
+	EXPECT_NEAR(0.2027, gdata[center - 1 - im_width].x, EPS * 10.0f);
+
+	free(gdata);
+	delete op;
+}
+
+TEST(CpuOperatorTest, AdjointConvolutionCenterSample2D)
+{
+	DType coords[2] = {0, 0};
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = coords;
+	kSpaceTraj.dim.length = 1;
+
+	DType2 value;
+	value.x = 1;
+	value.y = 0;
+	gpuNUFFT::Array<DType2> dataArray;
+	dataArray.data = &value;
+	dataArray.dim.length = 1;
+
+	int im_width = 10;
+	gpuNUFFT::Dimensions imgDims(im_width, im_width);
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::GpuNUFFTOperator *op = factory.createGpuNUFFTOperator(kSpaceTraj, 3, 5, (DType)1.0, imgDims);
+
+	gpuNUFFT::Array<CufftType> gdataArray = op->performGpuNUFFTAdj(dataArray, gpuNUFFT::CONVOLUTION);
+	CufftType *gdata = gdataArray.data;
+
+	int center = 5 + im_width * 5;
+	EXPECT_NEAR(1.0f, gdata[center].x, EPS);
+	EXPECT_NEAR(0.4502, gdata[center - 1].x, EPS * 10.0f);
+	EXPECT_NEAR(0.4502, gdata[center + im_width].x, EPS * 10.0f);
+	EXPECT_NEAR(0.2027, gdata[center + 1 + im_width].x, EPS * 10.0f);
+
+	free(gdata);
+	delete op;
+}
+
+TEST(CpuOperatorTest, AdjointBoundarySampleWrapsAround)
+{
+	// sample at the lower k-space border contributes to both grid borders
+	DType coords[2] = {(DType)-0.5, 0};
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = coords;
+	kSpaceTraj.dim.length = 1;
+
+	DType2 value;
+	value.x = 1;
+	value.y = 0;
+	gpuNUFFT::Array<DType2> dataArray;
+	dataArray.data = &value;
+	dataArray.dim.length = 1;
+
+	int im_width = 16;
+	gpuNUFFT::Dimensions imgDims(im_width, im_width);
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::GpuNUFFTOperator *op = factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.0, imgDims);
+
+	gpuNUFFT::Array<CufftType> gdataArray = op->performGpuNUFFTAdj(dataArray, gpuNUFFT::CONVOLUTION);
+	CufftType *gdata = gdataArray.data;
+
+	int row = im_width * (im_width / 2);
+	EXPECT_NEAR(1.0f, gdata[row].x, EPS);
+	EXPECT_NEAR(0.4502, gdata[row + 1].x, EPS * 10.0f);
+	EXPECT_NEAR(0.4502, gdata[row + im_width - 1].x, EPS * 10.0f);
+
+	free(gdata);
+	delete op;
+}
+
+TEST(CpuOperatorTest, Adjointness3D)
+{
+	checkAdjointness(gpuNUFFT::Dimensions(16, 16, 16), 500, 1, false, false);
+}
+
+TEST(CpuOperatorTest, Adjointness2DMultiCoil)
+{
+	checkAdjointness(gpuNUFFT::Dimensions(32, 32), 1000, 3, true, false);
+}
+
+TEST(CpuOperatorTest, Adjointness2DSens)
+{
+	checkAdjointness(gpuNUFFT::Dimensions(32, 32), 1000, 2, true, true);
+}
+
+TEST(CpuOperatorTest, Adjointness3DAnisotropic)
+{
+	checkAdjointness(gpuNUFFT::Dimensions(16, 12, 8), 400, 2, false, true);
+}
+
+TEST(CpuOperatorTest, ThreadCountIndependentResult)
+{
+	gpuNUFFT::Dimensions imgDims(16, 16, 16);
+	IndType coordCnt = 2000;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 3, 13);
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, 1, 17);
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims));
+
+	gpuNUFFT::ThreadPool serialPool(1);
+	gpuNUFFT::ThreadPool parallelPool(4);
+
+	op->setThreadPool(&serialPool);
+	gpuNUFFT::Array<CufftType> serial = op->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+	op->setThreadPool(&parallelPool);
+	gpuNUFFT::Array<CufftType> parallel = op->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+
+	for (IndType i = 0; i < serial.count(); i++)
+	{
+		EXPECT_NEAR(serial.data[i].x, parallel.data[i].x, EPS);
+		EXPECT_NEAR(serial.data[i].y, parallel.data[i].y, EPS);
+	}
+
+	free(serial.data);
+	free(parallel.data);
+	free(kspaceData.data);
+	free(kSpaceTraj.data);
+	delete op;
+}
+
+void checkSpaceFillingCurve(gpuNUFFT::Dimensions imgDims, gpuNUFFT::SpaceFillingCurve curve)
+{
+	IndType coordCnt = 3000;
+	int dimCount = imgDims.depth > 0 ? 3 : 2;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, dimCount, 89);
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, 1, 97);
+	gpuNUFFT::Array<DType2> imgData = createRandomData(imgDims.count(), 1, 101);
+	imgData.dim = imgDims;
+
+	gpuNUFFT::CostModelBalancer balancer(4);
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	factory.setLoadBalancer(&balancer);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims));
+	factory.setSpaceFillingCurve(curve);
+	gpuNUFFT::CpuNUFFTOperator *curveOp = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims));
+
+	// same chunks, only the order differs
+	EXPECT_EQ(op->getSectorProcessingOrder().count(), curveOp->getSectorProcessingOrder().count());
+
+	gpuNUFFT::Array<CufftType> adj = op->performGpuNUFFTAdj(kspaceData);
+	gpuNUFFT::Array<CufftType> curveAdj = curveOp->performGpuNUFFTAdj(kspaceData);
+	for (IndType i = 0; i < adj.count(); i++)
+	{
+		EXPECT_NEAR(adj.data[i].x, curveAdj.data[i].x, EPS);
+		EXPECT_NEAR(adj.data[i].y, curveAdj.data[i].y, EPS);
+	}
+
+	gpuNUFFT::Array<CufftType> forw = op->performForwardGpuNUFFT(imgData);
+	gpuNUFFT::Array<CufftType> curveForw = curveOp->performForwardGpuNUFFT(imgData);
+	for (IndType i = 0; i < coordCnt; i++)
+	{
+		EXPECT_NEAR(forw.data[i].x, curveForw.data[i].x, EPS);
+		EXPECT_NEAR(forw.data[i].y, curveForw.data[i].y, EPS);
+	}
+
+	free(adj.data);
+	free(curveAdj.data);
+	free(forw.data);
+	free(curveForw.data);
+	free(imgData.data);
+	free(kspaceData.data);
+	free(kSpaceTraj.data);
+	delete op;
+	delete curveOp;
+}
+
+TEST(CpuOperatorTest, MortonOrderMatchesSectorOrder)
+{
+	checkSpaceFillingCurve(gpuNUFFT::Dimensions(16, 16, 16), gpuNUFFT::MORTON_CURVE);
+}
+
+TEST(CpuOperatorTest, HilbertOrderMatchesSectorOrder2D)
+{
+	checkSpaceFillingCurve(gpuNUFFT::Dimensions(40, 24), gpuNUFFT::HILBERT_CURVE);
+}
+
+TEST(CpuOperatorTest, HilbertOrderMatchesSectorOrder3D)
+{
+	checkSpaceFillingCurve(gpuNUFFT::Dimensions(16, 12, 8), gpuNUFFT::HILBERT_CURVE);
+}
+
+TEST(CpuOperatorTest, HotSectorsBalancedByWorkStealing)
+{
+	// radial-like density: most samples fall into the central sectors
+	gpuNUFFT::Dimensions imgDims(32, 32);
+	IndType coordCnt = 6000;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 2, 73);
+	for (IndType i = 0; i < 2 * coordCnt; i++)
+		kSpaceTraj.data[i] *= (i % 4 == 0) ? (DType)1.0 : (DType)0.05;
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, 1, 79);
+	gpuNUFFT::Array<DType2> imgData = createRandomData(imgDims.count(), 1, 83);
+	imgData.dim = imgDims;
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CostModelBalancer balancer(4);
+	factory.setLoadBalancer(&balancer);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims));
+
+	// the chunks of the processing order start at distinct offsets of
+	// non-empty sectors, the hottest sector comes first
+	gpuNUFFT::Array<IndType2> order = op->getSectorProcessingOrder();
+	gpuNUFFT::Array<IndType> sectors = op->getSectorDataCount();
+	ASSERT_TRUE(order.data != NULL);
+	EXPECT_EQ(0u, order.data[0].y);
+	IndType maxLoad = 0;
+	for (IndType sec = 0; sec + 1 < sectors.count(); sec++)
+		maxLoad = std::max(maxLoad, sectors.data[sec + 1] - sectors.data[sec]);
+	EXPECT_EQ(maxLoad, sectors.data[order.data[0].x + 1] - sectors.data[order.data[0].x]);
+	std::vector<std::pair<IndType, IndType> > chunkStarts;
+	for (IndType i = 0; i < order.count(); i++)
+	{
+		EXPECT_LT(order.data[i].y, sectors.data[order.data[i].x + 1] - sectors.data[order.data[i].x]);
+		chunkStarts.push_back(std::make_pair(order.data[i].x, order.data[i].y));
+	}
+	std::sort(chunkStarts.begin(), chunkStarts.end());
+	EXPECT_TRUE(std::unique(chunkStarts.begin(), chunkStarts.end()) == chunkStarts.end());
+	// hot sectors are split
+	EXPECT_LT(balancer.getReport().chunkSize, maxLoad);
+	EXPECT_EQ(order.count(), balancer.getReport().chunkCount);
+
+	gpuNUFFT::ThreadPool serialPool(1);
+	gpuNUFFT::ThreadPool parallelPool(4);
+
+	op->setThreadPool(&serialPool);
+	gpuNUFFT::Array<CufftType> serial = op->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+	gpuNUFFT::Array<CufftType> serialForw = op->performForwardGpuNUFFT(imgData);
+	op->setThreadPool(&parallelPool);
+	gpuNUFFT::Array<CufftType> parallel = op->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+	gpuNUFFT::Array<CufftType> parallelForw = op->performForwardGpuNUFFT(imgData);
+
+	for (IndType i = 0; i < serial.count(); i++)
+	{
+		EXPECT_NEAR(serial.data[i].x, parallel.data[i].x, EPS);
+		EXPECT_NEAR(serial.data[i].y, parallel.data[i].y, EPS);
+	}
+	for (IndType i = 0; i < coordCnt; i++)
+	{
+		EXPECT_NEAR(serialForw.data[i].x, parallelForw.data[i].x, EPS);
+		EXPECT_NEAR(serialForw.data[i].y, parallelForw.data[i].y, EPS);
+	}
+
+	// every chunk of the forward convolution is one task
+	std::vector<gpuNUFFT::ThreadPool::ThreadStatistics> stats = parallelPool.getThreadStatistics();
+	IndType tasks = 0;
+	for (size_t t = 0; t < stats.size(); t++)
+		tasks += stats[t].tasks;
+	EXPECT_GE(tasks, order.count());
+
+	free(serial.data);
+	free(parallel.data);
+	free(serialForw.data);
+	free(parallelForw.data);
+	free(imgData.data);
+	free(kspaceData.data);
+	free(kSpaceTraj.data);
+	delete op;
+}
+
+TEST(CpuOperatorTest, ProcessingOrderChangeDiscardsCachedChunks)
+{
+	gpuNUFFT::Dimensions imgDims(32, 32);
+	IndType coordCnt = 3000;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 2, 89);
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, 1, 97);
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CostModelBalancer balancer(4);
+	factory.setLoadBalancer(&balancer);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims));
+	// serial processing, the modified order grids a chunk twice
+	gpuNUFFT::ThreadPool pool(1);
+	op->setThreadPool(&pool);
+
+	gpuNUFFT::Array<CufftType> full = op->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+
+	// change the order in place, the cached chunks are only discarded by
+	// setSectorProcessingOrder
+	gpuNUFFT::Array<IndType2> order = op->getSectorProcessingOrder();
+	ASSERT_LT(1u, order.count());
+	IndType2 last = order.data[order.count() - 1];
+	order.data[order.count() - 1] = order.data[0];
+	op->setSectorProcessingOrder(order);
+	gpuNUFFT::Array<CufftType> changed = op->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+	op->releaseWorkspace();
+	gpuNUFFT::Array<CufftType> recomputed = op->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+
+	double diff = 0;
+	for (IndType i = 0; i < full.count(); i++)
+	{
+		EXPECT_NEAR(recomputed.data[i].x, changed.data[i].x, EPS);
+		EXPECT_NEAR(recomputed.data[i].y, changed.data[i].y, EPS);
+		diff += std::abs(full.data[i].x - changed.data[i].x) + std::abs(full.data[i].y - changed.data[i].y);
+	}
+	EXPECT_LT(EPS, diff);
+
+	order.data[order.count() - 1] = last;
+	op->setSectorProcessingOrder(order);
+
+	free(full.data);
+	free(changed.data);
+	free(recomputed.data);
+	free(kspaceData.data);
+	free(kSpaceTraj.data);
+	delete op;
+}
+
+TEST(CpuOperatorTest, GpuArraysNotSupported)
+{
+	DType coords[2] = {0, 0};
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = coords;
+	kSpaceTraj.dim.length = 1;
+
+	gpuNUFFT::Dimensions imgDims(8, 8);
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::GpuNUFFTOperator *op = factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.0, imgDims);
+
+	gpuNUFFT::GpuArray<DType2> kspaceData_gpu;
+	gpuNUFFT::GpuArray<CufftType> imgData_gpu;
+	EXPECT_THROW(op->performGpuNUFFTAdj(kspaceData_gpu, imgData_gpu), std::runtime_error);
+
+	delete op;
+}
+
+void checkGriddingMatrix(gpuNUFFT::Dimensions imgDims, int dimCount)
+{
+	IndType coordCnt = 1500;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, dimCount, 29);
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, 1, 31);
+	gpuNUFFT::Array<DType2> imgData = createRandomData(imgDims.count(), 1, 37);
+	imgData.dim = imgDims;
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims));
+	EXPECT_FALSE(op->hasGriddingMatrix());
+
+	gpuNUFFT::Array<CufftType> gdata = op->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+	gpuNUFFT::Array<CufftType> forw = op->performForwardGpuNUFFT(imgData);
+
+	factory.setUseGriddingMatrix(true);
+	gpuNUFFT::CpuNUFFTOperator *matrixOp = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims));
+	EXPECT_TRUE(matrixOp->hasGriddingMatrix());
+	EXPECT_EQ(coordCnt + 1, matrixOp->getGriddingMatrix().rowOffsets.size());
+	EXPECT_GT(matrixOp->getGriddingMatrix().getMemorySize(), 0u);
+
+	gpuNUFFT::Array<CufftType> gdataMatrix = matrixOp->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+	gpuNUFFT::Array<CufftType> forwMatrix = matrixOp->performForwardGpuNUFFT(imgData);
+
+	for (IndType i = 0; i < gdata.count(); i++)
+	{
+		EXPECT_NEAR(gdata.data[i].x, gdataMatrix.data[i].x, EPS);
+		EXPECT_NEAR(gdata.data[i].y, gdataMatrix.data[i].y, EPS);
+	}
+	for (IndType i = 0; i < coordCnt; i++)
+	{
+		EXPECT_NEAR(forw.data[i].x, forwMatrix.data[i].x, EPS);
+		EXPECT_NEAR(forw.data[i].y, forwMatrix.data[i].y, EPS);
+	}
+
+	free(gdata.data);
+	free(forw.data);
+	free(gdataMatrix.data);
+	free(forwMatrix.data);
+	free(imgData.data);
+	free(kspaceData.data);
+	free(kSpaceTraj.data);
+	delete op;
+	delete matrixOp;
+}
+
+TEST(CpuOperatorTest, GriddingMatrixMatchesOnTheFly)
+{
+	checkGriddingMatrix(gpuNUFFT::Dimensions(16, 16, 16), 3);
+}
+
+TEST(CpuOperatorTest, GriddingMatrixMatchesOnTheFly2D)
+{
+	checkGriddingMatrix(gpuNUFFT::Dimensions(20, 16), 2);
+}
+
+TEST(CpuOperatorTest, GriddingMatrixExceedsMemoryBudget)
+{
+	gpuNUFFT::Dimensions imgDims(16, 16);
+	IndType coordCnt = 100;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 2, 41);
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	factory.setUseGriddingMatrix(true, 1024);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims));
+
+	//falls back to on-the-fly convolution
+	EXPECT_FALSE(op->hasGriddingMatrix());
+	EXPECT_EQ(0u, op->getGriddingMatrix().getMemorySize());
+
+	EXPECT_TRUE(op->precomputeGriddingMatrix());
+	EXPECT_TRUE(op->hasGriddingMatrix());
+	op->releaseGriddingMatrix();
+	EXPECT_FALSE(op->hasGriddingMatrix());
+
+	free(kSpaceTraj.data);
+	delete op;
+}
+
+// compares coil-batched gridding with gridding one coil at a time
+void checkCoilBatching(gpuNUFFT::Dimensions imgDims, IndType coilCnt, bool useSens, bool useMatrix)
+{
+	int dimCount = imgDims.depth > 0 ? 3 : 2;
+	IndType coordCnt = 1200;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, dimCount, 43);
+
+	gpuNUFFT::Array<DType> densData;
+	densData.data = (DType*)calloc(coordCnt, sizeof(DType));
+	densData.dim.length = coordCnt;
+	unsigned seed = 47;
+	for (IndType i = 0; i < coordCnt; i++)
+		densData.data[i] = nextRandom(seed) + (DType)1.0;
+
+	gpuNUFFT::Array<DType2> sensData;
+	if (useSens)
+	{
+		sensData = createRandomData(imgDims.count(), coilCnt, 53);
+		sensData.dim = imgDims;
+		sensData.dim.channels = coilCnt;
+	}
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	factory.setUseGriddingMatrix(useMatrix);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, densData, sensData, 3, 8, (DType)1.5, imgDims));
+	EXPECT_EQ(useMatrix, op->hasGriddingMatrix());
+	EXPECT_EQ(0u, op->getCoilBatchSize());
+
+	gpuNUFFT::Array<DType2> imgData = createRandomData(imgDims.count(), useSens ? 1 : coilCnt, 59);
+	imgData.dim = imgDims;
+	imgData.dim.channels = useSens ? 1 : coilCnt;
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, coilCnt, 61);
+
+	op->setCoilBatchSize(1);
+	gpuNUFFT::Array<CufftType> adj = op->performGpuNUFFTAdj(kspaceData);
+	gpuNUFFT::Array<CufftType> forw = op->performForwardGpuNUFFT(imgData);
+
+	// uneven batch split and automatic batch size, coil interleaving by
+	// several threads
+	gpuNUFFT::ThreadPool pool(3);
+	op->setThreadPool(&pool);
+	IndType batchSizes[] = { 3, 0 };
+	for (int b = 0; b < 2; b++)
+	{
+		op->setCoilBatchSize(batchSizes[b]);
+		gpuNUFFT::Array<CufftType> adjBatch = op->performGpuNUFFTAdj(kspaceData);
+		gpuNUFFT::Array<CufftType> forwBatch = op->performForwardGpuNUFFT(imgData);
+
+		EXPECT_EQ(adj.count(), adjBatch.count());
+		for (IndType i = 0; i < adj.count(); i++)
+		{
+			EXPECT_NEAR(adj.data[i].x, adjBatch.data[i].x, EPS);
+			EXPECT_NEAR(adj.data[i].y, adjBatch.data[i].y, EPS);
+		}
+		EXPECT_EQ(forw.count(), forwBatch.count());
+		for (IndType i = 0; i < forw.count(); i++)
+		{
+			EXPECT_NEAR(forw.data[i].x, forwBatch.data[i].x, EPS);
+			EXPECT_NEAR(forw.data[i].y, forwBatch.data[i].y, EPS);
+		}
+		free(adjBatch.data);
+		free(forwBatch.data);
+	}
+
+	free(adj.data);
+	free(forw.data);
+	free(imgData.data);
+	free(kspaceData.data);
+	free(kSpaceTraj.data);
+	free(densData.data);
+	if (useSens)
+		free(sensData.data);
+	delete op;
+}
+
+TEST(CpuOperatorTest, CoilBatching3D)
+{
+	checkCoilBatching(gpuNUFFT::Dimensions(16, 16, 16), 5, false, false);
+}
+
+TEST(CpuOperatorTest, CoilBatching2DSens)
+{
+	checkCoilBatching(gpuNUFFT::Dimensions(20, 16), 5, true, false);
+}
+
+TEST(CpuOperatorTest, CoilBatchingGriddingMatrix)
+{
+	checkCoilBatching(gpuNUFFT::Dimensions(16, 16, 16), 4, true, true);
+}
+
+TEST(CpuOperatorTest, CoilBatchingConvolutionOutput)
+{
+	gpuNUFFT::Dimensions imgDims(16, 16);
+	IndType coordCnt = 500;
+	IndType coilCnt = 3;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 2, 67);
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, coilCnt, 71);
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims));
+
+	op->setCoilBatchSize(1);
+	gpuNUFFT::Array<CufftType> gdata = op->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+	op->setCoilBatchSize(coilCnt);
+	gpuNUFFT::Array<CufftType> gdataBatch = op->performGpuNUFFTAdj(kspaceData, gpuNUFFT::CONVOLUTION);
+
+	EXPECT_EQ(op->getGridDims().count() * coilCnt, gdata.count());
+	for (IndType i = 0; i < gdata.count(); i++)
+	{
+		EXPECT_NEAR(gdata.data[i].x, gdataBatch.data[i].x, EPS);
+		EXPECT_NEAR(gdata.data[i].y, gdataBatch.data[i].y, EPS);
+	}
+
+	free(gdata.data);
+	free(gdataBatch.data);
+	free(kspaceData.data);
+	free(kSpaceTraj.data);
+	delete op;
+}
+
+// compares the Toeplitz normal operator with adjoint(forward(x))
+void checkToeplitzNormal(gpuNUFFT::Dimensions imgDims, IndType coilCnt, bool useDens, bool useSens)
+{
+	RandomProblem problem(imgDims, 3000, coilCnt, useDens, useSens, 43);
+	gpuNUFFT::CpuNUFFTOperator *op = problem.createOperator(5, (DType)2.0);
+	gpuNUFFT::ToeplitzNormalOperator normalOp(op);
+	EXPECT_EQ(2 * imgDims.width, normalOp.getEmbeddingDims().width);
+	EXPECT_EQ(2 * imgDims.depth, normalOp.getEmbeddingDims().depth);
+
+	std::vector<CufftType> Ax = takeArray(op->performForwardGpuNUFFT(problem.imgData));
+	gpuNUFFT::Array<DType2> kspaceData;
+	kspaceData.data = (DType2*)&Ax[0];
+	kspaceData.dim.length = problem.coordCnt;
+	kspaceData.dim.channels = coilCnt;
+	std::vector<CufftType> AHAx = takeArray(op->performGpuNUFFTAdj(kspaceData));
+	std::vector<CufftType> toeplitz = takeArray(normalOp.performNormal(problem.imgData));
+
+	EXPECT_EQ(AHAx.size(), toeplitz.size());
+	double diff = 0, norm = 0;
+	for (size_t i = 0; i < AHAx.size(); i++)
+	{
+		diff += pow(AHAx[i].x - toeplitz[i].x, 2) + pow(AHAx[i].y - toeplitz[i].y, 2);
+		norm += pow(AHAx[i].x, 2) + pow(AHAx[i].y, 2);
+	}
+	EXPECT_GT(norm, 0.0);
+	EXPECT_LT(sqrt(diff / norm), 0.01);
+}
+
+TEST(CpuOperatorTest, ToeplitzNormal2D)
+{
+	checkToeplitzNormal(gpuNUFFT::Dimensions(32, 32), 1, false, false);
+}
+
+TEST(CpuOperatorTest, ToeplitzNormal2DDensSens)
+{
+	checkToeplitzNormal(gpuNUFFT::Dimensions(32, 24), 3, true, true);
+}
+
+TEST(CpuOperatorTest, ToeplitzNormal3DMultiChannel)
+{
+	checkToeplitzNormal(gpuNUFFT::Dimensions(16, 16, 12), 2, true, false);
+}
+
+template <typename T>
+void expectEqualArrays(gpuNUFFT::Array<T> expected, gpuNUFFT::Array<T> actual, IndType byteCount)
+{
+	ASSERT_TRUE(actual.data != NULL);
+	EXPECT_EQ(expected.count(), actual.count());
+	EXPECT_EQ(0, memcmp(expected.data, actual.data, byteCount));
+}
+
+TEST(CpuOperatorTest, PlanFileRoundTrip)
+{
+	gpuNUFFT::Dimensions imgDims(16, 16, 12);
+	IndType coordCnt = 1500;
+	IndType coilCnt = 2;
+	const char *fileName = "gpuNUFFT_plan_test.bin";
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 3, 73);
+
+	gpuNUFFT::Array<DType> densData;
+	densData.data = (DType*)calloc(coordCnt, sizeof(DType));
+	densData.dim.length = coordCnt;
+	unsigned seed = 79;
+	for (IndType i = 0; i < coordCnt; i++)
+		densData.data[i] = nextRandom(seed) + (DType)1.0;
+	gpuNUFFT::Array<DType2> sensData;
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, densData, sensData, 3, 8, (DType)1.5, imgDims));
+	factory.savePlan(op, fileName);
+
+	gpuNUFFT::CpuNUFFTOperator *loaded = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.loadPlan(fileName));
+	ASSERT_EQ(gpuNUFFT::CPU, loaded->getType());
+	EXPECT_EQ(op->getKernelWidth(), loaded->getKernelWidth());
+	EXPECT_EQ(op->getSectorWidth(), loaded->getSectorWidth());
+	EXPECT_EQ(op->getOsf(), loaded->getOsf());
+	EXPECT_EQ(imgDims.count(), loaded->getImageDims().count());
+	EXPECT_EQ(op->getGridSectorDims().count(), loaded->getGridSectorDims().count());
+
+	// sections are 64 byte aligned
+	EXPECT_EQ(0u, (size_t)loaded->getKSpaceTraj().data % 64);
+	EXPECT_EQ(0u, (size_t)loaded->getDataIndices().data % 64);
+
+	expectEqualArrays(op->getKSpaceTraj(), loaded->getKSpaceTraj(), 3 * coordCnt * sizeof(DType));
+	expectEqualArrays(op->getDens(), loaded->getDens(), coordCnt * sizeof(DType));
+	expectEqualArrays(op->getDataIndices(), loaded->getDataIndices(), coordCnt * sizeof(IndType));
+	expectEqualArrays(op->getSectorDataCount(), loaded->getSectorDataCount(), op->getSectorDataCount().count() * sizeof(IndType));
+	expectEqualArrays(op->getSectorCenters(), loaded->getSectorCenters(), op->getSectorCenters().count() * sizeof(IndType));
+	expectEqualArrays(op->getSectorProcessingOrder(), loaded->getSectorProcessingOrder(), op->getSectorProcessingOrder().count() * sizeof(IndType2));
+	expectEqualArrays(op->getDeapodizationVectors(), loaded->getDeapodizationVectors(), (16 + 16 + 12) * sizeof(DType));
+
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, coilCnt, 83);
+	gpuNUFFT::Array<DType2> imgData = createRandomData(imgDims.count(), coilCnt, 89);
+	imgData.dim = imgDims;
+	imgData.dim.channels = coilCnt;
+
+	gpuNUFFT::Array<CufftType> adj = op->performGpuNUFFTAdj(kspaceData);
+	gpuNUFFT::Array<CufftType> adjLoaded = loaded->performGpuNUFFTAdj(kspaceData);
+	gpuNUFFT::Array<CufftType> forw = op->performForwardGpuNUFFT(imgData);
+	gpuNUFFT::Array<CufftType> forwLoaded = loaded->performForwardGpuNUFFT(imgData);
+	for (IndType i = 0; i < adj.count(); i++)
+	{
+		EXPECT_NEAR(adj.data[i].x, adjLoaded.data[i].x, EPS);
+		EXPECT_NEAR(adj.data[i].y, adjLoaded.data[i].y, EPS);
+	}
+	for (IndType i = 0; i < forw.count(); i++)
+	{
+		EXPECT_NEAR(forw.data[i].x, forwLoaded.data[i].x, EPS);
+		EXPECT_NEAR(forw.data[i].y, forwLoaded.data[i].y, EPS);
+	}
+
+	free(adj.data);
+	free(adjLoaded.data);
+	free(forw.data);
+	free(forwLoaded.data);
+	free(kspaceData.data);
+	free(imgData.data);
+	free(kSpaceTraj.data);
+	free(densData.data);
+	delete op;
+	delete loaded;
+	remove(fileName);
+}
+
+void writeRawFile(const char *fileName, const DType *data, IndType count)
+{
+	FILE *file = fopen(fileName, "wb");
+	ASSERT_TRUE(file != NULL);
+	fwrite(data, sizeof(DType), count, file);
+	fclose(file);
+}
+
+void checkOutOfCorePlan(gpuNUFFT::Dimensions imgDims, int dimCount, size_t memoryBudget, bool useDens)
+{
+	IndType coordCnt = 3000;
+	const char *trajFileName = "gpuNUFFT_traj_test.bin";
+	const char *densFileName = "gpuNUFFT_dens_test.bin";
+	const char *planFileName = "gpuNUFFT_plan_ooc_test.bin";
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, dimCount, 107);
+	writeRawFile(trajFileName, kSpaceTraj.data, dimCount * coordCnt);
+
+	gpuNUFFT::Array<DType> densData;
+	if (useDens)
+	{
+		densData.data = (DType*)calloc(coordCnt, sizeof(DType));
+		densData.dim.length = coordCnt;
+		unsigned seed = 109;
+		for (IndType i = 0; i < coordCnt; i++)
+			densData.data[i] = nextRandom(seed) + (DType)1.0;
+		writeRawFile(densFileName, densData.data, coordCnt);
+	}
+
+	gpuNUFFT::CostModelBalancer balancer(4);
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	factory.setLoadBalancer(&balancer);
+	gpuNUFFT::Array<DType2> sensData;
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, densData, sensData, 3, 8, (DType)1.5, imgDims));
+	factory.createPlanFile(trajFileName, useDens ? densFileName : "", 3, 8, (DType)1.5, imgDims, planFileName, memoryBudget);
+	gpuNUFFT::CpuNUFFTOperator *loaded = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.loadPlan(planFileName));
+
+	// same stable sort as the in-memory precomputation
+	expectEqualArrays(op->getKSpaceTraj(), loaded->getKSpaceTraj(), dimCount * coordCnt * sizeof(DType));
+	expectEqualArrays(op->getDataIndices(), loaded->getDataIndices(), coordCnt * sizeof(IndType));
+	expectEqualArrays(op->getSectorDataCount(), loaded->getSectorDataCount(), op->getSectorDataCount().count() * sizeof(IndType));
+	expectEqualArrays(op->getSectorCenters(), loaded->getSectorCenters(), op->getSectorCenters().count() * sizeof(IndType));
+	expectEqualArrays(op->getSectorProcessingOrder(), loaded->getSectorProcessingOrder(), op->getSectorProcessingOrder().count() * sizeof(IndType2));
+	if (useDens)
+		expectEqualArrays(op->getDens(), loaded->getDens(), coordCnt * sizeof(DType));
+	else
+		EXPECT_TRUE(loaded->getDens().data == NULL);
+
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, 1, 113);
+	gpuNUFFT::Array<CufftType> adj = op->performGpuNUFFTAdj(kspaceData);
+	gpuNUFFT::Array<CufftType> adjLoaded = loaded->performGpuNUFFTAdj(kspaceData);
+	for (IndType i = 0; i < adj.count(); i++)
+	{
+		EXPECT_NEAR(adj.data[i].x, adjLoaded.data[i].x, EPS);
+		EXPECT_NEAR(adj.data[i].y, adjLoaded.data[i].y, EPS);
+	}
+
+	free(adj.data);
+	free(adjLoaded.data);
+	free(kspaceData.data);
+	free(kSpaceTraj.data);
+	if (useDens)
+		free(densData.data);
+	delete op;
+	delete loaded;
+	remove(trajFileName);
+	remove(densFileName);
+	remove(planFileName);
+}
+
+TEST(CpuOperatorTest, OutOfCorePlanMatchesInMemory3D)
+{
+	// 64 samples per block and a single bucket
+	checkOutOfCorePlan(gpuNUFFT::Dimensions(16, 16, 12), 3, 128 * sizeof(IndType), true);
+	// several buckets written before the end of the pass
+	checkOutOfCorePlan(gpuNUFFT::Dimensions(16, 16, 12), 3, 64 * 1024, true);
+}
+
+TEST(CpuOperatorTest, OutOfCorePlanMatchesInMemory2D)
+{
+	// single sample blocks and a budget exceeding the trajectory
+	checkOutOfCorePlan(gpuNUFFT::Dimensions(32, 24), 2, 1, false);
+	checkOutOfCorePlan(gpuNUFFT::Dimensions(32, 24), 2, 1 << 20, true);
+}
+
+TEST(CpuOperatorTest, OutOfCorePlanRejectsInvalidFiles)
+{
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::Dimensions imgDims(16, 16, 12);
+	const char *trajFileName = "gpuNUFFT_traj_invalid.bin";
+	const char *planFileName = "gpuNUFFT_plan_ooc_invalid.bin";
+
+	EXPECT_THROW(factory.createPlanFile(trajFileName, "", 3, 8, (DType)1.5, imgDims, planFileName), std::runtime_error);
+
+	// no multiple of three coordinates
+	DType coords[10] = { 0 };
+	writeRawFile(trajFileName, coords, 10);
+	EXPECT_THROW(factory.createPlanFile(trajFileName, "", 3, 8, (DType)1.5, imgDims, planFileName), std::invalid_argument);
+
+	// density compensation of a different sample count
+	writeRawFile(trajFileName, coords, 9);
+	EXPECT_THROW(factory.createPlanFile(trajFileName, trajFileName, 3, 8, (DType)1.5, imgDims, planFileName), std::invalid_argument);
+
+	remove(trajFileName);
+	remove(planFileName);
+}
+
+TEST(CpuOperatorTest, PlanFileRejectsInvalidFiles)
+{
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	const char *fileName = "gpuNUFFT_plan_invalid.bin";
+
+	EXPECT_THROW(factory.loadPlan(fileName), std::runtime_error);
+
+	FILE *file = fopen(fileName, "wb");
+	ASSERT_TRUE(file != NULL);
+	char garbage[256] = "no plan";
+	fwrite(garbage, 1, sizeof(garbage), file);
+	fclose(file);
+	EXPECT_THROW(factory.loadPlan(fileName), std::runtime_error);
+
+	// truncated plan
+	gpuNUFFT::Dimensions imgDims(16, 16);
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(200, 2, 97);
+	gpuNUFFT::GpuNUFFTOperator *op = factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims);
+	factory.savePlan(op, fileName);
+	file = fopen(fileName, "rb");
+	ASSERT_TRUE(file != NULL);
+	std::vector<char> content(1 << 20);
+	size_t size = fread(&content[0], 1, content.size(), file);
+	fclose(file);
+	file = fopen(fileName, "wb");
+	ASSERT_TRUE(file != NULL);
+	fwrite(&content[0], 1, size - 8, file);
+	fclose(file);
+	EXPECT_THROW(factory.loadPlan(fileName), std::runtime_error);
+
+	free(kSpaceTraj.data);
+	delete op;
+	remove(fileName);
+}
+
+//plan cache directory in the temporary directory of the tests, the plans and
+//the directory are removed on destruction
+struct TemporaryPlanCacheDirectory
+{
+	TemporaryPlanCacheDirectory() : path(::testing::TempDir() + "gpuNUFFT_plan_cache_test")
+	{
+		gpuNUFFT::PlanCache(path).clear();
+	}
+
+	~TemporaryPlanCacheDirectory()
+	{
+		gpuNUFFT::PlanCache(path).clear();
+		rmdir(path.c_str());
+	}
+
+	std::string path;
+};
+
+//exposes the plan cache key of the factory
+class PlanKeyFactory : public gpuNUFFT::GpuNUFFTOperatorFactory
+{
+public:
+	PlanKeyFactory() : gpuNUFFT::GpuNUFFTOperatorFactory(false, false, false)
+	{
+	}
+
+	using gpuNUFFT::GpuNUFFTOperatorFactory::computePlanKey;
+};
+
+void copyFile(const std::string &source, const std::string &target)
+{
+	FILE *file = fopen(source.c_str(), "rb");
+	ASSERT_TRUE(file != NULL);
+	std::vector<char> content(1 << 20);
+	size_t size = fread(&content[0], 1, content.size(), file);
+	fclose(file);
+	file = fopen(target.c_str(), "wb");
+	ASSERT_TRUE(file != NULL);
+	fwrite(&content[0], 1, size, file);
+	fclose(file);
+}
+
+TEST(CpuOperatorTest, PlanCacheHitsAndMisses)
+{
+	gpuNUFFT::Dimensions imgDims(16, 16);
+	IndType coordCnt = 800;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 2, 101);
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, 1, 103);
+
+	TemporaryPlanCacheDirectory directory;
+	gpuNUFFT::PlanCache cache(directory.path);
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	factory.setPlanCache(&cache);
+
+	gpuNUFFT::GpuNUFFTOperator *op = factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims);
+	gpuNUFFT::PlanCache::Statistics statistics = cache.getStatistics();
+	EXPECT_EQ(0u, statistics.hits);
+	EXPECT_EQ(1u, statistics.misses);
+	EXPECT_EQ(1u, statistics.stores);
+	EXPECT_GT(cache.getSize(), 0u);
+
+	gpuNUFFT::GpuNUFFTOperator *cachedOp = factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims);
+	statistics = cache.getStatistics();
+	EXPECT_EQ(1u, statistics.hits);
+	EXPECT_EQ(1u, statistics.stores);
+
+	gpuNUFFT::Array<CufftType> adj = op->performGpuNUFFTAdj(kspaceData);
+	gpuNUFFT::Array<CufftType> adjCached = cachedOp->performGpuNUFFTAdj(kspaceData);
+	for (IndType i = 0; i < adj.count(); i++)
+	{
+		EXPECT_NEAR(adj.data[i].x, adjCached.data[i].x, EPS);
+		EXPECT_NEAR(adj.data[i].y, adjCached.data[i].y, EPS);
+	}
+
+	// changed parameters and trajectory are different plans
+	gpuNUFFT::GpuNUFFTOperator *osfOp = factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)2.0, imgDims);
+	kSpaceTraj.data[0] += (DType)0.01;
+	gpuNUFFT::GpuNUFFTOperator *trajOp = factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims);
+	statistics = cache.getStatistics();
+	EXPECT_EQ(1u, statistics.hits);
+	EXPECT_EQ(3u, statistics.misses);
+	EXPECT_EQ(3u, statistics.stores);
+
+	cache.resetStatistics();
+	EXPECT_EQ(0u, cache.getStatistics().misses);
+	cache.clear();
+	EXPECT_EQ(0u, cache.getSize());
+
+	free(adj.data);
+	free(adjCached.data);
+	free(kspaceData.data);
+	free(kSpaceTraj.data);
+	delete op;
+	delete cachedOp;
+	delete osfOp;
+	delete trajOp;
+}
+
+TEST(CpuOperatorTest, PlanCacheSizeLimit)
+{
+	gpuNUFFT::Dimensions imgDims(16, 16);
+	IndType coordCnt = 800;
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+
+	TemporaryPlanCacheDirectory directory;
+	uint64_t planSize;
+	{
+		gpuNUFFT::PlanCache cache(directory.path);
+		factory.setPlanCache(&cache);
+		gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 2, 107);
+		delete factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims);
+		free(kSpaceTraj.data);
+		planSize = cache.getSize();
+		cache.clear();
+	}
+
+	// room for two plans
+	gpuNUFFT::PlanCache cache(directory.path, planSize * 5 / 2);
+	factory.setPlanCache(&cache);
+	for (unsigned seed = 109; seed < 112; seed++)
+	{
+		gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 2, seed);
+		delete factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims);
+		free(kSpaceTraj.data);
+	}
+
+	EXPECT_EQ(3u, cache.getStatistics().stores);
+	EXPECT_EQ(1u, cache.getStatistics().evictions);
+	EXPECT_LE(cache.getSize(), cache.getMaxSize());
+
+	// the latest plan is never evicted
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 2, 111);
+	delete factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims);
+	EXPECT_EQ(1u, cache.getStatistics().hits);
+
+	free(kSpaceTraj.data);
+	cache.clear();
+}
+
+TEST(CpuOperatorTest, PlanCacheDiscardsMismatchingPlans)
+{
+	gpuNUFFT::Dimensions imgDims(16, 16);
+	IndType coordCnt = 800;
+	gpuNUFFT::Array<DType> trajA = createRandomTrajectory(coordCnt, 2, 113);
+	gpuNUFFT::Array<DType> trajB = createRandomTrajectory(coordCnt, 2, 127);
+	gpuNUFFT::Array<DType> densData;
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, 1, 131);
+
+	TemporaryPlanCacheDirectory directory;
+	gpuNUFFT::PlanCache cache(directory.path);
+	PlanKeyFactory factory;
+	factory.setPlanCache(&cache);
+	delete factory.createGpuNUFFTOperator(trajA, 3, 8, (DType)1.5, imgDims);
+	gpuNUFFT::GpuNUFFTOperator *op = factory.createGpuNUFFTOperator(trajB, 3, 8, (DType)1.5, imgDims);
+
+	// plan of another trajectory with equal parameters stored for the key of
+	// trajB, as in case of a hash collision
+	std::string pathA = cache.lookup(factory.computePlanKey(trajA, densData, 3, 8, (DType)1.5, imgDims));
+	std::string pathB = cache.lookup(factory.computePlanKey(trajB, densData, 3, 8, (DType)1.5, imgDims));
+	ASSERT_FALSE(pathA.empty());
+	ASSERT_FALSE(pathB.empty());
+	copyFile(pathA, pathB);
+	cache.resetStatistics();
+
+	gpuNUFFT::GpuNUFFTOperator *cachedOp = factory.createGpuNUFFTOperator(trajB, 3, 8, (DType)1.5, imgDims);
+	gpuNUFFT::PlanCache::Statistics statistics = cache.getStatistics();
+	EXPECT_EQ(0u, statistics.hits);
+	EXPECT_EQ(1u, statistics.misses);
+	EXPECT_EQ(1u, statistics.stores);
+
+	gpuNUFFT::Array<CufftType> adj = op->performGpuNUFFTAdj(kspaceData);
+	gpuNUFFT::Array<CufftType> adjCached = cachedOp->performGpuNUFFTAdj(kspaceData);
+	for (IndType i = 0; i < adj.count(); i++)
+	{
+		EXPECT_NEAR(adj.data[i].x, adjCached.data[i].x, EPS);
+		EXPECT_NEAR(adj.data[i].y, adjCached.data[i].y, EPS);
+	}
+
+	// the recomputed plan replaces the mismatching one
+	delete factory.createGpuNUFFTOperator(trajB, 3, 8, (DType)1.5, imgDims);
+	EXPECT_EQ(1u, cache.getStatistics().hits);
+
+	free(adj.data);
+	free(adjCached.data);
+	free(kspaceData.data);
+	free(trajA.data);
+	free(trajB.data);
+	delete op;
+	delete cachedOp;
+}
+
+namespace
+{
+// samples [first, first + count) of a linearized trajectory
+gpuNUFFT::Array<DType> sliceSamples(gpuNUFFT::Array<DType> data, IndType first, IndType count, int dimCount)
+{
+	gpuNUFFT::Array<DType> slice;
+	slice.data = (DType*)calloc(count * dimCount, sizeof(DType));
+	slice.dim.length = count;
+	for (int d = 0; d < dimCount; d++)
+		memcpy(slice.data + d * count, data.data + first + d * data.count(), count * sizeof(DType));
+	return slice;
+}
+
+// compares adjoint and forward operator of the incrementally updated and a newly created operator
+void expectEqualOperators(gpuNUFFT::CpuNUFFTOperator *expected, gpuNUFFT::CpuNUFFTOperator *actual, gpuNUFFT::Dimensions imgDims, IndType coordCnt, IndType coilCnt)
+{
+	ASSERT_EQ(coordCnt, actual->getDataCount());
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, coilCnt, 127);
+	gpuNUFFT::Array<CufftType> adj = expected->performGpuNUFFTAdj(kspaceData);
+	gpuNUFFT::Array<CufftType> adjActual = actual->performGpuNUFFTAdj(kspaceData);
+	for (IndType i = 0; i < adj.count(); i++)
+	{
+		EXPECT_NEAR(adj.data[i].x, adjActual.data[i].x, EPS);
+		EXPECT_NEAR(adj.data[i].y, adjActual.data[i].y, EPS);
+	}
+
+	gpuNUFFT::Array<DType2> imgData = createRandomData(imgDims.count(), coilCnt, 131);
+	imgData.dim = imgDims;
+	imgData.dim.channels = coilCnt;
+	gpuNUFFT::Array<CufftType> forw = expected->performForwardGpuNUFFT(imgData);
+	gpuNUFFT::Array<CufftType> forwActual = actual->performForwardGpuNUFFT(imgData);
+	for (IndType i = 0; i < coordCnt * coilCnt; i++)
+	{
+		EXPECT_NEAR(forw.data[i].x, forwActual.data[i].x, EPS);
+		EXPECT_NEAR(forw.data[i].y, forwActual.data[i].y, EPS);
+	}
+
+	free(adj.data);
+	free(adjActual.data);
+	free(forw.data);
+	free(forwActual.data);
+	free(imgData.data);
+	free(kspaceData.data);
+}
+
+void checkIncrementalPlan(gpuNUFFT::Dimensions imgDims, IndType coilCnt, bool useDens)
+{
+	int dimCount = imgDims.depth > 0 ? 3 : 2;
+	IndType batchSize = 400;
+	IndType batchCnt = 4;
+	IndType coordCnt = batchSize * batchCnt;
+	// the last batch replaces the first one of the sliding window
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt + batchSize, dimCount, 137);
+	gpuNUFFT::Array<DType> densData;
+	densData.data = (DType*)calloc(coordCnt + batchSize, sizeof(DType));
+	densData.dim.length = coordCnt + batchSize;
+	unsigned seed = 139;
+	for (IndType i = 0; i < densData.count(); i++)
+		densData.data[i] = nextRandom(seed) + (DType)1.0;
+
+	gpuNUFFT::CostModelBalancer balancer(4);
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	factory.setLoadBalancer(&balancer);
+	gpuNUFFT::Array<DType2> sensData;
+
+	gpuNUFFT::Array<DType> batchTraj = sliceSamples(kSpaceTraj, 0, batchSize, dimCount);
+	gpuNUFFT::Array<DType> batchDens;
+	if (useDens)
+		batchDens = sliceSamples(densData, 0, batchSize, 1);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(batchTraj, batchDens, sensData, 3, 8, (DType)1.5, imgDims));
+	free(batchTraj.data);
+	free(batchDens.data);
+
+	gpuNUFFT::IncrementalPlan plan(op, (DType)0.25, &balancer);
+	EXPECT_EQ(batchSize, plan.getSampleCount());
+	EXPECT_EQ(1u, plan.getCompactionCount());
+	for (IndType b = 1; b < batchCnt; b++)
+	{
+		batchTraj = sliceSamples(kSpaceTraj, b * batchSize, batchSize, dimCount);
+		if (useDens)
+			batchDens = sliceSamples(densData, b * batchSize, batchSize, 1);
+		plan.appendSamples(batchTraj, batchDens);
+		free(batchTraj.data);
+		free(batchDens.data);
+	}
+	EXPECT_EQ(coordCnt, plan.getSampleCount());
+	EXPECT_GE(plan.getSlotCount(), coordCnt);
+	// sectors running out of free slots
+	EXPECT_GT(plan.getCompactionCount(), 1u);
+
+	gpuNUFFT::Array<DType> fullTraj = sliceSamples(kSpaceTraj, 0, coordCnt, dimCount);
+	gpuNUFFT::Array<DType> fullDens;
+	if (useDens)
+		fullDens = sliceSamples(densData, 0, coordCnt, 1);
+	gpuNUFFT::CpuNUFFTOperator *expected = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(fullTraj, fullDens, sensData, 3, 8, (DType)1.5, imgDims));
+	expectEqualOperators(expected, op, imgDims, coordCnt, coilCnt);
+	delete expected;
+
+	// sliding window: the last batch reuses the data indices of the first one
+	plan.removeSamples(0, batchSize);
+	EXPECT_EQ(coordCnt - batchSize, plan.getSampleCount());
+	batchTraj = sliceSamples(kSpaceTraj, coordCnt, batchSize, dimCount);
+	if (useDens)
+		batchDens = sliceSamples(densData, coordCnt, batchSize, 1);
+	EXPECT_THROW(plan.appendSamples(batchTraj, batchDens, 1), std::invalid_argument);
+	plan.appendSamples(batchTraj, batchDens, 0);
+	EXPECT_EQ(coordCnt, plan.getSampleCount());
+
+	for (int d = 0; d < dimCount; d++)
+		memcpy(fullTraj.data + d * coordCnt, batchTraj.data + d * batchSize, batchSize * sizeof(DType));
+	if (useDens)
+		memcpy(fullDens.data, batchDens.data, batchSize * sizeof(DType));
+	expected = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(fullTraj, fullDens, sensData, 3, 8, (DType)1.5, imgDims));
+	expectEqualOperators(expected, op, imgDims, coordCnt, coilCnt);
+	delete expected;
+
+	// a gap in the middle of the data indices is gridded with zero data
+	plan.removeSamples(batchSize, batchSize);
+	plan.compact();
+	EXPECT_EQ(coordCnt - batchSize, plan.getSampleCount());
+	EXPECT_EQ(coordCnt, op->getDataCount());
+	gpuNUFFT::Array<DType2> kspaceData = createRandomData(coordCnt, 1, 149);
+	gpuNUFFT::Array<CufftType> adj = op->performGpuNUFFTAdj(kspaceData);
+	for (IndType i = batchSize; i < 2 * batchSize; i++)
+	{
+		kspaceData.data[i].x = 0;
+		kspaceData.data[i].y = 0;
+	}
+	gpuNUFFT::Array<CufftType> adjZero = op->performGpuNUFFTAdj(kspaceData);
+	for (IndType i = 0; i < adj.count(); i++)
+	{
+		EXPECT_NEAR(adj.data[i].x, adjZero.data[i].x, EPS);
+		EXPECT_NEAR(adj.data[i].y, adjZero.data[i].y, EPS);
+	}
+
+	// a copy of the first sample fits into the free slots of its sector
+	gpuNUFFT::Array<DType> sampleTraj = sliceSamples(fullTraj, 0, 1, dimCount);
+	gpuNUFFT::Array<DType> sampleDens;
+	if (useDens)
+		sampleDens = sliceSamples(fullDens, 0, 1, 1);
+	IndType compactionCnt = plan.getCompactionCount();
+	const IndType2 *processingOrder = op->getSectorProcessingOrder().data;
+	plan.appendSamples(sampleTraj, sampleDens, batchSize);
+	EXPECT_EQ(compactionCnt, plan.getCompactionCount());
+	// the slots of the sectors and thus the processing order are unchanged
+	EXPECT_EQ(processingOrder, op->getSectorProcessingOrder().data);
+	gpuNUFFT::Array<DType2> imgData = createRandomData(imgDims.count(), coilCnt, 157);
+	imgData.dim = imgDims;
+	imgData.dim.channels = coilCnt;
+	gpuNUFFT::Array<CufftType> forw = op->performForwardGpuNUFFT(imgData);
+	for (IndType c = 0; c < coilCnt; c++)
+	{
+		EXPECT_NEAR(forw.data[c * coordCnt].x, forw.data[batchSize + c * coordCnt].x, EPS);
+		EXPECT_NEAR(forw.data[c * coordCnt].y, forw.data[batchSize + c * coordCnt].y, EPS);
+	}
+
+	free(adj.data);
+	free(adjZero.data);
+	free(kspaceData.data);
+	free(forw.data);
+	free(imgData.data);
+	free(sampleTraj.data);
+	free(sampleDens.data);
+	free(batchTraj.data);
+	free(batchDens.data);
+	free(fullTraj.data);
+	free(fullDens.data);
+	free(kSpaceTraj.data);
+	free(densData.data);
+	delete op;
+}
+}
+
+TEST(CpuOperatorTest, IncrementalPlanMatchesNewOperator3D)
+{
+	checkIncrementalPlan(gpuNUFFT::Dimensions(16, 16, 12), 1, true);
+}
+
+TEST(CpuOperatorTest, IncrementalPlanMatchesNewOperator2DMultiCoil)
+{
+	checkIncrementalPlan(gpuNUFFT::Dimensions(32, 24), 3, false);
+}
+
+TEST(CpuOperatorTest, IncrementalPlanRejectsInvalidBatches)
+{
+	gpuNUFFT::Dimensions imgDims(16, 16, 12);
+	IndType coordCnt = 100;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 3, 151);
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims));
+	gpuNUFFT::IncrementalPlan plan(op);
+
+	// density compensation of an operator without
+	gpuNUFFT::Array<DType> densData;
+	densData.data = kSpaceTraj.data;
+	densData.dim.length = coordCnt;
+	EXPECT_THROW(plan.appendSamples(kSpaceTraj, densData), std::invalid_argument);
+
+	gpuNUFFT::Array<DType> noDens;
+	EXPECT_THROW(plan.appendSamples(kSpaceTraj, noDens, coordCnt - 1), std::invalid_argument);
+	EXPECT_EQ(coordCnt, plan.getSampleCount());
+	plan.appendSamples(kSpaceTraj, noDens);
+	EXPECT_EQ(2 * coordCnt, plan.getSampleCount());
+	EXPECT_EQ(2 * coordCnt, op->getDataCount());
+
+	const char *planFileName = "gpuNUFFT_plan_incremental_test.bin";
+	EXPECT_THROW(factory.savePlan(op, planFileName), std::invalid_argument);
+	gpuNUFFT::GpuNUFFTOperator *saved = factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.5, imgDims);
+	factory.savePlan(saved, planFileName);
+	delete saved;
+	gpuNUFFT::GpuNUFFTOperator *loaded = factory.loadPlan(planFileName);
+	EXPECT_THROW(gpuNUFFT::IncrementalPlan(static_cast<gpuNUFFT::CpuNUFFTOperator*>(loaded)), std::invalid_argument);
+
+	delete loaded;
+	delete op;
+	free(kSpaceTraj.data);
+	remove(planFileName);
+}
+
+namespace
+{
+// reference deapodization: gridding and transform of a single sample at k = 0
+void checkSeparableDeapodization(gpuNUFFT::Dimensions imgDims, IndType kernelWidth, DType osf)
+{
+	int dimCount = imgDims.depth > 0 ? 3 : 2;
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = (DType*)calloc(dimCount, sizeof(DType));
+	kSpaceTraj.dim.length = 1;
+	gpuNUFFT::Array<DType2> dataArray;
+	dataArray.data = (DType2*)calloc(1, sizeof(DType2));
+	dataArray.dim.length = 1;
+	dataArray.data[0].x = 1;
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, kernelWidth, 8, osf, imgDims));
+	gpuNUFFT::Array<CufftType> gridded = op->performGpuNUFFTAdj(dataArray, gpuNUFFT::FFT);
+
+	std::vector<DType> deapo(imgDims.count());
+	expandDeapodizationVectorsCPU(op->getDeapodizationVectors().data, imgDims, &deapo[0]);
+	double fftScaling = std::sqrt((double)imgDims.count());
+	for (IndType i = 0; i < imgDims.count(); i++)
+	{
+		double expected = 1.0 / (fftScaling * std::sqrt((double)gridded.data[i].x * gridded.data[i].x + (double)gridded.data[i].y * gridded.data[i].y));
+		EXPECT_NEAR(1.0, deapo[i] / expected, 1e-4) << "at " << i;
+	}
+
+	free(gridded.data);
+	free(kSpaceTraj.data);
+	free(dataArray.data);
+	delete op;
+}
+}
+
+TEST(CpuOperatorTest, SeparableDeapodization2D)
+{
+	checkSeparableDeapodization(gpuNUFFT::Dimensions(32, 32), 3, (DType)2.0);
+}
+
+TEST(CpuOperatorTest, SeparableDeapodization3DOddAnisotropic)
+{
+	checkSeparableDeapodization(gpuNUFFT::Dimensions(16, 14, 9), 5, (DType)1.5);
+}
+
+namespace
+{
+// exposes the gridding info of the operator to the kernel tests
+class InfoCpuNUFFTOperator : public gpuNUFFT::CpuNUFFTOperator
+{
+public:
+	InfoCpuNUFFTOperator(gpuNUFFT::Dimensions imgDims, DType osf) : gpuNUFFT::CpuNUFFTOperator(3, 8, osf, imgDims)
+	{
+	}
+
+	gpuNUFFT::GpuNUFFTInfo *createInfo()
+	{
+		return initGpuNUFFTInfo(1);
+	}
+};
+
+void expectNearArrays(const std::vector<CufftType> &expected, const std::vector<CufftType> &actual)
+{
+	ASSERT_EQ(expected.size(), actual.size());
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		EXPECT_NEAR(expected[i].x, actual[i].x, EPS * (1 + std::fabs(expected[i].x))) << "at " << i;
+		EXPECT_NEAR(expected[i].y, actual[i].y, EPS * (1 + std::fabs(expected[i].y))) << "at " << i;
+	}
+}
+
+// the fused image stages match the separate passes for separable, precomputed and analytic deapodization
+void checkFusedImageStages(gpuNUFFT::Dimensions imgDims, DType osf, bool useSens)
+{
+	InfoCpuNUFFTOperator op(imgDims, osf);
+	gpuNUFFT::GpuNUFFTInfo *gi_host = op.createInfo();
+	IndType imgCount = imgDims.count();
+	IndType gridCount = op.getGridDims().count();
+
+	gpuNUFFT::Array<DType> deapoVectors = op.computeDeapodizationVectors();
+	std::vector<DType> deapo(imgCount);
+	expandDeapodizationVectorsCPU(deapoVectors.data, imgDims, &deapo[0]);
+	DType *deapoModes[3][2] = { { NULL, deapoVectors.data }, { &deapo[0], NULL }, { NULL, NULL } };
+
+	std::vector<DType2> grid = createRandomVector(gridCount, 163);
+	std::vector<DType2> image = createRandomVector(imgCount, 167);
+	std::vector<DType2> sens = createRandomVector(imgCount, 173);
+	std::vector<DType2> sum = createRandomVector(imgCount, 179);
+	DType2 *sensData = useSens ? &sens[0] : NULL;
+
+	for (int m = 0; m < 3; m++)
+	{
+		// adjoint: crop, scaling, deapodization and coil summation
+		std::vector<CufftType> imdata(imgCount);
+		performCropCPU(&grid[0], &imdata[0], gi_host);
+		performFFTScalingCPU(&imdata[0], imgCount, gi_host);
+		performDeapodizationCPU(&imdata[0], deapoModes[m][0], deapoModes[m][1], gi_host);
+		std::vector<CufftType> expected(imdata);
+		if (useSens)
+		{
+			performSensMulCPU(&imdata[0], sensData, gi_host, true);
+			expected.assign(sum.begin(), sum.end());
+			performSensSumCPU(&imdata[0], &expected[0], gi_host);
+		}
+
+		std::vector<CufftType> fused(sum.begin(), sum.end());
+		performCropDeapodizationCPU(&grid[0], &fused[0], deapoModes[m][0], deapoModes[m][1], sensData, false, gi_host);
+		expectNearArrays(expected, fused);
+
+		// forward: sensitivities, deapodization, zero padding and scaling
+		std::vector<DType2> padImage(image);
+		if (useSens)
+			performSensMulCPU((CufftType*)&padImage[0], sensData, gi_host, false);
+		performForwardDeapodizationCPU(&padImage[0], deapoModes[m][0], deapoModes[m][1], gi_host);
+		CufftType zero;
+		zero.x = 0;
+		zero.y = 0;
+		std::vector<CufftType> expectedGrid(gridCount, zero);
+		performPaddingCPU(&padImage[0], &expectedGrid[0], gi_host);
+		performFFTScalingCPU(&expectedGrid[0], gridCount, gi_host);
+
+		// no zeroed grid required
+		std::vector<CufftType> fusedGrid(grid.begin(), grid.end());
+		performDeapodizationPaddingCPU(&image[0], sensData, &fusedGrid[0], deapoModes[m][0], deapoModes[m][1], false, gi_host);
+		expectNearArrays(expectedGrid, fusedGrid);
+	}
+
+	free(deapoVectors.data);
+	free(gi_host);
+}
+}
+
+TEST(CpuOperatorTest, FusedImageStages2D)
+{
+	checkFusedImageStages(gpuNUFFT::Dimensions(32, 24), (DType)2.0, false);
+	checkFusedImageStages(gpuNUFFT::Dimensions(32, 24), (DType)2.0, true);
+}
+
+TEST(CpuOperatorTest, FusedImageStages3DOdd)
+{
+	checkFusedImageStages(gpuNUFFT::Dimensions(15, 16, 9), (DType)1.5, true);
+}
+
+namespace
+{
+void expectNearGrids(const std::vector<CufftType> &expected, const std::vector<CufftType> &actual)
+{
+	// the transforms accumulate rounding errors relative to the largest value
+	DType maxAbs = 0;
+	for (size_t i = 0; i < expected.size(); i++)
+		maxAbs = std::max(maxAbs, std::max(std::fabs(expected[i].x), std::fabs(expected[i].y)));
+	ASSERT_EQ(expected.size(), actual.size());
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		EXPECT_NEAR(expected[i].x, actual[i].x, EPS * maxAbs) << "at " << i;
+		EXPECT_NEAR(expected[i].y, actual[i].y, EPS * maxAbs) << "at " << i;
+	}
+}
+
+// crop and padding with folded FFT shifts match the shift passes around the FFT
+void checkFoldedFFTShift(gpuNUFFT::Dimensions imgDims, DType osf)
+{
+	InfoCpuNUFFTOperator op(imgDims, osf);
+	gpuNUFFT::GpuNUFFTInfo *gi_host = op.createInfo();
+	gpuNUFFT::Dimensions gridDims = op.getGridDims();
+	IndType imgCount = imgDims.count();
+	IndType gridCount = gridDims.count();
+	gpuNUFFT::Array<DType> deapoVectors = op.computeDeapodizationVectors();
+
+	std::vector<DType2> grid = createRandomVector(gridCount, 181);
+	std::vector<DType2> image = createRandomVector(imgCount, 191);
+	std::vector<DType2> sens = createRandomVector(imgCount, 193);
+	std::vector<DType2> sum = createRandomVector(imgCount, 197);
+
+	// adjoint
+	const gpuNUFFT::CpuFFTPlan &inversePlan = gpuNUFFT::CpuFFTPlan::getPlan(gridDims, CUFFT_INVERSE);
+	std::vector<CufftType> shifted(grid.begin(), grid.end());
+	performFFTShiftCPU(&shifted[0], gpuNUFFT::INVERSE, gridDims, gi_host);
+	inversePlan.execute(&shifted[0]);
+	performFFTShiftCPU(&shifted[0], gpuNUFFT::INVERSE, gridDims, gi_host);
+	std::vector<CufftType> folded(grid.begin(), grid.end());
+	inversePlan.execute(&folded[0]);
+
+	std::vector<CufftType> expected(imgCount);
+	std::vector<CufftType> actual(imgCount);
+	performCropDeapodizationCPU(&shifted[0], &expected[0], NULL, deapoVectors.data, NULL, false, gi_host);
+	performCropDeapodizationCPU(&folded[0], &actual[0], NULL, deapoVectors.data, NULL, true, gi_host);
+	expectNearGrids(expected, actual);
+
+	expected.assign(sum.begin(), sum.end());
+	actual.assign(sum.begin(), sum.end());
+	performCropDeapodizationCPU(&shifted[0], &expected[0], NULL, deapoVectors.data, &sens[0], false, gi_host);
+	performCropDeapodizationCPU(&folded[0], &actual[0], NULL, deapoVectors.data, &sens[0], true, gi_host);
+	expectNearGrids(expected, actual);
+
+	// forward
+	const gpuNUFFT::CpuFFTPlan &forwardPlan = gpuNUFFT::CpuFFTPlan::getPlan(gridDims, CUFFT_FORWARD);
+	performDeapodizationPaddingCPU(&image[0], &sens[0], &shifted[0], NULL, deapoVectors.data, false, gi_host);
+	performFFTShiftCPU(&shifted[0], gpuNUFFT::INVERSE, gridDims, gi_host);
+	forwardPlan.execute(&shifted[0]);
+	performFFTShiftCPU(&shifted[0], gpuNUFFT::FORWARD, gridDims, gi_host);
+	performDeapodizationPaddingCPU(&image[0], &sens[0], &folded[0], NULL, deapoVectors.data, true, gi_host);
+	forwardPlan.execute(&folded[0]);
+	expectNearGrids(shifted, folded);
+
+	free(deapoVectors.data);
+	free(gi_host);
+}
+
+// operator results with folded shifts match the separate shift passes
+void checkFoldedFFTShiftOperator(gpuNUFFT::Dimensions imgDims, IndType coilCnt)
+{
+	RandomProblem problem(imgDims, 2000, coilCnt, false, true, 199);
+	gpuNUFFT::CpuNUFFTOperator *op = problem.createOperator(3, (DType)1.5);
+	EXPECT_TRUE(op->getFoldFFTShift());
+
+	std::vector<CufftType> adjFolded = takeArray(op->performGpuNUFFTAdj(problem.kspaceData));
+	std::vector<CufftType> forwFolded = takeArray(op->performForwardGpuNUFFT(problem.imgData));
+	op->setFoldFFTShift(false);
+	std::vector<CufftType> adj = takeArray(op->performGpuNUFFTAdj(problem.kspaceData));
+	std::vector<CufftType> forw = takeArray(op->performForwardGpuNUFFT(problem.imgData));
+
+	expectNearGrids(adj, adjFolded);
+	expectNearGrids(forw, forwFolded);
+}
+
+}
+
+TEST(CpuOperatorTest, FoldedFFTShiftEvenGrid)
+{
+	checkFoldedFFTShift(gpuNUFFT::Dimensions(32, 24), (DType)2.0);
+	checkFoldedFFTShift(gpuNUFFT::Dimensions(16, 12, 8), (DType)1.5);
+}
+
+TEST(CpuOperatorTest, FoldedFFTShiftOddGrid)
+{
+	// 21x15 and 21x18x9 grids
+	checkFoldedFFTShift(gpuNUFFT::Dimensions(14, 10), (DType)1.5);
+	checkFoldedFFTShift(gpuNUFFT::Dimensions(14, 12, 6), (DType)1.5);
+	checkFoldedFFTShift(gpuNUFFT::Dimensions(15, 13), (DType)1.0);
+}
+
+TEST(CpuOperatorTest, FoldedFFTShiftMatchesShiftPasses)
+{
+	checkFoldedFFTShiftOperator(gpuNUFFT::Dimensions(14, 10), 2);
+	checkFoldedFFTShiftOperator(gpuNUFFT::Dimensions(14, 12, 6), 2);
+	checkFoldedFFTShiftOperator(gpuNUFFT::Dimensions(16, 16), 1);
+}
+
+namespace
+{
+// reference transform: direct evaluation of the 1-d DFTs along each axis
+void referenceFFT(std::vector<std::complex<double> > &data, gpuNUFFT::Dimensions dims, int direction)
+{
+	IndType n[3] = {dims.width, DEFAULT_VALUE(dims.height), DEFAULT_VALUE(dims.depth)};
+	IndType stride[3] = {1, n[0], n[0] * n[1]};
+	IndType total = n[0] * n[1] * n[2];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		std::vector<std::complex<double> > line(n[axis]);
+		for (IndType start = 0; start < total; start++)
+		{
+			// only visit the first element of each line
+			if ((start / stride[axis]) % n[axis] != 0)
+				continue;
+			for (IndType k = 0; k < n[axis]; k++)
+			{
+				std::complex<double> sum(0.0, 0.0);
+				for (IndType j = 0; j < n[axis]; j++)
+				{
+					double phi = direction * 2.0 * M_PI * (double)((j * k) % n[axis]) / n[axis];
+					sum += data[start + j * stride[axis]] * std::complex<double>(cos(phi), sin(phi));
+				}
+				line[k] = sum;
+			}
+			for (IndType k = 0; k < n[axis]; k++)
+				data[start + k * stride[axis]] = line[k];
+		}
+	}
+}
+
+void checkFFT(gpuNUFFT::Dimensions dims, int direction, gpuNUFFT::ThreadPool *threadPool)
+{
+	IndType n = dims.count();
+	std::vector<CufftType> data(n);
+	std::vector<std::complex<double> > expected(n);
+	unsigned seed = 19;
+	for (IndType i = 0; i < n; i++)
+	{
+		data[i].x = nextRandom(seed);
+		data[i].y = nextRandom(seed);
+		expected[i] = std::complex<double>(data[i].x, data[i].y);
+	}
+
+	performFFTCPU(&data[0], dims, direction, threadPool);
+	referenceFFT(expected, dims, direction);
+
+	double maxError = 0.0;
+	double maxValue = 0.0;
+	for (IndType i = 0; i < n; i++)
+	{
+		maxError = std::max(maxError, std::abs(expected[i] - std::complex<double>(data[i].x, data[i].y)));
+		maxValue = std::max(maxValue, std::abs(expected[i]));
+	}
+	EXPECT_LT(maxError / maxValue, 1e-5) << "size " << dims.width << " x " << dims.height << " x " << dims.depth;
+}
+}
+
+TEST(CpuFFTTest, MatchesDFT)
+{
+	// mixed radix and prime sizes
+	checkFFT(gpuNUFFT::Dimensions(12, 5, 7), CUFFT_FORWARD, NULL);
+	checkFFT(gpuNUFFT::Dimensions(12, 5, 7), CUFFT_INVERSE, NULL);
+	checkFFT(gpuNUFFT::Dimensions(64, 30, 21), CUFFT_FORWARD, NULL);
+	checkFFT(gpuNUFFT::Dimensions(11, 13, 9), CUFFT_INVERSE, NULL);
+	checkFFT(gpuNUFFT::Dimensions(8, 1, 2), CUFFT_FORWARD, NULL);
+}
+
+TEST(CpuFFTTest, MatchesDFT2D)
+{
+	checkFFT(gpuNUFFT::Dimensions(48, 50), CUFFT_FORWARD, NULL);
+	checkFFT(gpuNUFFT::Dimensions(49, 17), CUFFT_INVERSE, NULL);
+	checkFFT(gpuNUFFT::Dimensions(1, 45), CUFFT_FORWARD, NULL);
+}
+
+TEST(CpuFFTTest, ThreadCountIndependentResult)
+{
+	gpuNUFFT::ThreadPool serialPool(1);
+	gpuNUFFT::ThreadPool parallelPool(3);
+	checkFFT(gpuNUFFT::Dimensions(24, 20, 15), CUFFT_FORWARD, &serialPool);
+	checkFFT(gpuNUFFT::Dimensions(24, 20, 15), CUFFT_FORWARD, &parallelPool);
+}
+
+TEST(CpuFFTTest, InverseOfForward)
+{
+	gpuNUFFT::Dimensions dims(36, 28, 10);
+	IndType n = dims.count();
+
+	std::vector<CufftType> data(n);
+	unsigned seed = 23;
+	for (IndType i = 0; i < n; i++)
+	{
+		data[i].x = nextRandom(seed);
+		data[i].y = nextRandom(seed);
+	}
+	std::vector<CufftType> fft = data;
+
+	// the unnormalized inverse transform scales by n
+	performFFTCPU(&fft[0], dims, CUFFT_FORWARD);
+	performFFTCPU(&fft[0], dims, CUFFT_INVERSE);
+	for (IndType i = 0; i < n; i++)
+	{
+		EXPECT_NEAR(data[i].x, fft[i].x / n, 1e-5);
+		EXPECT_NEAR(data[i].y, fft[i].y / n, 1e-5);
+	}
+}
+
+TEST(CpuFFTTest, PlansAreCached)
+{
+	gpuNUFFT::Dimensions dims(30, 42, 14);
+	const gpuNUFFT::CpuFFTPlan &plan = gpuNUFFT::CpuFFTPlan::getPlan(dims, CUFFT_FORWARD);
+	IndType planCount = gpuNUFFT::CpuFFTPlan::getCachedPlanCount();
+
+	// same size and direction reuses the plan
+	EXPECT_EQ(&plan, &gpuNUFFT::CpuFFTPlan::getPlan(dims, CUFFT_FORWARD));
+	EXPECT_EQ(planCount, gpuNUFFT::CpuFFTPlan::getCachedPlanCount());
+
+	// other direction creates a new plan
+	const gpuNUFFT::CpuFFTPlan &inversePlan = gpuNUFFT::CpuFFTPlan::getPlan(dims, CUFFT_INVERSE);
+	EXPECT_NE(&plan, &inversePlan);
+	EXPECT_EQ(CUFFT_INVERSE, inversePlan.getDirection());
+	EXPECT_EQ(planCount + 1, gpuNUFFT::CpuFFTPlan::getCachedPlanCount());
+}
+
+TEST(CpuFFTTest, MatchesDFTForAllSimdLevels)
+{
+	gpuNUFFT::CpuSimdLevel defaultLevel = gpuNUFFT::getCpuSimdLevel();
+	for (int level = gpuNUFFT::SIMD_SCALAR; level <= gpuNUFFT::getSupportedCpuSimdLevel(); level++)
+	{
+		gpuNUFFT::setCpuSimdLevel((gpuNUFFT::CpuSimdLevel)level);
+		checkFFT(gpuNUFFT::Dimensions(40, 15, 7), CUFFT_FORWARD, NULL);
+		checkFFT(gpuNUFFT::Dimensions(11, 13, 9), CUFFT_INVERSE, NULL);
+	}
+	gpuNUFFT::setCpuSimdLevel(defaultLevel);
+}
+
+TEST(CpuFFTTest, ScratchIsReused)
+{
+	gpuNUFFT::ThreadPool pool(3);
+	gpuNUFFT::CpuFFTPlan::Scratch scratch;
+	gpuNUFFT::Dimensions sizes[2] = { gpuNUFFT::Dimensions(30, 20, 12), gpuNUFFT::Dimensions(12, 5, 7) };
+	size_t bytes = 0;
+	unsigned seed = 31;
+	for (int s = 0; s < 2; s++)
+	{
+		std::vector<CufftType> data(sizes[s].count());
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			data[i].x = nextRandom(seed);
+			data[i].y = nextRandom(seed);
+		}
+		std::vector<CufftType> expected(data);
+
+		const gpuNUFFT::CpuFFTPlan &plan = gpuNUFFT::CpuFFTPlan::getPlan(sizes[s], CUFFT_FORWARD);
+		plan.execute(&expected[0], &pool);
+		plan.execute(&data[0], &pool, &scratch);
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			EXPECT_EQ(expected[i].x, data[i].x) << "at " << i;
+			EXPECT_EQ(expected[i].y, data[i].y) << "at " << i;
+		}
+
+		// the buffers of all threads are allocated by the first call, the
+		// scratch of the larger transform is reused by the smaller one
+		if (s == 0)
+		{
+			bytes = scratch.getBytes();
+			for (int call = 0; call < 3; call++)
+				plan.execute(&expected[0], &pool, &scratch);
+		}
+		EXPECT_GT(bytes, 0u);
+		EXPECT_EQ(bytes, scratch.getBytes());
+	}
+}
+
+namespace
+{
+// pruned pencils are computed as by the full transform
+void checkPrunedFFT(gpuNUFFT::Dimensions dims, gpuNUFFT::CpuFFTPlan::Pruning pruning)
+{
+	IndType axisDims[3] = { dims.width, DEFAULT_VALUE(dims.height), DEFAULT_VALUE(dims.depth) };
+	unsigned seed = 29;
+	gpuNUFFT::CpuFFTPlan::Support support;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// wrapped range as covered by the image
+		IndType count = (axisDims[axis] + 1) / 2;
+		IndType first = axisDims[axis] - count / 2;
+		support.axes[axis].assign(axisDims[axis], false);
+		for (IndType i = 0; i < count; i++)
+			support.axes[axis][(first + i) % axisDims[axis]] = true;
+	}
+
+	IndType n = dims.count();
+	std::vector<CufftType> data(n);
+	for (IndType i = 0; i < n; i++)
+	{
+		IndType x = i % axisDims[0];
+		IndType y = (i / axisDims[0]) % axisDims[1];
+		IndType z = i / (axisDims[0] * axisDims[1]);
+		bool inside = support.axes[0][x] && support.axes[1][y] && support.axes[2][z];
+		data[i].x = nextRandom(seed);
+		data[i].y = nextRandom(seed);
+		if (pruning == gpuNUFFT::CpuFFTPlan::PRUNE_INPUT && !inside)
+			data[i].x = data[i].y = 0;
+	}
+
+	const gpuNUFFT::CpuFFTPlan &plan = gpuNUFFT::CpuFFTPlan::getPlan(dims, CUFFT_FORWARD);
+	std::vector<CufftType> pruned(data);
+	plan.execute(&data[0]);
+	plan.executePruned(&pruned[0], support, pruning);
+
+	for (IndType i = 0; i < n; i++)
+	{
+		IndType x = i % axisDims[0];
+		IndType y = (i / axisDims[0]) % axisDims[1];
+		IndType z = i / (axisDims[0] * axisDims[1]);
+		if (pruning == gpuNUFFT::CpuFFTPlan::PRUNE_OUTPUT && !(support.axes[0][x] && support.axes[1][y] && support.axes[2][z]))
+			continue;
+		EXPECT_EQ(data[i].x, pruned[i].x) << "at " << i;
+		EXPECT_EQ(data[i].y, pruned[i].y) << "at " << i;
+	}
+}
+
+// operator results with pruned FFTs match the full FFTs
+void checkPrunedFFTOperator(gpuNUFFT::Dimensions imgDims, DType osf, bool foldFFTShift)
+{
+	RandomProblem problem(imgDims, 2000, 1, false, false, 229);
+	gpuNUFFT::CpuNUFFTOperator *op = problem.createOperator(3, osf);
+	op->setFoldFFTShift(foldFFTShift);
+	EXPECT_TRUE(op->getPrunedFFT());
+
+	std::vector<CufftType> adjPruned = takeArray(op->performGpuNUFFTAdj(problem.kspaceData));
+	std::vector<CufftType> forwPruned = takeArray(op->performForwardGpuNUFFT(problem.imgData));
+	op->setPrunedFFT(false);
+	std::vector<CufftType> adj = takeArray(op->performGpuNUFFTAdj(problem.kspaceData));
+	std::vector<CufftType> forw = takeArray(op->performForwardGpuNUFFT(problem.imgData));
+
+	ASSERT_EQ(adj.size(), adjPruned.size());
+	for (size_t i = 0; i < adj.size(); i++)
+	{
+		EXPECT_EQ(adj[i].x, adjPruned[i].x) << "at " << i;
+		EXPECT_EQ(adj[i].y, adjPruned[i].y) << "at " << i;
+	}
+	ASSERT_EQ(forw.size(), forwPruned.size());
+	for (size_t i = 0; i < forw.size(); i++)
+	{
+		EXPECT_EQ(forw[i].x, forwPruned[i].x) << "at " << i;
+		EXPECT_EQ(forw[i].y, forwPruned[i].y) << "at " << i;
+	}
+}
+}
+
+TEST(CpuFFTTest, PrunedInputMatchesFull)
+{
+	checkPrunedFFT(gpuNUFFT::Dimensions(24, 20, 16), gpuNUFFT::CpuFFTPlan::PRUNE_INPUT);
+	checkPrunedFFT(gpuNUFFT::Dimensions(21, 15, 9), gpuNUFFT::CpuFFTPlan::PRUNE_INPUT);
+	checkPrunedFFT(gpuNUFFT::Dimensions(30, 25), gpuNUFFT::CpuFFTPlan::PRUNE_INPUT);
+}
+
+TEST(CpuFFTTest, PrunedOutputMatchesFull)
+{
+	checkPrunedFFT(gpuNUFFT::Dimensions(24, 20, 16), gpuNUFFT::CpuFFTPlan::PRUNE_OUTPUT);
+	checkPrunedFFT(gpuNUFFT::Dimensions(21, 15, 9), gpuNUFFT::CpuFFTPlan::PRUNE_OUTPUT);
+	checkPrunedFFT(gpuNUFFT::Dimensions(30, 25), gpuNUFFT::CpuFFTPlan::PRUNE_OUTPUT);
+}
+
+TEST(CpuOperatorTest, PrunedFFTMatchesFullFFT)
+{
+	checkPrunedFFTOperator(gpuNUFFT::Dimensions(16, 12, 10), (DType)2.0, true);
+	checkPrunedFFTOperator(gpuNUFFT::Dimensions(14, 12, 6), (DType)1.5, false);
+	checkPrunedFFTOperator(gpuNUFFT::Dimensions(20, 16), (DType)1.25, true);
+}
+
+namespace
+{
+// normal operator matches adjoint of the weighted forward operation
+void checkNormalOperator(gpuNUFFT::Dimensions imgDims, IndType coilCnt, bool useSens, bool useDens, bool useWeights, IndType coilBatchSize)
+{
+	IndType coordCnt = 1500;
+	RandomProblem problem(imgDims, coordCnt, coilCnt, useDens, useSens, 251);
+	gpuNUFFT::CpuNUFFTOperator *op = problem.createOperator(3, (DType)1.5);
+	op->setCoilBatchSize(coilBatchSize);
+
+	std::vector<DType> weightValues;
+	gpuNUFFT::Array<DType> weights;
+	if (useWeights)
+	{
+		unsigned seed = 241;
+		for (IndType i = 0; i < coordCnt; i++)
+			weightValues.push_back(nextRandom(seed) + (DType)0.5);
+		weights.data = &weightValues[0];
+		weights.dim.length = coordCnt;
+	}
+
+	std::vector<CufftType> kspaceValues(coordCnt * coilCnt);
+	gpuNUFFT::Array<CufftType> kspace;
+	kspace.data = &kspaceValues[0];
+	kspace.dim.length = coordCnt;
+	kspace.dim.channels = coilCnt;
+	op->performForwardGpuNUFFT(problem.imgData, kspace);
+	if (useWeights)
+		for (IndType c = 0; c < coilCnt; c++)
+			for (IndType i = 0; i < coordCnt; i++)
+			{
+				kspaceValues[c * coordCnt + i].x *= weightValues[i];
+				kspaceValues[c * coordCnt + i].y *= weightValues[i];
+			}
+	std::vector<CufftType> expected(problem.imgData.count());
+	gpuNUFFT::Array<CufftType> expectedData;
+	expectedData.data = &expected[0];
+	expectedData.dim = problem.imgData.dim;
+	op->performGpuNUFFTAdj(kspace, expectedData);
+
+	std::vector<CufftType> normalValues(problem.imgData.count());
+	gpuNUFFT::Array<CufftType> normal;
+	normal.data = &normalValues[0];
+	normal.dim = problem.imgData.dim;
+	for (int call = 0; call < 2; call++)
+	{
+		// stale output values are overwritten
+		for (IndType i = 0; i < normal.count(); i++)
+			normal.data[i].x = normal.data[i].y = (DType)(call + 1);
+		op->performNormal(problem.imgData, normal, weights);
+		expectNearGrids(expected, normalValues);
+	}
+}
+}
+
+TEST(CpuOperatorTest, NormalMatchesAdjointOfForward)
+{
+	checkNormalOperator(gpuNUFFT::Dimensions(16, 12), 1, false, false, false, 0);
+	checkNormalOperator(gpuNUFFT::Dimensions(16, 12), 3, true, true, true, 2);
+	checkNormalOperator(gpuNUFFT::Dimensions(14, 12, 6), 3, false, true, true, 2);
+	checkNormalOperator(gpuNUFFT::Dimensions(14, 12, 6), 2, true, false, true, 0);
+}
+
+TEST(CpuOperatorTest, NormalReusesWorkspace)
+{
+	gpuNUFFT::Dimensions imgDims(16, 16, 8);
+	IndType coordCnt = 1000;
+	IndType coilCnt = 4;
+	gpuNUFFT::Array<DType> kSpaceTraj = createRandomTrajectory(coordCnt, 3, 269);
+	gpuNUFFT::Array<DType> densData;
+	gpuNUFFT::Array<DType2> sensData = createRandomData(imgDims.count(), coilCnt, 271);
+	sensData.dim = imgDims;
+	sensData.dim.channels = coilCnt;
+	gpuNUFFT::Array<DType2> imgData = createRandomData(imgDims.count(), 1, 277);
+	imgData.dim = imgDims;
+	gpuNUFFT::Array<CufftType> normal;
+	normal.data = (CufftType*)malloc(imgData.count() * sizeof(CufftType));
+	normal.dim = imgDims;
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, densData, sensData, 3, 8, (DType)2.0, imgDims));
+	op->setCoilBatchSize(2);
+	// work stealing decides which threads process chunks, the scratch of
+	// all threads is allocated by the first call
+	gpuNUFFT::ThreadPool pool(4);
+	op->setThreadPool(&pool);
+	EXPECT_EQ(0u, op->getWorkspaceBytes());
+
+	op->performNormal(imgData, normal);
+	size_t workspaceBytes = op->getWorkspaceBytes();
+	size_t gridCount = op->getGridDims().count();
+	// k-space and grids of the coil batch, single coil grid, FFT and
+	// convolution scratch
+	EXPECT_LT((2 * op->getDataIndices().count() + 3 * gridCount) * sizeof(CufftType), workspaceBytes);
+	for (int call = 0; call < 3; call++)
+	{
+		op->performNormal(imgData, normal);
+		EXPECT_EQ(workspaceBytes, op->getWorkspaceBytes());
+	}
+
+	// adjoint and forward operation share the workspace
+	gpuNUFFT::Array<CufftType> kspace = op->performForwardGpuNUFFT(imgData);
+	gpuNUFFT::Array<CufftType> adj = op->performGpuNUFFTAdj(kspace);
+	EXPECT_EQ(workspaceBytes, op->getWorkspaceBytes());
+
+	// separate FFT shift passes keep the copy of the grid
+	op->setFoldFFTShift(false);
+	op->performNormal(imgData, normal);
+	workspaceBytes = op->getWorkspaceBytes();
+	op->performNormal(imgData, normal);
+	EXPECT_EQ(workspaceBytes, op->getWorkspaceBytes());
+
+	op->releaseWorkspace();
+	EXPECT_EQ(0u, op->getWorkspaceBytes());
+
+	free(adj.data);
+	free(kspace.data);
+	free(normal.data);
+	free(imgData.data);
+	free(sensData.data);
+	free(kSpaceTraj.data);
+	delete op;
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "gpuNUFFT_operator_factory.hpp"
+
+//Benchmark of the space-filling curve ordering of the CPU operator.
+//
+//Creates a 3-d radial (kooshball) trajectory and compares the adjoint and
+//forward throughput of the operator without curve ordering and with Morton
+//and Hilbert ordering of the sectors and samples. On Linux the last level
+//cache misses of the calling thread are counted by perf events, run with
+//one thread to count all gridding work. Cache misses are reported as n/a if
+//perf events are not available (e.g. perf_event_paranoid or containers).
+//
+//usage: runCurveOrderingBenchmark [image width] [threads] [repetitions]
+
+typedef std::chrono::high_resolution_clock Clock;
+
+//last level cache misses of the calling thread
+class CacheMissCounter
+{
+public:
+	CacheMissCounter() : fd(-1)
+	{
+#ifdef __linux__
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+
+	~CacheMissCounter()
+	{
+#ifdef __linux__
+		if (fd >= 0)
+			close(fd);
+#endif
+	}
+
+	void start()
+	{
+#ifdef __linux__
+		if (fd < 0)
+			return;
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	}
+
+	long long stop()
+	{
+		long long count = 0;
+#ifdef __linux__
+		if (fd < 0)
+			return -1;
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &count, sizeof(count)) != sizeof(count))
+			return -1;
+#endif
+		return count;
+	}
+
+private:
+	int fd;
+};
+
+//spokes x readout samples through the k-space center, spoke directions
+//on a golden angle spiral over the sphere
+std::vector<DType> createKooshball(IndType spokes, IndType readout)
+{
+	IndType coordCnt = spokes * readout;
+	std::vector<DType> coords(3*coordCnt);
+	DType goldenAngle = (DType)M_PI * (3 - sqrt((DType)5.0));
+	for (IndType s = 0; s < spokes; s++)
+	{
+		DType cosTheta = 1 - 2 * (s + (DType)0.5) / spokes;
+		DType sinTheta = sqrt(1 - cosTheta * cosTheta);
+		DType phi = goldenAngle * s;
+		for (IndType r = 0; r < readout; r++)
+		{
+			DType k = ((DType)r / readout - 0.5f) * 0.999f;
+			coords[s*readout + r] = k * sinTheta * cos(phi);
+			coords[s*readout + r + coordCnt] = k * sinTheta * sin(phi);
+			coords[s*readout + r + 2*coordCnt] = k * cosTheta;
+		}
+	}
+	return coords;
+}
+
+void printMisses(long long misses, int repetitions)
+{
+	if (misses < 0)
+		printf(" %14s", "n/a");
+	else
+		printf(" %14lld", misses / repetitions);
+}
+
+void runCurve(const char *name, gpuNUFFT::SpaceFillingCurve curve, std::vector<DType> &coords, gpuNUFFT::Dimensions imgDims, gpuNUFFT::ThreadPool &pool, int repetitions)
+{
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = coords.data();
+	kSpaceTraj.dim.length = (IndType)coords.size() / 3;
+	IndType coordCnt = kSpaceTraj.count();
+
+	gpuNUFFT::CostModelBalancer balancer(pool.getThreadCount());
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	factory.setLoadBalancer(&balancer);
+	factory.setSpaceFillingCurve(curve);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)1.25, imgDims));
+	op->setThreadPool(&pool);
+
+	gpuNUFFT::Array<DType2> imgData;
+	std::vector<DType2> image(imgDims.count());
+	for (IndType i = 0; i < imgDims.count(); i++)
+	{
+		image[i].x = (DType)rand() / RAND_MAX - 0.5f;
+		image[i].y = (DType)rand() / RAND_MAX - 0.5f;
+	}
+	imgData.data = image.data();
+	imgData.dim = imgDims;
+
+	gpuNUFFT::Array<CufftType> kspaceData;
+	std::vector<CufftType> kspace(coordCnt);
+	kspaceData.data = kspace.data();
+	kspaceData.dim.length = coordCnt;
+
+	//warm up
+	op->performForwardGpuNUFFT(imgData, kspaceData);
+	op->performGpuNUFFTAdj(kspaceData, imgData);
+
+	CacheMissCounter counter;
+	counter.start();
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		op->performForwardGpuNUFFT(imgData, kspaceData);
+	double forwSeconds = std::chrono::duration<double>(Clock::now() - start).count() / repetitions;
+	long long forwMisses = counter.stop();
+
+	counter.start();
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		op->performGpuNUFFTAdj(kspaceData, imgData);
+	double adjSeconds = std::chrono::duration<double>(Clock::now() - start).count() / repetitions;
+	long long adjMisses = counter.stop();
+
+	printf("%-8s %10.4f %12.2f", name, forwSeconds, coordCnt / forwSeconds * 1e-6);
+	printMisses(forwMisses, repetitions);
+	printf(" %10.4f %12.2f", adjSeconds, coordCnt / adjSeconds * 1e-6);
+	printMisses(adjMisses, repetitions);
+	printf("\n");
+
+	delete op;
+}
+
+int main(int argc, char** argv)
+{
+	int width = argc > 1 ? atoi(argv[1]) : 96;
+	int threads = argc > 2 ? atoi(argv[2]) : 1;
+	int repetitions = argc > 3 ? atoi(argv[3]) : 3;
+
+	gpuNUFFT::ThreadPool pool(threads);
+	gpuNUFFT::Dimensions imgDims(width, width, width);
+	std::vector<DType> radial = createKooshball(width * width / 2, 2 * width);
+
+	printf("image %d^3, %u samples, %u threads, %d repetitions\n", width, (unsigned)(radial.size() / 3), pool.getThreadCount(), repetitions);
+	printf("%-8s %10s %12s %14s %10s %12s %14s\n", "curve", "forw [s]", "forw [MS/s]", "forw misses", "adj [s]", "adj [MS/s]", "adj misses");
+
+	runCurve("none", gpuNUFFT::NO_CURVE, radial, imgDims, pool, repetitions);
+	runCurve("morton", gpuNUFFT::MORTON_CURVE, radial, imgDims, pool, repetitions);
+	runCurve("hilbert", gpuNUFFT::HILBERT_CURVE, radial, imgDims, pool, repetitions);
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include <limits.h>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include "gpuNUFFT_load_balancer.hpp"
+
+#include "gtest/gtest.h"
+
+namespace
+{
+// cumulative sample count of the sector loads
+std::vector<IndType> createSectorDataCount(const std::vector<IndType> &loads)
+{
+	std::vector<IndType> sectors(loads.size() + 1, 0);
+	for (size_t i = 0; i < loads.size(); i++)
+		sectors[i + 1] = sectors[i] + loads[i];
+	return sectors;
+}
+
+// sample counts of the chunks, a chunk ends at the next offset of its sector
+std::vector<IndType> getChunkSizes(const std::vector<IndType2> &order, const std::vector<IndType> &sectors)
+{
+	std::vector<IndType> sizes;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		IndType end = sectors[order[i].x + 1] - sectors[order[i].x];
+		for (size_t j = 0; j < order.size(); j++)
+			if (order[j].x == order[i].x && order[j].y > order[i].y)
+				end = std::min(end, order[j].y);
+		sizes.push_back(end - order[i].y);
+	}
+	return sizes;
+}
+
+// radial-like density: a few hot central sectors and many sparse ones
+std::vector<IndType> createRadialLoads()
+{
+	std::vector<IndType> loads(512, 40);
+	loads[200] = 20000;
+	loads[201] = 12000;
+	loads[232] = 9000;
+	loads[233] = 5000;
+	loads[300] = 0;
+	return loads;
+}
+}
+
+TEST(LoadBalancerTest, FixedPayloadSplit)
+{
+	IndType loadArray[] = {0, 600, 10, 256, 257};
+	std::vector<IndType> sectors = createSectorDataCount(std::vector<IndType>(loadArray, loadArray + 5));
+
+	gpuNUFFT::FixedPayloadBalancer balancer(256, 2);
+	std::vector<IndType2> order = balancer.computeProcessingOrder(&sectors[0], 5, gpuNUFFT::SectorGeometry(3, 8, true));
+
+	IndType expected[][2] = {{1, 0}, {1, 256}, {1, 512}, {4, 0}, {4, 256}, {3, 0}, {2, 0}};
+	ASSERT_EQ(7u, order.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		EXPECT_EQ(expected[i][0], order[i].x);
+		EXPECT_EQ(expected[i][1], order[i].y);
+	}
+	EXPECT_EQ(256u, balancer.getReport().chunkSize);
+	EXPECT_EQ(7u, balancer.getReport().chunkCount);
+	EXPECT_EQ(2u, balancer.getReport().workerCount);
+	EXPECT_GE(balancer.getReport().getPredictedImbalance(), 1.0);
+}
+
+TEST(LoadBalancerTest, CostModelSingleWorkerKeepsSectors)
+{
+	std::vector<IndType> loads = createRadialLoads();
+	std::vector<IndType> sectors = createSectorDataCount(loads);
+
+	gpuNUFFT::CostModelBalancer balancer(1);
+	std::vector<IndType2> order = balancer.computeProcessingOrder(&sectors[0], (IndType)loads.size(), gpuNUFFT::SectorGeometry(3, 8, true));
+
+	// splitting only adds merge cost
+	EXPECT_EQ(20000u, balancer.getReport().chunkSize);
+	EXPECT_EQ(loads.size() - 1, order.size());
+	EXPECT_NEAR(1.0, balancer.getReport().getPredictedImbalance(), 1e-9);
+}
+
+TEST(LoadBalancerTest, CostModelBalancesHotSectors)
+{
+	std::vector<IndType> loads = createRadialLoads();
+	std::vector<IndType> sectors = createSectorDataCount(loads);
+	gpuNUFFT::SectorGeometry geometry(3, 8, true);
+	IndType sampleCount = sectors[loads.size()];
+
+	gpuNUFFT::CostModelBalancer balancer(16);
+	std::vector<IndType2> order = balancer.computeProcessingOrder(&sectors[0], (IndType)loads.size(), geometry);
+	gpuNUFFT::LoadBalancingReport report = balancer.getReport();
+
+	gpuNUFFT::FixedPayloadBalancer fixedBalancer(MAXIMUM_PAYLOAD, 16);
+	fixedBalancer.computeProcessingOrder(&sectors[0], (IndType)loads.size(), geometry);
+	gpuNUFFT::FixedPayloadBalancer unsplitBalancer(20000, 16);
+	unsplitBalancer.computeProcessingOrder(&sectors[0], (IndType)loads.size(), geometry);
+
+	EXPECT_LT(report.chunkSize, 20000u);
+	EXPECT_LE(report.predictedMakespan, fixedBalancer.getReport().predictedMakespan);
+	EXPECT_LT(report.predictedMakespan, unsplitBalancer.getReport().predictedMakespan);
+	EXPECT_LT(report.getPredictedImbalance(), 1.1);
+
+	// longest processing time first, every sample is part of one chunk
+	std::vector<IndType> sizes = getChunkSizes(order, sectors);
+	IndType coveredSamples = 0;
+	for (size_t i = 0; i < sizes.size(); i++)
+	{
+		EXPECT_LE(sizes[i], report.chunkSize);
+		if (i > 0)
+		{
+			EXPECT_LE(sizes[i], sizes[i - 1]);
+		}
+		coveredSamples += sizes[i];
+	}
+	EXPECT_EQ(sampleCount, coveredSamples);
+	EXPECT_EQ(order.size(), report.chunkCount);
+}
+
+TEST(LoadBalancerTest, MergeCostSelectsLargerChunks)
+{
+	std::vector<IndType> loads = createRadialLoads();
+	std::vector<IndType> sectors = createSectorDataCount(loads);
+	gpuNUFFT::SectorGeometry geometry(3, 8, true);
+
+	gpuNUFFT::SectorCostModel cheapMerge;
+	cheapMerge.mergePointCost = 0.01;
+	gpuNUFFT::SectorCostModel expensiveMerge;
+	expensiveMerge.mergePointCost = 100.0;
+
+	gpuNUFFT::CostModelBalancer cheapBalancer(16, cheapMerge);
+	cheapBalancer.computeProcessingOrder(&sectors[0], (IndType)loads.size(), geometry);
+	gpuNUFFT::CostModelBalancer expensiveBalancer(16, expensiveMerge);
+	expensiveBalancer.computeProcessingOrder(&sectors[0], (IndType)loads.size(), geometry);
+
+	EXPECT_LT(cheapBalancer.getReport().chunkSize, expensiveBalancer.getReport().chunkSize);
+	EXPECT_NE(cheapBalancer.getDescription(), expensiveBalancer.getDescription());
+}
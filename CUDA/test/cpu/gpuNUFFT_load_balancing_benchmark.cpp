@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "gpuNUFFT_operator_factory.hpp"
+
+//Benchmark of the sector load balancing of the CPU operator.
+//
+//Creates 2-d radial and spiral trajectories, whose samples concentrate in
+//the sectors of the k-space center, and compares the fixed split into
+//chunks of MAXIMUM_PAYLOAD samples with the cost model driven balancing.
+//Reports the predicted makespan (relative to a perfectly balanced load) and
+//the measured makespan of the forward convolution, i.e. the largest busy
+//time of a thread, together with its ratio to the mean busy time.
+//
+//usage: runLoadBalancingBenchmark [image width] [threads] [repetitions]
+
+typedef std::chrono::high_resolution_clock Clock;
+
+//spokes x readout samples through the k-space center
+std::vector<DType> createRadial(IndType spokes, IndType readout)
+{
+	IndType coordCnt = spokes * readout;
+	std::vector<DType> coords(2*coordCnt);
+	for (IndType s = 0; s < spokes; s++)
+	{
+		DType phi = (DType)M_PI * s / spokes;
+		for (IndType r = 0; r < readout; r++)
+		{
+			DType k = ((DType)r / readout - 0.5f) * 0.999f;
+			coords[s*readout + r] = k * cos(phi);
+			coords[s*readout + r + coordCnt] = k * sin(phi);
+		}
+	}
+	return coords;
+}
+
+//variable density spiral arms, radius growing quadratically with time
+std::vector<DType> createSpiral(IndType arms, IndType samplesPerArm)
+{
+	IndType coordCnt = arms * samplesPerArm;
+	std::vector<DType> coords(2*coordCnt);
+	DType turns = 32;
+	for (IndType a = 0; a < arms; a++)
+	{
+		for (IndType i = 0; i < samplesPerArm; i++)
+		{
+			DType t = (DType)i / samplesPerArm;
+			DType k = 0.499f * t * t;
+			DType phi = 2 * (DType)M_PI * (turns * t + (DType)a / arms);
+			coords[a*samplesPerArm + i] = k * cos(phi);
+			coords[a*samplesPerArm + i + coordCnt] = k * sin(phi);
+		}
+	}
+	return coords;
+}
+
+void runBalancer(const char *name, const char *balancing, std::vector<DType> &coords, gpuNUFFT::Dimensions imgDims, gpuNUFFT::LoadBalancer &balancer, gpuNUFFT::ThreadPool &pool, int repetitions)
+{
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = coords.data();
+	kSpaceTraj.dim.length = (IndType)coords.size() / 2;
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	factory.setLoadBalancer(&balancer);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, 3, 8, (DType)2.0, imgDims));
+	op->setThreadPool(&pool);
+	gpuNUFFT::LoadBalancingReport report = balancer.getReport();
+
+	gpuNUFFT::Array<DType2> imgData;
+	std::vector<DType2> image(imgDims.count());
+	for (IndType i = 0; i < imgDims.count(); i++)
+	{
+		image[i].x = (DType)rand() / RAND_MAX - 0.5f;
+		image[i].y = (DType)rand() / RAND_MAX - 0.5f;
+	}
+	imgData.data = image.data();
+	imgData.dim = imgDims;
+
+	gpuNUFFT::Array<CufftType> kspaceData;
+	kspaceData.data = (CufftType*)malloc(kSpaceTraj.count() * sizeof(CufftType));
+	kspaceData.dim.length = kSpaceTraj.count();
+
+	pool.resetThreadStatistics();
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		op->performForwardGpuNUFFT(imgData, kspaceData);
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count() / repetitions;
+
+	//only the convolution is scheduled by work stealing
+	std::vector<gpuNUFFT::ThreadPool::ThreadStatistics> stats = pool.getThreadStatistics();
+	double maxBusy = 0.0;
+	double sumBusy = 0.0;
+	for (size_t t = 0; t < stats.size(); t++)
+	{
+		maxBusy = std::max(maxBusy, stats[t].busySeconds);
+		sumBusy += stats[t].busySeconds;
+	}
+	double measuredImbalance = sumBusy > 0.0 ? maxBusy * stats.size() / sumBusy : 1.0;
+
+	printf("%-8s %-12s %8u %8u %12.3f %14.4f %12.3f %10.4f\n", name, balancing, report.chunkSize, report.chunkCount, report.getPredictedImbalance(), maxBusy / repetitions, measuredImbalance, seconds);
+
+	free(kspaceData.data);
+	delete op;
+}
+
+int main(int argc, char** argv)
+{
+	int width = argc > 1 ? atoi(argv[1]) : 256;
+	int threads = argc > 2 ? atoi(argv[2]) : 0;
+	int repetitions = argc > 3 ? atoi(argv[3]) : 5;
+
+	gpuNUFFT::ThreadPool pool(threads);
+	gpuNUFFT::Dimensions imgDims(width, width);
+	std::vector<DType> radial = createRadial(2 * width, 2 * width);
+	std::vector<DType> spiral = createSpiral(width / 4, 16 * width);
+
+	printf("image %d^2, %u threads, %d repetitions\n", width, pool.getThreadCount(), repetitions);
+	printf("%-8s %-12s %8s %8s %12s %14s %12s %10s\n", "traj", "balancing", "chunk", "chunks", "pred. imbal.", "makespan [s]", "meas. imbal.", "time [s]");
+
+	gpuNUFFT::FixedPayloadBalancer fixedBalancer(MAXIMUM_PAYLOAD, pool.getThreadCount());
+	gpuNUFFT::CostModelBalancer costModelBalancer(pool.getThreadCount());
+	runBalancer("radial", "fixed", radial, imgDims, fixedBalancer, pool, repetitions);
+	runBalancer("radial", "cost model", radial, imgDims, costModelBalancer, pool, repetitions);
+	runBalancer("spiral", "fixed", spiral, imgDims, fixedBalancer, pool, repetitions);
+	runBalancer("spiral", "cost model", spiral, imgDims, costModelBalancer, pool, repetitions);
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include <limits.h>
+#include <vector>
+#include "gpuNUFFT_memory_planner.hpp"
+#include "gpuNUFFT_operator_factory.hpp"
+#include "gpuNUFFT_cpu_fft.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(MemoryPlannerTest, DeviceRequirements2D)
+{
+	// 128x128 grid, 16x16 sectors
+	gpuNUFFT::Dimensions imgDims(64, 64);
+	IndType dataCount = 1000;
+	gpuNUFFT::MemoryPlanner planner(gpuNUFFT::DEVICE_MEMORY, imgDims, (DType)2.0, 8, dataCount, true, true);
+	planner.setDeapodization(true);
+	EXPECT_EQ(128u, planner.getGridDims().width);
+	EXPECT_EQ(128u, planner.getGridDims().height);
+
+	size_t gridCount = 128 * 128;
+	size_t imgCount = 64 * 64;
+	size_t sectorCount = 16 * 16;
+	gpuNUFFT::MemoryRequirements req = planner.getRequirements(3);
+	EXPECT_EQ(dataCount * (2 * sizeof(DType) + sizeof(IndType) + sizeof(DType)) +
+		(sectorCount + 1) * sizeof(IndType) + 2 * sectorCount * sizeof(IndType) +
+		imgCount * sizeof(DType), req.planBytes);
+	EXPECT_EQ(3 * dataCount * sizeof(DType2), req.kspaceBytes);
+	EXPECT_EQ(3 * gridCount * sizeof(CufftType), req.gridBytes);
+	EXPECT_EQ(3 * imgCount * sizeof(CufftType), req.imageBytes);
+	EXPECT_EQ(gridCount * sizeof(CufftType), req.fftScratchBytes);
+	EXPECT_EQ(3 * imgCount * sizeof(DType2) + imgCount * sizeof(CufftType), req.sensBytes);
+	EXPECT_EQ(req.planBytes + req.kspaceBytes + req.gridBytes + req.imageBytes + req.fftScratchBytes + req.sensBytes, req.getTotalBytes());
+
+	// the processing order of the balanced operators is uploaded as well
+	planner.setProcessingOrderCount(100);
+	EXPECT_EQ(req.planBytes + 100 * sizeof(IndType2), planner.getRequirements(3).planBytes);
+}
+
+TEST(MemoryPlannerTest, DepthOf3DGrids)
+{
+	gpuNUFFT::MemoryPlanner planner2D(gpuNUFFT::DEVICE_MEMORY, gpuNUFFT::Dimensions(32, 32), (DType)1.5, 8, 500, false, false);
+	gpuNUFFT::MemoryPlanner planner3D(gpuNUFFT::DEVICE_MEMORY, gpuNUFFT::Dimensions(32, 32, 20), (DType)1.5, 8, 500, false, false);
+	EXPECT_EQ(30u, planner3D.getGridDims().depth);
+
+	gpuNUFFT::MemoryRequirements req2D = planner2D.getRequirements(2);
+	gpuNUFFT::MemoryRequirements req3D = planner3D.getRequirements(2);
+	EXPECT_EQ(30 * req2D.gridBytes, req3D.gridBytes);
+	EXPECT_EQ(20 * req2D.imageBytes, req3D.imageBytes);
+	EXPECT_EQ(0u, req3D.sensBytes);
+}
+
+TEST(MemoryPlannerTest, LargestFeasibleCoilBatch)
+{
+	gpuNUFFT::MemoryPlanner planner(gpuNUFFT::DEVICE_MEMORY, gpuNUFFT::Dimensions(64, 64, 32), (DType)1.25, 8, 20000, true, true);
+	IndType coilCnt = 32;
+
+	for (IndType batch = 1; batch <= coilCnt; batch++)
+	{
+		size_t required = planner.getRequirements(batch).getTotalBytes();
+		EXPECT_EQ(batch, planner.selectCoilBatch(coilCnt, required));
+		EXPECT_EQ(batch - 1, planner.selectCoilBatch(coilCnt, required - 1));
+	}
+	EXPECT_EQ(coilCnt, planner.selectCoilBatch(coilCnt, (size_t)-1));
+	EXPECT_EQ(0u, planner.selectCoilBatch(coilCnt, planner.getRequirements(0).getTotalBytes()));
+	EXPECT_EQ(0u, planner.selectCoilBatch(0, (size_t)-1));
+}
+
+TEST(MemoryPlannerTest, HostRequirements)
+{
+	gpuNUFFT::MemoryPlanner planner(gpuNUFFT::HOST_MEMORY, gpuNUFFT::Dimensions(20, 16, 12), (DType)2.0, 8, 300, false, true);
+	planner.setThreadCount(4);
+
+	size_t gridCount = 40 * 32 * 24;
+	gpuNUFFT::MemoryRequirements req = planner.getRequirements(5);
+	// batched buffers of the convolution and single coil grid
+	EXPECT_EQ(5 * 300 * sizeof(DType2), req.kspaceBytes);
+	EXPECT_EQ(6 * gridCount * sizeof(CufftType), req.gridBytes);
+	EXPECT_EQ(0u, req.imageBytes);
+	EXPECT_EQ(0u, req.sensBytes);
+	EXPECT_EQ(4 * 4 * 40 * gpuNUFFT::CpuFFTPlan::LANES * sizeof(DType), req.fftScratchBytes);
+}
+
+TEST(MemoryPlannerTest, PlanBytesOfCpuOperator)
+{
+	gpuNUFFT::Dimensions imgDims(16, 16, 12);
+	IndType coordCnt = 400;
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = (DType*)calloc(3 * coordCnt, sizeof(DType));
+	kSpaceTraj.dim.length = coordCnt;
+	for (IndType i = 0; i < 3 * coordCnt; i++)
+		kSpaceTraj.data[i] = (DType)((i * 37) % 100) / 100 - (DType)0.5;
+	gpuNUFFT::Array<DType> densData;
+	densData.data = (DType*)calloc(coordCnt, sizeof(DType));
+	densData.dim.length = coordCnt;
+	gpuNUFFT::Array<DType2> sensData;
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, densData, sensData, 3, 8, (DType)1.5, imgDims));
+	gpuNUFFT::MemoryPlanner planner = gpuNUFFT::MemoryPlanner::forOperator(op);
+	EXPECT_EQ(gpuNUFFT::HOST_MEMORY, planner.getTarget());
+
+	size_t planBytes = 3 * coordCnt * sizeof(DType) + op->getDataIndices().count() * sizeof(IndType) +
+		op->getSectorDataCount().count() * sizeof(IndType) + op->getSectorCenters().count() * sizeof(IndType) +
+		op->getSectorProcessingOrder().count() * sizeof(IndType2) + op->getDens().count() * sizeof(DType) +
+		op->getDeapodizationVectors().count() * sizeof(DType);
+	EXPECT_EQ(planBytes, planner.getRequirements(1).planBytes);
+
+	delete op;
+	free(kSpaceTraj.data);
+	free(densData.data);
+}
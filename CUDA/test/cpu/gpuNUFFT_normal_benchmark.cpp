@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+#include <cmath>
+
+#include "gpuNUFFT_operator_factory.hpp"
+
+//Benchmark of the normal operator of the CPU operator.
+//
+//Runs 50 conjugate gradient iterations solving A^H A x = A^H y for a 3-d
+//multi-coil acquisition with coil sensitivities, once applying A^H A as
+//separate forward and adjoint operation allocating the k-space data and
+//image of each call and once using performNormal, which reuses the
+//workspace of the operator. Prints the time per iteration, the workspace
+//size and the difference of the solutions.
+//
+//usage: runNormalBenchmark [image width] [coils] [samples] [threads]
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+DType randomValue()
+{
+	return (DType)rand() / RAND_MAX - (DType)0.5;
+}
+
+double dot(const std::vector<CufftType> &a, const std::vector<CufftType> &b)
+{
+	double sum = 0;
+	for (size_t i = 0; i < a.size(); i++)
+		sum += (double)a[i].x * b[i].x + (double)a[i].y * b[i].y;
+	return sum;
+}
+
+void axpy(std::vector<CufftType> &y, DType alpha, const std::vector<CufftType> &x)
+{
+	for (size_t i = 0; i < y.size(); i++)
+	{
+		y[i].x += alpha * x[i].x;
+		y[i].y += alpha * x[i].y;
+	}
+}
+
+//applies A^H A to p by separate forward and adjoint operation
+void applySeparate(gpuNUFFT::CpuNUFFTOperator *op, std::vector<CufftType> &p, std::vector<CufftType> &q)
+{
+	gpuNUFFT::Array<DType2> image;
+	image.data = (DType2*)p.data();
+	image.dim = op->getImageDims();
+	gpuNUFFT::Array<CufftType> kspace = op->performForwardGpuNUFFT(image);
+	gpuNUFFT::Array<CufftType> result = op->performGpuNUFFTAdj(kspace);
+	std::copy(result.data, result.data + q.size(), q.begin());
+	free(kspace.data);
+	free(result.data);
+}
+
+void applyNormal(gpuNUFFT::CpuNUFFTOperator *op, std::vector<CufftType> &p, std::vector<CufftType> &q)
+{
+	gpuNUFFT::Array<DType2> image;
+	image.data = (DType2*)p.data();
+	image.dim = op->getImageDims();
+	gpuNUFFT::Array<CufftType> result;
+	result.data = q.data();
+	result.dim = op->getImageDims();
+	op->performNormal(image, result);
+}
+
+//conjugate gradient iterations starting at x = 0, returns the seconds spent
+double solveCG(gpuNUFFT::CpuNUFFTOperator *op, const std::vector<CufftType> &rhs, std::vector<CufftType> &x, int iterations, bool normal)
+{
+	CufftType zero;
+	zero.x = 0;
+	zero.y = 0;
+	x.assign(rhs.size(), zero);
+	std::vector<CufftType> r(rhs);
+	std::vector<CufftType> p(rhs);
+	std::vector<CufftType> q(rhs.size());
+	double rr = dot(r, r);
+
+	Clock::time_point start = Clock::now();
+	for (int it = 0; it < iterations; it++)
+	{
+		if (normal)
+			applyNormal(op, p, q);
+		else
+			applySeparate(op, p, q);
+		DType alpha = (DType)(rr / dot(p, q));
+		axpy(x, alpha, p);
+		axpy(r, -alpha, q);
+		double rrNew = dot(r, r);
+		DType beta = (DType)(rrNew / rr);
+		rr = rrNew;
+		for (size_t i = 0; i < p.size(); i++)
+		{
+			p[i].x = r[i].x + beta * p[i].x;
+			p[i].y = r[i].y + beta * p[i].y;
+		}
+	}
+	return secondsSince(start);
+}
+
+int main(int argc, char **argv)
+{
+	IndType width = argc > 1 ? (IndType)atoi(argv[1]) : 64;
+	IndType coilCnt = argc > 2 ? (IndType)atoi(argv[2]) : 8;
+	IndType coordCnt = argc > 3 ? (IndType)atoi(argv[3]) : 200000;
+	unsigned threads = argc > 4 ? (unsigned)atoi(argv[4]) : 0;
+	int iterations = 50;
+
+	gpuNUFFT::ThreadPool pool(threads);
+	gpuNUFFT::Dimensions imgDims(width, width, width);
+	IndType imgCount = imgDims.count();
+
+	srand(1);
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = (DType*)malloc(3 * coordCnt * sizeof(DType));
+	kSpaceTraj.dim.length = coordCnt;
+	for (IndType i = 0; i < 3 * coordCnt; i++)
+		kSpaceTraj.data[i] = randomValue();
+	gpuNUFFT::Array<DType> densData;
+	gpuNUFFT::Array<DType2> sensData;
+	sensData.data = (DType2*)malloc(imgCount * coilCnt * sizeof(DType2));
+	sensData.dim = imgDims;
+	sensData.dim.channels = coilCnt;
+	for (IndType i = 0; i < imgCount * coilCnt; i++)
+	{
+		sensData.data[i].x = randomValue();
+		sensData.data[i].y = randomValue();
+	}
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false, false, false);
+	gpuNUFFT::CpuNUFFTOperator *op = static_cast<gpuNUFFT::CpuNUFFTOperator*>(factory.createGpuNUFFTOperator(kSpaceTraj, densData, sensData, 3, 8, (DType)1.5, imgDims));
+	op->setThreadPool(&pool);
+
+	//right hand side A^H y of random k-space data
+	gpuNUFFT::Array<DType2> kspaceData;
+	kspaceData.data = (DType2*)malloc(coordCnt * coilCnt * sizeof(DType2));
+	kspaceData.dim.length = coordCnt;
+	kspaceData.dim.channels = coilCnt;
+	for (IndType i = 0; i < coordCnt * coilCnt; i++)
+	{
+		kspaceData.data[i].x = randomValue();
+		kspaceData.data[i].y = randomValue();
+	}
+	gpuNUFFT::Array<CufftType> adj = op->performGpuNUFFTAdj(kspaceData);
+	std::vector<CufftType> rhs(adj.data, adj.data + imgCount);
+	free(adj.data);
+
+	printf("image %u^3, %u coils, %u samples, %u threads, %d CG iterations\n", (unsigned)width, (unsigned)coilCnt, (unsigned)coordCnt, pool.getThreadCount(), iterations);
+
+	std::vector<CufftType> xSeparate;
+	std::vector<CufftType> xNormal;
+	double separate = solveCG(op, rhs, xSeparate, iterations, false);
+	op->releaseWorkspace();
+	double normal = solveCG(op, rhs, xNormal, iterations, true);
+
+	double diff = 0;
+	for (IndType i = 0; i < imgCount; i++)
+		diff += (double)(xSeparate[i].x - xNormal[i].x) * (xSeparate[i].x - xNormal[i].x) + (double)(xSeparate[i].y - xNormal[i].y) * (xSeparate[i].y - xNormal[i].y);
+
+	printf("%-28s %10.2f ms/iteration\n", "forward + adjoint", 1000 * separate / iterations);
+	printf("%-28s %10.2f ms/iteration %8.2fx\n", "performNormal", 1000 * normal / iterations, separate / normal);
+	printf("workspace %.1f MB, solution difference %g (relative)\n", op->getWorkspaceBytes() / 1e6, sqrt(diff / dot(xSeparate, xSeparate)));
+
+	delete op;
+	free(kspaceData.data);
+	free(sensData.data);
+	free(kSpaceTraj.data);
+	return 0;
+}
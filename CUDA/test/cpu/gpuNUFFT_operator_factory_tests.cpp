@@ -108,6 +108,32 @@ TEST(OperatorFactoryTest,TestInvalidArgumentInit)
 	},std::invalid_argument);
 }
 
+TEST(OperatorFactoryTest,TestGpuIndexRange)
+{
+	// the CUDA kernels index with int, the check precedes any allocation
+	IndType imageWidth = 1300;
+	DType osf = 1.0;
+	IndType sectorWidth = 8;
+	IndType kernelWidth = 3;
+
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	gpuNUFFT::Array<IndType> dataIndices;
+	dataIndices.dim.length = 4;
+	gpuNUFFT::Array<IndType> sectorDataCount;
+	gpuNUFFT::Array<IndType2> sectorProcessingOrder;
+	gpuNUFFT::Array<IndType> sectorCenters;
+	gpuNUFFT::Array<DType2> sensData;
+	gpuNUFFT::Array<DType> deapoData;
+	gpuNUFFT::Dimensions imgDims(imageWidth,imageWidth,imageWidth);
+
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false,true,false);
+	EXPECT_THROW(factory.loadPrecomputedGpuNUFFTOperator(kSpaceTraj, dataIndices, sectorDataCount, sectorProcessingOrder, sectorCenters, sensData, deapoData, kernelWidth, sectorWidth, osf, imgDims),std::invalid_argument);
+
+	gpuNUFFT::Dimensions smallDims(16,16,16);
+	dataIndices.dim.length = (IndType)INT_MAX + 1;
+	EXPECT_THROW(factory.loadPrecomputedGpuNUFFTOperator(kSpaceTraj, dataIndices, sectorDataCount, sectorProcessingOrder, sectorCenters, sensData, deapoData, kernelWidth, sectorWidth, osf, smallDims),std::invalid_argument);
+}
+
 TEST(OperatorFactoryTest,Test2DInit)
 {
 	IndType imageWidth = 16; 
@@ -165,3 +191,42 @@ TEST(OperatorFactoryTest,Test2DInit)
 	EXPECT_NEAR(-0.33,sortedCoords.data[12],EPS);*/
 	delete gpuNUFFTOp;
 }
+
+#ifdef GPU_INDEX64
+TEST(OperatorFactoryTest,Test64BitGridInit)
+{
+	// oversampled grid of 2^33 points, only the sector data is allocated
+	IndType imageWidth = 1024;
+	DType osf = 2.0;
+	IndType sectorWidth = 256;
+	IndType kernelWidth = 3;
+
+	const IndType coordCnt = 4;
+	DType coords[coordCnt*3] = {(DType)-0.5,(DType)-0.1,(DType)0.1,(DType)0.45,//x
+								(DType)-0.5,(DType)0.0,(DType)0.1,(DType)0.45,//y
+								(DType)-0.5,(DType)0.0,(DType)-0.1,(DType)0.45};//z
+
+	gpuNUFFT::Array<DType> kSpaceTraj;
+	kSpaceTraj.data = coords;
+	kSpaceTraj.dim.length = coordCnt;
+
+	gpuNUFFT::Dimensions imgDims(imageWidth,imageWidth,imageWidth);
+	gpuNUFFT::GpuNUFFTOperatorFactory factory(false,false,false);
+	gpuNUFFT::GpuNUFFTOperator *gpuNUFFTOp = factory.createGpuNUFFTOperator(kSpaceTraj, kernelWidth, sectorWidth, osf, imgDims);
+
+	EXPECT_EQ(8u, sizeof(IndType));
+	EXPECT_EQ(1ull << 33, gpuNUFFTOp->getGridDims().count());
+	EXPECT_EQ(1ull << 30, gpuNUFFTOp->getImageDims().count());
+	EXPECT_EQ(512u, gpuNUFFTOp->getGridSectorDims().count());
+
+	gpuNUFFT::Array<IndType> sectorDataCount = gpuNUFFTOp->getSectorDataCount();
+	EXPECT_EQ(coordCnt, sectorDataCount.data[sectorDataCount.count() - 1]);
+	gpuNUFFT::Array<IndType> dataIndices = gpuNUFFTOp->getDataIndices();
+	std::vector<IndType> indices(dataIndices.data, dataIndices.data + coordCnt);
+	std::sort(indices.begin(), indices.end());
+	for (IndType i = 0; i < coordCnt; i++)
+		EXPECT_EQ(i, indices[i]);
+
+	delete gpuNUFFTOp;
+}
+#endif
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "cpuNUFFT_operator.hpp"
+#include "gpuNUFFT_cpu_kernels.hpp"
+
+//Benchmark of the fused image stages of the CPU operator.
+//
+//Compares the separate passes of the adjoint post-processing (crop, FFT
+//scaling, deapodization, sensitivity multiplication and coil summation)
+//and the forward pre-processing (sensitivity multiplication, deapodization,
+//zero padding and FFT scaling) with the fused single pass stages
+//performCropDeapodizationCPU and performDeapodizationPaddingCPU for a 3-d
+//multi-coil volume. Further compares the FFT shift passes around the FFT
+//with the shifts folded into these stages. The effective bandwidth counts
+//the bytes read and written by each variant.
+//
+//usage: runPostprocessingBenchmark [image width] [coils] [threads] [repetitions]
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//exposes the gridding info of the operator
+class InfoCpuNUFFTOperator : public gpuNUFFT::CpuNUFFTOperator
+{
+public:
+	InfoCpuNUFFTOperator(gpuNUFFT::Dimensions imgDims, DType osf, gpuNUFFT::ThreadPool *pool) : gpuNUFFT::CpuNUFFTOperator(3, 8, osf, imgDims, false, pool)
+	{
+	}
+
+	gpuNUFFT::GpuNUFFTInfo *createInfo()
+	{
+		return initGpuNUFFTInfo(1);
+	}
+};
+
+std::vector<DType2> createData(IndType count, unsigned seed)
+{
+	srand(seed);
+	std::vector<DType2> data(count);
+	for (IndType i = 0; i < count; i++)
+	{
+		data[i].x = (DType)rand() / RAND_MAX - (DType)0.5;
+		data[i].y = (DType)rand() / RAND_MAX - (DType)0.5;
+	}
+	return data;
+}
+
+void printResult(const char *name, double seconds, double bytes, int repetitions)
+{
+	printf("%-24s %10.2f ms %10.2f GB/s\n", name, 1000 * seconds / repetitions, bytes * repetitions / seconds / 1e9);
+}
+
+int main(int argc, char **argv)
+{
+	IndType width = argc > 1 ? (IndType)atoi(argv[1]) : 128;
+	IndType coilCnt = argc > 2 ? (IndType)atoi(argv[2]) : 8;
+	unsigned threads = argc > 3 ? (unsigned)atoi(argv[3]) : 0;
+	int repetitions = argc > 4 ? atoi(argv[4]) : 3;
+
+	gpuNUFFT::ThreadPool pool(threads);
+	gpuNUFFT::Dimensions imgDims(width, width, width);
+	InfoCpuNUFFTOperator op(imgDims, (DType)1.5, &pool);
+	gpuNUFFT::GpuNUFFTInfo *gi_host = op.createInfo();
+	gpuNUFFT::Array<DType> deapoVectors = op.computeDeapodizationVectors();
+
+	IndType imgCount = imgDims.count();
+	IndType gridCount = op.getGridDims().count();
+	std::vector<CufftType> grid = createData(gridCount, 1);
+	std::vector<DType2> sens = createData(imgCount * coilCnt, 2);
+	std::vector<DType2> image = createData(imgCount, 3);
+	std::vector<CufftType> imdata(imgCount);
+	std::vector<CufftType> imdataSum(imgCount);
+	std::vector<DType2> padImage(imgCount);
+
+	printf("image %u^3, grid %u^3, %u coils, %u threads\n", (unsigned)width, (unsigned)op.getGridDims().width, (unsigned)coilCnt, pool.getThreadCount());
+
+	//bytes per coil, the crop reads the image region of the grid
+	double cropBytes = (double)imgCount * sizeof(CufftType);
+	double imgBytes = (double)imgCount * sizeof(CufftType);
+	double vecBytes = (double)(3 * width) * sizeof(DType);
+
+	//adjoint: crop 2, scaling 2, deapodization 2, sensitivities 3, sum 3
+	double separateAdjBytes = coilCnt * (cropBytes + 11 * imgBytes + vecBytes);
+	//fused: grid region, sensitivities, read and write of the sum
+	double fusedAdjBytes = coilCnt * (cropBytes + 3 * imgBytes + vecBytes);
+
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		for (IndType c = 0; c < coilCnt; c++)
+		{
+			performCropCPU(grid.data(), imdata.data(), gi_host, &pool);
+			performFFTScalingCPU(imdata.data(), gi_host->im_width_dim, gi_host, &pool);
+			performDeapodizationCPU(imdata.data(), NULL, deapoVectors.data, gi_host, &pool);
+			performSensMulCPU(imdata.data(), sens.data() + c * imgCount, gi_host, true, &pool);
+			performSensSumCPU(imdata.data(), imdataSum.data(), gi_host, &pool);
+		}
+	printResult("adjoint separate", secondsSince(start), separateAdjBytes, repetitions);
+
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		for (IndType c = 0; c < coilCnt; c++)
+			performCropDeapodizationCPU(grid.data(), imdataSum.data(), NULL, deapoVectors.data, sens.data() + c * imgCount, false, gi_host, &pool);
+	printResult("adjoint fused", secondsSince(start), fusedAdjBytes, repetitions);
+
+	//forward: copy 2, sensitivities 3, deapodization 2, padding 2 passes
+	//over the image, zero fill 1 and scaling 2 passes over the grid
+	double fullGridBytes = (double)gridCount * sizeof(CufftType);
+	double separateFwdBytes = coilCnt * (9 * imgBytes + 3 * fullGridBytes + vecBytes);
+	//fused: image, sensitivities, single write of the grid
+	double fusedFwdBytes = coilCnt * (2 * imgBytes + fullGridBytes + vecBytes);
+
+	CufftType zero;
+	zero.x = 0;
+	zero.y = 0;
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		for (IndType c = 0; c < coilCnt; c++)
+		{
+			std::copy(image.begin(), image.end(), padImage.begin());
+			std::fill(grid.begin(), grid.end(), zero);
+			performSensMulCPU((CufftType*)padImage.data(), sens.data() + c * imgCount, gi_host, false, &pool);
+			performForwardDeapodizationCPU(padImage.data(), NULL, deapoVectors.data, gi_host, &pool);
+			performPaddingCPU(padImage.data(), grid.data(), gi_host, &pool);
+			performFFTScalingCPU(grid.data(), gridCount, gi_host, &pool);
+		}
+	printResult("forward separate", secondsSince(start), separateFwdBytes, repetitions);
+
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		for (IndType c = 0; c < coilCnt; c++)
+			performDeapodizationPaddingCPU(image.data(), sens.data() + c * imgCount, grid.data(), NULL, deapoVectors.data, false, gi_host, &pool);
+	printResult("forward fused", secondsSince(start), fusedFwdBytes, repetitions);
+
+	//FFT shifts: copy and write back of the grid, 4 passes each, two per
+	//coil and direction, versus the folded index mapping of the fused stages
+	gpuNUFFT::Dimensions gridDims = op.getGridDims();
+	double shiftBytes = coilCnt * 8 * fullGridBytes;
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		for (IndType c = 0; c < coilCnt; c++)
+		{
+			performFFTShiftCPU(grid.data(), gpuNUFFT::INVERSE, gridDims, gi_host, &pool);
+			performFFTShiftCPU(grid.data(), gpuNUFFT::INVERSE, gridDims, gi_host, &pool);
+			performCropDeapodizationCPU(grid.data(), imdataSum.data(), NULL, deapoVectors.data, sens.data() + c * imgCount, false, gi_host, &pool);
+		}
+	printResult("adjoint shifts + fused", secondsSince(start), shiftBytes + fusedAdjBytes, repetitions);
+
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		for (IndType c = 0; c < coilCnt; c++)
+			performCropDeapodizationCPU(grid.data(), imdataSum.data(), NULL, deapoVectors.data, sens.data() + c * imgCount, true, gi_host, &pool);
+	printResult("adjoint folded shifts", secondsSince(start), fusedAdjBytes, repetitions);
+
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		for (IndType c = 0; c < coilCnt; c++)
+		{
+			performDeapodizationPaddingCPU(image.data(), sens.data() + c * imgCount, grid.data(), NULL, deapoVectors.data, false, gi_host, &pool);
+			performFFTShiftCPU(grid.data(), gpuNUFFT::INVERSE, gridDims, gi_host, &pool);
+			performFFTShiftCPU(grid.data(), gpuNUFFT::FORWARD, gridDims, gi_host, &pool);
+		}
+	printResult("forward fused + shifts", secondsSince(start), shiftBytes + fusedFwdBytes, repetitions);
+
+	start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+		for (IndType c = 0; c < coilCnt; c++)
+			performDeapodizationPaddingCPU(image.data(), sens.data() + c * imgCount, grid.data(), NULL, deapoVectors.data, true, gi_host, &pool);
+	printResult("forward folded shifts", secondsSince(start), fusedFwdBytes, repetitions);
+
+	free(deapoVectors.data);
+	free(gi_host);
+	return 0;
+}
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "gpuNUFFT_cpu_kernels.hpp"
+#include "precomp_utils.hpp"
+
+//Benchmark of the host precomputation (sorting of the samples by sector).
+//
+//Compares the former sequential pipeline (sector assignment, std::sort of
+//index/sector pairs, scatter loop, sector data count) with the parallel
+//counting sort sortSamplesBySectorCPU for 10^6 up to max samples of a 3-d
+//trajectory.
+//
+//usage: runPrecomputationBenchmark [max samples] [grid width] [threads]
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//former host precomputation of createGpuNUFFTOperator
+void sortReference(std::vector<DType> &coords, std::vector<DType> &dens, IndType coordCnt, gpuNUFFT::Dimensions gridDims, gpuNUFFT::Dimensions sectorDims, IndType sectorWidth, std::vector<DType> &trajSorted, std::vector<DType> &densSorted, std::vector<IndType> &dataIndices, std::vector<IndType> &sectorDataCount)
+{
+	std::vector<IndType> assignedSectors(coordCnt);
+	for (IndType i = 0; i < coordCnt; i++)
+	{
+		DType3 coord;
+		coord.x = coords[i];
+		coord.y = coords[i + coordCnt];
+		coord.z = coords[i + 2*coordCnt];
+		assignedSectors[i] = computeInd32Lin(computeSectorMapping(coord, gridDims, (DType)sectorWidth), sectorDims);
+	}
+
+	std::vector<gpuNUFFT::IndPair> secVector;
+	for (IndType i = 0; i < coordCnt; i++)
+		secVector.push_back(gpuNUFFT::IndPair(i, assignedSectors[i]));
+	std::sort(secVector.begin(), secVector.end());
+
+	for (IndType i = 0; i < coordCnt; i++)
+	{
+		for (int d = 0; d < 3; d++)
+			trajSorted[i + d*coordCnt] = coords[secVector[i].first + d*coordCnt];
+		densSorted[i] = dens[secVector[i].first];
+		dataIndices[i] = secVector[i].first;
+		assignedSectors[i] = secVector[i].second;
+	}
+
+	IndType cnt = 0;
+	sectorDataCount[0] = 0;
+	for (IndType sec = 0; sec < sectorDims.count(); sec++)
+	{
+		while (cnt < coordCnt && sec == assignedSectors[cnt])
+			cnt++;
+		sectorDataCount[sec+1] = cnt;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	double maxSamples = argc > 1 ? atof(argv[1]) : 1e8;
+	int width = argc > 2 ? atoi(argv[2]) : 256;
+	int threads = argc > 3 ? atoi(argv[3]) : 0;
+	IndType sectorWidth = 8;
+
+	gpuNUFFT::Dimensions gridDims(width, width, width);
+	gpuNUFFT::Dimensions sectorDims((width + sectorWidth - 1) / sectorWidth, (width + sectorWidth - 1) / sectorWidth, (width + sectorWidth - 1) / sectorWidth);
+	gpuNUFFT::ThreadPool pool(threads);
+
+	printf("grid %d^3, %u sectors, %u threads\n", width, sectorDims.count(), pool.getThreadCount());
+	printf("%12s %14s %14s %8s\n", "samples", "reference [s]", "parallel [s]", "speedup");
+
+	srand(1);
+	for (double samples = 1e6; samples <= maxSamples * 1.001; samples *= 10)
+	{
+		IndType coordCnt = (IndType)samples;
+		std::vector<DType> coords(3*coordCnt);
+		std::vector<DType> dens(coordCnt);
+		//kooshball like density, increasing towards the k-space center
+		for (IndType i = 0; i < coordCnt; i++)
+		{
+			DType r = (DType)rand() / RAND_MAX;
+			DType d[3];
+			DType norm = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				d[k] = (DType)rand() / RAND_MAX - 0.5f;
+				norm += d[k] * d[k];
+			}
+			norm = sqrt(norm) + 1e-6f;
+			for (int k = 0; k < 3; k++)
+				coords[i + k*coordCnt] = 0.5f * r * d[k] / norm;
+			dens[i] = r * r;
+		}
+
+		std::vector<DType> trajSorted(3*coordCnt), densSorted(coordCnt);
+		std::vector<IndType> dataIndices(coordCnt), sectorDataCount(sectorDims.count() + 1);
+
+		Clock::time_point start = Clock::now();
+		sortReference(coords, dens, coordCnt, gridDims, sectorDims, sectorWidth, trajSorted, densSorted, dataIndices, sectorDataCount);
+		double reference = secondsSince(start);
+
+		start = Clock::now();
+		sortSamplesBySectorCPU(coords.data(), dens.data(), coordCnt, gridDims, sectorDims, sectorWidth, trajSorted.data(), densSorted.data(), dataIndices.data(), sectorDataCount.data(), &pool);
+		double parallel = secondsSince(start);
+
+		printf("%12u %14.3f %14.3f %7.1fx\n", coordCnt, reference, parallel, reference / parallel);
+	}
+	return 0;
+}
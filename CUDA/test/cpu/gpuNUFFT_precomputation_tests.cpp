@@ -4,6 +4,7 @@
 #include "gtest/gtest.h"
 #include "gpuNUFFT_operator.hpp"
 #include "precomp_utils.hpp"
+#include "gpuNUFFT_cpu_kernels.hpp"
 
 // sort algorithm example
 #include <iostream>   // std::cout
@@ -681,6 +682,208 @@ TEST(PrecomputationTest, AssignSectors3DSorted)
   free(assignedSectors.data);
 }
 
+// compares the parallel counting sort with a stable sort of the assigned
+// sectors
+void checkSortSamplesBySector(gpuNUFFT::Dimensions gridDims,
+                              IndType sectorWidth, IndType coordCnt)
+{
+  bool is3D = gridDims.depth > 0;
+  int dimCount = is3D ? 3 : 2;
+  gpuNUFFT::Dimensions sectorDims =
+      computeSectorCountPerDimension(gridDims, sectorWidth);
+  IndType sectorCount = sectorDims.count();
+
+  std::vector<DType> coords(dimCount * coordCnt);
+  std::vector<DType> dens(coordCnt);
+  unsigned seed = 3;
+  for (IndType i = 0; i < dimCount * coordCnt; i++)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    // include the borders -0.5 and 0.5
+    coords[i] = (DType)((seed >> 8) % 1001) / (DType)1000.0 - (DType)0.5;
+  }
+  for (IndType i = 0; i < coordCnt; i++)
+    dens[i] = (DType)i;
+
+  std::vector<gpuNUFFT::IndPair> expected;
+  for (IndType i = 0; i < coordCnt; i++)
+  {
+    IndType sector;
+    if (is3D)
+    {
+      DType3 coord;
+      coord.x = coords[i];
+      coord.y = coords[i + coordCnt];
+      coord.z = coords[i + 2 * coordCnt];
+      sector = computeInd32Lin(
+          computeSectorMapping(coord, gridDims, (DType)sectorWidth),
+          sectorDims);
+    }
+    else
+    {
+      DType2 coord;
+      coord.x = coords[i];
+      coord.y = coords[i + coordCnt];
+      sector = computeInd22Lin(
+          computeSectorMapping(coord, gridDims, (DType)sectorWidth),
+          sectorDims);
+    }
+    expected.push_back(gpuNUFFT::IndPair(i, sector));
+  }
+  std::stable_sort(expected.begin(), expected.end());
+
+  std::vector<DType> trajSorted(dimCount * coordCnt);
+  std::vector<DType> densSorted(coordCnt);
+  std::vector<IndType> dataIndices(coordCnt);
+  std::vector<IndType> sectorDataCount(sectorCount + 1);
+  gpuNUFFT::ThreadPool pool(4);
+  sortSamplesBySectorCPU(coords.data(), dens.data(), coordCnt, gridDims,
+                         sectorDims, sectorWidth, trajSorted.data(),
+                         densSorted.data(), dataIndices.data(),
+                         sectorDataCount.data(), &pool);
+
+  EXPECT_EQ(0u, sectorDataCount[0]);
+  EXPECT_EQ(coordCnt, sectorDataCount[sectorCount]);
+  IndType sec = 0;
+  for (IndType i = 0; i < coordCnt; i++)
+  {
+    ASSERT_EQ(expected[i].first, dataIndices[i]);
+    while (sectorDataCount[sec + 1] <= i)
+      sec++;
+    EXPECT_EQ(expected[i].second, sec);
+    EXPECT_EQ(dens[expected[i].first], densSorted[i]);
+    for (int d = 0; d < dimCount; d++)
+      EXPECT_EQ(coords[expected[i].first + d * coordCnt],
+                trajSorted[i + d * coordCnt]);
+  }
+}
+
+TEST(PrecomputationTest, SortSamplesBySectorCPU3D)
+{
+  checkSortSamplesBySector(gpuNUFFT::Dimensions(24, 24, 20), 8, 200000);
+}
+
+TEST(PrecomputationTest, SortSamplesBySectorCPU2D)
+{
+  checkSortSamplesBySector(gpuNUFFT::Dimensions(30, 20), 8, 150000);
+}
+
+// visit all cells of the curve, consecutive cells have to be adjacent
+void checkCurveAdjacency(unsigned bits, bool is3D)
+{
+  IndType width = 1u << bits;
+  IndType cellCount = width * width * (is3D ? width : 1);
+  std::vector<IndType3> cells(cellCount);
+  std::vector<bool> visited(cellCount, false);
+  for (IndType ind = 0; ind < cellCount; ind++)
+  {
+    IndType3 cell;
+    cell.x = ind % width;
+    cell.y = (ind / width) % width;
+    cell.z = ind / (width * width);
+    uint64_t curveIndex =
+        computeCurveIndexCPU(gpuNUFFT::HILBERT_CURVE, cell, bits, is3D);
+    ASSERT_LT(curveIndex, (uint64_t)cellCount);
+    ASSERT_FALSE(visited[curveIndex]);
+    visited[curveIndex] = true;
+    cells[curveIndex] = cell;
+  }
+
+  for (IndType i = 1; i < cellCount; i++)
+  {
+    int distance = std::abs((int)cells[i].x - (int)cells[i - 1].x) +
+                   std::abs((int)cells[i].y - (int)cells[i - 1].y) +
+                   std::abs((int)cells[i].z - (int)cells[i - 1].z);
+    EXPECT_EQ(1, distance) << "at curve index " << i;
+  }
+}
+
+TEST(PrecomputationTest, HilbertCurveAdjacency2D)
+{
+  checkCurveAdjacency(1, false);
+  checkCurveAdjacency(4, false);
+}
+
+TEST(PrecomputationTest, HilbertCurveAdjacency3D)
+{
+  checkCurveAdjacency(1, true);
+  checkCurveAdjacency(3, true);
+}
+
+TEST(PrecomputationTest, MortonCurveInterleavesBits)
+{
+  IndType3 cell;
+  cell.x = 5;  // 101
+  cell.y = 3;  // 011
+  cell.z = 6;  // 110
+  // bits z y x from the most significant level: 101 110 011
+  EXPECT_EQ(0x173u, computeCurveIndexCPU(gpuNUFFT::MORTON_CURVE, cell, 3, true));
+  // bits y x: 01 10 11
+  EXPECT_EQ(0x1Bu, computeCurveIndexCPU(gpuNUFFT::MORTON_CURVE, cell, 3, false));
+  EXPECT_EQ(5u + 8u * (3u + 8u * 6u),
+            computeCurveIndexCPU(gpuNUFFT::NO_CURVE, cell, 3, true));
+}
+
+TEST(PrecomputationTest, SortSectorSamplesByCurveCPU)
+{
+  gpuNUFFT::Dimensions gridDims(24, 24, 20);
+  IndType sectorWidth = 8;
+  IndType coordCnt = 20000;
+  gpuNUFFT::Dimensions sectorDims =
+      computeSectorCountPerDimension(gridDims, sectorWidth);
+  IndType sectorCount = sectorDims.count();
+
+  std::vector<DType> coords(3 * coordCnt);
+  std::vector<DType> dens(coordCnt);
+  unsigned seed = 5;
+  for (IndType i = 0; i < 3 * coordCnt; i++)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    coords[i] = (DType)((seed >> 8) % 1001) / (DType)1000.0 - (DType)0.5;
+  }
+  for (IndType i = 0; i < coordCnt; i++)
+    dens[i] = (DType)i;
+
+  std::vector<DType> trajSorted(3 * coordCnt);
+  std::vector<DType> densSorted(coordCnt);
+  std::vector<IndType> dataIndices(coordCnt);
+  std::vector<IndType> sectorDataCount(sectorCount + 1);
+  gpuNUFFT::ThreadPool pool(4);
+  sortSamplesBySectorCPU(coords.data(), dens.data(), coordCnt, gridDims,
+                         sectorDims, sectorWidth, trajSorted.data(),
+                         densSorted.data(), dataIndices.data(),
+                         sectorDataCount.data(), &pool);
+  std::vector<IndType> sectorIndices(dataIndices);
+
+  sortSectorSamplesByCurveCPU(gpuNUFFT::HILBERT_CURVE, trajSorted.data(),
+                              densSorted.data(), dataIndices.data(),
+                              coordCnt, sectorDataCount.data(), sectorCount,
+                              gridDims, &pool);
+
+  // samples stay in their sector and keep their data index
+  for (IndType sec = 0; sec < sectorCount; sec++)
+  {
+    std::vector<IndType> before(sectorIndices.begin() + sectorDataCount[sec],
+                                sectorIndices.begin() +
+                                    sectorDataCount[sec + 1]);
+    std::vector<IndType> after(dataIndices.begin() + sectorDataCount[sec],
+                               dataIndices.begin() + sectorDataCount[sec + 1]);
+    std::sort(before.begin(), before.end());
+    std::sort(after.begin(), after.end());
+    EXPECT_TRUE(before == after);
+  }
+  bool reordered = false;
+  for (IndType i = 0; i < coordCnt; i++)
+  {
+    reordered = reordered || dataIndices[i] != sectorIndices[i];
+    EXPECT_EQ(dens[dataIndices[i]], densSorted[i]);
+    for (int d = 0; d < 3; d++)
+      EXPECT_EQ(coords[dataIndices[i] + d * coordCnt],
+                trajSorted[i + d * coordCnt]);
+  }
+  EXPECT_TRUE(reordered);
+}
+
 TEST(PrecomputationTest, ComputeDataIndices)
 {
   IndType imageWidth = 16;
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+#include "cpuNUFFT_operator.hpp"
+#include "gpuNUFFT_cpu_kernels.hpp"
+
+//Benchmark of the pruned host FFT.
+//
+//Compares the full 3-d FFT of the oversampled grid with the pruned FFT
+//skipping the pencils of the zero padding (forward) and of the cropped away
+//grid points (adjoint) for the oversampling ratios 1.25, 1.5 and 2.
+//
+//usage: runPrunedFFTBenchmark [image width] [threads] [repetitions]
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//exposes the gridding info of the operator
+class InfoCpuNUFFTOperator : public gpuNUFFT::CpuNUFFTOperator
+{
+public:
+	InfoCpuNUFFTOperator(gpuNUFFT::Dimensions imgDims, DType osf, gpuNUFFT::ThreadPool *pool) : gpuNUFFT::CpuNUFFTOperator(3, 8, osf, imgDims, false, pool)
+	{
+	}
+
+	gpuNUFFT::GpuNUFFTInfo *createInfo()
+	{
+		return initGpuNUFFTInfo(1);
+	}
+};
+
+double timeFFT(const gpuNUFFT::CpuFFTPlan &plan, std::vector<CufftType> &grid, const gpuNUFFT::CpuFFTPlan::Support *support, gpuNUFFT::CpuFFTPlan::Pruning pruning, gpuNUFFT::ThreadPool &pool, int repetitions)
+{
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		if (support == NULL)
+			plan.execute(grid.data(), &pool);
+		else
+			plan.executePruned(grid.data(), *support, pruning, &pool);
+	}
+	return 1000 * secondsSince(start) / repetitions;
+}
+
+int main(int argc, char **argv)
+{
+	IndType width = argc > 1 ? (IndType)atoi(argv[1]) : 128;
+	unsigned threads = argc > 2 ? (unsigned)atoi(argv[2]) : 0;
+	int repetitions = argc > 3 ? atoi(argv[3]) : 3;
+
+	gpuNUFFT::ThreadPool pool(threads);
+	gpuNUFFT::Dimensions imgDims(width, width, width);
+	DType osfs[3] = { (DType)1.25, (DType)1.5, (DType)2.0 };
+
+	printf("image %u^3, %u threads\n", (unsigned)width, pool.getThreadCount());
+	printf("%6s %6s %12s %12s %8s %12s %12s %8s\n", "osf", "grid", "forward ms", "pruned ms", "speedup", "adjoint ms", "pruned ms", "speedup");
+	for (int o = 0; o < 3; o++)
+	{
+		InfoCpuNUFFTOperator op(imgDims, osfs[o], &pool);
+		gpuNUFFT::GpuNUFFTInfo *gi_host = op.createInfo();
+		gpuNUFFT::Dimensions gridDims = op.getGridDims();
+		std::vector<CufftType> grid(gridDims.count());
+		for (IndType i = 0; i < grid.size(); i++)
+		{
+			grid[i].x = (DType)rand() / RAND_MAX;
+			grid[i].y = (DType)rand() / RAND_MAX;
+		}
+
+		const gpuNUFFT::CpuFFTPlan &forwardPlan = gpuNUFFT::CpuFFTPlan::getPlan(gridDims, CUFFT_FORWARD);
+		const gpuNUFFT::CpuFFTPlan &inversePlan = gpuNUFFT::CpuFFTPlan::getPlan(gridDims, CUFFT_INVERSE);
+		gpuNUFFT::CpuFFTPlan::Support paddingSupport = computeImageSupportCPU(gi_host, true);
+		gpuNUFFT::CpuFFTPlan::Support cropSupport = computeImageSupportCPU(gi_host, false);
+
+		//warm up the plans and buffers
+		forwardPlan.execute(grid.data(), &pool);
+		inversePlan.execute(grid.data(), &pool);
+
+		double forward = timeFFT(forwardPlan, grid, NULL, gpuNUFFT::CpuFFTPlan::PRUNE_INPUT, pool, repetitions);
+		double forwardPruned = timeFFT(forwardPlan, grid, &paddingSupport, gpuNUFFT::CpuFFTPlan::PRUNE_INPUT, pool, repetitions);
+		double adjoint = timeFFT(inversePlan, grid, NULL, gpuNUFFT::CpuFFTPlan::PRUNE_OUTPUT, pool, repetitions);
+		double adjointPruned = timeFFT(inversePlan, grid, &cropSupport, gpuNUFFT::CpuFFTPlan::PRUNE_OUTPUT, pool, repetitions);
+
+		printf("%6.2f %6u %12.2f %12.2f %8.2f %12.2f %12.2f %8.2f\n", osfs[o], (unsigned)gridDims.width, forward, forwardPruned, forward / forwardPruned, adjoint, adjointPruned, adjoint / adjointPruned);
+		free(gi_host);
+	}
+	return 0;
+}
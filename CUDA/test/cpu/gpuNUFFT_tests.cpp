@@ -1,6 +1,7 @@
 
 #include <limits.h>
 #include "gpuNUFFT_cpu.hpp"
+#include "gpuNUFFT_cpu_simd.hpp"
 
 #include "gtest/gtest.h"
 
@@ -1166,3 +1167,375 @@ TEST(TestGpuNUFFT,CPUTest_Kernel5w64)
 	//free(sectors);
 	//free(sector_centers);
 }
+
+TEST(TestGpuNUFFT,CPUTest_ParallelSectorsKernel3w32)
+{
+	float osr = DEFAULT_OVERSAMPLING_RATIO;
+	int kernel_width = 3;
+
+	long kernel_entries = calculateGrid3KernelSize(osr, kernel_width);
+
+	DType *kern = (DType*) calloc(kernel_entries,sizeof(DType));
+	load1DKernel(kern,kernel_entries,kernel_width,osr);
+
+	int im_width = 32;
+	int sector_width = 8;
+	const int sectors_per_dim = 4;
+	const int sector_count = sectors_per_dim*sectors_per_dim*sectors_per_dim;
+
+	//random samples sorted by sector, including samples on the grid borders
+	int data_entries = 2000;
+	DType* data = (DType*) calloc(2*data_entries,sizeof(DType));
+	DType* coords = (DType*) calloc(3*data_entries,sizeof(DType));
+	int sectors[sector_count+1];
+	int sector_centers[3*sector_count];
+
+	srand(42);
+	int data_cnt = 0;
+	for (int sec = 0; sec < sector_count; sec++)
+	{
+		int sx = sec / (sectors_per_dim*sectors_per_dim);
+		int sy = (sec / sectors_per_dim) % sectors_per_dim;
+		int sz = sec % sectors_per_dim;
+		sector_centers[3*sec] = sx * sector_width + sector_width / 2;
+		sector_centers[3*sec+1] = sy * sector_width + sector_width / 2;
+		sector_centers[3*sec+2] = sz * sector_width + sector_width / 2;
+
+		sectors[sec] = data_cnt;
+		int sec_entries = (sec == sector_count-1) ? data_entries - data_cnt : (sec % 3) * 20;
+		for (int i = 0; i < sec_entries; i++, data_cnt++)
+		{
+			int s[3] = {sx, sy, sz};
+			for (int d = 0; d < 3; d++)
+			{
+				DType r = (DType)rand() / RAND_MAX;
+				coords[3*data_cnt+d] = (s[d] + r) * sector_width / (DType)im_width - 0.5f;
+			}
+			data[2*data_cnt] = (DType)rand() / RAND_MAX - 0.5f;
+			data[2*data_cnt+1] = (DType)rand() / RAND_MAX - 0.5f;
+		}
+	}
+	sectors[sector_count] = data_cnt;
+
+	long grid_size = 2*im_width*im_width*im_width;
+	DType* gdata_serial = (DType*) calloc(grid_size,sizeof(DType));
+	DType* gdata_parallel = (DType*) calloc(grid_size,sizeof(DType));
+
+	gpuNUFFT::ThreadPool serialPool(1);
+	gpuNUFFT::ThreadPool parallelPool(4);
+	gpuNUFFT_cpu(data,coords,gdata_serial,kern,sectors,sector_count,sector_centers,sector_width, kernel_width, kernel_entries,im_width,&serialPool);
+	gpuNUFFT_cpu(data,coords,gdata_parallel,kern,sectors,sector_count,sector_centers,sector_width, kernel_width, kernel_entries,im_width,&parallelPool);
+
+	DType sum = 0;
+	for (long i = 0; i < grid_size; i++)
+	{
+		EXPECT_NEAR(gdata_serial[i],gdata_parallel[i],epsilon);
+		sum += fabs(gdata_serial[i]);
+	}
+	EXPECT_GT(sum, 0.0f);
+
+	free(data);
+	free(coords);
+	free(gdata_serial);
+	free(gdata_parallel);
+	free(kern);
+}
+
+TEST(TestGpuNUFFT,CPUTest_ForwardAdjointnessKernel3w32)
+{
+	float osr = DEFAULT_OVERSAMPLING_RATIO;
+	int kernel_width = 3;
+
+	long kernel_entries = calculateGrid3KernelSize(osr, kernel_width);
+
+	DType *kern = (DType*) calloc(kernel_entries,sizeof(DType));
+	load1DKernel(kern,kernel_entries,kernel_width,osr);
+
+	int im_width = 32;
+	int sector_width = 8;
+	const int sectors_per_dim = 4;
+	const int sector_count = sectors_per_dim*sectors_per_dim*sectors_per_dim;
+
+	int data_entries = 1000;
+	DType* data = (DType*) calloc(2*data_entries,sizeof(DType));
+	DType* coords = (DType*) calloc(3*data_entries,sizeof(DType));
+	int sectors[sector_count+1];
+	int sector_centers[3*sector_count];
+
+	srand(7);
+	int data_cnt = 0;
+	for (int sec = 0; sec < sector_count; sec++)
+	{
+		int s[3] = {sec / (sectors_per_dim*sectors_per_dim), (sec / sectors_per_dim) % sectors_per_dim, sec % sectors_per_dim};
+		for (int d = 0; d < 3; d++)
+			sector_centers[3*sec+d] = s[d] * sector_width + sector_width / 2;
+
+		sectors[sec] = data_cnt;
+		int sec_entries = (sec == sector_count-1) ? data_entries - data_cnt : (sec % 4) * 5;
+		for (int i = 0; i < sec_entries; i++, data_cnt++)
+		{
+			for (int d = 0; d < 3; d++)
+				coords[3*data_cnt+d] = (s[d] + (DType)rand() / RAND_MAX) * sector_width / (DType)im_width - 0.5f;
+			data[2*data_cnt] = (DType)rand() / RAND_MAX - 0.5f;
+			data[2*data_cnt+1] = (DType)rand() / RAND_MAX - 0.5f;
+		}
+	}
+	sectors[sector_count] = data_cnt;
+
+	long grid_size = 2*im_width*im_width*im_width;
+	DType* gdata = (DType*) calloc(grid_size,sizeof(DType));
+	DType* gdata_rand = (DType*) calloc(grid_size,sizeof(DType));
+	for (long i = 0; i < grid_size; i++)
+		gdata_rand[i] = (DType)rand() / RAND_MAX - 0.5f;
+
+	DType* data_forw = (DType*) calloc(2*data_entries,sizeof(DType));
+	DType* data_forw_unsorted = (DType*) calloc(2*data_entries,sizeof(DType));
+	IndType* data_indices = (IndType*) calloc(data_entries,sizeof(IndType));
+	for (int i = 0; i < data_entries; i++)
+		data_indices[i] = (i * 7) % data_entries;
+
+	gpuNUFFT::ThreadPool pool(4);
+	gpuNUFFT_cpu(data,coords,gdata,kern,sectors,sector_count,sector_centers,sector_width, kernel_width, kernel_entries,im_width,&pool);
+	gpuNUFFT_forward_cpu(data_forw,coords,gdata_rand,kern,sectors,sector_count,sector_centers,sector_width, kernel_width, kernel_entries,im_width,NULL,&pool);
+	gpuNUFFT_forward_cpu(data_forw_unsorted,coords,gdata_rand,kern,sectors,sector_count,sector_centers,sector_width, kernel_width, kernel_entries,im_width,data_indices,&pool);
+
+	//<A^H x, y> == <x, A y>
+	double grid_product = 0;
+	for (long i = 0; i < grid_size; i++)
+		grid_product += gdata[i] * gdata_rand[i];
+
+	double data_product = 0;
+	for (int i = 0; i < 2*data_entries; i++)
+		data_product += data[i] * data_forw[i];
+
+	EXPECT_NEAR(1.0, grid_product / data_product, epsilon);
+
+	for (int i = 0; i < data_entries; i++)
+	{
+		EXPECT_EQ(data_forw[2*i], data_forw_unsorted[2*data_indices[i]]);
+		EXPECT_EQ(data_forw[2*i+1], data_forw_unsorted[2*data_indices[i]+1]);
+	}
+
+	free(data);
+	free(coords);
+	free(gdata);
+	free(gdata_rand);
+	free(data_forw);
+	free(data_forw_unsorted);
+	free(data_indices);
+	free(kern);
+}
+
+//creates random samples sorted by sector for the grid described by gi_host
+//and returns the sample count
+int createSectorSortedSamples(gpuNUFFT::GpuNUFFTInfo *gi_host, int samples_per_sector, DType* &data, DType* &coords, int* &sectors, int* &sector_centers)
+{
+	int dims = gi_host->is2Dprocessing ? 2 : 3;
+	int grid[3] = {(int)gi_host->gridDims.x, (int)gi_host->gridDims.y, (int)DEFAULT_VALUE(gi_host->gridDims.z)};
+	int sw = gi_host->sector_width;
+	int sectors_per_dim[3] = {grid[0] / sw, grid[1] / sw, grid[2] / sw};
+	int sector_count = gi_host->sector_count;
+	int data_entries = sector_count * samples_per_sector;
+
+	data = (DType*) calloc(2*data_entries,sizeof(DType));
+	coords = (DType*) calloc(dims*data_entries,sizeof(DType));
+	sectors = (int*) calloc(sector_count+1,sizeof(int));
+	sector_centers = (int*) calloc(dims*sector_count,sizeof(int));
+
+	int data_cnt = 0;
+	for (int sec = 0; sec < sector_count; sec++)
+	{
+		int s[3] = {sec % sectors_per_dim[0], (sec / sectors_per_dim[0]) % sectors_per_dim[1], sec / (sectors_per_dim[0]*sectors_per_dim[1])};
+		for (int d = 0; d < dims; d++)
+			sector_centers[dims*sec+d] = s[d] * sw + sw / 2;
+
+		sectors[sec] = data_cnt;
+		//leave every third sector empty
+		int sec_entries = (sec % 3 == 1) ? 0 : samples_per_sector;
+		for (int i = 0; i < sec_entries; i++, data_cnt++)
+		{
+			//grid positions which are rounded into the sector, see computeSectorMapping
+			for (int d = 0; d < dims; d++)
+				coords[dims*data_cnt+d] = ((s[d] + 0.99f * (DType)rand() / RAND_MAX) * sw - 0.49f) / (DType)grid[d] - 0.5f;
+			data[2*data_cnt] = (DType)rand() / RAND_MAX - 0.5f;
+			data[2*data_cnt+1] = (DType)rand() / RAND_MAX - 0.5f;
+		}
+	}
+	sectors[sector_count] = data_cnt;
+	return data_cnt;
+}
+
+//direct evaluation of the gridding for all grid points
+void gridBruteForce(DType* data, DType* coords, int data_entries, DType* gdata, DType* kern, gpuNUFFT::GpuNUFFTInfo *gi_host)
+{
+	int dims = gi_host->is2Dprocessing ? 2 : 3;
+	int grid[3] = {(int)gi_host->gridDims.x, (int)gi_host->gridDims.y, (int)DEFAULT_VALUE(gi_host->gridDims.z)};
+	DType scale[3] = {gi_host->aniso_x_scale, gi_host->aniso_y_scale, gi_host->aniso_z_scale};
+
+	for (int n = 0; n < data_entries; n++)
+		for (int z = 0; z < grid[2]; z++)
+			for (int y = 0; y < grid[1]; y++)
+				for (int x = 0; x < grid[0]; x++)
+				{
+					int pos[3] = {x, y, z};
+					DType val = 1.0f;
+					for (int d = 0; d < dims && val != 0.0f; d++)
+					{
+						DType dist = (static_cast<DType>(pos[d]) / static_cast<DType>(grid[d]) - 0.5f - coords[dims*n+d]) * scale[d];
+						dist *= dist;
+						if (dist < gi_host->radiusSquared)
+							val *= kern[(int)round(dist * gi_host->dist_multiplier)];
+						else
+							val = 0.0f;
+					}
+					int ind = 2*(x + grid[0] * (y + grid[1] * z));
+					gdata[ind] += val * data[2*n];
+					gdata[ind+1] += val * data[2*n+1];
+				}
+}
+
+void checkGridding(gpuNUFFT::Dimensions gridDims)
+{
+	float osr = DEFAULT_OVERSAMPLING_RATIO;
+	int kernel_width = 3;
+	long kernel_entries = calculateGrid3KernelSize(osr, kernel_width);
+	DType *kern = (DType*) calloc(kernel_entries,sizeof(DType));
+	load1DKernel(kern,kernel_entries,kernel_width,osr);
+
+	gpuNUFFT::GpuNUFFTInfo gi_host;
+	initGpuNUFFTInfoCPU(&gi_host, gridDims, 8, kernel_width, kernel_entries);
+
+	DType *data, *coords;
+	int *sectors, *sector_centers;
+	srand(11);
+	int data_entries = createSectorSortedSamples(&gi_host, 10, data, coords, sectors, sector_centers);
+
+	long grid_size = 2*gi_host.gridDims_count;
+	DType* gdata = (DType*) calloc(grid_size,sizeof(DType));
+	DType* gdata_ref = (DType*) calloc(grid_size,sizeof(DType));
+
+	gpuNUFFT::ThreadPool pool(4);
+	gpuNUFFT_cpu(data,coords,gdata,kern,sectors,sector_centers,&gi_host,&pool);
+	gridBruteForce(data,coords,data_entries,gdata_ref,kern,&gi_host);
+
+	DType sum = 0;
+	for (long i = 0; i < grid_size; i++)
+	{
+		EXPECT_NEAR(gdata_ref[i],gdata[i],epsilon);
+		sum += fabs(gdata[i]);
+	}
+	EXPECT_GT(sum, 0.0f);
+
+	//<A^H x, y> == <x, A y>
+	DType* gdata_rand = (DType*) calloc(grid_size,sizeof(DType));
+	for (long i = 0; i < grid_size; i++)
+		gdata_rand[i] = (DType)rand() / RAND_MAX - 0.5f;
+	DType* data_forw = (DType*) calloc(2*data_entries,sizeof(DType));
+	gpuNUFFT_forward_cpu(data_forw,coords,gdata_rand,kern,sectors,sector_centers,&gi_host,NULL,&pool);
+
+	double grid_product = 0;
+	for (long i = 0; i < grid_size; i++)
+		grid_product += gdata[i] * gdata_rand[i];
+	double data_product = 0;
+	for (int i = 0; i < 2*data_entries; i++)
+		data_product += data[i] * data_forw[i];
+	EXPECT_NEAR(1.0, grid_product / data_product, epsilon);
+
+	free(data);
+	free(coords);
+	free(sectors);
+	free(sector_centers);
+	free(gdata);
+	free(gdata_ref);
+	free(gdata_rand);
+	free(data_forw);
+	free(kern);
+}
+
+TEST(TestGpuNUFFT,CPUTest_2DKernel3w32)
+{
+	checkGridding(gpuNUFFT::Dimensions(32,32));
+}
+
+TEST(TestGpuNUFFT,CPUTest_2DAnisotropicKernel3w40x24)
+{
+	checkGridding(gpuNUFFT::Dimensions(40,24));
+}
+
+TEST(TestGpuNUFFT,CPUTest_3DAnisotropicKernel3w32x24x16)
+{
+	checkGridding(gpuNUFFT::Dimensions(32,24,16));
+}
+
+TEST(TestGpuNUFFT,CPUTest_CubicGridInfo)
+{
+	gpuNUFFT::GpuNUFFTInfo gi_host;
+	initGpuNUFFTInfoCPU(&gi_host, gpuNUFFT::Dimensions(32,32,32), 8, 3, 1000);
+
+	EXPECT_FALSE(gi_host.is2Dprocessing);
+	EXPECT_EQ(64, gi_host.sector_count);
+	EXPECT_EQ(10, gi_host.sector_pad_width);
+	EXPECT_EQ(1000, gi_host.sector_dim);
+	EXPECT_EQ(5, gi_host.sector_offset);
+	EXPECT_NEAR(1.0f, gi_host.aniso_z_scale, epsilon);
+
+	initGpuNUFFTInfoCPU(&gi_host, gpuNUFFT::Dimensions(32,16), 8, 3, 1000);
+	EXPECT_TRUE(gi_host.is2Dprocessing);
+	EXPECT_EQ(8, gi_host.sector_count);
+	EXPECT_EQ(100, gi_host.sector_dim);
+	EXPECT_NEAR(0.5f, gi_host.aniso_y_scale, epsilon);
+}
+
+TEST(TestGpuNUFFT,CPUTest_SimdLevelsAgree)
+{
+	float osr = DEFAULT_OVERSAMPLING_RATIO;
+	int kernel_width = 5;
+	long kernel_entries = calculateGrid3KernelSize(osr, kernel_width);
+	DType *kern = (DType*) calloc(kernel_entries,sizeof(DType));
+	load1DKernel(kern,kernel_entries,kernel_width,osr);
+
+	gpuNUFFT::GpuNUFFTInfo gi_host;
+	initGpuNUFFTInfoCPU(&gi_host, gpuNUFFT::Dimensions(32,24,16), 8, kernel_width, kernel_entries);
+
+	DType *data, *coords;
+	int *sectors, *sector_centers;
+	srand(5);
+	int data_entries = createSectorSortedSamples(&gi_host, 10, data, coords, sectors, sector_centers);
+
+	long grid_size = 2*gi_host.gridDims_count;
+	DType* gdata_rand = (DType*) calloc(grid_size,sizeof(DType));
+	for (long i = 0; i < grid_size; i++)
+		gdata_rand[i] = (DType)rand() / RAND_MAX - 0.5f;
+
+	gpuNUFFT::CpuSimdLevel defaultLevel = gpuNUFFT::getCpuSimdLevel();
+	std::vector<std::vector<DType> > gdata, data_forw;
+	for (int level = gpuNUFFT::SIMD_SCALAR; level <= gpuNUFFT::getSupportedCpuSimdLevel(); level++)
+	{
+		gpuNUFFT::setCpuSimdLevel((gpuNUFFT::CpuSimdLevel)level);
+		EXPECT_EQ(level, gpuNUFFT::getCpuSimdLevel());
+
+		gdata.push_back(std::vector<DType>(grid_size, 0.0f));
+		data_forw.push_back(std::vector<DType>(2*data_entries, 0.0f));
+		gpuNUFFT_cpu(data,coords,gdata.back().data(),kern,sectors,sector_centers,&gi_host);
+		gpuNUFFT_forward_cpu(data_forw.back().data(),coords,gdata_rand,kern,sectors,sector_centers,&gi_host);
+	}
+	//unsupported levels fall back to the supported level
+	gpuNUFFT::setCpuSimdLevel(gpuNUFFT::SIMD_AVX512);
+	EXPECT_EQ(gpuNUFFT::getSupportedCpuSimdLevel(), gpuNUFFT::getCpuSimdLevel());
+	gpuNUFFT::setCpuSimdLevel(defaultLevel);
+
+	for (size_t level = 1; level < gdata.size(); level++)
+	{
+		for (long i = 0; i < grid_size; i++)
+			EXPECT_NEAR(gdata[0][i],gdata[level][i],epsilon);
+		for (int i = 0; i < 2*data_entries; i++)
+			EXPECT_NEAR(data_forw[0][i],data_forw[level][i],epsilon);
+	}
+
+	free(data);
+	free(coords);
+	free(sectors);
+	free(sector_centers);
+	free(gdata_rand);
+	free(kern);
+}
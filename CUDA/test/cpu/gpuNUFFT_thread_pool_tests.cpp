@@ -0,0 +1,125 @@
+#include <limits.h>
+#include <stdexcept>
+#include <vector>
+#include "thread_pool.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(ThreadPoolTest, ProcessAllItemsOnce)
+{
+	gpuNUFFT::ThreadPool pool(4);
+	EXPECT_EQ(4u, pool.getThreadCount());
+
+	const IndType count = 1000;
+	std::vector<int> visits(count, 0);
+	std::vector<int> threadIds(count, -1);
+
+	for (int run = 0; run < 10; run++)
+	{
+		pool.parallelFor(count, [&](IndType item, unsigned threadId)
+		{
+			visits[item]++;
+			threadIds[item] = threadId;
+		});
+	}
+
+	for (IndType i = 0; i < count; i++)
+	{
+		EXPECT_EQ(10, visits[i]);
+		EXPECT_LT(threadIds[i], 4);
+	}
+}
+
+TEST(ThreadPoolTest, NestedCallsRunSerially)
+{
+	gpuNUFFT::ThreadPool pool(3);
+	std::vector<int> visits(100, 0);
+
+	pool.parallelFor(10, [&](IndType outer, unsigned threadId)
+	{
+		pool.parallelFor(10, [&](IndType inner, unsigned innerThreadId)
+		{
+			EXPECT_EQ(0u, innerThreadId);
+			visits[outer * 10 + inner]++;
+		});
+	});
+
+	for (int i = 0; i < 100; i++)
+		EXPECT_EQ(1, visits[i]);
+}
+
+TEST(ThreadPoolTest, RethrowTaskException)
+{
+	gpuNUFFT::ThreadPool pool(4);
+
+	EXPECT_THROW(pool.parallelFor(100, [&](IndType item, unsigned threadId)
+	{
+		if (item == 50)
+			throw std::runtime_error("task failed");
+	}), std::runtime_error);
+
+	// pool remains usable
+	int count = 0;
+	pool.parallelFor(1, [&](IndType item, unsigned threadId) { count++; });
+	EXPECT_EQ(1, count);
+}
+
+TEST(ThreadPoolTest, WorkStealingProcessesAllItemsOnce)
+{
+	gpuNUFFT::ThreadPool pool(4);
+
+	const IndType count = 500;
+	std::vector<int> visits(count, 0);
+
+	for (int run = 0; run < 10; run++)
+	{
+		// descending cost as produced by a sector processing order
+		pool.parallelForStealing(count, [&](IndType item, unsigned threadId)
+		{
+			volatile double sum = 0;
+			for (IndType i = 0; i < 100 * (count - item); i++)
+				sum += i;
+			visits[item]++;
+		});
+	}
+
+	for (IndType i = 0; i < count; i++)
+		EXPECT_EQ(10, visits[i]);
+
+	std::vector<gpuNUFFT::ThreadPool::ThreadStatistics> stats = pool.getThreadStatistics();
+	ASSERT_EQ(4u, stats.size());
+	IndType tasks = 0;
+	for (size_t t = 0; t < stats.size(); t++)
+	{
+		tasks += stats[t].tasks;
+		EXPECT_LE(stats[t].stolenTasks, stats[t].tasks);
+		EXPECT_GE(stats[t].idleSeconds, 0.0);
+	}
+	EXPECT_EQ(10 * count, tasks);
+	EXPECT_GT(stats[0].busySeconds, 0.0);
+
+	pool.resetThreadStatistics();
+	stats = pool.getThreadStatistics();
+	for (size_t t = 0; t < stats.size(); t++)
+	{
+		EXPECT_EQ(0u, stats[t].tasks);
+		EXPECT_EQ(0.0, stats[t].busySeconds);
+	}
+}
+
+TEST(ThreadPoolTest, WorkStealingRethrowTaskException)
+{
+	gpuNUFFT::ThreadPool pool(3);
+
+	EXPECT_THROW(pool.parallelForStealing(100, [&](IndType item, unsigned threadId)
+	{
+		if (item == 10)
+			throw std::runtime_error("task failed");
+	}), std::runtime_error);
+
+	// pool remains usable
+	std::vector<int> visits(50, 0);
+	pool.parallelForStealing(50, [&](IndType item, unsigned threadId) { visits[item]++; });
+	for (int i = 0; i < 50; i++)
+		EXPECT_EQ(1, visits[i]);
+}